@@ -0,0 +1,701 @@
+/////////////////////////////////////////////////////////////////////////////
+// cp210x-bench.cpp
+//
+// Throughput benchmark of libcp210x against simulated devices (see
+// CP210xSim.h). For every device count it measures enumeration, open/close,
+// the getter hot path and a full station cycle: program, reset and wait for
+// re-enumeration, verify, lock. Each phase reports devices per second,
+// per-operation latency and heap allocations (operator new) made while it
+// ran. --json writes the same numbers in a form meant to be kept and
+// compared across commits. With --virtual-time the simulated latencies and
+// the waits for re-enumeration pass on a virtual clock, so the timings are
+// the library's own cost.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "CP210xManufacturing.h"
+#include "CP210xSim.h"
+#include "OsDep.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210X_BENCH_VERSION
+#define CP210X_BENCH_VERSION        "unknown"
+#endif
+
+// Exception specification of the replaced operator delete
+#if __cplusplus >= 201103L
+#define BENCH_NOTHROW               noexcept
+#else
+#define BENCH_NOTHROW               throw()
+#endif
+
+#define BENCH_MAX_STRLEN            256
+#define BENCH_REENUM_TIMEOUT_MSEC   30000
+#define BENCH_GETTER_OPS            4096    // getter calls per device count, at least one round
+
+// CP2102N config block fields touched by the lock step
+#define CP2102N_CONFIG_SIZE             0x2a6
+#define CP2102N_CONFIG_UPDATE_OFFSET    4
+#define CP2102N_CONFIG_UNLOCKED         0xff
+
+static const DWORD DefaultCounts[] = { 1, 8, 32, 128, 512 };
+
+struct CBenchOptions
+{
+    BYTE partNum;
+    std::vector<DWORD> counts;
+    DWORD enumRepeat;
+    DWORD transferUsec;
+    DWORD openUsec;
+    DWORD reenumerationMsec;
+    bool virtualTime;
+    const char* jsonPath;
+};
+
+struct CPhaseResult
+{
+    DWORD devices;
+    const char* phase;
+    DWORD ops;
+    double devicesPerOp;    // devices an operation covers, for devices/s
+    double seconds;
+    double meanUsec;
+    double p50Usec;
+    double p99Usec;
+    double maxUsec;
+    unsigned long allocs;
+    unsigned long allocBytes;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Allocation counting
+/////////////////////////////////////////////////////////////////////////////
+
+// Replacing the global operators counts the allocations of libcp210x too.
+// Every form that allocates is replaced, so none goes uncounted.
+static volatile unsigned long AllocCount;
+static volatile unsigned long AllocBytes;
+
+static void* CountedAlloc(size_t size)
+{
+    __sync_fetch_and_add(&AllocCount, 1);
+    __sync_fetch_and_add(&AllocBytes, size);
+
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* p = CountedAlloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) BENCH_NOTHROW
+{
+    return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) BENCH_NOTHROW
+{
+    return CountedAlloc(size);
+}
+
+void operator delete(void* p) BENCH_NOTHROW
+{
+    free(p);
+}
+
+void operator delete[](void* p) BENCH_NOTHROW
+{
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) BENCH_NOTHROW
+{
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) BENCH_NOTHROW
+{
+    free(p);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) BENCH_NOTHROW
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) BENCH_NOTHROW
+{
+    free(p);
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// Helpers
+/////////////////////////////////////////////////////////////////////////////
+
+static double NowUsec()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// The simulated devices run on the OS clock, virtual with --virtual-time
+static uint64_t OsClockNowUsec()
+{
+    return GetOsClock()->NowUsec();
+}
+
+static void OsClockSleepUsec(uint64_t usec)
+{
+    GetOsClock()->SleepUsec(usec);
+}
+
+static void Check(CP210x_STATUS status, const char* what)
+{
+    if (status != CP210x_SUCCESS) {
+        fprintf(stderr, "cp210x-bench: %s failed with status 0x%02x\n", what, status);
+        exit(1);
+    }
+}
+
+static void Fail(const char* what)
+{
+    fprintf(stderr, "cp210x-bench: %s\n", what);
+    exit(1);
+}
+
+static bool IsCP2102N(BYTE partNum)
+{
+    return partNum >= CP210x_CP2102N_QFN28_VERSION && partNum <= CP210x_CP2102N_QFN20_VERSION;
+}
+
+static void SerialFor(DWORD index, char* serial)
+{
+    sprintf(serial, "BENCH%06u", static_cast<unsigned int>(index));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CPhase Class
+/////////////////////////////////////////////////////////////////////////////
+
+// Times the operations of one phase from Start() to Finish(). The sample
+// buffer is reserved up front so the bench itself doesn't show up in the
+// allocation counts.
+class CPhase
+{
+public:
+    CPhase(DWORD devices, const char* phase, DWORD maxOps) : m_devices(devices), m_phase(phase) {
+        m_samples.reserve(maxOps);
+        Start();
+    }
+
+    void Start() {
+        m_allocs = AllocCount;
+        m_allocBytes = AllocBytes;
+        m_start = NowUsec();
+    }
+
+    void Begin() {
+        m_opStart = NowUsec();
+    }
+    // Returns the latency of the operation
+    double End() {
+        return Add(NowUsec() - m_opStart);
+    }
+    // Records the latency of an operation timed by the caller
+    double Add(double usec) {
+        m_samples.push_back(usec);
+        return usec;
+    }
+
+    CPhaseResult Finish();
+
+private:
+    DWORD m_devices;
+    const char* m_phase;
+    std::vector<double> m_samples;
+    unsigned long m_allocs;
+    unsigned long m_allocBytes;
+    double m_start;
+    double m_opStart;
+};
+
+CPhaseResult CPhase::Finish()
+{
+    CPhaseResult r;
+
+    r.seconds = (NowUsec() - m_start) / 1e6;
+    r.allocs = AllocCount - m_allocs;
+    r.allocBytes = AllocBytes - m_allocBytes;
+    r.devices = m_devices;
+    r.phase = m_phase;
+    r.ops = static_cast<DWORD>(m_samples.size());
+    r.devicesPerOp = 1;
+    r.meanUsec = r.p50Usec = r.p99Usec = r.maxUsec = 0;
+
+    if (!m_samples.empty()) {
+        double sum = 0;
+
+        std::sort(m_samples.begin(), m_samples.end());
+        for (size_t i = 0; i < m_samples.size(); i++) {
+            sum += m_samples[i];
+        }
+        r.meanUsec = sum / m_samples.size();
+        r.p50Usec = m_samples[m_samples.size() / 2];
+        r.p99Usec = m_samples[(m_samples.size() * 99) / 100 < m_samples.size() ? (m_samples.size() * 99) / 100 : m_samples.size() - 1];
+        r.maxUsec = m_samples.back();
+    }
+    return r;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Phases
+/////////////////////////////////////////////////////////////////////////////
+
+static CPhaseResult BenchEnumerate(DWORD devices, DWORD repeat)
+{
+    CPhase phase(devices, "enumerate", repeat);
+
+    for (DWORD i = 0; i < repeat; i++) {
+        DWORD num = 0;
+
+        phase.Begin();
+        Check(CP210x_GetNumDevices(&num), "CP210x_GetNumDevices");
+        phase.End();
+        if (num != devices) {
+            Fail("enumeration found an unexpected number of devices");
+        }
+    }
+
+    CPhaseResult r = phase.Finish();
+    r.devicesPerOp = devices;
+    return r;
+}
+
+static CPhaseResult BenchOpen(DWORD devices)
+{
+    CPhase phase(devices, "open", devices);
+
+    for (DWORD i = 0; i < devices; i++) {
+        HANDLE h;
+
+        phase.Begin();
+        Check(CP210x_Open(i, &h), "CP210x_Open");
+        Check(CP210x_Close(h), "CP210x_Close");
+        phase.End();
+    }
+    return phase.Finish();
+}
+
+// The reads every station does over and over: identity and strings
+static CPhaseResult BenchGetters(DWORD devices)
+{
+    const DWORD rounds = (BENCH_GETTER_OPS / 5 + devices - 1) / devices;
+    std::vector<HANDLE> handles(devices);
+    BYTE str[BENCH_MAX_STRLEN];
+    BYTE length;
+    BYTE partNum;
+    WORD word;
+
+    for (DWORD i = 0; i < devices; i++) {
+        Check(CP210x_Open(i, &handles[i]), "CP210x_Open");
+    }
+
+    CPhase phase(devices, "getters", rounds * devices * 5);
+    for (DWORD r = 0; r < rounds; r++) {
+        for (DWORD i = 0; i < devices; i++) {
+            phase.Begin();
+            Check(CP210x_GetPartNumber(handles[i], &partNum), "CP210x_GetPartNumber");
+            phase.End();
+            phase.Begin();
+            Check(CP210x_GetDeviceVid(handles[i], &word), "CP210x_GetDeviceVid");
+            phase.End();
+            phase.Begin();
+            Check(CP210x_GetDevicePid(handles[i], &word), "CP210x_GetDevicePid");
+            phase.End();
+            phase.Begin();
+            Check(CP210x_GetDeviceProductString(handles[i], str, &length, TRUE), "CP210x_GetDeviceProductString");
+            phase.End();
+            phase.Begin();
+            Check(CP210x_GetDeviceSerialNumber(handles[i], str, &length, TRUE), "CP210x_GetDeviceSerialNumber");
+            phase.End();
+        }
+    }
+    CPhaseResult result = phase.Finish();
+    result.devicesPerOp = 1.0 / 5;
+
+    for (DWORD i = 0; i < devices; i++) {
+        Check(CP210x_Close(handles[i]), "CP210x_Close");
+    }
+    return result;
+}
+
+static void Program(HANDLE h, DWORD index)
+{
+    static const char product[] = "cp210x-bench station";
+    char serial[BENCH_MAX_STRLEN];
+
+    SerialFor(index, serial);
+    Check(CP210x_SetProductString(h, const_cast<char*>(product), sizeof(product) - 1, TRUE), "CP210x_SetProductString");
+    Check(CP210x_SetSerialNumber(h, serial, static_cast<BYTE>(strlen(serial)), TRUE), "CP210x_SetSerialNumber");
+    Check(CP210x_SetDeviceVersion(h, 0x0200), "CP210x_SetDeviceVersion");
+    Check(CP210x_SetMaxPower(h, 0x3C), "CP210x_SetMaxPower");
+}
+
+// The device is reopened by index after re-enumeration, so its serial
+// number tells which one it is
+static void Verify(HANDLE h)
+{
+    BYTE str[BENCH_MAX_STRLEN];
+    BYTE length = 0;
+    WORD version = 0;
+    BYTE maxPower = 0;
+
+    Check(CP210x_GetDeviceProductString(h, str, &length, TRUE), "CP210x_GetDeviceProductString");
+    if (length != strlen("cp210x-bench station") || memcmp(str, "cp210x-bench station", length)) {
+        Fail("product string verification failed");
+    }
+    Check(CP210x_GetDeviceSerialNumber(h, str, &length, TRUE), "CP210x_GetDeviceSerialNumber");
+    if (length < 5 || memcmp(str, "BENCH", 5)) {
+        Fail("serial number verification failed");
+    }
+    Check(CP210x_GetDeviceVersion(h, &version), "CP210x_GetDeviceVersion");
+    Check(CP210x_GetMaxPower(h, &maxPower), "CP210x_GetMaxPower");
+    if (version != 0x0200 || maxPower != 0x3C) {
+        Fail("descriptor verification failed after reset");
+    }
+}
+
+// Locks the same way smt does: the CP2102N through its config block, parts
+// without a lock are left alone
+static void Lock(HANDLE h, BYTE partNum)
+{
+    if (IsCP2102N(partNum)) {
+        BYTE config[CP2102N_CONFIG_SIZE];
+
+        Check(CP210x_GetConfig(h, config, sizeof(config)), "CP210x_GetConfig");
+        config[CP2102N_CONFIG_UPDATE_OFFSET] = 0;
+        Check(CP210x_SetConfig(h, config, sizeof(config)), "CP210x_SetConfig");
+        Check(CP210x_GetConfig(h, config, sizeof(config)), "CP210x_GetConfig");
+        if (config[CP2102N_CONFIG_UPDATE_OFFSET] == CP2102N_CONFIG_UNLOCKED) {
+            Fail("lock verification failed");
+        }
+    } else {
+        BYTE lockValue = 0;
+
+        const CP210x_STATUS status = CP210x_SetLockValue(h);
+
+        // The CP2101 can't be locked
+        if (status == CP210x_FUNCTION_NOT_SUPPORTED) {
+            return;
+        }
+        Check(status, "CP210x_SetLockValue");
+        Check(CP210x_GetLockValue(h, &lockValue), "CP210x_GetLockValue");
+        if (!lockValue) {
+            Fail("lock verification failed");
+        }
+    }
+}
+
+static void WaitForDevices(DWORD devices)
+{
+    const double deadline = NowUsec() + BENCH_REENUM_TIMEOUT_MSEC * 1e3;
+
+    for (;;) {
+        DWORD num = 0;
+
+        Check(CP210x_GetNumDevices(&num), "CP210x_GetNumDevices");
+        if (num == devices) {
+            return;
+        }
+        if (NowUsec() > deadline) {
+            Fail("devices failed to re-enumerate after reset");
+        }
+        Sleep(1);
+    }
+}
+
+// Program, reset, verify and lock every device the way smt does: all
+// devices are opened and programmed first, then reset through the handles
+// already held, since a reset changes the indexes of the devices that
+// follow. The steps are timed per device. "cycle" covers the whole run for
+// devices/s, its latency per device is the sum of the device's steps and
+// the wait for re-enumeration every device goes through.
+static void BenchCycle(DWORD devices, BYTE partNum, std::vector<CPhaseResult>& results)
+{
+    CPhase cycle(devices, "cycle", devices);
+    CPhase program(devices, "program", devices);
+    CPhase reset(devices, "reset", devices);
+    CPhase verify(devices, "verify", devices);
+    CPhase lock(devices, "lock", devices);
+    std::vector<HANDLE> handles(devices);
+    std::vector<double> deviceUsec(devices);
+    double waitUsec;
+    HANDLE h;
+
+    cycle.Start();
+    program.Start();
+    for (DWORD i = 0; i < devices; i++) {
+        program.Begin();
+        Check(CP210x_Open(i, &handles[i]), "CP210x_Open");
+        Program(handles[i], i);
+        deviceUsec[i] = program.End();
+    }
+    results.push_back(program.Finish());
+
+    reset.Start();
+    for (DWORD i = 0; i < devices; i++) {
+        reset.Begin();
+        Check(CP210x_Reset(handles[i]), "CP210x_Reset");
+        Check(CP210x_Close(handles[i]), "CP210x_Close");
+        deviceUsec[i] += reset.End();
+    }
+    waitUsec = NowUsec();
+    WaitForDevices(devices);
+    waitUsec = NowUsec() - waitUsec;
+    results.push_back(reset.Finish());
+
+    verify.Start();
+    for (DWORD i = 0; i < devices; i++) {
+        verify.Begin();
+        Check(CP210x_Open(i, &h), "CP210x_Open");
+        Verify(h);
+        Check(CP210x_Close(h), "CP210x_Close");
+        deviceUsec[i] += verify.End();
+    }
+    results.push_back(verify.Finish());
+
+    lock.Start();
+    for (DWORD i = 0; i < devices; i++) {
+        lock.Begin();
+        Check(CP210x_Open(i, &h), "CP210x_Open");
+        Lock(h, partNum);
+        Check(CP210x_Close(h), "CP210x_Close");
+        deviceUsec[i] += lock.End();
+    }
+    results.push_back(lock.Finish());
+
+    for (DWORD i = 0; i < devices; i++) {
+        cycle.Add(deviceUsec[i] + waitUsec);
+    }
+    results.push_back(cycle.Finish());
+}
+
+static void RunCount(const CBenchOptions& opt, DWORD devices, std::vector<CPhaseResult>& results)
+{
+    Check(CP210xSim_RemoveAllDevices(), "CP210xSim_RemoveAllDevices");
+    for (DWORD i = 0; i < devices; i++) {
+        Check(CP210xSim_AddDevice(opt.partNum, 0, 0, NULL, NULL), "CP210xSim_AddDevice");
+    }
+
+    results.push_back(BenchEnumerate(devices, opt.enumRepeat));
+    results.push_back(BenchOpen(devices));
+    results.push_back(BenchGetters(devices));
+    BenchCycle(devices, opt.partNum, results);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Output
+/////////////////////////////////////////////////////////////////////////////
+
+static void PrintTable(const std::vector<CPhaseResult>& results)
+{
+    printf("%7s %-10s %8s %12s %10s %10s %10s %10s %10s\n",
+           "devices", "phase", "ops", "devices/s", "mean us", "p50 us", "p99 us", "max us", "allocs/op");
+    for (size_t i = 0; i < results.size(); i++) {
+        const CPhaseResult& r = results[i];
+
+        printf("%7u %-10s %8u %12.1f %10.1f %10.1f %10.1f %10.1f %10.2f\n",
+               static_cast<unsigned int>(r.devices), r.phase, static_cast<unsigned int>(r.ops),
+               r.seconds > 0 ? r.ops * r.devicesPerOp / r.seconds : 0.0,
+               r.meanUsec, r.p50Usec, r.p99Usec, r.maxUsec,
+               r.ops ? static_cast<double>(r.allocs) / r.ops : 0.0);
+    }
+}
+
+static void WriteJson(FILE* f, const CBenchOptions& opt, const std::vector<CPhaseResult>& results)
+{
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"cp210x-bench\",\n");
+    fprintf(f, "  \"version\": \"%s\",\n", CP210X_BENCH_VERSION);
+    fprintf(f, "  \"part\": \"0x%02x\",\n", opt.partNum);
+    fprintf(f, "  \"latency\": { \"transfer_usec\": %u, \"open_usec\": %u, \"reenumeration_msec\": %u },\n",
+            static_cast<unsigned int>(opt.transferUsec), static_cast<unsigned int>(opt.openUsec),
+            static_cast<unsigned int>(opt.reenumerationMsec));
+    fprintf(f, "  \"virtual_time\": %s,\n", opt.virtualTime ? "true" : "false");
+    fprintf(f, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const CPhaseResult& r = results[i];
+
+        fprintf(f, "    { \"devices\": %u, \"phase\": \"%s\", \"ops\": %u, \"seconds\": %.6f, "
+                   "\"devices_per_sec\": %.3f, \"ops_per_sec\": %.3f, "
+                   "\"latency_usec\": { \"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f }, "
+                   "\"allocs\": %lu, \"alloc_bytes\": %lu }%s\n",
+                static_cast<unsigned int>(r.devices), r.phase, static_cast<unsigned int>(r.ops), r.seconds,
+                r.seconds > 0 ? r.ops * r.devicesPerOp / r.seconds : 0.0,
+                r.seconds > 0 ? r.ops / r.seconds : 0.0,
+                r.meanUsec, r.p50Usec, r.p99Usec, r.maxUsec,
+                r.allocs, r.allocBytes,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// main
+/////////////////////////////////////////////////////////////////////////////
+
+static void PrintUsage()
+{
+    printf(
+"Usage: cp210x-bench [options]\n"
+"Benchmarks libcp210x against simulated CP210x devices.\n"
+"Options\n"
+"--part <hex>\n"
+"    Part number of the simulated devices, e.g. 04 or 20. Default: 04.\n"
+"--counts <n>[,<n>...]\n"
+"    Device counts to run. Default: 1,8,32,128,512.\n"
+"--enum-repeat <n>\n"
+"    Enumerations timed per device count. Default: 20.\n"
+"--latency <transfer usec>[,<open usec>[,<re-enumeration msec>]]\n"
+"    Simulated USB timing. Default: 0,0,0.\n"
+"--virtual-time\n"
+"    Runs the simulated timing and the waits on a virtual clock.\n"
+"--json <file>\n"
+"    Also writes the results as JSON, \"-\" for stdout.\n"
+"--help\n"
+"    Output this page.\n"
+    );
+}
+
+static void ParseArgs(int argc, const char* argv[], CBenchOptions& opt)
+{
+    opt.partNum = CP210x_CP2104_VERSION;
+    opt.enumRepeat = 20;
+    opt.transferUsec = opt.openUsec = opt.reenumerationMsec = 0;
+    opt.virtualTime = false;
+    opt.jsonPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (arg == "--help") {
+            PrintUsage();
+            exit(0);
+        }
+        if (arg == "--virtual-time") {
+            opt.virtualTime = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "cp210x-bench: invalid or incomplete option %s\n", argv[i]);
+            exit(2);
+        }
+
+        const char* val = argv[++i];
+        if (arg == "--part") {
+            opt.partNum = static_cast<BYTE>(strtoul(val, NULL, 16));
+        } else if (arg == "--counts") {
+            char* end;
+
+            opt.counts.clear();
+            for (const char* p = val; *p; p = (*end == ',') ? end + 1 : end) {
+                const unsigned long n = strtoul(p, &end, 10);
+
+                if (end == p || !n) {
+                    fprintf(stderr, "cp210x-bench: invalid device count list %s\n", val);
+                    exit(2);
+                }
+                opt.counts.push_back(n);
+            }
+        } else if (arg == "--enum-repeat") {
+            opt.enumRepeat = strtoul(val, NULL, 10);
+        } else if (arg == "--latency") {
+            unsigned int t = 0, o = 0, r = 0;
+
+            sscanf(val, "%u,%u,%u", &t, &o, &r);
+            opt.transferUsec = t;
+            opt.openUsec = o;
+            opt.reenumerationMsec = r;
+        } else if (arg == "--json") {
+            opt.jsonPath = val;
+        } else {
+            fprintf(stderr, "cp210x-bench: unknown option %s\n", argv[i - 1]);
+            exit(2);
+        }
+    }
+    if (opt.counts.empty()) {
+        opt.counts.assign(DefaultCounts, DefaultCounts + sizeof(DefaultCounts) / sizeof(DefaultCounts[0]));
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    CBenchOptions opt;
+    std::vector<CPhaseResult> results;
+
+    ParseArgs(argc, argv, opt);
+
+    if (opt.virtualTime) {
+        static CVirtualClock clock;
+
+        SetOsClock(&clock);
+        Check(CP210xSim_SetClock(OsClockNowUsec, OsClockSleepUsec), "CP210xSim_SetClock");
+    }
+    Check(CP210xSim_Enable(TRUE), "CP210xSim_Enable");
+    Check(CP210xSim_SetLatency(opt.transferUsec, opt.openUsec, opt.reenumerationMsec), "CP210xSim_SetLatency");
+    if (CP210xSim_AddDevice(opt.partNum, 0, 0, NULL, NULL) != CP210x_SUCCESS) {
+        fprintf(stderr, "cp210x-bench: part 0x%02x can't be simulated\n", opt.partNum);
+        return 2;
+    }
+
+    results.reserve(opt.counts.size() * 8);
+    for (size_t i = 0; i < opt.counts.size(); i++) {
+        RunCount(opt, opt.counts[i], results);
+    }
+    Check(CP210xSim_RemoveAllDevices(), "CP210xSim_RemoveAllDevices");
+
+    PrintTable(results);
+    if (opt.jsonPath) {
+        FILE* f = strcmp(opt.jsonPath, "-") ? fopen(opt.jsonPath, "w") : stdout;
+
+        if (!f) {
+            perror(opt.jsonPath);
+            return 1;
+        }
+        WriteJson(f, opt, results);
+        if (f != stdout) {
+            fclose(f);
+        }
+    }
+    return 0;
+}
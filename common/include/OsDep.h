@@ -28,4 +28,45 @@ void Sleep(DWORD msec);
 
 #include "CriticalSectionLock.h"
 
+#if	!defined(_WIN32)
+#include <stdint.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// COsClock
+/////////////////////////////////////////////////////////////////////////////
+
+// Time source behind GetTickCount() and Sleep(). The monotonic system clock
+// is used unless another one is installed with SetOsClock().
+class COsClock
+{
+public:
+	virtual ~COsClock() {}
+
+	virtual uint64_t NowUsec() = 0;
+	virtual void SleepUsec(uint64_t usec) = 0;
+};
+
+// Simulation time: starts at zero and only moves when slept on or advanced,
+// so waits on simulated devices return at once. Concurrent sleepers each
+// add their own wait.
+class CVirtualClock : public COsClock
+{
+public:
+	CVirtualClock() : m_nowUsec(0) {}
+
+	virtual uint64_t NowUsec();
+	virtual void SleepUsec(uint64_t usec);
+	void Advance(uint64_t usec);
+
+private:
+	CCriticalSectionLock m_lock;
+	uint64_t m_nowUsec;
+};
+
+COsClock* GetOsClock();
+// NULL restores the system clock
+void SetOsClock(COsClock* clock);
+
+#endif	// !defined(_WIN32)
+
 #endif // __OS_DEP_H__
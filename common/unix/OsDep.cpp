@@ -7,23 +7,88 @@
 #include <time.h>
 #include <unistd.h> // for usleep
 
-// Get system tick count in milliseconds
-DWORD GetTickCount()
+/////////////////////////////////////////////////////////////////////////////
+// CSystemClock
+/////////////////////////////////////////////////////////////////////////////
+
+class CSystemClock : public COsClock
 {
-    DWORD count;
-    timespec ts;
+public:
+    virtual uint64_t NowUsec()
+    {
+        timespec ts;
+
+        if (clock_gettime(CLOCK_MONOTONIC, &ts))
+        {
+            return 0;
+        }
+
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
 
-    if (clock_gettime(CLOCK_MONOTONIC, &ts))
+    virtual void SleepUsec(uint64_t usec)
     {
-        return 0;
+        // usleep() may refuse a second or more
+        while (usec >= 1000000)
+        {
+            sleep(1);
+            usec -= 1000000;
+        }
+        usleep(static_cast<useconds_t>(usec));
     }
+};
 
-    count = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+static CSystemClock SystemClock;
+static COsClock* ActiveClock = &SystemClock;
+
+COsClock* GetOsClock()
+{
+    return ActiveClock;
+}
+
+void SetOsClock(COsClock* clock)
+{
+    ActiveClock = clock ? clock : &SystemClock;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CVirtualClock
+/////////////////////////////////////////////////////////////////////////////
 
-    return count;
+uint64_t CVirtualClock::NowUsec()
+{
+    uint64_t now;
+
+    m_lock.Lock();
+    now = m_nowUsec;
+    m_lock.Unlock();
+
+    return now;
+}
+
+void CVirtualClock::SleepUsec(uint64_t usec)
+{
+    Advance(usec);
+}
+
+void CVirtualClock::Advance(uint64_t usec)
+{
+    m_lock.Lock();
+    m_nowUsec += usec;
+    m_lock.Unlock();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// GetTickCount/Sleep
+/////////////////////////////////////////////////////////////////////////////
+
+// Get system tick count in milliseconds
+DWORD GetTickCount()
+{
+    return static_cast<DWORD>(ActiveClock->NowUsec() / 1000);
 }
 
 void Sleep( DWORD msec)
 {
-    usleep( msec * 1000);
+    ActiveClock->SleepUsec(static_cast<uint64_t>(msec) * 1000);
 }
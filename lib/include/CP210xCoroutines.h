@@ -0,0 +1,521 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xCoroutines.h
+//
+// C++20 coroutines over libcp210x, header only: a program/verify flow is
+// written as sequentially as with the blocking API, and a CScheduler runs
+// thousands of them on one thread. Each setter awaited on a CAsyncDevice is
+// captured on a plan of the device's part and run with CP210x_SubmitPlan(),
+// so while it is on the bus the thread resumes the other devices' flows.
+// The getters have no asynchronous form in the library: awaiting one reads
+// the device at once, without suspending.
+//
+// A failed call throws cp210x::CError out of the co_await.
+//
+// Example:
+//   cp210x::CTask<> Program(cp210x::CAsyncDevice& dev, std::string serial)
+//   {
+//       co_await dev.SetProductString("Station 4");
+//       co_await dev.SetSerialNumber(serial);
+//       co_await dev.SetMaxPower(0x32);
+//       if (co_await dev.GetDeviceSerialNumber() != serial) {
+//           throw std::runtime_error("verify failed");
+//       }
+//   }
+//
+//   cp210x::CScheduler scheduler;
+//   std::vector<cp210x::CAsyncDevice> devices;
+//   for (DWORD i = 0; i < numDevices; i++) {
+//       devices.push_back(cp210x::CAsyncDevice::Open(scheduler, i));
+//   }
+//   for (DWORD i = 0; i < numDevices; i++) {
+//       scheduler.Spawn(Program(devices[i], SerialFor(i)));
+//   }
+//   scheduler.Run();
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_COROUTINES_H
+#define CP210x_COROUTINES_H
+
+#if __cplusplus < 202002L
+#error "CP210xCoroutines.h needs C++20"
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+#include "CP210xManufacturing.h"
+
+namespace cp210x {
+
+/////////////////////////////////////////////////////////////////////////////
+// CError Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CError : public std::runtime_error
+{
+public:
+    CError(const char* what, CP210x_STATUS status) : std::runtime_error(Format(what, status)), m_status(status) {}
+
+    CP210x_STATUS Status() const {
+        return m_status;
+    }
+
+private:
+    static std::string Format(const char* what, CP210x_STATUS status) {
+        char msg[128];
+
+        snprintf(msg, sizeof(msg), "%s failed with status 0x%02x", what, status);
+        return msg;
+    }
+
+    CP210x_STATUS m_status;
+};
+
+inline void Check(CP210x_STATUS status, const char* what)
+{
+    if (status != CP210x_SUCCESS) {
+        throw CError(what, status);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CTask Class
+/////////////////////////////////////////////////////////////////////////////
+
+template <class T> class CTask;
+
+namespace detail {
+
+// What CTask's promises share: the coroutine awaiting the task, resumed once
+// it is done, and what it threw
+struct CPromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    struct CFinalAwaiter
+    {
+        bool await_ready() noexcept {
+            return false;
+        }
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            const std::coroutine_handle<> continuation = h.promise().continuation;
+
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {
+        }
+    };
+
+    std::suspend_always initial_suspend() noexcept {
+        return std::suspend_always();
+    }
+    CFinalAwaiter final_suspend() noexcept {
+        return CFinalAwaiter();
+    }
+    void unhandled_exception() noexcept {
+        error = std::current_exception();
+    }
+};
+
+template <class T>
+struct CPromise : CPromiseBase
+{
+    T value;
+
+    CTask<T> get_return_object() noexcept;
+    void return_value(T v) {
+        value = std::move(v);
+    }
+    T Result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(value);
+    }
+};
+
+template <>
+struct CPromise<void> : CPromiseBase
+{
+    CTask<void> get_return_object() noexcept;
+    void return_void() noexcept {
+    }
+    void Result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+} // namespace detail
+
+// A coroutine that starts when it is awaited, or spawned on a CScheduler,
+// and owns its frame
+template <class T = void>
+class CTask
+{
+public:
+    typedef detail::CPromise<T> promise_type;
+
+    explicit CTask(std::coroutine_handle<promise_type> h) : m_h(h) {}
+    CTask(CTask&& other) noexcept : m_h(std::exchange(other.m_h, nullptr)) {}
+    CTask& operator=(CTask&& other) noexcept {
+        if (this != &other) {
+            Destroy();
+            m_h = std::exchange(other.m_h, nullptr);
+        }
+        return *this;
+    }
+    CTask(const CTask&) = delete;
+    CTask& operator=(const CTask&) = delete;
+    ~CTask() {
+        Destroy();
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        m_h.promise().continuation = awaiting;
+        return m_h;
+    }
+    T await_resume() {
+        return m_h.promise().Result();
+    }
+
+    std::coroutine_handle<promise_type> Handle() const {
+        return m_h;
+    }
+
+private:
+    void Destroy() {
+        if (m_h) {
+            m_h.destroy();
+            m_h = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> m_h;
+};
+
+namespace detail {
+
+template <class T>
+inline CTask<T> CPromise<T>::get_return_object() noexcept
+{
+    return CTask<T>(std::coroutine_handle<CPromise<T> >::from_promise(*this));
+}
+
+inline CTask<void> CPromise<void>::get_return_object() noexcept
+{
+    return CTask<void>(std::coroutine_handle<CPromise<void> >::from_promise(*this));
+}
+
+} // namespace detail
+
+/////////////////////////////////////////////////////////////////////////////
+// CScheduler Class
+/////////////////////////////////////////////////////////////////////////////
+
+// Runs the spawned tasks on the calling thread: it resumes the coroutines
+// whose operations completed, and waits in CP210x_HandleEvents() while all
+// of them are waiting on the bus. RunOnce() is a single round of that for an
+// event loop of the application's own, to call when a file descriptor of
+// CP210x_GetPollFds() is ready.
+class CScheduler
+{
+public:
+    CScheduler() : m_pending(0) {}
+    CScheduler(const CScheduler&) = delete;
+    CScheduler& operator=(const CScheduler&) = delete;
+
+    void Spawn(CTask<> task) {
+        m_ready.push_back(task.Handle());
+        m_tasks.push_back(std::move(task));
+    }
+
+    // Until every task spawned is done, then rethrows what the first task
+    // that failed threw
+    void Run() {
+        while (!m_ready.empty() || m_pending) {
+            RunOnce(m_ready.empty() ? 1000 : 0);
+        }
+        std::vector<CTask<> > tasks;
+
+        tasks.swap(m_tasks);
+        for (size_t i = 0; i < tasks.size(); i++) {
+            tasks[i].await_resume();
+        }
+    }
+
+    void RunOnce(DWORD dwTimeoutMsec) {
+        if (m_pending) {
+            Check(CP210x_HandleEvents(dwTimeoutMsec), "CP210x_HandleEvents");
+        }
+        // Only those ready now, the coroutines they resume come next round
+        for (size_t n = m_ready.size(); n; n--) {
+            const std::coroutine_handle<> h = m_ready.front();
+
+            m_ready.pop_front();
+            h.resume();
+        }
+    }
+
+    // Asynchronous operations in flight
+    DWORD Pending() const {
+        return m_pending;
+    }
+
+    // For the awaitables: an operation was submitted, one completed
+    void Submitted() {
+        m_pending++;
+    }
+    void Completed(std::coroutine_handle<> h) {
+        m_pending--;
+        m_ready.push_back(h);
+    }
+
+private:
+    std::deque<std::coroutine_handle<> > m_ready;
+    std::vector<CTask<> > m_tasks;
+    DWORD m_pending;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Awaitables
+/////////////////////////////////////////////////////////////////////////////
+
+// A plan run with CP210x_SubmitPlan(), the coroutine resumes when it is done.
+// A plan it opened itself is closed then. status is that of capturing the
+// plan, what the call that failed if it did.
+class CPlanAwaiter
+{
+public:
+    CPlanAwaiter(CScheduler& scheduler, HANDLE cyHandle, HANDLE cyPlan, bool ownPlan, std::string serial, CP210x_STATUS status, const char* what)
+        : m_scheduler(scheduler), m_cyHandle(cyHandle), m_cyPlan(cyPlan), m_ownPlan(ownPlan), m_serial(std::move(serial)), m_status(status),
+          m_what(status == CP210x_SUCCESS ? "CP210x_SubmitPlan" : what) {}
+    CPlanAwaiter(const CPlanAwaiter&) = delete;
+    CPlanAwaiter& operator=(const CPlanAwaiter&) = delete;
+    ~CPlanAwaiter() {
+        if (m_ownPlan && m_cyPlan) {
+            CP210x_Close(m_cyPlan);
+        }
+    }
+
+    // Capturing the setter on the plan may have failed already
+    bool await_ready() const noexcept {
+        return m_status != CP210x_SUCCESS;
+    }
+    bool await_suspend(std::coroutine_handle<> h) {
+        m_h = h;
+        m_status = CP210x_SubmitPlan(m_cyHandle, m_cyPlan,
+                                     m_serial.empty() ? NULL : const_cast<char*>(m_serial.data()),
+                                     static_cast<BYTE>(m_serial.size()), TRUE, OnDone, this);
+        if (m_status != CP210x_SUCCESS) {
+            return false;
+        }
+        m_scheduler.Submitted();
+        return true;
+    }
+    void await_resume() {
+        Check(m_status, m_what);
+    }
+
+private:
+    static void OnDone(HANDLE /*cyHandle*/, CP210x_STATUS status, LPVOID lpContext) {
+        CPlanAwaiter* awaiter = static_cast<CPlanAwaiter*>(lpContext);
+
+        awaiter->m_status = status;
+        awaiter->m_scheduler.Completed(awaiter->m_h);
+    }
+
+    CScheduler& m_scheduler;
+    HANDLE m_cyHandle;
+    HANDLE m_cyPlan;
+    bool m_ownPlan;
+    std::string m_serial;
+    CP210x_STATUS m_status;
+    const char* m_what;
+    std::coroutine_handle<> m_h;
+};
+
+// A getter's value, read when it was called
+template <class T>
+class CReadyAwaiter
+{
+public:
+    explicit CReadyAwaiter(T value) : m_value(std::move(value)) {}
+
+    bool await_ready() const noexcept {
+        return true;
+    }
+    void await_suspend(std::coroutine_handle<>) noexcept {
+    }
+    T await_resume() {
+        return std::move(m_value);
+    }
+
+private:
+    T m_value;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CAsyncDevice Class
+/////////////////////////////////////////////////////////////////////////////
+
+// An open device whose setters are awaited. One operation at a time: a
+// coroutine awaits each before it starts the next on the same device.
+class CAsyncDevice
+{
+public:
+    CAsyncDevice(CScheduler& scheduler, HANDLE cyHandle) : m_scheduler(&scheduler), m_cyHandle(cyHandle), m_partNum(0) {
+        Check(CP210x_GetPartNumber(m_cyHandle, &m_partNum), "CP210x_GetPartNumber");
+    }
+    CAsyncDevice(CAsyncDevice&& other) noexcept
+        : m_scheduler(other.m_scheduler), m_cyHandle(std::exchange(other.m_cyHandle, nullptr)), m_partNum(other.m_partNum) {}
+    CAsyncDevice& operator=(CAsyncDevice&& other) noexcept {
+        if (this != &other) {
+            Close();
+            m_scheduler = other.m_scheduler;
+            m_cyHandle = std::exchange(other.m_cyHandle, nullptr);
+            m_partNum = other.m_partNum;
+        }
+        return *this;
+    }
+    CAsyncDevice(const CAsyncDevice&) = delete;
+    CAsyncDevice& operator=(const CAsyncDevice&) = delete;
+    ~CAsyncDevice() {
+        Close();
+    }
+
+    static CAsyncDevice Open(CScheduler& scheduler, DWORD dwDevice) {
+        HANDLE cyHandle;
+
+        Check(CP210x_Open(dwDevice, &cyHandle), "CP210x_Open");
+        return CAsyncDevice(scheduler, cyHandle);
+    }
+
+    HANDLE Handle() const {
+        return m_cyHandle;
+    }
+    BYTE PartNumber() const {
+        return m_partNum;
+    }
+
+    // A plan of the device's part, with the serial number replaced unless empty
+    CPlanAwaiter RunPlan(HANDLE cyPlan, std::string serial = std::string()) {
+        return CPlanAwaiter(*m_scheduler, m_cyHandle, cyPlan, false, std::move(serial), CP210x_SUCCESS, NULL);
+    }
+
+    // Any of the CP210x_Set* calls, made by setter on a plan of the device's
+    // part; what names it in the CError of a failure
+    template <class F>
+    CPlanAwaiter Set(F setter, const char* what) {
+        HANDLE cyPlan = NULL;
+        CP210x_STATUS status = CP210x_OpenPlan(m_partNum, &cyPlan);
+
+        if (status != CP210x_SUCCESS) {
+            what = "CP210x_OpenPlan";
+        } else {
+            status = setter(cyPlan);
+        }
+        return CPlanAwaiter(*m_scheduler, m_cyHandle, cyPlan, true, std::string(), status, what);
+    }
+
+    CPlanAwaiter SetVid(WORD wVid) {
+        return Set([=](HANDLE h) { return CP210x_SetVid(h, wVid); }, "CP210x_SetVid");
+    }
+    CPlanAwaiter SetPid(WORD wPid) {
+        return Set([=](HANDLE h) { return CP210x_SetPid(h, wPid); }, "CP210x_SetPid");
+    }
+    CPlanAwaiter SetProductString(const std::string& product) {
+        return Set([&](HANDLE h) { return CP210x_SetProductString(h, const_cast<char*>(product.data()), static_cast<BYTE>(product.size()), TRUE); },
+                   "CP210x_SetProductString");
+    }
+    CPlanAwaiter SetSerialNumber(const std::string& serial) {
+        return Set([&](HANDLE h) { return CP210x_SetSerialNumber(h, const_cast<char*>(serial.data()), static_cast<BYTE>(serial.size()), TRUE); },
+                   "CP210x_SetSerialNumber");
+    }
+    CPlanAwaiter SetSelfPower(BOOL bSelfPower) {
+        return Set([=](HANDLE h) { return CP210x_SetSelfPower(h, bSelfPower); }, "CP210x_SetSelfPower");
+    }
+    CPlanAwaiter SetMaxPower(BYTE bMaxPower) {
+        return Set([=](HANDLE h) { return CP210x_SetMaxPower(h, bMaxPower); }, "CP210x_SetMaxPower");
+    }
+    CPlanAwaiter SetDeviceVersion(WORD wVersion) {
+        return Set([=](HANDLE h) { return CP210x_SetDeviceVersion(h, wVersion); }, "CP210x_SetDeviceVersion");
+    }
+
+    CReadyAwaiter<WORD> GetDeviceVid() {
+        WORD wVid;
+
+        Check(CP210x_GetDeviceVid(m_cyHandle, &wVid), "CP210x_GetDeviceVid");
+        return CReadyAwaiter<WORD>(wVid);
+    }
+    CReadyAwaiter<WORD> GetDevicePid() {
+        WORD wPid;
+
+        Check(CP210x_GetDevicePid(m_cyHandle, &wPid), "CP210x_GetDevicePid");
+        return CReadyAwaiter<WORD>(wPid);
+    }
+    CReadyAwaiter<std::string> GetDeviceProductString() {
+        BYTE str[CP210x_MAX_DEVICE_STRLEN];
+        BYTE length = 0;
+
+        Check(CP210x_GetDeviceProductString(m_cyHandle, str, &length, TRUE), "CP210x_GetDeviceProductString");
+        return CReadyAwaiter<std::string>(std::string(reinterpret_cast<char*>(str), length));
+    }
+    CReadyAwaiter<std::string> GetDeviceSerialNumber() {
+        BYTE str[CP210x_MAX_DEVICE_STRLEN];
+        BYTE length = 0;
+
+        Check(CP210x_GetDeviceSerialNumber(m_cyHandle, str, &length, TRUE), "CP210x_GetDeviceSerialNumber");
+        return CReadyAwaiter<std::string>(std::string(reinterpret_cast<char*>(str), length));
+    }
+    CReadyAwaiter<BYTE> GetMaxPower() {
+        BYTE bMaxPower;
+
+        Check(CP210x_GetMaxPower(m_cyHandle, &bMaxPower), "CP210x_GetMaxPower");
+        return CReadyAwaiter<BYTE>(bMaxPower);
+    }
+    CReadyAwaiter<WORD> GetDeviceVersion() {
+        WORD wVersion;
+
+        Check(CP210x_GetDeviceVersion(m_cyHandle, &wVersion), "CP210x_GetDeviceVersion");
+        return CReadyAwaiter<WORD>(wVersion);
+    }
+    // The configuration block of the parts that have one (CP2102N)
+    CReadyAwaiter<std::vector<BYTE> > GetConfig(WORD wLength) {
+        std::vector<BYTE> config(wLength);
+
+        Check(CP210x_GetConfig(m_cyHandle, config.data(), wLength), "CP210x_GetConfig");
+        return CReadyAwaiter<std::vector<BYTE> >(std::move(config));
+    }
+
+private:
+    void Close() {
+        if (m_cyHandle) {
+            CP210x_Close(m_cyHandle);
+            m_cyHandle = nullptr;
+        }
+    }
+
+    CScheduler* m_scheduler;
+    HANDLE m_cyHandle;
+    BYTE m_partNum;
+};
+
+} // namespace cp210x
+
+#endif // CP210x_COROUTINES_H
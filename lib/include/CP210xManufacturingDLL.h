@@ -72,6 +72,8 @@
 #define		CP210x_FILE_ERROR					0x06
 #define		CP210x_COMMAND_FAILED				0x08
 #define		CP210x_INVALID_ACCESS_TYPE			0x09
+#define		CP210x_SESSION_ENDED				0x0A	// a replayed session diverged or ran out, final
+#define		CP210x_DEVICE_BUSY					0x0B	// plans submitted to the device haven't finished
 
 // Type definitions
 typedef		int		CP210x_STATUS;
@@ -108,6 +110,11 @@ typedef		char	CP210x_SERIAL_STRING[CP210x_MAX_SERIAL_STRLEN];
 typedef		char	CP2105_INTERFACE_STRING[CP2105_MAX_INTERFACE_STRLEN];
 typedef		char	CP2108_INTERFACE_STRING[CP2108_MAX_INTERFACE_STRLEN];
 
+// Device location: "<bus>-<port>[.<port>...]" as in /sys/bus/usb/devices,
+// including the terminating NUL
+#define		CP210x_MAX_LOCATION_STRLEN			32
+typedef		char	CP210x_LOCATION_STRING[CP210x_MAX_LOCATION_STRLEN];
+
 #define		CP210x_MAX_MAXPOWER					250
 
 
@@ -403,6 +410,52 @@ typedef struct {
 	uint8_t build;
 } firmware_t, *pFirmware_t;
 
+// GetCapabilities() operation flags, each one covers the Get/Set pair of the API
+#define		CP210x_CAP_MANUFACTURER_STRING		0x00000001
+#define		CP210x_CAP_INTERFACE_STRING			0x00000002
+#define		CP210x_CAP_FLUSH_BUFFER_CONFIG		0x00000004
+#define		CP210x_CAP_DEVICE_MODE				0x00000008
+#define		CP210x_CAP_BAUD_RATE_CONFIG			0x00000010
+#define		CP210x_CAP_PORT_CONFIG				0x00000020
+#define		CP210x_CAP_DUAL_PORT_CONFIG			0x00000040
+#define		CP210x_CAP_QUAD_PORT_CONFIG			0x00000080
+#define		CP210x_CAP_LOCK_VALUE				0x00000100
+#define		CP210x_CAP_FIRMWARE_VERSION			0x00000200
+#define		CP210x_CAP_CONFIG					0x00000400	// GetConfig()/SetConfig()
+#define		CP210x_CAP_FIRMWARE_UPDATE			0x00000800
+#define		CP210x_CAP_GENERIC					0x00001000	// GetGeneric()/SetGeneric()
+
+// What a part supports, as returned by GetCapabilities().
+// String limits are in characters, 0 where the string can't be set.
+typedef struct {
+	BYTE	PartNum;
+	DWORD	Operations;				// CP210x_CAP_* flags
+	BYTE	NumInterfaces;
+	BYTE	MaxManufacturerStrLen;
+	BYTE	MaxProductStrLen;
+	BYTE	MaxSerialStrLen;
+	BYTE	MaxInterfaceStrLen;
+} CP210x_CAPABILITIES;
+
+// A control transfer captured on a plan, as returned by GetPlanTransfers()
+typedef struct {
+	BYTE	bmRequestType;
+	BYTE	bRequest;
+	WORD	wValue;
+	WORD	wIndex;
+	WORD	wLength;
+} CP210x_PLAN_TRANSFER;
+
+// A file descriptor to poll for the library's events, as returned by GetPollFds()
+typedef struct {
+	int		fd;
+	short	events;					// POLLIN, POLLOUT
+} CP210x_POLLFD;
+
+// Called from HandleEvents() once a plan submitted with SubmitPlan() is done,
+// with the status RunPlan() would have returned
+typedef void (*CP210x_PLAN_DONE)(HANDLE cyHandle, CP210x_STATUS status, LPVOID lpContext);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -419,6 +472,45 @@ CP210x_STATUS WINAPI CP210x_GetNumDevices(
 	_Out_writes_bytes_(sizeof(DWORD)) _Pre_defensive_ LPDWORD lpdwNumDevices
 	);
 
+/// @brief Keeps a registry of the part numbers of the devices probed, so that later enumerations of a
+/// long-running process (a daemon) don't probe them again. A device re-plugged, reset or re-enumerated
+/// since comes back at a new address and is probed anew. Not keeping it any more empties the registry.
+/// @param bKeep TRUE to keep the registry, FALSE to probe every device on every enumeration (the default)
+/// @returns Returns CP210x_SUCCESS
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_KeepDeviceRegistry(
+	_In_ const BOOL bKeep
+	);
+
+/// @brief Limits the devices counted, opened and listed by the process to those plugged in at some ports,
+/// so that several processes can each drive their own hub tree without touching each other's devices
+/// @param lpszPorts is a space or comma separated list of patterns: a bus ("1"), a port ("1-4.2") or the
+/// ports downstream of a hub ("1-4.*"), as CP210x_GetDeviceLocation() names them; NULL or "" for every port (the default)
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- a pattern is malformed
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_INVALID_PARAMETER)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_SetPortFilter(
+	_In_opt_ LPCSTR lpszPorts
+	);
+
+/// @brief Opens the devices of each bus in a libusb context of its own, so that threads working on
+/// devices of different buses don't contend for the event handling of one shared context. Devices
+/// already open stay in the context they were opened in; with FALSE, a bus context goes away with the
+/// last of them. Simulated and replayed devices ignore it.
+/// @param bPerBus TRUE for a context per bus, FALSE to open every device in the shared one (the default)
+/// @returns Returns CP210x_SUCCESS
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_SetContextPerBus(
+	_In_ const BOOL bPerBus
+	);
+
 _Check_return_
 _Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
 _Success_(return == CP210x_SUCCESS)
@@ -438,10 +530,194 @@ CP210x_STATUS WINAPI CP210x_Open(
 	HANDLE*	cyHandle
 	); 
 
+/// @brief Opens the CP210x device plugged in at a location, without opening any other device
+/// @param lpszLocation is the location as returned by CP210x_GetDeviceLocation(), e.g. "1-4.2"
+/// @param cyHandle points at a buffer into which the handle will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- lpszLocation or cyHandle is an unexpected value
+///			CP210x_DEVICE_NOT_FOUND -- no CP210x device is there (yet), e.g. while it re-enumerates after a reset
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_OpenByLocation(
+	_In_ _Pre_defensive_ LPCSTR lpszLocation,
+	HANDLE*	cyHandle
+	);
+
+/// @brief Tells for each of the locations whether a CP210x device can be opened there, as
+/// CP210x_OpenByLocation() would, from a single enumeration; for waiting on many devices at once
+/// @param lpszLocations are dwCount locations as returned by CP210x_GetDeviceLocation()
+/// @param dwCount is the number of locations
+/// @param lpbFound points at a buffer of dwCount BOOLs into which TRUE is written for the locations found
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- lpszLocations or lpbFound is an unexpected value
+///			CP210x_GLOBAL_DATA_ERROR -- the devices could not be enumerated
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_SESSION_ENDED)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_FindLocations(
+	_In_reads_bytes_(dwCount * sizeof(LPCSTR)) _Pre_defensive_ const LPCSTR* lpszLocations,
+	_In_ _Pre_defensive_ const DWORD dwCount,
+	_Out_writes_bytes_(dwCount * sizeof(BOOL)) _Pre_defensive_ LPBOOL lpbFound
+	);
+
+/// @brief Returns where the device is plugged in, which unlike its index or address survives resets
+/// @param cyHandle is an open handle to the device
+/// @param lpszLocation points at a buffer of CP210x_MAX_LOCATION_STRLEN characters into which the location will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_HANDLE -- cyHandle is invalid
+///			CP210x_INVALID_PARAMETER -- lpszLocation is an unexpected value
+///			CP210x_FUNCTION_NOT_SUPPORTED -- the backend can't tell, e.g. replaying a session log of version 1
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_GetDeviceLocation(
+	_In_ _Pre_defensive_ const HANDLE cyHandle,
+	_Out_writes_bytes_(CP210x_MAX_LOCATION_STRLEN) _Pre_defensive_ LPSTR lpszLocation
+	);
+
+/// @brief Opens a transfer plan for a part: a handle on which the CP210x_Set* functions check their
+/// parameters and capture the transfers they would send, for CP210x_RunPlan() to send them to devices.
+/// The getters fail on it. Close it with CP210x_Close().
+/// @param bPartNum is the CP210x_CP210*_VERSION of the part
+/// @param cyHandle points at a buffer into which the handle will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- bPartNum or cyHandle is an unexpected value
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_OpenPlan(
+	_In_ _Pre_defensive_ const BYTE bPartNum,
+	HANDLE*	cyHandle
+	);
+
+/// @brief Sends the transfers captured on a plan to the device, in the order they were captured
+/// @param cyHandle is an open handle to the device
+/// @param cyPlan is an open plan of the device's part
+/// @param lpvSerialNumber, if not NULL, replaces the serial number the plan sets, as CP210x_SetSerialNumber() takes it
+/// @param bLength is the length of lpvSerialNumber
+/// @param bConvertToUnicode is whether lpvSerialNumber is to be converted to Unicode
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_HANDLE -- cyHandle or cyPlan is invalid
+///			CP210x_INVALID_PARAMETER -- cyPlan is no plan or of another part, sets no serial number
+///			to replace, or the serial number is an unexpected value
+///			CP210x_DEVICE_IO_FAILED -- a transfer failed, the ones before it went through
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_RunPlan(
+	_In_ _Pre_defensive_ const HANDLE cyHandle,
+	_In_ _Pre_defensive_ const HANDLE cyPlan,
+	_In_opt_ LPVOID lpvSerialNumber,
+	_In_ _Pre_defensive_ const BYTE bLength,
+	_In_ _Pre_defensive_ const BOOL bConvertToUnicode
+	);
+
+/// @brief Returns the transfers captured on a plan, in the order CP210x_RunPlan() sends them
+/// @param cyPlan is an open plan
+/// @param lpTransfers points at a buffer of *lpdwCount transfers, may be NULL to only count them
+/// @param lpdwCount points at the size of lpTransfers, into which the number of transfers of the plan will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_HANDLE -- cyPlan is invalid
+///			CP210x_INVALID_PARAMETER -- cyPlan is no plan, or lpdwCount is an unexpected value
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_GetPlanTransfers(
+	_In_ _Pre_defensive_ const HANDLE cyPlan,
+	CP210x_PLAN_TRANSFER* lpTransfers,
+	_Pre_defensive_ LPDWORD lpdwCount
+	);
+
+/// @brief Starts sending the transfers captured on a plan to the device as CP210x_RunPlan() does, but
+/// without waiting for them: each is submitted when the one before it completed, from CP210x_HandleEvents(),
+/// which calls pfnDone once the last one did or one failed. The transfers are copied, so cyPlan may be
+/// closed on return; cyHandle can't be closed or reset (CP210x_DEVICE_BUSY) until pfnDone was called,
+/// from which it can. Simulated and replayed devices carry out each transfer as it is submitted.
+/// @param cyHandle is an open handle to the device
+/// @param cyPlan is an open plan of the device's part
+/// @param lpvSerialNumber, if not NULL, replaces the serial number the plan sets, as CP210x_RunPlan() takes it
+/// @param bLength is the length of lpvSerialNumber
+/// @param bConvertToUnicode is whether lpvSerialNumber is to be converted to Unicode
+/// @param pfnDone is called with the status CP210x_RunPlan() would have returned
+/// @param lpContext is passed to pfnDone
+/// @returns Returns CP210x_SUCCESS if the first transfer was submitted, another CP210x_STATUS if there is an
+/// error, and then pfnDone isn't called:
+///			CP210x_INVALID_HANDLE -- cyHandle or cyPlan is invalid
+///			CP210x_INVALID_PARAMETER -- cyPlan is no plan, of another part or empty, sets no serial number
+///			to replace, the serial number is an unexpected value, or pfnDone is NULL
+///			CP210x_DEVICE_IO_FAILED -- the first transfer couldn't be submitted
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_SubmitPlan(
+	_In_ _Pre_defensive_ const HANDLE cyHandle,
+	_In_ _Pre_defensive_ const HANDLE cyPlan,
+	_In_opt_ LPVOID lpvSerialNumber,
+	_In_ _Pre_defensive_ const BYTE bLength,
+	_In_ _Pre_defensive_ const BOOL bConvertToUnicode,
+	_In_ CP210x_PLAN_DONE pfnDone,
+	_In_opt_ LPVOID lpContext
+	);
+
+/// @brief Returns the file descriptors an application's own event loop (poll, epoll, ...) waits on,
+/// calling CP210x_HandleEvents() when one is ready. They may change as devices are opened.
+/// @param lpFds points at a buffer of *lpdwCount file descriptors, may be NULL to only count them
+/// @param lpdwCount points at the size of lpFds, into which the number of file descriptors will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- lpdwCount is an unexpected value
+///			CP210x_FUNCTION_NOT_SUPPORTED -- the platform's USB stack has no file descriptors to poll
+///			CP210x_GLOBAL_DATA_ERROR -- the library couldn't set up its own
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_GetPollFds(
+	CP210x_POLLFD* lpFds,
+	_Pre_defensive_ LPDWORD lpdwCount
+	);
+
+/// @brief Completes the transfers submitted by CP210x_SubmitPlan() that are done, calling the pfnDone
+/// of the plans that finished and submitting the next transfer of the others
+/// @param dwTimeoutMsec is how long to wait for a transfer to complete if none has, 0 not to block
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_DEVICE_IO_FAILED -- the USB stack failed to handle its events
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_HandleEvents(
+	_In_ _Pre_defensive_ const DWORD dwTimeoutMsec
+	);
+
+/// @brief Returns the number of requests the library has sent to the device through the handle:
+/// control transfers and string descriptor reads. Together with a clock, it gives the latency of a request.
+/// @param cyHandle is an open handle to the device
+/// @param lpdwCount points at a buffer into which the count will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_HANDLE -- cyHandle is invalid
+///			CP210x_INVALID_PARAMETER -- lpdwCount is an unexpected value
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_GetRequestCount(
+	_In_ _Pre_defensive_ const HANDLE cyHandle,
+	_Out_writes_bytes_(sizeof(DWORD)) _Pre_defensive_ LPDWORD lpdwCount
+	);
+
 /// @brief Closes an open handle to the device
 /// @param cyHandle is an open handle to the device
 /// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
 ///			CP210x_INVALID_HANDLE -- cyHandle is invalid
+///			CP210x_DEVICE_BUSY -- a plan submitted to the device is still running, the handle stays open
 _Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
 _Success_(return == CP210x_SUCCESS)
 CP210xDLL_API
@@ -465,6 +741,21 @@ CP210x_STATUS WINAPI CP210x_GetPartNumber(
 	_Out_writes_bytes_(sizeof(BYTE)) _Pre_defensive_ LPBYTE lpbPartNum
 	);
 
+/// @brief Describes what a part supports, without any device I/O
+/// @param bPartNum is one of the CP210x_CP210*_VERSION part numbers
+/// @param lpCapabilities points at a buffer into which the capabilities will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- lpCapabilities is an unexpected value
+///			CP210x_FUNCTION_NOT_SUPPORTED -- bPartNum isn't a part the library supports
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210x_GetCapabilities(
+	_In_ _Pre_defensive_ const BYTE bPartNum,
+	_Out_writes_bytes_(sizeof(CP210x_CAPABILITIES)) _Pre_defensive_ CP210x_CAPABILITIES* lpCapabilities
+	);
+
 _Check_return_
 _Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
 _Success_(return == CP210x_SUCCESS)
@@ -946,6 +1237,30 @@ CP210x_Reset(
 	_In_ _Pre_defensive_ const HANDLE cyHandle
 	);
 
+/// @brief Resets the device and opens it again once it is back at the same port, even under another VID/PID,
+/// e.g. after programming them, and without rescanning the whole bus for it
+/// @param cyHandle is the device to reset, closed by the call unless it fails with CP210x_INVALID_HANDLE,
+/// CP210x_INVALID_PARAMETER, CP210x_FUNCTION_NOT_SUPPORTED or CP210x_DEVICE_BUSY
+/// @param dwTimeoutMsec is how long to wait for the device to come back
+/// @param cyNewHandle points at a buffer into which the handle of the device will be written
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- cyNewHandle is an unexpected value or cyHandle is a plan
+///			CP210x_FUNCTION_NOT_SUPPORTED -- the backend can't tell where the device is plugged in
+///			CP210x_DEVICE_BUSY -- a plan submitted to the device is still running
+///			CP210x_DEVICE_IO_FAILED -- the reset failed
+///			CP210x_DEVICE_NOT_FOUND -- the device didn't come back in time
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS
+WINAPI
+CP210x_ResetAndReopen(
+	_In_ _Pre_defensive_ const HANDLE cyHandle,
+	_In_ const DWORD dwTimeoutMsec,
+	_Out_ HANDLE* cyNewHandle
+	);
+
 _Check_return_
 _Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
 _Success_(return == CP210x_SUCCESS)
@@ -0,0 +1,206 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xSim.h
+//
+// Simulated CP210x devices built into libcp210x, for exercising the
+// program/verify/lock pipeline without hardware. While the sim backend is
+// active CP210x_GetNumDevices(), CP210x_Open() and the rest of the API see
+// the simulated devices instead of the USB buses. Each simulated device
+// answers the vendor requests of its part family, keeps its programmed
+// values in "flash", presents them after a reset/re-enumeration and can be
+// locked.
+//
+// The backend is activated either by CP210xSim_Enable() or by setting
+// CP210X_BACKEND=sim in the environment. The initial population is then
+// taken from the environment as well:
+//   CP210X_SIM_DEVICES  comma separated <partnum>[:<count>] entries, partnum
+//                       in hex as in FilterPartNumByte, e.g. "20:8,04:2"
+//   CP210X_SIM_LATENCY  <transfer usec>[,<open usec>[,<re-enumeration msec>]]
+//   CP210X_SIM_FAULTS   comma separated <fault>=<per million>[:<param>] rates
+//                       applied to every device, e.g. "stall=1000,timeout=200:50"
+//   CP210X_SIM_FAULT_SCRIPT
+//                       semicolon separated <sim id>:<script> entries, e.g.
+//                       "1:ok*3,stall;2:disconnect"
+//   CP210X_SIM_SEED     seed of the fault generators, runs are reproducible
+//   CP210X_SIM_CLOCK    "virtual" makes smt-cp210x and cp210x-bench run their
+//                       waits and the devices on simulated time, see
+//                       CP210xSim_SetClock()
+//
+// Faults are drawn per device operation: a control transfer, a string
+// descriptor request or a reset. Reading an ASCII string is two operations,
+// the language ID request and the string itself, as with libusb. A fault
+// script is a comma separated list of <fault>[*<count>] steps consumed one
+// per operation; "ok" passes an operation through, as does a fault that
+// can't happen to it. Once the script is used up the fault rates apply.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_SIM_H
+#define CP210x_SIM_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "CP210xManufacturing.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+// Injectable faults, the script/environment name in quotes
+#define CP210xSim_FAULT_TIMEOUT             0x00    // "timeout"    transfer or string request times out
+#define CP210xSim_FAULT_STALL               0x01    // "stall"      transfer or string request STALLs
+#define CP210xSim_FAULT_SHORT_READ          0x02    // "short"      IN transfer or string returns half the data
+#define CP210xSim_FAULT_DISCONNECT          0x03    // "disconnect" device drops off the bus during an OUT transfer
+#define CP210xSim_FAULT_SLOW_REENUMERATION  0x04    // "slowreenum" reset takes longer to re-enumerate
+#define CP210xSim_FAULT_CORRUPT_STRING      0x05    // "corrupt"    string descriptor returns a wrong character
+#define CP210xSim_NUM_FAULTS                0x06
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Switches the library between the simulated devices and the real USB buses
+/// @param bEnable TRUE to enumerate simulated devices, FALSE to enumerate real ones
+/// @returns Returns CP210x_SUCCESS
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_Enable(
+	_In_ _Pre_defensive_ const BOOL bEnable
+	);
+
+/// @brief Plugs a new simulated device in
+/// @param bPartNum is one of the CP210x_CP210*_VERSION part numbers
+/// @param wVid is the initial Vendor ID, 0 selects the factory default
+/// @param wPid is the initial Product ID, 0 selects the factory default
+/// @param lpszSerialNumber is the initial ASCII serial number, NULL generates a unique one
+/// @param lpdwSimId optionally receives the identifier of the new device
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- bPartNum or lpszSerialNumber is an unexpected value
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_AddDevice(
+	_In_ _Pre_defensive_ const BYTE bPartNum,
+	_In_ _Pre_defensive_ const WORD wVid,
+	_In_ _Pre_defensive_ const WORD wPid,
+	_In_ _Pre_defensive_ LPCSTR lpszSerialNumber,
+	LPDWORD lpdwSimId
+	);
+
+/// @brief Unplugs a simulated device, handles still open to it start failing
+/// @param dwSimId is the identifier returned by CP210xSim_AddDevice()
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_DEVICE_NOT_FOUND -- no device with this identifier is plugged in
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_RemoveDevice(
+	_In_ _Pre_defensive_ const DWORD dwSimId
+	);
+
+/// @brief Unplugs all simulated devices
+/// @returns Returns CP210x_SUCCESS
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_RemoveAllDevices();
+
+/// @brief Sets the simulated timing of all devices
+/// @param dwTransferUsec is the duration of every control transfer
+/// @param dwOpenUsec is the duration of opening a device
+/// @param dwReenumerationMsec is how long a device stays off the bus after a reset
+/// @returns Returns CP210x_SUCCESS
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_SetLatency(
+	_In_ _Pre_defensive_ const DWORD dwTransferUsec,
+	_In_ _Pre_defensive_ const DWORD dwOpenUsec,
+	_In_ _Pre_defensive_ const DWORD dwReenumerationMsec
+	);
+
+/// @brief Sets how often a fault is injected
+/// @param dwSimId is the device identifier, 0 for all devices plugged in now and later
+/// @param dwFault is one of the CP210xSim_FAULT_* values
+/// @param dwPerMillion is the probability per eligible operation, in parts per million
+/// @param dwParam is fault specific: for CP210xSim_FAULT_TIMEOUT the time the request
+///			hangs in msec (0 takes the request's own timeout), for
+///			CP210xSim_FAULT_SLOW_REENUMERATION the extra re-enumeration time in msec
+///			(0 for 2000), unused otherwise
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- dwFault or dwPerMillion is an unexpected value
+///			CP210x_DEVICE_NOT_FOUND -- no device with this identifier is plugged in
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_SetFaultRate(
+	_In_ _Pre_defensive_ const DWORD dwSimId,
+	_In_ _Pre_defensive_ const DWORD dwFault,
+	_In_ _Pre_defensive_ const DWORD dwPerMillion,
+	_In_ _Pre_defensive_ const DWORD dwParam
+	);
+
+/// @brief Sets the faults of the next operations of a device, see the top of this file
+/// @param dwSimId is the device identifier, 0 for all devices plugged in
+/// @param lpszScript is the fault script, NULL or empty to drop the remaining steps
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- lpszScript is not a valid script
+///			CP210x_DEVICE_NOT_FOUND -- no device with this identifier is plugged in
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_SetFaultScript(
+	_In_ _Pre_defensive_ const DWORD dwSimId,
+	_In_ _Pre_defensive_ LPCSTR lpszScript
+	);
+
+/// @brief Reads how many faults have been injected
+/// @param dwSimId is the device identifier, 0 for the sum over all devices plugged in
+/// @param dwFault is one of the CP210xSim_FAULT_* values
+/// @param lpdwCount points at a DWORD which will receive the count
+/// @returns Returns CP210x_SUCCESS on success, another CP210x_STATUS if there is an error:
+///			CP210x_INVALID_PARAMETER -- dwFault or lpdwCount is an unexpected value
+///			CP210x_DEVICE_NOT_FOUND -- no device with this identifier is plugged in
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_DEVICE_NOT_FOUND)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_GetFaultCount(
+	_In_ _Pre_defensive_ const DWORD dwSimId,
+	_In_ _Pre_defensive_ const DWORD dwFault,
+	_Out_writes_bytes_(sizeof(DWORD)) _Pre_defensive_ LPDWORD lpdwCount
+	);
+
+/// @brief Time source of the simulated devices, see CP210xSim_SetClock()
+typedef uint64_t (*CP210xSim_NOW_USEC)(void);
+typedef void (*CP210xSim_SLEEP_USEC)(uint64_t usec);
+
+/// @brief Runs the simulated devices on the caller's clock
+/// @param pfnNowUsec returns the current time in usec, re-enumeration is timed with it
+/// @param pfnSleepUsec passes time for the simulated latencies and hangs
+/// @returns Returns CP210x_SUCCESS, CP210x_INVALID_PARAMETER if only one of them is NULL
+/// @note Passing two NULLs restores the system clock. With a virtual clock that only
+///			advances when slept on, waits against simulated devices cost no wall time.
+///			Set the clock before any simulated device is used.
+_Check_return_
+_Ret_range_(CP210x_SUCCESS, CP210x_INVALID_PARAMETER)
+_Success_(return == CP210x_SUCCESS)
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_SetClock(
+	_In_opt_ CP210xSim_NOW_USEC pfnNowUsec,
+	_In_opt_ CP210xSim_SLEEP_USEC pfnSleepUsec
+	);
+
+/// @brief Reseeds the fault generators of all devices, plugged in now and later
+/// @param dwSeed is the new seed, each device mixes in its identifier
+/// @returns Returns CP210x_SUCCESS
+CP210xDLL_API
+CP210x_STATUS WINAPI CP210xSim_SetFaultSeed(
+	_In_ _Pre_defensive_ const DWORD dwSeed
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CP210x_SIM_H
@@ -0,0 +1,91 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xCapabilities.cpp
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include "CP210xCapabilities.h"
+
+#define SIZEOF_ARRAY( a ) (sizeof( a ) / sizeof( a[0]))
+
+/////////////////////////////////////////////////////////////////////////////
+// Part Descriptors
+/////////////////////////////////////////////////////////////////////////////
+
+// Operations of the CP2102N family, whose customization goes through its config
+#define CP2102N_OPERATIONS  (CP210x_CAP_MANUFACTURER_STRING | CP210x_CAP_FIRMWARE_VERSION | \
+                             CP210x_CAP_CONFIG | CP210x_CAP_FIRMWARE_UPDATE | CP210x_CAP_GENERIC)
+
+static const CCP210xPartDescriptor PartDescriptors[] =
+{
+    // { PartNum, Operations,
+    //   NumInterfaces, MaxManufacturerStrLen, MaxProductStrLen, MaxSerialStrLen, MaxInterfaceStrLen },
+    // interfaceStringRequest, flushBufferConfigSize
+    {
+        { CP210x_CP2101_VERSION, 0,
+          1, 0, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+    {
+        { CP210x_CP2102_VERSION, CP210x_CAP_MANUFACTURER_STRING | CP210x_CAP_BAUD_RATE_CONFIG | CP210x_CAP_LOCK_VALUE,
+          1, CP210x_MAX_MANUFACTURER_STRLEN, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+    {
+        { CP210x_CP2103_VERSION, CP210x_CAP_MANUFACTURER_STRING | CP210x_CAP_BAUD_RATE_CONFIG | CP210x_CAP_PORT_CONFIG |
+                                 CP210x_CAP_LOCK_VALUE,
+          1, CP210x_MAX_MANUFACTURER_STRLEN, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+    {
+        { CP210x_CP2104_VERSION, CP210x_CAP_MANUFACTURER_STRING | CP210x_CAP_FLUSH_BUFFER_CONFIG | CP210x_CAP_PORT_CONFIG |
+                                 CP210x_CAP_LOCK_VALUE,
+          1, CP210x_MAX_MANUFACTURER_STRLEN, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 1
+    },
+    {
+        { CP210x_CP2105_VERSION, CP210x_CAP_MANUFACTURER_STRING | CP210x_CAP_INTERFACE_STRING | CP210x_CAP_FLUSH_BUFFER_CONFIG |
+                                 CP210x_CAP_DEVICE_MODE | CP210x_CAP_DUAL_PORT_CONFIG | CP210x_CAP_LOCK_VALUE,
+          2, CP2105_MAX_MANUFACTURER_STRLEN, CP2105_MAX_PRODUCT_STRLEN, CP2105_MAX_SERIAL_STRLEN, CP2105_MAX_INTERFACE_STRLEN },
+        { 0x0F, 0x10 }, 1
+    },
+    {
+        { CP210x_CP2108_VERSION, CP210x_CAP_MANUFACTURER_STRING | CP210x_CAP_INTERFACE_STRING | CP210x_CAP_FLUSH_BUFFER_CONFIG |
+                                 CP210x_CAP_QUAD_PORT_CONFIG | CP210x_CAP_LOCK_VALUE,
+          4, CP2108_MAX_MANUFACTURER_STRLEN, CP2108_MAX_PRODUCT_STRLEN, CP2108_MAX_SERIAL_STRLEN, CP2108_MAX_INTERFACE_STRLEN },
+        { 0x0F, 0x10, 0x12, 0x13 }, 2
+    },
+    {
+        { CP210x_CP2109_VERSION, CP210x_CAP_BAUD_RATE_CONFIG | CP210x_CAP_LOCK_VALUE,
+          1, 0, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+    {
+        { CP210x_CP2102N_QFN28_VERSION, CP2102N_OPERATIONS,
+          1, CP210x_MAX_MANUFACTURER_STRLEN, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+    {
+        { CP210x_CP2102N_QFN24_VERSION, CP2102N_OPERATIONS,
+          1, CP210x_MAX_MANUFACTURER_STRLEN, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+    {
+        { CP210x_CP2102N_QFN20_VERSION, CP2102N_OPERATIONS,
+          1, CP210x_MAX_MANUFACTURER_STRLEN, CP210x_MAX_PRODUCT_STRLEN, CP210x_MAX_SERIAL_STRLEN, 0 },
+        { 0 }, 0
+    },
+};
+
+const CCP210xPartDescriptor* GetCP210xPartDescriptor(BYTE partNum)
+{
+    for (size_t i = 0; i < SIZEOF_ARRAY(PartDescriptors); i++) {
+        if (PartDescriptors[i].caps.PartNum == partNum) {
+            return &PartDescriptors[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,40 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xCapabilities.h
+//
+// Per-part descriptors driving CCP210xDevice. Each entry carries the public
+// CP210x_CAPABILITIES of a part and the few request details that differ
+// between the parts supporting an operation; the vendor requests themselves
+// are common to the family and stay in CCP210xDevice.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_CAPABILITIES_H
+#define CP210x_CAPABILITIES_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include "CP210xManufacturing.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+#define CP210x_MAX_INTERFACES   4
+
+struct CCP210xPartDescriptor
+{
+    CP210x_CAPABILITIES caps;
+
+    // Low byte of the SetInterfaceString() wValue (0x37xx) of each interface
+    BYTE interfaceStringRequest[CP210x_MAX_INTERFACES];
+
+    // Bytes of the GetFlushBufferConfig() transfer
+    BYTE flushBufferConfigSize;
+};
+
+// The descriptor of a CP210x_CP210*_VERSION part number, NULL if the
+// library doesn't support it
+const CCP210xPartDescriptor* GetCP210xPartDescriptor(BYTE partNum);
+
+#endif // CP210x_CAPABILITIES_H
@@ -7,94 +7,191 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "CP210xDevice.h"
-#include "CP2101Device.h"
-#include "CP2102Device.h"
-#include "CP2102NDevice.h"
-#include "CP2103Device.h"
-#include "CP2104Device.h"
-#include "CP2105Device.h"
-#include "CP2108Device.h"
-#include "CP2109Device.h"
+#include "CP210xCapabilities.h"
 #include "CP210xSupportFunctions.h"
 #include "CP210xManufacturing.h"
+#include "CP210xTransport.h"
+#include "OsDep.h"
 
 #include "silabs_defs.h"
 
+#define CP210x_PROBES_DEFINE_SEMAPHORES
+#include "CP210xProbes.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
 #define SIZEOF_ARRAY( a ) (sizeof( a ) / sizeof( a[0]))
 
-////////////////////////////////////////////////////////////////////////////////
-// constructor is called after the executable is loaded, before main()
-// destructor is called before the executable is unloaded, after main()
-////////////////////////////////////////////////////////////////////////////////
+// How often ResetAndReopen() looks for the device at its port: first after
+// CP210x_REOPEN_POLL_MSEC, then backing off to CP210x_REOPEN_MAX_POLL_MSEC
+#define CP210x_REOPEN_POLL_MSEC 10
+#define CP210x_REOPEN_MAX_POLL_MSEC 160
+
+// The state of a SubmitPlan() between the completions of its transfers
+struct CCP210xDevice::CPlanRun
+{
+    CCP210xDevice* dev;
+    std::vector<CCP210xPlanTransfer> transfers;
+    size_t next;                    // the transfer in flight
+    uint64_t submitNs;              // when it was submitted, for the transfer__complete probe
+    CP210x_PLAN_DONE done;
+    LPVOID context;
+};
+
+// A device probed while the registry is kept, see CCP210xDevice::KeepRegistry()
+struct CCP210xRegistryEntry
+{
+    CCP210xLocation location;
+    int address;
+    libusb_device_descriptor desc;
+    BYTE partNum;
+};
+
+static CCriticalSectionLock RegistryLock;
+static bool RegistryKept;
+static std::vector<CCP210xRegistryEntry> Registry;
+
+// The port paths enumerated, all of them if empty, see CCP210xDevice::SetPortFilter()
+static CCriticalSectionLock PortFilterLock;
+static std::vector<std::string> PortFilter;
 
-static libusb_context* libusbContext;
+// Guards CCP210xDevice::m_pendingRuns, which completions change on the thread
+// handling the events
+static CCriticalSectionLock PlanRunLock;
 
-__attribute__((constructor))
-static void Initializer()
+// The locations of the candidate devices as of the last enumeration of
+// IsLocationPresent(), shared by the ResetAndReopen() calls polling at once
+static CCriticalSectionLock PresentLock;
+static std::vector<std::string> Present;
+static uint64_t PresentMsec;
+static bool PresentValid;
+
+// Bus number and device address identifying the device in probe arguments
+static void GetProbeIdentity(CCP210xTransport* t, int* bus, int* address)
 {
-    libusb_init(&libusbContext);
+    *bus = t ? t->GetBusNumber() : -1;
+    *address = t ? t->GetDeviceAddress() : -1;
 }
 
-__attribute__((destructor))
-static void Finalizer()
+// "<bus>-<port>.<port>...", the kernel's name of the device in /sys/bus/usb/devices
+static void FormatLocation(const CCP210xLocation& location, char* str)
 {
-    libusb_exit(libusbContext);
+    int length = sprintf(str, "%d", location.bus);
+
+    for (int i = 0; i < location.depth; i++) {
+        length += sprintf(str + length, "%c%u", i ? '.' : '-', location.ports[i]);
+    }
 }
 
-static bool IsCP210xCandidateDevice(libusb_device *pdevice)
+// "1" is bus 1, "1-4.*" any device downstream of the hub at 1-4, "1-4.2" that port only
+static bool LocationMatches(const char* location, const std::string& pattern)
 {
-    bool bIsCP210xCandidateDevice = true;   /* innocent til proven guilty */
-    
-    libusb_device_descriptor devDesc;
-    if (0 == libusb_get_device_descriptor(pdevice, &devDesc)) {
-        bIsCP210xCandidateDevice = false;
-        switch (devDesc.bDeviceClass) {
-        case LIBUSB_CLASS_PER_INTERFACE:  /* CP2102, CP2112,  */
-            if ((1 == devDesc.iManufacturer) && (2 == devDesc.iProduct) && (3 <= devDesc.iSerialNumber)) {
-                libusb_config_descriptor *pconfigDesc;
-                bIsCP210xCandidateDevice = true;
-                if (0 == libusb_get_config_descriptor(pdevice, 0, &pconfigDesc)) {
-                    if (pconfigDesc->bNumInterfaces && pconfigDesc->interface->num_altsetting) {
-                        if (LIBUSB_CLASS_VENDOR_SPEC != pconfigDesc->interface->altsetting->bInterfaceClass) {
-                            bIsCP210xCandidateDevice = false;
-                        }
-                    }
-                    libusb_free_config_descriptor(pconfigDesc);
-                    pconfigDesc = (libusb_config_descriptor *) NULL;
-                }
-            }
-            break;
-                
-        default:
-            bIsCP210xCandidateDevice = false;
-            break;
-#if defined(DEBUG)
-        case LIBUSB_CLASS_COMM: /* */
-            /* FALLTHROUGH */
-        case LIBUSB_CLASS_HID:  /* */
-            bIsCP210xCandidateDevice = false;
-            break;
+    if (pattern.find('-') == std::string::npos) {
+        return !strncmp(location, pattern.c_str(), pattern.size()) && location[pattern.size()] == '-';
+    }
+    if (pattern[pattern.size() - 1] == '*') {
+        const size_t length = pattern.size() - 1;
+        return !strncmp(location, pattern.c_str(), length) && location[length] != '\0';
+    }
+    return pattern == location;
+}
 
-        case 0xef:
-            /* FALLTHROUGH */
-        case LIBUSB_CLASS_VENDOR_SPEC:
-            /* FALLTHROUGH */
-        case LIBUSB_CLASS_PRINTER: /* */
-            /* FALLTHROUGH */
-        case LIBUSB_CLASS_HUB:
-            bIsCP210xCandidateDevice = false;
-            break;
-#endif
+// bus["-"port{"."port}[".*"]] or bus"-*", the patterns LocationMatches() takes
+static bool IsPortPattern(const std::string& pattern)
+{
+    const char* p = pattern.c_str();
+    size_t digits = strspn(p, "0123456789");
+
+    if (!digits) {
+        return false;
+    }
+    p += digits;
+    if (*p == '\0') {
+        return true;
+    }
+    if (*p++ != '-') {
+        return false;
+    }
+    if (!strcmp(p, "*")) {
+        return true;
+    }
+    for (;;) {
+        digits = strspn(p, "0123456789");
+        if (!digits) {
+            return false;
+        }
+        p += digits;
+        if (*p == '\0' || !strcmp(p, ".*")) {
+            return true;
+        }
+        if (*p++ != '.') {
+            return false;
         }
     }
+}
 
-    return bIsCP210xCandidateDevice;
+// Whether the device of the snapshot is plugged in where the port filter lets it be
+static bool InPortFilter(CCP210xEnumeration* usbDevices, ssize_t index)
+{
+    CCP210xLocation location;
+    CP210x_LOCATION_STRING str;
+    bool in = false;
+
+    PortFilterLock.Lock();
+    if (PortFilter.empty()) {
+        in = true;
+    } else if (usbDevices->GetLocation(index, &location) == 0) {
+        FormatLocation(location, str);
+        for (size_t i = 0; i < PortFilter.size() && !in; i++) {
+            in = LocationMatches(str, PortFilter[i]);
+        }
+    }
+    PortFilterLock.Unlock();
+    return in;
 }
-static bool IsCP210xCandidateDevice(libusb_device_handle *pdevice_handle)
+
+// Whether a candidate device is plugged in at the location, by an enumeration
+// at most CP210x_REOPEN_POLL_MSEC old, so that threads waiting for their devices
+// to come back from resets at once cost one enumeration a poll between them
+static CP210x_STATUS IsLocationPresent(const char* location, bool* present)
 {
-    bool bIsCP210xCandidateDevice = true;   /* innocent til proven guilty */
-    
-    return bIsCP210xCandidateDevice;
+    CCP210xBackend* backend = CCP210xBackend::Get();
+    CP210x_STATUS status = CP210x_SUCCESS;
+
+    PresentLock.Lock();
+    const uint64_t now = backend->NowMsec();
+    if (!PresentValid || now - PresentMsec >= CP210x_REOPEN_POLL_MSEC) {
+        CCP210xEnumeration* usbDevices;
+
+        status = backend->Enumerate(&usbDevices);
+        if (status == CP210x_SUCCESS) {
+            const ssize_t NumOfUSBDevices = usbDevices->GetCount();
+
+            Present.clear();
+            for (ssize_t i = 0; i < NumOfUSBDevices; i++) {
+                CCP210xLocation loc;
+                CP210x_LOCATION_STRING str;
+
+                if (usbDevices->IsCandidate(i) && usbDevices->GetLocation(i, &loc) == 0 && InPortFilter(usbDevices, i)) {
+                    FormatLocation(loc, str);
+                    Present.push_back(str);
+                }
+            }
+            delete usbDevices;
+            PresentMsec = now;
+            PresentValid = true;
+        }
+    }
+    *present = false;
+    for (size_t i = 0; status == CP210x_SUCCESS && i < Present.size() && !*present; i++) {
+        *present = Present[i] == location;
+    }
+    PresentLock.Unlock();
+    return status;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -107,38 +204,43 @@ CP210x_STATUS CCP210xDevice::GetNumDevices(LPDWORD lpdwNumDevices)
         return CP210x_INVALID_PARAMETER;
     }
 
-    // Enumerate all USB devices, returning the number
-    // of USB devices and a list of those devices
-    libusb_device** list;
-    const ssize_t NumOfUSBDevices = libusb_get_device_list(libusbContext, &list);
-    
-    // A negative count indicates an error
-	if (NumOfUSBDevices < 0) {
-		return CP210x_GLOBAL_DATA_ERROR;
-	}
+    const uint64_t startNs = CP210x_PROBE_ENABLED(enumerate__done) ? CP210x_ProbeTimestampNs() : 0;
+    CP210x_PROBE1(enumerate__start, CP210x_PROBE_OP_GET_NUM_DEVICES);
+
+    // Take a snapshot of all USB devices
+    CCP210xEnumeration* usbDevices;
+    const CP210x_STATUS enumStatus = CCP210xBackend::Get()->Enumerate(&usbDevices);
+    if (enumStatus != CP210x_SUCCESS) {
+        // A backend that can't serve any more calls says so, retrying is pointless
+        return enumStatus == CP210x_SESSION_ENDED ? enumStatus : CP210x_GLOBAL_DATA_ERROR;
+    }
+    const ssize_t NumOfUSBDevices = usbDevices->GetCount();
 
     size_t NumOfCP210xDevices = 0;
     for (ssize_t i = 0; i < NumOfUSBDevices; i++) {
-        libusb_device *device = list[i];
-            
-        if (IsCP210xCandidateDevice(device)) {
-            libusb_device_handle* h;
-                
-            if ((0 == libusb_open(list[i], &h)) && IsCP210xCandidateDevice(h)) {
+        if (usbDevices->IsCandidate(i) && InPortFilter(usbDevices, i)) {
+            CCP210xTransport* t;
+
+            if (usbDevices->Open(i, &t) == CP210x_SUCCESS) {
                 BYTE partNum;
-                if( CCP210xDevice::GetDevicePartNumber(h, &partNum) == CP210x_SUCCESS) {
+                if( CCP210xDevice::LookUpPartNumber(usbDevices, i, t, &partNum) == CP210x_SUCCESS) {
                     if (IsValidCP210X_PARTNUM((CP210X_PARTNUM)partNum)) {
                         NumOfCP210xDevices++;
                     }
                 }
-                
-                libusb_close(h);
-                h = (libusb_device_handle *)NULL;
+
+                delete t;
+                t = (CCP210xTransport *)NULL;
             }
         }
     }
     *lpdwNumDevices = static_cast<DWORD>( NumOfCP210xDevices);
-    libusb_free_device_list(list, 1); // Unreference all devices to free the device list
+    delete usbDevices;
+
+    if (CP210x_PROBE_ENABLED(enumerate__done)) {
+        CP210x_PROBE4(enumerate__done, CP210x_PROBE_OP_GET_NUM_DEVICES, NumOfUSBDevices, NumOfCP210xDevices,
+                      CP210x_ProbeTimestampNs() - startNs);
+    }
     return CP210x_SUCCESS;
 }
 
@@ -151,76 +253,43 @@ CP210x_STATUS CCP210xDevice::Open(const DWORD dwDevice, CCP210xDevice** devObj)
 
 	*devObj = NULL;
 
-    // Enumerate all USB devices, returning the number
-    // of USB devices and a list of those devices
-    libusb_device** list;
-    const ssize_t NumOfUSBDevices = libusb_get_device_list(libusbContext, &list);
-    
-    // A negative count indicates an error
-	if (NumOfUSBDevices < 0) {
-		return CP210x_GLOBAL_DATA_ERROR;
-	}
- 
+    const bool probeLatency = CP210x_PROBE_ENABLED(enumerate__done) || CP210x_PROBE_ENABLED(device__open);
+    const uint64_t startNs = probeLatency ? CP210x_ProbeTimestampNs() : 0;
+    CP210x_PROBE1(enumerate__start, CP210x_PROBE_OP_OPEN);
+
+    // Take a snapshot of all USB devices
+    CCP210xEnumeration* usbDevices;
+    const CP210x_STATUS enumStatus = CCP210xBackend::Get()->Enumerate(&usbDevices);
+    if (enumStatus != CP210x_SUCCESS) {
+        // A backend that can't serve any more calls says so, retrying is pointless
+        return enumStatus == CP210x_SESSION_ENDED ? enumStatus : CP210x_GLOBAL_DATA_ERROR;
+    }
+    const ssize_t NumOfUSBDevices = usbDevices->GetCount();
+
 	if (dwDevice >= static_cast<DWORD>(NumOfUSBDevices)) {
+		delete usbDevices;
 		return CP210x_DEVICE_NOT_FOUND;
 	}
 
 	size_t NumOfCP210xDevices = 0;
 	for (ssize_t i = 0; i < NumOfUSBDevices; i++) {
-        libusb_device *device = list[i];
-            
-		if (IsCP210xCandidateDevice(device)) {
-			libusb_device_handle* h;
-                
-			if ((0 == libusb_open(list[i], &h)) && IsCP210xCandidateDevice(h)) {
+		if (usbDevices->IsCandidate(i) && InPortFilter(usbDevices, i)) {
+			CCP210xTransport* t;
+
+			if (usbDevices->Open(i, &t) == CP210x_SUCCESS) {
 				BYTE partNum;
 
-				if( CCP210xDevice::GetDevicePartNumber( h, &partNum) == CP210x_SUCCESS) {
+				if( CCP210xDevice::LookUpPartNumber( usbDevices, i, t, &partNum) == CP210x_SUCCESS) {
 					if (IsValidCP210X_PARTNUM((CP210X_PARTNUM)partNum)) {
 						if (dwDevice == NumOfCP210xDevices++) {
-							BOOL bFound = TRUE;
-									
-							switch (partNum) {
-							case CP210x_CP2101_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2101Device(h);
-								break;
-							case CP210x_CP2102_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2102Device(h);
-								break;
-							case CP210x_CP2103_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2103Device(h);
-								break;
-							case CP210x_CP2104_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2104Device(h);
-								break;
-							case CP210x_CP2105_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2105Device(h);
-								break;
-							case CP210x_CP2108_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2108Device(h);
-								break;
-							case CP210x_CP2109_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2109Device(h);
-								break;
-                            
-							case CP210x_CP2102N_QFN28_VERSION:
-								/* FALLTHROUGH */
-							case CP210x_CP2102N_QFN24_VERSION:
-								/* FALLTHROUGH */
-							case CP210x_CP2102N_QFN20_VERSION:
-								*devObj = (CCP210xDevice*)new CCP2102NDevice(h, partNum);
-								break;
-                            
-							default:
-								bFound = FALSE;
-								break;
-							}
-									
+							*devObj = NewDevice(usbDevices, i, t, partNum);
+							const BOOL bFound = *devObj ? TRUE : FALSE;
+
 							// We've found the Nth (well, dwDevice'th) CP210x device. Break from the for()-loop purposefully
-							// NOT closing handle-h (after all, this in an open() function, we want to return that open handle
+							// NOT closing transport-t (after all, this in an open() function, we want to return that open handle
 							if (bFound) {
 								if( !(*devObj)) {
-									libusb_close(h);
+									delete t;
 								}
 								break;
 							}
@@ -228,112 +297,200 @@ CP210x_STATUS CCP210xDevice::Open(const DWORD dwDevice, CCP210xDevice** devObj)
 					}
 				}
                 
-				libusb_close(h);
-				h = (libusb_device_handle *)NULL;
+				delete t;
+				t = (CCP210xTransport *)NULL;
 			}
 		}
 	} // for
-	libusb_free_device_list(list, 1); // Unreference all devices to free the device list
+	delete usbDevices;
+
+	if (probeLatency) {
+		const uint64_t latencyNs = CP210x_ProbeTimestampNs() - startNs;
+
+		CP210x_PROBE4(enumerate__done, CP210x_PROBE_OP_OPEN, NumOfUSBDevices, NumOfCP210xDevices, latencyNs);
+		if (*devObj && CP210x_PROBE_ENABLED(device__open)) {
+			int bus, address;
+
+			GetProbeIdentity((*devObj)->m_transport, &bus, &address);
+			CP210x_PROBE4(device__open, bus, address, (*devObj)->m_partNumber, latencyNs);
+		}
+	}
 	return (*devObj) ? CP210x_SUCCESS : CP210x_DEVICE_NOT_FOUND;
 }
 
-#if 0
-CP210x_STATUS CCP210xDevice::OldOpen(const DWORD dwDevice, CCP210xDevice** devObj) {
-    CP210x_STATUS status = CP210x_INVALID_PARAMETER;
-    
-    if (!devObj) {
+// Looks at the locations in the snapshot and opens nothing but the device
+// found there, so it doesn't disturb devices other threads are working on
+CP210x_STATUS CCP210xDevice::OpenByLocation(LPCSTR lpszLocation, CCP210xDevice** devObj)
+{
+    if (!lpszLocation || !devObj) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    // Enumerate all USB devices, returning the number
-    // of devices and a list of devices
-    libusb_device** list;
-    const ssize_t count = libusb_get_device_list(libusbContext, &list);
-    
     *devObj = NULL;
 
-    // A negative count indicates an error
-    if (count > 0) {
-        if (dwDevice < (DWORD) count) {
-            const libusb_device *device = list[dwDevice];
-        
-            if (IsCP210xCandidateDevice(device)) {
-                libusb_device_handle* h;
-            
-                if (0 == libusb_open(list[dwDevice], &h)) {
-                    if (IsCP210xCandidateDevice(h)) {
-                        BYTE partNum;
-            
-                        status = CCP210xDevice::GetDevicePartNumber(h, &partNum);
-                        if (status == CP210x_SUCCESS) {
-                            switch (partNum) {
-                            case CP210x_CP2101_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2101Device(h);
-                                break;
-                            case CP210x_CP2102_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2102Device(h);
-                                break;
-                            case CP210x_CP2103_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2103Device(h);
-                                break;
-                            case CP210x_CP2104_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2104Device(h);
-                                break;
-                            case CP210x_CP2105_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2105Device(h);
-                                break;
-                            case CP210x_CP2108_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2108Device(h);
-                                break;
-                            case CP210x_CP2109_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2109Device(h);
-                                break;
-                            
-                            case CP210x_CP2102N_QFN28_VERSION:
-                                /* FALLTHROUGH */
-                            case CP210x_CP2102N_QFN24_VERSION:
-                                /* FALLTHROUGH */
-                            case CP210x_CP2102N_QFN20_VERSION:
-                                *devObj = (CCP210xDevice*)new CCP2102NDevice(h, partNum);
-                                break;
-                            
-                            default:
-                                status = CP210x_DEVICE_NOT_FOUND;
-                                break;
-                            }
-                        } else {
-                            // return the status that GetDevicePartNumber failed with (was: status = CP210x_DEVICE_NOT_FOUND;)
-                        }
-                    } else {
-                        // no error, simply not a IsCP210xCandidateDevice()
-                    }
-                } else {
-                    status = 0x77 ; // CP210x_DEVICE_NOT_FOUND; // libusb_open
-                }
-            } else {
-                // no error, simply not a IsCP210xCandidateDevice()
+    const bool probeLatency = CP210x_PROBE_ENABLED(enumerate__done) || CP210x_PROBE_ENABLED(device__open);
+    const uint64_t startNs = probeLatency ? CP210x_ProbeTimestampNs() : 0;
+    CP210x_PROBE1(enumerate__start, CP210x_PROBE_OP_OPEN_BY_LOCATION);
+
+    CCP210xEnumeration* usbDevices;
+    const CP210x_STATUS enumStatus = CCP210xBackend::Get()->Enumerate(&usbDevices);
+    if (enumStatus != CP210x_SUCCESS) {
+        return enumStatus == CP210x_SESSION_ENDED ? enumStatus : CP210x_GLOBAL_DATA_ERROR;
+    }
+    const ssize_t NumOfUSBDevices = usbDevices->GetCount();
+
+    size_t NumOfCP210xDevices = 0;
+    for (ssize_t i = 0; i < NumOfUSBDevices; i++) {
+        CCP210xLocation location;
+        CP210x_LOCATION_STRING str;
+        CCP210xTransport* t;
+
+        if (!usbDevices->IsCandidate(i) || usbDevices->GetLocation(i, &location) != 0 || !InPortFilter(usbDevices, i)) {
+            continue;
+        }
+        FormatLocation(location, str);
+        if (strcmp(str, lpszLocation)) {
+            continue;
+        }
+
+        // Only one device can be plugged in there
+        if (usbDevices->Open(i, &t) == CP210x_SUCCESS) {
+            BYTE partNum;
+
+            if (LookUpPartNumber(usbDevices, i, t, &partNum) == CP210x_SUCCESS && IsValidCP210X_PARTNUM((CP210X_PARTNUM)partNum)) {
+                NumOfCP210xDevices++;
+                *devObj = NewDevice(usbDevices, i, t, partNum);
+            }
+            if (!*devObj) {
+                delete t;
             }
-        } else {
-            status = CP210x_DEVICE_NOT_FOUND; // dwDevice out of range
         }
-    } else {
-        status = CP210x_GLOBAL_DATA_ERROR;  // libusb_get_device_list failed
+        break;
     }
+    delete usbDevices;
 
-    // Unreference all devices to free the device list
-    libusb_free_device_list(list, 1);
+    if (probeLatency) {
+        const uint64_t latencyNs = CP210x_ProbeTimestampNs() - startNs;
 
-    return status;
+        CP210x_PROBE4(enumerate__done, CP210x_PROBE_OP_OPEN_BY_LOCATION, NumOfUSBDevices, NumOfCP210xDevices, latencyNs);
+        if (*devObj && CP210x_PROBE_ENABLED(device__open)) {
+            int bus, address;
+
+            GetProbeIdentity((*devObj)->m_transport, &bus, &address);
+            CP210x_PROBE4(device__open, bus, address, (*devObj)->m_partNumber, latencyNs);
+        }
+    }
+    return (*devObj) ? CP210x_SUCCESS : CP210x_DEVICE_NOT_FOUND;
+}
+
+// OpenByLocation() for many locations at once, from one snapshot: whether a
+// CP210x device can be opened at each, which opens nothing but the devices
+// found there and closes them again
+CP210x_STATUS CCP210xDevice::FindLocations(const LPCSTR* lpszLocations, DWORD dwCount, LPBOOL lpbFound)
+{
+    if (!lpszLocations || !lpbFound) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    for (DWORD j = 0; j < dwCount; j++) {
+        lpbFound[j] = FALSE;
+    }
+
+    const uint64_t startNs = CP210x_PROBE_ENABLED(enumerate__done) ? CP210x_ProbeTimestampNs() : 0;
+    CP210x_PROBE1(enumerate__start, CP210x_PROBE_OP_FIND_LOCATIONS);
+
+    CCP210xEnumeration* usbDevices;
+    const CP210x_STATUS enumStatus = CCP210xBackend::Get()->Enumerate(&usbDevices);
+    if (enumStatus != CP210x_SUCCESS) {
+        return enumStatus == CP210x_SESSION_ENDED ? enumStatus : CP210x_GLOBAL_DATA_ERROR;
+    }
+    const ssize_t NumOfUSBDevices = usbDevices->GetCount();
+
+    size_t NumOfCP210xDevices = 0;
+    for (ssize_t i = 0; i < NumOfUSBDevices; i++) {
+        CCP210xLocation location;
+        CP210x_LOCATION_STRING str;
+        CCP210xTransport* t;
+        DWORD j = 0;
+
+        if (!usbDevices->IsCandidate(i) || usbDevices->GetLocation(i, &location) != 0 || !InPortFilter(usbDevices, i)) {
+            continue;
+        }
+        FormatLocation(location, str);
+        while (j < dwCount && (lpbFound[j] || !lpszLocations[j] || strcmp(str, lpszLocations[j]))) {
+            j++;
+        }
+        if (j == dwCount) {
+            continue;
+        }
+
+        if (usbDevices->Open(i, &t) == CP210x_SUCCESS) {
+            BYTE partNum;
+
+            if (LookUpPartNumber(usbDevices, i, t, &partNum) == CP210x_SUCCESS && IsValidCP210X_PARTNUM((CP210X_PARTNUM)partNum)) {
+                NumOfCP210xDevices++;
+                lpbFound[j] = TRUE;
+            }
+            delete t;
+        }
+    }
+    delete usbDevices;
+
+    if (CP210x_PROBE_ENABLED(enumerate__done)) {
+        CP210x_PROBE4(enumerate__done, CP210x_PROBE_OP_FIND_LOCATIONS, NumOfUSBDevices, NumOfCP210xDevices,
+                      CP210x_ProbeTimestampNs() - startNs);
+    }
+    return CP210x_SUCCESS;
 }
-#endif
 
-CP210x_STATUS CCP210xDevice::GetDevicePartNumber(libusb_device_handle* h, LPBYTE lpbPartNum)
+// The device object for a transport opened from the snapshot, NULL if the
+// library doesn't support the part
+CCP210xDevice* CCP210xDevice::NewDevice(CCP210xEnumeration* usbDevices, ssize_t index, CCP210xTransport* t, BYTE partNum)
 {
-    if (!h || !lpbPartNum || !ValidParam(lpbPartNum)) {
+    const CCP210xPartDescriptor* part = GetCP210xPartDescriptor(partNum);
+    CCP210xLocation location;
+
+    if (!part) {
+        return NULL;
+    }
+    if (usbDevices->GetLocation(index, &location) != 0) {
+        location.bus = -1;
+        location.depth = 0;
+    }
+    return new CCP210xDevice(t, partNum, part, location);
+}
+
+// A device object for the part that captures what its setters send
+// instead of talking to a device
+CP210x_STATUS CCP210xDevice::OpenPlan(BYTE partNum, CCP210xDevice** devObj)
+{
+    const CCP210xPartDescriptor* part = GetCP210xPartDescriptor(partNum);
+    CCP210xLocation location;
+
+    if (!devObj) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    *devObj = NULL;
+
+    if (!part) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    location.bus = -1;
+    location.depth = 0;
+
+    CCP210xPlanTransport* plan = new CCP210xPlanTransport();
+    *devObj = new CCP210xDevice(plan, partNum, part, location);
+    (*devObj)->m_plan = plan;
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CCP210xDevice::GetDevicePartNumber(CCP210xTransport* t, LPBYTE lpbPartNum)
+{
+    if (!t || !lpbPartNum || !ValidParam(lpbPartNum)) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    const int ret = libusb_control_transfer(h, 0xC0, 0xFF, 0x370B, 0x0000, lpbPartNum, 1, 7000);
+    const int ret = ProbedControlTransfer(t, 0xC0, 0xFF, 0x370B, 0x0000, lpbPartNum, 1, 7000);
     if (1 == ret) {
         return CP210x_SUCCESS;
     }
@@ -344,7 +501,7 @@ CP210x_STATUS CCP210xDevice::GetDevicePartNumber(libusb_device_handle* h, LPBYTE
     libusb_config_descriptor* configDesc;
         
     CP210x_STATUS status = CP210x_DEVICE_IO_FAILED;
-    if (libusb_get_config_descriptor(libusb_get_device(h), 0, &configDesc) == 0) {
+    if (t->GetConfigDescriptor(&configDesc) == 0) {
         // Looking for a very particular fingerprint to conclude the device is a CP2101
         if ((configDesc->bNumInterfaces > 0) &&
             (configDesc->interface[0].altsetting->bNumEndpoints > 1) &&
@@ -353,26 +510,250 @@ CP210x_STATUS CCP210xDevice::GetDevicePartNumber(libusb_device_handle* h, LPBYTE
             *lpbPartNum = CP210x_CP2101_VERSION;
             status = CP210x_SUCCESS;
         }
-        libusb_free_config_descriptor(configDesc);
+        t->FreeConfigDescriptor(configDesc);
+    }
+    return status;
+}
+
+// Once kept, the registry remembers the part number of every device probed,
+// so a process that enumerates over and over (a daemon) probes each device
+// once. An entry is keyed by where the device is plugged in, its address and
+// its device descriptor: a device that is re-plugged, reset or re-enumerates
+// under another VID/PID comes back at a new address and is probed again.
+void CCP210xDevice::KeepRegistry(bool bKeep)
+{
+    RegistryLock.Lock();
+    RegistryKept = bKeep;
+    if (!bKeep) {
+        Registry.clear();
+    }
+    RegistryLock.Unlock();
+}
+
+// Limits enumeration, and so Open() and OpenByLocation(), to the devices
+// plugged in at the ports of the space or comma separated patterns, so that
+// several processes can each drive their own hub tree without opening each
+// other's devices. NULL or "" lifts the filter.
+CP210x_STATUS CCP210xDevice::SetPortFilter(LPCSTR lpszPorts)
+{
+    std::vector<std::string> patterns;
+
+    for (const char* p = lpszPorts ? lpszPorts : ""; *p; ) {
+        const size_t length = strcspn(p, " ,");
+        if (length) {
+            const std::string pattern(p, length);
+            if (!IsPortPattern(pattern)) {
+                return CP210x_INVALID_PARAMETER;
+            }
+            patterns.push_back(pattern);
+        }
+        p += length;
+        p += strspn(p, " ,");
+    }
+
+    PortFilterLock.Lock();
+    PortFilter.swap(patterns);
+    PortFilterLock.Unlock();
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CCP210xDevice::LookUpPartNumber(CCP210xEnumeration* usbDevices, ssize_t index, CCP210xTransport* t, LPBYTE lpbPartNum)
+{
+    CCP210xRegistryEntry entry;
+
+    RegistryLock.Lock();
+    const bool kept = RegistryKept;
+    RegistryLock.Unlock();
+
+    if (!kept || usbDevices->GetLocation(index, &entry.location) != 0 || t->GetDeviceDescriptor(&entry.desc) != 0) {
+        return GetDevicePartNumber(t, lpbPartNum);
+    }
+    entry.address = t->GetDeviceAddress();
+
+    RegistryLock.Lock();
+    for (size_t i = 0; i < Registry.size(); i++) {
+        const CCP210xRegistryEntry& e = Registry[i];
+
+        if (e.location.bus == entry.location.bus && e.location.depth == entry.location.depth &&
+            !memcmp(e.location.ports, entry.location.ports, e.location.depth) && e.address == entry.address) {
+            if (!memcmp(&e.desc, &entry.desc, sizeof(e.desc))) {
+                *lpbPartNum = e.partNum;
+                RegistryLock.Unlock();
+                return CP210x_SUCCESS;
+            }
+            // another device took the address there since
+            Registry.erase(Registry.begin() + i);
+            break;
+        }
+    }
+    RegistryLock.Unlock();
+
+    const CP210x_STATUS status = GetDevicePartNumber(t, lpbPartNum);
+    if (status == CP210x_SUCCESS) {
+        entry.partNum = *lpbPartNum;
+        RegistryLock.Lock();
+        Registry.push_back(entry);
+        RegistryLock.Unlock();
     }
     return status;
 }
 
+int CCP210xDevice::ProbedControlTransfer(CCP210xTransport* t, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout)
+{
+    if (!CP210x_PROBE_ENABLED(transfer__submit) && !CP210x_PROBE_ENABLED(transfer__complete)) {
+        return t->ControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+    }
+
+    int bus, address;
+    GetProbeIdentity(t, &bus, &address);
+
+    CP210x_PROBE5(transfer__submit, bus, address, bmRequestType, wValue, wLength);
+    const uint64_t startNs = CP210x_ProbeTimestampNs();
+    const int ret = t->ControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+    CP210x_PROBE6(transfer__complete, bus, address, bmRequestType, wValue, ret, CP210x_ProbeTimestampNs() - startNs);
+    return ret;
+}
+
+int CCP210xDevice::ControlTransfer(CCP210xTransport* t, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout)
+{
+    m_requestCount++;
+    return ProbedControlTransfer(t, bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+}
+
+int CCP210xDevice::GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length)
+{
+    m_requestCount++;
+    return m_transport->GetStringDescriptor(descIndex, langId, data, length);
+}
+
+int CCP210xDevice::GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length)
+{
+    m_requestCount++;
+    return m_transport->GetStringDescriptorAscii(descIndex, data, length);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // CCP210xDevice Class - Public Methods
 /////////////////////////////////////////////////////////////////////////////
 
+CCP210xDevice::CCP210xDevice(CCP210xTransport* t, BYTE partNum, const CCP210xPartDescriptor* part, const CCP210xLocation& location) {
+    m_transport = t;
+    m_partNumber = partNum;
+    m_part = part;
+    m_location = location;
+    m_plan = NULL;
+    m_requestCount = 0;
+    m_pendingRuns = 0;
+}
+
+int CCP210xDevice::ProbedReset() {
+    if (!CP210x_PROBE_ENABLED(reset)) {
+        return m_transport->Reset();
+    }
+
+    int bus, address;
+    GetProbeIdentity(m_transport, &bus, &address);
+
+    const uint64_t startNs = CP210x_ProbeTimestampNs();
+    const int ret = m_transport->Reset();
+    CP210x_PROBE5(reset, bus, address, m_partNumber, ret, CP210x_ProbeTimestampNs() - startNs);
+    return ret;
+}
+
 CP210x_STATUS CCP210xDevice::Reset() {
-    libusb_reset_device(m_handle);
+    ProbedReset();
     return CP210x_SUCCESS;
 }
 
+// Resets the device and opens whatever CP210x comes back at its port, under
+// any VID/PID. A device that re-enumerates (libusb reports it gone after the
+// reset) comes back at another address, so one still at the old address is
+// the device before the reset and not taken for it.
+CP210x_STATUS CCP210xDevice::ResetAndReopen(DWORD dwTimeoutMsec, CCP210xDevice** devObj) {
+    if (!devObj || m_plan) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    if (HasPendingRuns()) {
+        return CP210x_DEVICE_BUSY;
+    }
+    *devObj = NULL;
+    if (m_location.bus < 0) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    CP210x_LOCATION_STRING location;
+    FormatLocation(m_location, location);
+    const int oldAddress = m_transport->GetDeviceAddress();
+
+    const int ret = ProbedReset();
+    if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_NOT_FOUND) {
+        return CP210x_DEVICE_IO_FAILED;
+    }
+    const bool reenumerates = ret == LIBUSB_ERROR_NOT_FOUND;
+
+    CCP210xBackend* backend = CCP210xBackend::Get();
+    const uint64_t deadline = backend->NowMsec() + dwTimeoutMsec;
+    DWORD pollMsec = CP210x_REOPEN_POLL_MSEC;
+    for (;;) {
+        CCP210xDevice* dev;
+        bool present;
+        CP210x_STATUS status = IsLocationPresent(location, &present);
+
+        if (status == CP210x_SUCCESS) {
+            // only then is it worth an enumeration of its own
+            status = present ? OpenByLocation(location, &dev) : CP210x_DEVICE_NOT_FOUND;
+        } else if (status != CP210x_SESSION_ENDED) {
+            status = CP210x_GLOBAL_DATA_ERROR;
+        }
+        if (status == CP210x_SUCCESS) {
+            if (!reenumerates || dev->m_transport->GetDeviceAddress() != oldAddress) {
+                *devObj = dev;
+                return CP210x_SUCCESS;
+            }
+            dev->Close();
+            delete dev;
+        } else if (status != CP210x_DEVICE_NOT_FOUND) {
+            return status;
+        }
+        const uint64_t now = backend->NowMsec();
+        if (now >= deadline) {
+            return CP210x_DEVICE_NOT_FOUND;
+        }
+        backend->Delay(static_cast<DWORD>(std::min<uint64_t>(pollMsec, deadline - now)));
+        pollMsec = std::min(pollMsec * 2, static_cast<DWORD>(CP210x_REOPEN_MAX_POLL_MSEC));
+    }
+}
+
+// Refused while plans submitted to the device are running: their transfers
+// are in flight on its transport
 CP210x_STATUS CCP210xDevice::Close() {
-    libusb_close(m_handle);
-    m_handle = NULL;
+    if (HasPendingRuns()) {
+        return CP210x_DEVICE_BUSY;
+    }
+    if (CP210x_PROBE_ENABLED(device__close)) {
+        int bus, address;
+
+        GetProbeIdentity(m_transport, &bus, &address);
+        CP210x_PROBE3(device__close, bus, address, m_partNumber);
+    }
+    delete m_transport;
+    m_transport = NULL;
     return CP210x_SUCCESS;
 }
 
+// Permanently locks the device configuration via SetLockValue()
+CP210x_STATUS CCP210xDevice::Lock() {
+    const CP210x_STATUS status = SetLockValue();
+
+    if (CP210x_PROBE_ENABLED(lock)) {
+        int bus, address;
+
+        GetProbeIdentity(m_transport, &bus, &address);
+        CP210x_PROBE4(lock, bus, address, m_partNumber, status);
+    }
+    return status;
+}
+
 HANDLE CCP210xDevice::GetHandle() {
     return this;
 }
@@ -388,52 +769,247 @@ CP210x_STATUS CCP210xDevice::GetPartNumber(LPBYTE lpbPartNum) {
     return CP210x_SUCCESS;
 }
 
-CP210x_STATUS CCP210xDevice::SetVid(WORD wVid) {
-    CP210x_STATUS status;
-
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3701, wVid, NULL, 0, 0) == 0) {
-        status = CP210x_SUCCESS;
-    } else {
-        status = CP210x_DEVICE_IO_FAILED;
+CP210x_STATUS CCP210xDevice::GetRequestCount(LPDWORD lpdwCount) {
+    // Validate parameter
+    if (!ValidParam(lpdwCount)) {
+        return CP210x_INVALID_PARAMETER;
     }
 
-    return status;
-}
+    *lpdwCount = m_requestCount;
 
-CP210x_STATUS CCP210xDevice::SetPid(WORD wPid) {
-    CP210x_STATUS status;
+    return CP210x_SUCCESS;
+}
 
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3702, wPid, NULL, 0, 0) == 0) {
-        status = CP210x_SUCCESS;
-    } else {
-        status = CP210x_DEVICE_IO_FAILED;
+CP210x_STATUS CCP210xDevice::GetLocation(LPSTR lpszLocation) {
+    if (m_location.bus < 0) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
     }
-
-    return status;
+    FormatLocation(m_location, lpszLocation);
+    return CP210x_SUCCESS;
 }
 
-CP210x_STATUS CCP210xDevice::SetProductString(LPVOID lpvProduct, BYTE bLength, BOOL bConvertToUnicode) {
-    CP210x_STATUS status;
-    BYTE str[CP210x_MAX_DEVICE_STRLEN];
-    BYTE length = bLength;
-    int transferSize;
+// The plan's SetSerialNumber() request, transfers.size() if it has none
+static size_t FindSerialSlot(const std::vector<CCP210xPlanTransfer>& transfers)
+{
+    size_t serialSlot = transfers.size();
 
-    // Validate parameter
-    if (!ValidParam(lpvProduct)) {
-        return CP210x_INVALID_PARAMETER;
+    for (size_t i = 0; i < transfers.size(); i++) {
+        if (transfers[i].bmRequestType == 0x40 && transfers[i].bRequest == 0xFF && transfers[i].wValue == 0x3704) {
+            serialSlot = i;
+        }
     }
+    return serialSlot;
+}
 
-    if ((bLength > maxProductStrLen) || (bLength < 1)) {
+// Sends the transfers captured on the plan, except that a serial number given
+// here replaces the plan's: the part checked and converted the rest when the
+// plan was captured.
+CP210x_STATUS CCP210xDevice::RunPlan(CCP210xDevice* plan, LPVOID lpvSerialNumber, BYTE bLength, BOOL bConvertToUnicode) {
+    if (m_plan || !plan->m_plan || plan->m_partNumber != m_partNumber) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    CopyToString(str, lpvProduct, &length, bConvertToUnicode);
+    const std::vector<CCP210xPlanTransfer>& transfers = plan->m_plan->Transfers();
+    const size_t serialSlot = FindSerialSlot(transfers);
 
-    transferSize = length + 2;
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3703, 0, str, transferSize, 0) == transferSize) {
-        status = CP210x_SUCCESS;
-    } else {
-        status = CP210x_DEVICE_IO_FAILED;
+    // The plan needs a serial number request for a serial number to go into
+    if (lpvSerialNumber && serialSlot == transfers.size()) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    for (size_t i = 0; i < transfers.size(); i++) {
+        const CCP210xPlanTransfer& transfer = transfers[i];
+
+        if (lpvSerialNumber && i == serialSlot) {
+            const CP210x_STATUS status = SetSerialNumber(lpvSerialNumber, bLength, bConvertToUnicode);
+
+            if (status != CP210x_SUCCESS) {
+                return status;
+            }
+            continue;
+        }
+
+        // An OUT transfer doesn't write to its buffer
+        const int length = (int) transfer.data.size();
+        unsigned char* data = length ? const_cast<unsigned char*>(&transfer.data[0]) : NULL;
+
+        if (ControlTransfer(m_transport, transfer.bmRequestType, transfer.bRequest, transfer.wValue, transfer.wIndex, data, (uint16_t) length, 0) != length) {
+            return CP210x_DEVICE_IO_FAILED;
+        }
+    }
+
+    return CP210x_SUCCESS;
+}
+
+// Copies the plan's transfers, with the serial number's transfer captured on a
+// plan of its own, and submits the first: the rest follow from its completion.
+CP210x_STATUS CCP210xDevice::SubmitPlan(CCP210xDevice* plan, LPVOID lpvSerialNumber, BYTE bLength, BOOL bConvertToUnicode, CP210x_PLAN_DONE done, LPVOID lpContext) {
+    if (m_plan || !plan->m_plan || plan->m_partNumber != m_partNumber || plan->m_plan->Transfers().empty()) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    CPlanRun* run = new CPlanRun;
+    const size_t serialSlot = FindSerialSlot(plan->m_plan->Transfers());
+
+    run->dev = this;
+    run->transfers = plan->m_plan->Transfers();
+    run->next = 0;
+    run->submitNs = 0;
+    run->done = done;
+    run->context = lpContext;
+
+    if (lpvSerialNumber) {
+        CCP210xDevice* serialPlan = NULL;
+        CP210x_STATUS status = serialSlot == run->transfers.size() ? CP210x_INVALID_PARAMETER : OpenPlan(m_partNumber, &serialPlan);
+
+        if (status == CP210x_SUCCESS) {
+            status = serialPlan->SetSerialNumber(lpvSerialNumber, bLength, bConvertToUnicode);
+            if (status == CP210x_SUCCESS) {
+                run->transfers[serialSlot] = serialPlan->m_plan->Transfers()[0];
+            }
+            serialPlan->Close();
+            delete serialPlan;
+        }
+        if (status != CP210x_SUCCESS) {
+            delete run;
+            return status;
+        }
+    }
+
+    // Counted first, the transfer may complete before the submission returns
+    PlanRunLock.Lock();
+    m_pendingRuns++;
+    PlanRunLock.Unlock();
+    if (SubmitPlanTransfer(run) != 0) {
+        PlanRunLock.Lock();
+        m_pendingRuns--;
+        PlanRunLock.Unlock();
+        delete run;
+        return CP210x_DEVICE_IO_FAILED;
+    }
+    return CP210x_SUCCESS;
+}
+
+bool CCP210xDevice::HasPendingRuns() {
+    PlanRunLock.Lock();
+    const bool pending = m_pendingRuns != 0;
+    PlanRunLock.Unlock();
+    return pending;
+}
+
+int CCP210xDevice::SubmitPlanTransfer(CPlanRun* run) {
+    const CCP210xPlanTransfer& transfer = run->transfers[run->next];
+    const int length = (int) transfer.data.size();
+    unsigned char* data = length ? const_cast<unsigned char*>(&transfer.data[0]) : NULL;
+
+    m_requestCount++;
+    if (CP210x_PROBE_ENABLED(transfer__submit) || CP210x_PROBE_ENABLED(transfer__complete)) {
+        int bus, address;
+
+        GetProbeIdentity(m_transport, &bus, &address);
+        CP210x_PROBE5(transfer__submit, bus, address, transfer.bmRequestType, transfer.wValue, length);
+        run->submitNs = CP210x_ProbeTimestampNs();
+    }
+    return m_transport->SubmitControlTransfer(transfer.bmRequestType, transfer.bRequest, transfer.wValue, transfer.wIndex, data, (uint16_t) length, 0, OnPlanTransferDone, run);
+}
+
+// Submits the run's next transfer, or ends the run after its last one or a
+// transfer that failed
+void CCP210xDevice::OnPlanTransferDone(void* context, int result) {
+    CPlanRun* run = static_cast<CPlanRun*>(context);
+    const CCP210xPlanTransfer& transfer = run->transfers[run->next];
+    CP210x_STATUS status = CP210x_SUCCESS;
+
+    if (CP210x_PROBE_ENABLED(transfer__complete)) {
+        int bus, address;
+
+        GetProbeIdentity(run->dev->m_transport, &bus, &address);
+        CP210x_PROBE6(transfer__complete, bus, address, transfer.bmRequestType, transfer.wValue, result, CP210x_ProbeTimestampNs() - run->submitNs);
+    }
+
+    if (result != (int) transfer.data.size()) {
+        status = CP210x_DEVICE_IO_FAILED;
+    } else if (++run->next < run->transfers.size()) {
+        if (run->dev->SubmitPlanTransfer(run) == 0) {
+            return;
+        }
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+    // No longer pending when done is called, so it may close the device
+    const HANDLE handle = run->dev->GetHandle();
+    PlanRunLock.Lock();
+    run->dev->m_pendingRuns--;
+    PlanRunLock.Unlock();
+    run->done(handle, status, run->context);
+    delete run;
+}
+
+// Fills as many of the transfers as lpTransfers has room for and counts all of them
+CP210x_STATUS CCP210xDevice::GetPlanTransfers(CP210x_PLAN_TRANSFER* lpTransfers, LPDWORD lpdwCount) {
+    if (!m_plan) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    const std::vector<CCP210xPlanTransfer>& transfers = m_plan->Transfers();
+
+    for (size_t i = 0; lpTransfers && i < transfers.size() && i < *lpdwCount; i++) {
+        lpTransfers[i].bmRequestType = transfers[i].bmRequestType;
+        lpTransfers[i].bRequest = transfers[i].bRequest;
+        lpTransfers[i].wValue = transfers[i].wValue;
+        lpTransfers[i].wIndex = transfers[i].wIndex;
+        lpTransfers[i].wLength = (WORD) transfers[i].data.size();
+    }
+    *lpdwCount = (DWORD) transfers.size();
+
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CCP210xDevice::SetVid(WORD wVid) {
+    CP210x_STATUS status;
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3701, wVid, NULL, 0, 0) == 0) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetPid(WORD wPid) {
+    CP210x_STATUS status;
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3702, wPid, NULL, 0, 0) == 0) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetProductString(LPVOID lpvProduct, BYTE bLength, BOOL bConvertToUnicode) {
+    CP210x_STATUS status;
+    BYTE str[CP210x_MAX_DEVICE_STRLEN];
+    BYTE length = bLength;
+    int transferSize;
+
+    // Validate parameter
+    if (!ValidParam(lpvProduct)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    if ((bLength > m_part->caps.MaxProductStrLen) || (bLength < 1)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    CopyToString(str, lpvProduct, &length, bConvertToUnicode);
+
+    transferSize = length + 2;
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3703, 0, str, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
     }
     
     return status;
@@ -450,14 +1026,14 @@ CP210x_STATUS CCP210xDevice::SetSerialNumber(LPVOID lpvSerialNumber, BYTE bLengt
         return CP210x_INVALID_PARAMETER;
     }
 
-    if ((bLength > maxProductStrLen) || (bLength < 1)) {
+    if ((bLength > m_part->caps.MaxSerialStrLen) || (bLength < 1)) {
         return CP210x_INVALID_PARAMETER;
     }
 
     CopyToString(str, lpvSerialNumber, &length, bConvertToUnicode);
 
     transferSize = length + 2;
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3704, 0, str, transferSize, 0) == transferSize) {
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3704, 0, str, transferSize, 0) == transferSize) {
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -473,7 +1049,7 @@ CP210x_STATUS CCP210xDevice::SetSelfPower(BOOL bSelfPower) {
     if (bSelfPower)
         bPowerAttrib |= 0x40; // Set the self-powered bit.
 
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3705, bPowerAttrib, NULL, 0, 0) == 0) {
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3705, bPowerAttrib, NULL, 0, 0) == 0) {
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -488,7 +1064,7 @@ CP210x_STATUS CCP210xDevice::SetMaxPower(BYTE bMaxPower) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3706, bMaxPower, NULL, 0, 0) == 0) {
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3706, bMaxPower, NULL, 0, 0) == 0) {
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -500,7 +1076,7 @@ CP210x_STATUS CCP210xDevice::SetMaxPower(BYTE bMaxPower) {
 CP210x_STATUS CCP210xDevice::SetDeviceVersion(WORD wVersion) {
     CP210x_STATUS status;
 
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3707, wVersion, NULL, 0, 0) == 0) {
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3707, wVersion, NULL, 0, 0) == 0) {
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -518,7 +1094,7 @@ CP210x_STATUS CCP210xDevice::GetVid(LPWORD lpwVid) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    if (libusb_get_device_descriptor(libusb_get_device(m_handle), &devDesc) == 0) {
+    if (m_transport->GetDeviceDescriptor(&devDesc) == 0) {
         *lpwVid = devDesc.idVendor;
 
         status = CP210x_SUCCESS;
@@ -538,7 +1114,7 @@ CP210x_STATUS CCP210xDevice::GetPid(LPWORD lpwPid) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    if (libusb_get_device_descriptor(libusb_get_device(m_handle), &devDesc) == 0) {
+    if (m_transport->GetDeviceDescriptor(&devDesc) == 0) {
         *lpwPid = devDesc.idProduct;
 
         status = CP210x_SUCCESS;
@@ -559,7 +1135,7 @@ struct UsbStrDesc
 CP210x_STATUS CCP210xDevice::GetUnicodeString( uint8_t desc_index, LPBYTE pBuf, int CbBuf, LPBYTE pCchStr)
 {
     CP210x_STATUS status;
-    const int CbReturned = libusb_get_string_descriptor(m_handle, desc_index, 0x0000 /*desc_type*/, pBuf, CbBuf);
+    const int CbReturned = GetStringDescriptor(desc_index, 0x0000 /*desc_type*/, pBuf, CbBuf);
     if( CbReturned > 0) {
         if( CbReturned > 1) { // at least have the prefix
             const struct UsbStrDesc *pDesc = (struct UsbStrDesc *) pBuf;
@@ -589,18 +1165,22 @@ CP210x_STATUS CCP210xDevice::GetDeviceManufacturerString(LPVOID lpManufacturer,
     int length;
     int index;
 
+    if (!Supports(CP210x_CAP_MANUFACTURER_STRING)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
     // Validate parameter
     if (!ValidParam(lpManufacturer, pCchStr)) {
         return CP210x_INVALID_PARAMETER;
     }
 
     // Get descriptor that contains the index of the USB_STRING_DESCRIPTOR containing the Product String
-    if (libusb_get_device_descriptor(libusb_get_device(m_handle), &devDesc) == 0) {
+    if (m_transport->GetDeviceDescriptor(&devDesc) == 0) {
         index = devDesc.iManufacturer;
     }
 
     if (bConvertToASCII) {
-        length = libusb_get_string_descriptor_ascii(m_handle, index, (unsigned char*) lpManufacturer, CP210x_MAX_DEVICE_STRLEN);
+        length = GetStringDescriptorAscii(index, (unsigned char*) lpManufacturer, CP210x_MAX_DEVICE_STRLEN);
         if (length > 0) {
             *pCchStr = (BYTE) (length & 0xFF);
             status = CP210x_SUCCESS;
@@ -619,12 +1199,16 @@ CP210x_STATUS CCP210xDevice::SetManufacturerString(LPVOID lpvManufacturer, BYTE
     BYTE length = CchStr;
     int transferSize;
 
+    if (!Supports(CP210x_CAP_MANUFACTURER_STRING)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
     // Validate parameter
     if (!ValidParam(lpvManufacturer)) {
         return CP210x_INVALID_PARAMETER;
     }
 
-    if ((CchStr > CP210x_MAX_MANUFACTURER_STRLEN) || (CchStr < 1)) {
+    if ((CchStr > m_part->caps.MaxManufacturerStrLen) || (CchStr < 1)) {
         return CP210x_INVALID_PARAMETER;
     }
 
@@ -633,7 +1217,7 @@ CP210x_STATUS CCP210xDevice::SetManufacturerString(LPVOID lpvManufacturer, BYTE
     CopyToString(setup, lpvManufacturer, &length, bConvertToUnicode);
 
     transferSize = length + 2;
-    if (libusb_control_transfer(m_handle, 0x40, 0xFF, 0x3714, 0, setup, transferSize, 0) == transferSize) {
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3714, 0, setup, transferSize, 0) == transferSize) {
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -644,7 +1228,7 @@ CP210x_STATUS CCP210xDevice::SetManufacturerString(LPVOID lpvManufacturer, BYTE
 
 CP210x_STATUS CCP210xDevice::GetDeviceProductString(LPVOID lpProduct, LPBYTE pCchStr, BOOL bConvertToASCII) {
     CP210x_STATUS status = CP210x_INVALID_HANDLE;
-    BYTE index = 2;  // Our "best guess", lest libusb_get_device_descriptor() fails, and we choose to continue anyway
+    BYTE index = 2;  // Our "best guess", lest GetDeviceDescriptor() fails, and we choose to continue anyway
 
     // Validate parameter
     if (!ValidParam(lpProduct, pCchStr)) {
@@ -653,12 +1237,12 @@ CP210x_STATUS CCP210xDevice::GetDeviceProductString(LPVOID lpProduct, LPBYTE pCc
 
     // Get descriptor that contains the index of the USB_STRING_DESCRIPTOR containing the Product String
     libusb_device_descriptor devDesc;
-    if (0 == libusb_get_device_descriptor(libusb_get_device(m_handle), &devDesc)) {
+    if (0 == m_transport->GetDeviceDescriptor(&devDesc)) {
         index = devDesc.iProduct;
     }
 
     if (bConvertToASCII) {
-        const int length = libusb_get_string_descriptor_ascii(m_handle, index, (unsigned char*) lpProduct, CP210x_MAX_DEVICE_STRLEN);
+        const int length = GetStringDescriptorAscii(index, (unsigned char*) lpProduct, CP210x_MAX_DEVICE_STRLEN);
         if (length > 0) {
             *pCchStr = (BYTE) (length & 0xFF);
             status = CP210x_SUCCESS;
@@ -674,7 +1258,7 @@ CP210x_STATUS CCP210xDevice::GetDeviceProductString(LPVOID lpProduct, LPBYTE pCc
 
 CP210x_STATUS CCP210xDevice::GetDeviceSerialNumber(LPVOID lpSerial, LPBYTE pCchStr, BOOL bConvertToASCII) {
     CP210x_STATUS status = CP210x_INVALID_HANDLE;
-    BYTE index = 3;  // Our "best guess", lest libusb_get_device_descriptor() fails, and we choose to continue anyway
+    BYTE index = 3;  // Our "best guess", lest GetDeviceDescriptor() fails, and we choose to continue anyway
 
     // Validate parameter
     if (!ValidParam(lpSerial, pCchStr)) {
@@ -682,12 +1266,12 @@ CP210x_STATUS CCP210xDevice::GetDeviceSerialNumber(LPVOID lpSerial, LPBYTE pCchS
     }
 
     libusb_device_descriptor devDesc;
-    if (0 == libusb_get_device_descriptor(libusb_get_device(m_handle), &devDesc)) {
+    if (0 == m_transport->GetDeviceDescriptor(&devDesc)) {
         index = devDesc.iSerialNumber;
     }
 
     if (bConvertToASCII) {
-        const int length = libusb_get_string_descriptor_ascii(m_handle, index, (unsigned char*) lpSerial, CP210x_MAX_DEVICE_STRLEN);
+        const int length = GetStringDescriptorAscii(index, (unsigned char*) lpSerial, CP210x_MAX_DEVICE_STRLEN);
         if (length > 0) {
             *pCchStr = (BYTE) (length & 0xFF);
             status = CP210x_SUCCESS;
@@ -711,12 +1295,12 @@ CP210x_STATUS CCP210xDevice::GetSelfPower(LPBOOL lpbSelfPower) {
     }
 
     // Get descriptor that contains the index of the USB_STRING_DESCRIPTOR containing the Product String
-    if (libusb_get_config_descriptor(libusb_get_device(m_handle), 0, &configDesc) == 0) {
+    if (m_transport->GetConfigDescriptor(&configDesc) == 0) {
         if (configDesc->bmAttributes & 0x40)
             *lpbSelfPower = TRUE;
         else
             *lpbSelfPower = FALSE;
-        libusb_free_config_descriptor(configDesc);
+        m_transport->FreeConfigDescriptor(configDesc);
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -735,9 +1319,9 @@ CP210x_STATUS CCP210xDevice::GetMaxPower(LPBYTE lpbMaxPower) {
     }
 
     // Get descriptor that contains the index of the USB_STRING_DESCRIPTOR containing the Product String
-    if (libusb_get_config_descriptor(libusb_get_device(m_handle), 0, &configDesc) == 0) {
+    if (m_transport->GetConfigDescriptor(&configDesc) == 0) {
         *lpbMaxPower = configDesc->MaxPower;
-        libusb_free_config_descriptor(configDesc);
+        m_transport->FreeConfigDescriptor(configDesc);
         status = CP210x_SUCCESS;
     } else {
         status = CP210x_DEVICE_IO_FAILED;
@@ -756,7 +1340,7 @@ CP210x_STATUS CCP210xDevice::GetDeviceVersion(LPWORD lpwVersion) {
     }
 
     // Get descriptor that contains the index of the USB_STRING_DESCRIPTOR containing the Product String
-    if (libusb_get_device_descriptor(libusb_get_device(m_handle), &devDesc) == 0) {
+    if (m_transport->GetDeviceDescriptor(&devDesc) == 0) {
         *lpwVersion = devDesc.bcdDevice;
         status = CP210x_SUCCESS;
     } else {
@@ -766,5 +1350,705 @@ CP210x_STATUS CCP210xDevice::GetDeviceVersion(LPWORD lpwVersion) {
     return status;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xDevice Class - Part-Specific Methods
+/////////////////////////////////////////////////////////////////////////////
+
+CP210x_STATUS CCP210xDevice::GetDeviceInterfaceString(BYTE bInterfaceNumber, LPVOID lpInterface, LPBYTE pCchStr, BOOL bConvertToASCII) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    int length;
+    int index;
+
+    if (!Supports(CP210x_CAP_INTERFACE_STRING)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Validate parameter
+    if (!ValidParam(lpInterface, pCchStr)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    if (bInterfaceNumber >= m_part->caps.NumInterfaces) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    // Interface strings follow the manufacturer, product and serial number
+    // ones, from string 3 on
+    index = 3 + bInterfaceNumber;
+
+    if (bConvertToASCII) {
+        length = GetStringDescriptorAscii(index, (unsigned char*) lpInterface, CP210x_MAX_DEVICE_STRLEN);
+        if (length > 0) {
+            *pCchStr = (BYTE) (length & 0xFF);
+            status = CP210x_SUCCESS;
+        } else {
+            status = CP210x_DEVICE_IO_FAILED;
+        }
+    } else {
+        status = GetUnicodeString( index, (LPBYTE) lpInterface, CP210x_MAX_DEVICE_STRLEN, pCchStr);
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetFlushBufferConfig(LPWORD lpwFlushBufferConfig) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    const int transferSize = m_part->flushBufferConfigSize;
+
+    if (!Supports(CP210x_CAP_FLUSH_BUFFER_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Validate parameter
+    if (!ValidParam(lpwFlushBufferConfig)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x370D, 0, setup, transferSize, 0) == transferSize) {
+        *lpwFlushBufferConfig = setup[0] | (setup[1] << 8);
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetDeviceMode(LPBYTE lpbDeviceModeECI, LPBYTE lpbDeviceModeSCI) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    int transferSize = 2;
+
+    if (!Supports(CP210x_CAP_DEVICE_MODE)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Validate parameter
+    if (!ValidParam(lpbDeviceModeECI)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    // Validate parameter
+    if (!ValidParam(lpbDeviceModeSCI)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x3711, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+        *lpbDeviceModeECI = setup[0];
+        *lpbDeviceModeSCI = setup[1];
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetBaudRateConfig(BAUD_CONFIG* baudConfigData) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    int transferSize = (NUM_BAUD_CONFIGS * BAUD_CONFIG_SIZE);
+
+    if (!Supports(CP210x_CAP_BAUD_RATE_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+    
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x3709, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+        BAUD_CONFIG* currentBaudConfig;
+        currentBaudConfig = baudConfigData;
+
+        for (int i = 0; i < transferSize; i += BAUD_CONFIG_SIZE) {
+            currentBaudConfig->BaudGen = (setup[i] << 8) + setup[i + 1];
+            currentBaudConfig->Timer0Reload = (setup[i + 2] << 8) + setup[i + 3];
+            currentBaudConfig->Prescaler = setup[i + 4];
+            //setup[i+5] reserved for later use
+            currentBaudConfig->BaudRate = setup[i + 6] + (setup[i + 7] << 8) + (setup[i + 8] << 16) + (setup[i + 9] << 24);
+
+            currentBaudConfig++;
+        }
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetPortConfig(PORT_CONFIG* PortConfig) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    int transferSize = 13;
+
+    if (!Supports(CP210x_CAP_PORT_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+    
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x370C, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+        PortConfig->Mode = (setup[0] << 8) + setup[1];
+        //PortConfig->Reset.LowPower = (setup[10] << 8) + setup[11];
+        PortConfig->Reset_Latch = (setup[4] << 8) + setup[5];
+        //PortConfig->Suspend.Mode = (setup[14] << 8) + setup[15];
+        //PortConfig->Suspend.LowPower = (setup[16] << 8) + setup[17];
+        PortConfig->Suspend_Latch = (setup[10] << 8) + setup[11];
+        PortConfig->EnhancedFxn = setup[12];
+
+        // Mask out reserved bits in EnhancedFxn
+        PortConfig->EnhancedFxn &= ~(EF_SERIAL_DYNAMIC_SUSPEND | EF_RESERVED_1);
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetDualPortConfig(DUAL_PORT_CONFIG* DualPortConfig) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    int transferSize = 15;
+
+    if (!Supports(CP210x_CAP_DUAL_PORT_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x370C, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+        DualPortConfig->Mode = (setup[0] << 8) + setup[1];
+        //PortConfig->Reset.LowPower = (setup[10] << 8) + setup[11];
+        DualPortConfig->Reset_Latch = (setup[4] << 8) + setup[5];
+        //PortConfig->Suspend.Mode = (setup[14] << 8) + setup[15];
+        //PortConfig->Suspend.LowPower = (setup[16] << 8) + setup[17];
+        DualPortConfig->Suspend_Latch = (setup[10] << 8) + setup[11];
+        DualPortConfig->EnhancedFxn_SCI = setup[12];
+        DualPortConfig->EnhancedFxn_ECI = setup[13];
+        DualPortConfig->EnhancedFxn_Device = setup[14];
+
+        // Mask out reserved bits in EnhancedFxn
+        //DualPortConfig->EnhancedFxnECI &= ~EF_DYNAMIC_SUSPEND_ECI;
+        //DualPortConfig->EnhancedFxnSCI &= ~EF_DYNAMIC_SUSPEND_SCI;
+        DualPortConfig->EnhancedFxn_Device &= ~EF_RESERVED_1;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetQuadPortConfig(QUAD_PORT_CONFIG* QuadPortConfig) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    int transferSize = 73;
 
+    if (!Supports(CP210x_CAP_QUAD_PORT_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
 
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x370C, 0, (BYTE*) QuadPortConfig, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetLockValue(LPBYTE lpbLockValue) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+
+    if (!Supports(CP210x_CAP_LOCK_VALUE)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Validate parameter
+    if (!ValidParam(lpbLockValue)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+    
+    if (ControlTransfer(m_transport, 0xC0, 0xFF, 0x370A, 0, setup, 1, 0) == 1) {
+        if (setup[0] == 0xFF)
+            *lpbLockValue = 0x00;
+        else
+            *lpbLockValue = 0x01;
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetInterfaceString(BYTE bInterfaceNumber, LPVOID lpvInterface, BYTE bLength, BOOL bConvertToUnicode) {
+    CP210x_STATUS status;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    BYTE length = bLength;
+    int transferSize;
+
+    if (!Supports(CP210x_CAP_INTERFACE_STRING)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Validate parameter
+    if (!ValidParam(lpvInterface)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    if ((bLength > m_part->caps.MaxInterfaceStrLen) || (bLength < 1)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    if (bInterfaceNumber < m_part->caps.NumInterfaces) {
+        // Copy string will alter the length if the string has to be converted to unicode.
+        CopyToString(setup, lpvInterface, &length, bConvertToUnicode);
+
+        transferSize = length + 2;
+        if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3700 | m_part->interfaceStringRequest[bInterfaceNumber], 0, setup, transferSize, 0) == transferSize) {
+            status = CP210x_SUCCESS;
+        } else {
+            status = CP210x_DEVICE_IO_FAILED;
+        }
+    } else {
+        status = CP210x_INVALID_PARAMETER;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetFlushBufferConfig(WORD wFlushBufferConfig) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+
+    if (!Supports(CP210x_CAP_FLUSH_BUFFER_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x370D, wFlushBufferConfig, NULL, 0, 0) == 0) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetDeviceMode(BYTE bDeviceModeECI, BYTE bDeviceModeSCI) {
+    CP210x_STATUS status;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    int transferSize = 4;
+
+    if (!Supports(CP210x_CAP_DEVICE_MODE)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    setup[0] = bDeviceModeECI;
+    setup[1] = bDeviceModeSCI;
+    setup[2] = 0;
+    setup[3] = 0;
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3711, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetBaudRateConfig(BAUD_CONFIG* baudConfigData) {
+    CP210x_STATUS status;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    BAUD_CONFIG* currentBaudConfig;
+    int transferSize = (NUM_BAUD_CONFIGS * BAUD_CONFIG_SIZE);
+    currentBaudConfig = baudConfigData;
+
+    if (!Supports(CP210x_CAP_BAUD_RATE_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+    
+    for (int i = 0; i < transferSize; i += BAUD_CONFIG_SIZE) {
+        setup[i] = (currentBaudConfig->BaudGen & 0xFF00) >> 8;
+        setup[i + 1] = currentBaudConfig->BaudGen & 0x00FF;
+        setup[i + 2] = (currentBaudConfig->Timer0Reload & 0xFF00) >> 8;
+        setup[i + 3] = currentBaudConfig->Timer0Reload & 0x00FF;
+        setup[i + 4] = currentBaudConfig->Prescaler;
+        setup[i + 5] = 0x00; //reserved for later
+        setup[i + 6] = (BYTE) (currentBaudConfig->BaudRate & 0x000000FF);
+        setup[i + 7] = (BYTE) ((currentBaudConfig->BaudRate & 0x0000FF00) >> 8);
+        setup[i + 8] = (BYTE) ((currentBaudConfig->BaudRate & 0x00FF0000) >> 16);
+        setup[i + 9] = (BYTE) ((currentBaudConfig->BaudRate & 0xFF000000) >> 24);
+
+        currentBaudConfig++;
+    }
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x3709, 0, setup, transferSize + 2, 0) == transferSize + 2) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetPortConfig(PORT_CONFIG* PortConfig) {
+    CP210x_STATUS status;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    BYTE Temp_EnhancedFxn;
+    int transferSize = 13;
+
+    if (!Supports(CP210x_CAP_PORT_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Change user Port_Config structure to match firmware, and check reserved bits are zero
+    if (PortConfig->EnhancedFxn & (EF_SERIAL_DYNAMIC_SUSPEND | EF_RESERVED_1))
+        return CP210x_INVALID_PARAMETER;
+
+    Temp_EnhancedFxn = PortConfig->EnhancedFxn; // save user settings into temp variable to send out
+
+    if (Temp_EnhancedFxn & EF_WEAKPULLUP) {
+        Temp_EnhancedFxn |= 0x30; // Set both Weak Pullup bits
+    } else {
+        Temp_EnhancedFxn &= ~0x30; // Clear both Weak Pullup bits
+    }
+    
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    setup[0] = (PortConfig->Mode & 0xFF00) >> 8;
+    setup[1] = (PortConfig->Mode & 0x00FF);
+    setup[2] = 0x00; //(PortConfig->Reset.LowPower & 0xFF00) >> 8;
+    setup[3] = 0x00; //(PortConfig->Reset.LowPower & 0x00FF);
+    setup[4] = (PortConfig->Reset_Latch & 0xFF00) >> 8;
+    setup[5] = (PortConfig->Reset_Latch & 0x00FF);
+    setup[6] = (PortConfig->Mode & 0xFF00) >> 8;
+    setup[7] = (PortConfig->Mode & 0x00FF);
+    setup[8] = 0x00; //(PortConfig->Suspend.LowPower & 0xFF00) >> 8;
+    setup[9] = 0x00; //(PortConfig->Suspend.LowPower & 0x00FF);
+    setup[10] = (PortConfig->Suspend_Latch & 0xFF00) >> 8;
+    setup[11] = (PortConfig->Suspend_Latch & 0x00FF);
+    setup[12] = Temp_EnhancedFxn;
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x370C, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetDualPortConfig(DUAL_PORT_CONFIG* DualPortConfig) {
+    CP210x_STATUS status;
+    BYTE setup[CP210x_MAX_SETUP_LENGTH];
+    BYTE Temp_EnhancedFxn_ECI, Temp_EnhancedFxn_SCI, Temp_EnhancedFxn_Device;
+    int transferSize = 15;
+
+    if (!Supports(CP210x_CAP_DUAL_PORT_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    // Change user Port_Config structure to match firmware, and check reserved bits are zero
+    if ((DualPortConfig->EnhancedFxn_Device & EF_RESERVED_1) /*||
+		(DualPortConfig->EnhancedFxn_ECI & EF_DYNAMIC_SUSPEND_ECI) ||
+		(DualPortConfig->EnhancedFxn_SCI & EF_DYNAMIC_SUSPEND_SCI)*/)
+        return CP210x_INVALID_PARAMETER;
+
+    Temp_EnhancedFxn_ECI = DualPortConfig->EnhancedFxn_ECI; // save user settings into temp variable to send out
+    Temp_EnhancedFxn_SCI = DualPortConfig->EnhancedFxn_SCI;
+    Temp_EnhancedFxn_Device = DualPortConfig->EnhancedFxn_Device;
+
+    if (Temp_EnhancedFxn_Device & EF_WEAKPULLUP) {
+        Temp_EnhancedFxn_Device |= 0x30; // Set both Weak Pullup bits
+    } else {
+        Temp_EnhancedFxn_Device &= ~0x30; // Clear both Weak Pullup bits
+    }
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    setup[0] = (DualPortConfig->Mode & 0xFF00) >> 8;
+    setup[1] = (DualPortConfig->Mode & 0x00FF);
+    setup[2] = 0x00;
+    setup[3] = 0x00;
+    setup[4] = (DualPortConfig->Reset_Latch & 0xFF00) >> 8;
+    setup[5] = (DualPortConfig->Reset_Latch & 0x00FF);
+    setup[6] = (DualPortConfig->Mode & 0xFF00) >> 8;
+    setup[7] = (DualPortConfig->Mode & 0x00FF);
+    setup[8] = 0x00;
+    setup[9] = 0x00;
+    setup[10] = (DualPortConfig->Suspend_Latch & 0xFF00) >> 8;
+    setup[11] = (DualPortConfig->Suspend_Latch & 0x00FF);
+    setup[12] = Temp_EnhancedFxn_SCI;
+    setup[13] = Temp_EnhancedFxn_ECI;
+    setup[14] = Temp_EnhancedFxn_Device;
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x370C, 0, setup, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetQuadPortConfig(QUAD_PORT_CONFIG* QuadPortConfig) {
+    CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    int transferSize = 73;
+
+    if (!Supports(CP210x_CAP_QUAD_PORT_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x370C, 0, (BYTE*) QuadPortConfig, transferSize, 0) == transferSize) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetLockValue() {
+    CP210x_STATUS status;
+
+    if (!Supports(CP210x_CAP_LOCK_VALUE)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    if (ControlTransfer(m_transport, 0x40, 0xFF, 0x370A, 0xF0, NULL, 0, 0) == 0) {
+        status = CP210x_SUCCESS;
+    } else {
+        status = CP210x_DEVICE_IO_FAILED;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetFirmwareVersion( pFirmware_t	lpVersion)
+{
+    if (!Supports(CP210x_CAP_FIRMWARE_VERSION)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+	CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE	setup[CP210x_MAX_SETUP_LENGTH];
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+    if (ControlTransfer(m_transport,
+            0xC0, // bmRequestType
+            0xFF, // bRequest
+            0x10, // wValue
+            0, // WIndex
+            setup, // data
+            3, // data size
+            0) == 3)
+	{
+		lpVersion->major = setup[0];
+		lpVersion->minor = setup[1];
+		lpVersion->build = setup[2];
+		status = CP210x_SUCCESS;
+	}
+	else
+	{
+		lpVersion->major = 0x0;
+		lpVersion->minor = 0x0;
+		lpVersion->build = 0x0;
+		status = CP210x_DEVICE_IO_FAILED;
+	}
+	return status;
+}
+
+CP210x_STATUS CCP210xDevice::GetConfig( LPBYTE	lpbConfig, WORD	bLength)
+{
+    if (!Supports(CP210x_CAP_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+	CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE	setup[CP210x_MAX_SETUP_LENGTH];
+
+    memset(setup, 0, CP210x_MAX_SETUP_LENGTH);
+
+	// 8 bytes are taken by setup packet, rest of buffer can be config data
+	if (bLength > (CP210x_MAX_SETUP_LENGTH-8))
+	{
+		return CP210x_INVALID_PARAMETER;
+	}
+
+    if (ControlTransfer(m_transport,
+            0xC0,
+            0xFF,
+            0xe, // wValue
+            0, // WIndex
+            setup, // data
+            bLength, // data size
+            0) == bLength)
+    {
+		memcpy((BYTE*)lpbConfig, (BYTE*)&(setup[ 0]), bLength);
+		status = CP210x_SUCCESS;
+	}
+	else
+	{
+		status = CP210x_DEVICE_IO_FAILED;
+	}
+	return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetConfig(LPBYTE	lpbConfig,	WORD	bLength)
+{
+    if (!Supports(CP210x_CAP_CONFIG)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+	CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE	setup[CP210x_MAX_SETUP_LENGTH];
+
+	// 8 bytes are taken by setup packet, rest of buffer can be config data
+	if (bLength > (CP210x_MAX_SETUP_LENGTH-8))
+	{
+		return CP210x_INVALID_PARAMETER;
+	}
+
+	memcpy( (BYTE*)&(setup[0]), (BYTE*) lpbConfig, bLength);
+
+    if (ControlTransfer(m_transport,
+            0x40,
+            0xFF,
+            0x370F, // wValue
+            0, // WIndex
+            setup, // data
+            bLength, // data size
+            0) == bLength)
+    {
+		status = CP210x_SUCCESS;
+	}
+	else
+	{
+		status = CP210x_DEVICE_IO_FAILED;
+	}
+	return status;
+}
+
+CP210x_STATUS CCP210xDevice::UpdateFirmware()
+{
+    if (!Supports(CP210x_CAP_FIRMWARE_UPDATE)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+    (void) ControlTransfer(m_transport,
+            0x40,
+            0xFF,
+            0x37FF, // wValue
+            0, // WIndex
+            NULL, // data
+            0, // data size
+            0);
+		
+    // SendSetup will always fail because the device
+    // will get reset - so the USB request doesn't get completed
+    // properly. Because of this we will always return success
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CCP210xDevice::GetGeneric( LPBYTE	lpbGeneric, WORD	bLength)
+{
+    if (!Supports(CP210x_CAP_GENERIC)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+	CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE	data[CP210x_MAX_SETUP_LENGTH];
+
+	if (bLength > (CP210x_MAX_SETUP_LENGTH))
+	{
+		return CP210x_INVALID_PARAMETER;
+	}
+	if (bLength < 8)
+	{
+		return CP210x_INVALID_PARAMETER;
+	}
+    uint8_t 	bmRequestType = lpbGeneric[ 0];
+    uint8_t 	bRequest      = lpbGeneric[ 1];
+    uint16_t 	wValue        = lpbGeneric[ 2] | (lpbGeneric[ 3] << 8);
+    uint16_t 	wIndex        = lpbGeneric[ 4] | (lpbGeneric[ 5] << 8);
+    uint16_t 	wLength       = bLength - 8;
+
+	memcpy((BYTE*)&data[0], (BYTE*)lpbGeneric + 8, wLength);
+
+    if (ControlTransfer(m_transport,
+            bmRequestType,
+            bRequest,
+            wValue,
+            wIndex,
+            data, // data
+            wLength, // data size
+            0) == wLength)
+    {
+		memcpy((BYTE*)lpbGeneric + 8, (BYTE*)&(data[0]), wLength);
+		status = CP210x_SUCCESS;
+	}
+	else
+	{
+		status = CP210x_DEVICE_IO_FAILED;
+	}
+	return status;
+}
+
+CP210x_STATUS CCP210xDevice::SetGeneric( LPBYTE	lpbGeneric, WORD	bLength)
+{
+    if (!Supports(CP210x_CAP_GENERIC)) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+
+	CP210x_STATUS status = CP210x_INVALID_HANDLE;
+    BYTE	data[CP210x_MAX_SETUP_LENGTH];
+
+	if (bLength > (CP210x_MAX_SETUP_LENGTH))
+	{
+		return CP210x_INVALID_PARAMETER;
+	}
+	if (bLength < 8)
+	{
+		return CP210x_INVALID_PARAMETER;
+	}
+    uint8_t 	bmRequestType = lpbGeneric[ 0];
+    uint8_t 	bRequest      = lpbGeneric[ 1];
+    uint16_t 	wValue        = lpbGeneric[ 2] | (lpbGeneric[ 3] << 8);
+    uint16_t 	wIndex        = lpbGeneric[ 4] | (lpbGeneric[ 5] << 8);
+    uint16_t 	wLength       = bLength - 8;
+
+	memcpy((BYTE*)&data[0], (BYTE*)lpbGeneric + 8, wLength);
+
+    if (ControlTransfer(m_transport,
+            bmRequestType,
+            bRequest,
+            wValue,
+            wIndex,
+            data, // data
+            wLength, // data size
+            0) == wLength)
+    {
+		status = CP210x_SUCCESS;
+	}
+	else
+	{
+		status = CP210x_DEVICE_IO_FAILED;
+	}
+	return status;
+}
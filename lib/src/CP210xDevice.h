@@ -11,9 +11,17 @@
 
 #include "libusb.h"
 #include "CP210xManufacturing.h"
+#include "CP210xTransport.h"
+#include "CP210xCapabilities.h"
+#include "CP210xPlan.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // CCP210xDevice Class
+//
+// One implementation for every part: the part descriptor (see
+// CP210xCapabilities.h) tells which operations the part supports and how they
+// differ, an operation the part lacks fails with CP210x_FUNCTION_NOT_SUPPORTED
+// before any transfer.
 /////////////////////////////////////////////////////////////////////////////
 
 class CCP210xDevice
@@ -22,19 +30,36 @@ class CCP210xDevice
 public:
     static CP210x_STATUS GetNumDevices(LPDWORD lpdwNumDevices);
     static CP210x_STATUS Open(DWORD dwDevice, CCP210xDevice** devObj);
+    static CP210x_STATUS OpenByLocation(LPCSTR lpszLocation, CCP210xDevice** devObj);
+    static CP210x_STATUS FindLocations(const LPCSTR* lpszLocations, DWORD dwCount, LPBOOL lpbFound);
+    static CP210x_STATUS OpenPlan(BYTE partNum, CCP210xDevice** devObj);
+    static void KeepRegistry(bool bKeep);
+    static CP210x_STATUS SetPortFilter(LPCSTR lpszPorts);
 
-    virtual ~CCP210xDevice() {}
+    CCP210xDevice(CCP210xTransport* t, BYTE partNum, const CCP210xPartDescriptor* part, const CCP210xLocation& location);
 
 private:
-    static CP210x_STATUS GetDevicePartNumber(libusb_device_handle* h, LPBYTE lpbPartNum);
+    static CP210x_STATUS GetDevicePartNumber(CCP210xTransport* t, LPBYTE lpbPartNum);
+    static CP210x_STATUS LookUpPartNumber(CCP210xEnumeration* usbDevices, ssize_t index, CCP210xTransport* t, LPBYTE lpbPartNum);
+    static CCP210xDevice* NewDevice(CCP210xEnumeration* usbDevices, ssize_t index, CCP210xTransport* t, BYTE partNum);
     
 // Public Methods
 public:
     CP210x_STATUS Reset();
+    CP210x_STATUS ResetAndReopen(DWORD dwTimeoutMsec, CCP210xDevice** devObj);
     CP210x_STATUS Close();
+    CP210x_STATUS Lock();
     HANDLE GetHandle();
 
     CP210x_STATUS GetPartNumber(LPBYTE lpbPartNum);
+    CP210x_STATUS GetLocation(LPSTR lpszLocation);
+    CP210x_STATUS GetRequestCount(LPDWORD lpdwCount);
+
+    // Replays a plan of the same part, see CP210xPlan.h
+    CP210x_STATUS RunPlan(CCP210xDevice* plan, LPVOID lpvSerialNumber, BYTE bLength, BOOL bConvertToUnicode);
+    // The same with asynchronous transfers, done runs from CCP210xBackend::HandleEvents()
+    CP210x_STATUS SubmitPlan(CCP210xDevice* plan, LPVOID lpvSerialNumber, BYTE bLength, BOOL bConvertToUnicode, CP210x_PLAN_DONE done, LPVOID lpContext);
+    CP210x_STATUS GetPlanTransfers(CP210x_PLAN_TRANSFER* lpTransfers, LPDWORD lpdwCount);
     
     CP210x_STATUS SetVid(WORD wVid);
     CP210x_STATUS SetPid(WORD wPid);
@@ -53,45 +78,68 @@ public:
     CP210x_STATUS GetMaxPower(LPBYTE lpbMaxPower);
     CP210x_STATUS GetDeviceVersion(LPWORD lpwVersion);
 
-
-    // virtual functions
-    virtual CP210x_STATUS GetDeviceManufacturerString(LPVOID lpManufacturer, LPBYTE lpbLength, BOOL bConvertToASCII = true);
-    virtual CP210x_STATUS GetDeviceInterfaceString(BYTE bInterfaceNumber, LPVOID lpInterface, LPBYTE lpbLength, BOOL bConvertToASCII)=0;
-    virtual CP210x_STATUS GetFlushBufferConfig(LPWORD lpwFlushBufferConfig)=0;
-    virtual CP210x_STATUS GetDeviceMode(LPBYTE lpbDeviceModeECI,LPBYTE lpbDeviceModeSCI)=0;
-    virtual CP210x_STATUS GetBaudRateConfig(BAUD_CONFIG* baudConfigData)=0;
-    virtual CP210x_STATUS GetPortConfig(PORT_CONFIG* PortConfig)=0;
-    virtual CP210x_STATUS GetDualPortConfig(DUAL_PORT_CONFIG* DualPortConfig)=0;
-    virtual CP210x_STATUS GetQuadPortConfig(QUAD_PORT_CONFIG* QuadPortConfig)=0;
-    virtual CP210x_STATUS GetLockValue(LPBYTE lpbLockValue)=0;
-
-
-    virtual CP210x_STATUS SetManufacturerString(LPVOID lpvManufacturer, BYTE bLength, BOOL bConvertToUnicode = true);
-    virtual CP210x_STATUS SetInterfaceString(BYTE bInterfaceNumber, LPVOID lpvInterface, BYTE bLength, BOOL bConvertToUnicode)=0;
-    virtual CP210x_STATUS SetFlushBufferConfig(WORD wFlushBufferConfig)=0;
-    virtual CP210x_STATUS SetDeviceMode(BYTE bDeviceModeECI, BYTE bDeviceModeSCI)=0;
-    virtual CP210x_STATUS SetBaudRateConfig(BAUD_CONFIG* baudConfigData)=0;
-    virtual CP210x_STATUS SetPortConfig(PORT_CONFIG* PortConfig)=0;
-    virtual CP210x_STATUS SetDualPortConfig(DUAL_PORT_CONFIG* DualPortConfig)=0;
-    virtual CP210x_STATUS SetQuadPortConfig(QUAD_PORT_CONFIG* QuadPortConfig)=0;
-    virtual CP210x_STATUS SetLockValue()=0;
-
-    virtual CP210x_STATUS GetFirmwareVersion( pFirmware_t	lpVersion) { return CP210x_FUNCTION_NOT_SUPPORTED; }
-    virtual CP210x_STATUS GetConfig( LPBYTE	lpbConfig, WORD	bLength) { return CP210x_FUNCTION_NOT_SUPPORTED; }
-    virtual CP210x_STATUS SetConfig(LPBYTE	lpbConfig,	WORD	bLength) { return CP210x_FUNCTION_NOT_SUPPORTED; }
-    virtual CP210x_STATUS UpdateFirmware() { return CP210x_FUNCTION_NOT_SUPPORTED; }
-    virtual CP210x_STATUS GetGeneric( LPBYTE	lpbGeneric, WORD	bLength) { return CP210x_FUNCTION_NOT_SUPPORTED; }
-    virtual CP210x_STATUS SetGeneric( LPBYTE	lpbGeneric, WORD	bLength) { return CP210x_FUNCTION_NOT_SUPPORTED; }
+    // part-specific operations, see CP210x_CAPABILITIES
+    CP210x_STATUS GetDeviceManufacturerString(LPVOID lpManufacturer, LPBYTE lpbLength, BOOL bConvertToASCII = true);
+    CP210x_STATUS GetDeviceInterfaceString(BYTE bInterfaceNumber, LPVOID lpInterface, LPBYTE lpbLength, BOOL bConvertToASCII);
+    CP210x_STATUS GetFlushBufferConfig(LPWORD lpwFlushBufferConfig);
+    CP210x_STATUS GetDeviceMode(LPBYTE lpbDeviceModeECI,LPBYTE lpbDeviceModeSCI);
+    CP210x_STATUS GetBaudRateConfig(BAUD_CONFIG* baudConfigData);
+    CP210x_STATUS GetPortConfig(PORT_CONFIG* PortConfig);
+    CP210x_STATUS GetDualPortConfig(DUAL_PORT_CONFIG* DualPortConfig);
+    CP210x_STATUS GetQuadPortConfig(QUAD_PORT_CONFIG* QuadPortConfig);
+    CP210x_STATUS GetLockValue(LPBYTE lpbLockValue);
+
+    CP210x_STATUS SetManufacturerString(LPVOID lpvManufacturer, BYTE bLength, BOOL bConvertToUnicode = true);
+    CP210x_STATUS SetInterfaceString(BYTE bInterfaceNumber, LPVOID lpvInterface, BYTE bLength, BOOL bConvertToUnicode);
+    CP210x_STATUS SetFlushBufferConfig(WORD wFlushBufferConfig);
+    CP210x_STATUS SetDeviceMode(BYTE bDeviceModeECI, BYTE bDeviceModeSCI);
+    CP210x_STATUS SetBaudRateConfig(BAUD_CONFIG* baudConfigData);
+    CP210x_STATUS SetPortConfig(PORT_CONFIG* PortConfig);
+    CP210x_STATUS SetDualPortConfig(DUAL_PORT_CONFIG* DualPortConfig);
+    CP210x_STATUS SetQuadPortConfig(QUAD_PORT_CONFIG* QuadPortConfig);
+    CP210x_STATUS SetLockValue();
+
+    CP210x_STATUS GetFirmwareVersion( pFirmware_t	lpVersion);
+    CP210x_STATUS GetConfig( LPBYTE	lpbConfig, WORD	bLength);
+    CP210x_STATUS SetConfig(LPBYTE	lpbConfig,	WORD	bLength);
+    CP210x_STATUS UpdateFirmware();
+    CP210x_STATUS GetGeneric( LPBYTE	lpbGeneric, WORD	bLength);
+    CP210x_STATUS SetGeneric( LPBYTE	lpbGeneric, WORD	bLength);
 
 // Protected Members
 protected:
     CP210x_STATUS GetUnicodeString( uint8_t desc_index, LPBYTE pBuf, int CbBuf, LPBYTE pCchStr);
 
-    libusb_device_handle* m_handle;
+    // Whether the part supports the CP210x_CAP_* operation
+    bool Supports(DWORD operation) const {
+        return (m_part->caps.Operations & operation) != 0;
+    }
+
+    // CCP210xTransport::ControlTransfer() instrumented with the transfer__* probes (see CP210xProbes.h)
+    static int ProbedControlTransfer(CCP210xTransport* t, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout);
+
+    // CCP210xTransport::Reset() instrumented with the reset probe
+    int ProbedReset();
+
+    // A plan run by SubmitPlan(): each transfer is submitted when the one
+    // before it completed. The device can't go away while m_pendingRuns.
+    struct CPlanRun;
+    int SubmitPlanTransfer(CPlanRun* run);
+    bool HasPendingRuns();
+    static void OnPlanTransferDone(void* context, int result);
+
+    // The requests of the device, counted in m_requestCount
+    int ControlTransfer(CCP210xTransport* t, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout);
+    int GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length);
+    int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length);
+
+    CCP210xTransport* m_transport;
     BYTE m_partNumber;
-    
-    BYTE maxSerialStrLen;
-    BYTE maxProductStrLen;
+    const CCP210xPartDescriptor* m_part;
+    CCP210xLocation m_location;     // bus -1 if the backend can't tell
+    CCP210xPlanTransport* m_plan;   // m_transport of a plan handle, NULL for a device
+    DWORD m_requestCount;           // since the device was opened
+    DWORD m_pendingRuns;            // of SubmitPlan() that haven't called their done yet
 };
 
 #endif // CP210x_DEVICE_H
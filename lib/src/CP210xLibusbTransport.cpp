@@ -0,0 +1,509 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xLibusbTransport.cpp
+//
+// libusb backend of the transport seam: real devices on the host's buses.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <vector>
+#include "CP210xTransport.h"
+#include "OsDep.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// constructor is called after the executable is loaded, before main()
+// destructor is called before the executable is unloaded, after main()
+////////////////////////////////////////////////////////////////////////////////
+
+static libusb_context* libusbContext;
+
+// With CP210x_SetContextPerBus(), the devices of each bus are opened in a context
+// of its own, created on first use. A synchronous transfer handles the events of
+// its device's context, so threads working on different buses don't take turns
+// on the event lock of a shared one. A context keeps its device list, to find
+// the devices to open in it without listing them again each time, and lives
+// until the mode is off and its last handle is closed.
+#define CP210x_MAX_BUSES                256
+
+struct CBusContext
+{
+    libusb_context* context;
+    libusb_device** list;           // NULL until listed, or after an open failed
+    ssize_t count;
+    int handles;                    // open in the context
+};
+
+static CCriticalSectionLock BusContextLock;
+static bool ContextPerBus;
+static CBusContext BusContexts[CP210x_MAX_BUSES];
+
+__attribute__((constructor))
+static void Initializer()
+{
+    libusb_init(&libusbContext);
+}
+
+// With BusContextLock held
+static void FreeBusList(CBusContext& bc)
+{
+    if (bc.list) {
+        libusb_free_device_list(bc.list, 1);
+        bc.list = NULL;
+        bc.count = 0;
+    }
+}
+
+// With BusContextLock held
+static void ExitBusContext(CBusContext& bc)
+{
+    FreeBusList(bc);
+    libusb_exit(bc.context);
+    bc.context = NULL;
+}
+
+__attribute__((destructor))
+static void Finalizer()
+{
+    for (int bus = 0; bus < CP210x_MAX_BUSES; bus++) {
+        if (BusContexts[bus].context) {
+            ExitBusContext(BusContexts[bus]);
+        }
+    }
+    libusb_exit(libusbContext);
+}
+
+// Turning the mode off releases the contexts no handle is open in any more;
+// the others go with their last handle
+void SetCP210xLibusbContextPerBus(bool bPerBus)
+{
+    BusContextLock.Lock();
+    ContextPerBus = bPerBus;
+    for (int bus = 0; bus < CP210x_MAX_BUSES && !bPerBus; bus++) {
+        if (BusContexts[bus].context && !BusContexts[bus].handles) {
+            ExitBusContext(BusContexts[bus]);
+        }
+    }
+    BusContextLock.Unlock();
+}
+
+// The shared context and those of the buses alive
+static void GetContexts(std::vector<libusb_context*>& contexts)
+{
+    contexts.assign(1, libusbContext);
+
+    BusContextLock.Lock();
+    for (int bus = 0; bus < CP210x_MAX_BUSES; bus++) {
+        if (BusContexts[bus].context) {
+            contexts.push_back(BusContexts[bus].context);
+        }
+    }
+    BusContextLock.Unlock();
+}
+
+// The device at the bus and address in the list the context kept, referenced
+static libusb_device* FindInBusList(const CBusContext& bc, uint8_t bus, uint8_t address)
+{
+    for (ssize_t i = 0; i < bc.count; i++) {
+        if (libusb_get_bus_number(bc.list[i]) == bus && libusb_get_device_address(bc.list[i]) == address) {
+            return libusb_ref_device(bc.list[i]);
+        }
+    }
+    return NULL;
+}
+
+// The bus context's own instance of the device, referenced, NULL if the mode
+// is off or the context can't have it
+static libusb_device* FindInBusContext(libusb_device* device)
+{
+    const uint8_t bus = libusb_get_bus_number(device);
+    const uint8_t address = libusb_get_device_address(device);
+    CBusContext& bc = BusContexts[bus];
+    libusb_device* found = NULL;
+
+    BusContextLock.Lock();
+    if (ContextPerBus && !bc.context && libusb_init(&bc.context) != 0) {
+        bc.context = NULL;
+    }
+    if (ContextPerBus && bc.context) {
+        found = FindInBusList(bc, bus, address);
+        if (!found) {
+            // plugged in since the context listed its devices, list them again
+            FreeBusList(bc);
+            bc.count = libusb_get_device_list(bc.context, &bc.list);
+            if (bc.count < 0) {
+                bc.list = NULL;
+                bc.count = 0;
+            }
+            found = FindInBusList(bc, bus, address);
+        }
+    }
+    BusContextLock.Unlock();
+
+    return found;
+}
+
+// Opens the device in the context of its bus, if the mode is on: a handle
+// belongs to the context its device came from. Returns the bus, -1 for the
+// shared context, to close the handle with CloseInContext().
+static int OpenInContext(libusb_device* device, libusb_device_handle** h, int* ret)
+{
+    libusb_device* own = FindInBusContext(device);
+
+    if (!own) {
+        *ret = libusb_open(device, h);
+        return -1;
+    }
+
+    const int bus = libusb_get_bus_number(device);
+    *ret = libusb_open(own, h); // the handle keeps its device referenced
+    libusb_unref_device(own);
+
+    BusContextLock.Lock();
+    if (*ret == 0) {
+        BusContexts[bus].handles++;
+    } else {
+        FreeBusList(BusContexts[bus]); // it may be gone, or another device at its address
+    }
+    BusContextLock.Unlock();
+    return bus;
+}
+
+static void CloseInContext(libusb_device_handle* h, int bus)
+{
+    libusb_close(h);
+    if (bus < 0) {
+        return;
+    }
+
+    BusContextLock.Lock();
+    CBusContext& bc = BusContexts[bus];
+    if (!--bc.handles && !ContextPerBus) {
+        ExitBusContext(bc);
+    }
+    BusContextLock.Unlock();
+}
+
+static bool IsCP210xCandidateDevice(libusb_device *pdevice)
+{
+    bool bIsCP210xCandidateDevice = true;   /* innocent til proven guilty */
+
+    libusb_device_descriptor devDesc;
+    if (0 == libusb_get_device_descriptor(pdevice, &devDesc)) {
+        bIsCP210xCandidateDevice = false;
+        switch (devDesc.bDeviceClass) {
+        case LIBUSB_CLASS_PER_INTERFACE:  /* CP2102, CP2112,  */
+            if ((1 == devDesc.iManufacturer) && (2 == devDesc.iProduct) && (3 <= devDesc.iSerialNumber)) {
+                libusb_config_descriptor *pconfigDesc;
+                bIsCP210xCandidateDevice = true;
+                if (0 == libusb_get_config_descriptor(pdevice, 0, &pconfigDesc)) {
+                    if (pconfigDesc->bNumInterfaces && pconfigDesc->interface->num_altsetting) {
+                        if (LIBUSB_CLASS_VENDOR_SPEC != pconfigDesc->interface->altsetting->bInterfaceClass) {
+                            bIsCP210xCandidateDevice = false;
+                        }
+                    }
+                    libusb_free_config_descriptor(pconfigDesc);
+                    pconfigDesc = (libusb_config_descriptor *) NULL;
+                }
+            }
+            break;
+
+        default:
+            bIsCP210xCandidateDevice = false;
+            break;
+#if defined(DEBUG)
+        case LIBUSB_CLASS_COMM: /* */
+            /* FALLTHROUGH */
+        case LIBUSB_CLASS_HID:  /* */
+            bIsCP210xCandidateDevice = false;
+            break;
+
+        case 0xef:
+            /* FALLTHROUGH */
+        case LIBUSB_CLASS_VENDOR_SPEC:
+            /* FALLTHROUGH */
+        case LIBUSB_CLASS_PRINTER: /* */
+            /* FALLTHROUGH */
+        case LIBUSB_CLASS_HUB:
+            bIsCP210xCandidateDevice = false;
+            break;
+#endif
+        }
+    }
+
+    return bIsCP210xCandidateDevice;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Asynchronous Transfers
+/////////////////////////////////////////////////////////////////////////////
+
+// What a submitted transfer completes: the caller's buffer of an IN transfer
+// gets the data past the setup packet of the transfer's own
+struct CLibusbSubmission
+{
+    CCP210xTransferDone done;
+    void* context;
+    unsigned char* data;
+};
+
+// The result libusb_control_transfer() returns for the transfer
+static int TransferResult(const libusb_transfer* transfer)
+{
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+        return transfer->actual_length;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        return LIBUSB_ERROR_TIMEOUT;
+    case LIBUSB_TRANSFER_STALL:
+        return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_OVERFLOW:
+        return LIBUSB_ERROR_OVERFLOW;
+    default:
+        return LIBUSB_ERROR_IO;
+    }
+}
+
+static void LIBUSB_CALL OnTransferDone(libusb_transfer* transfer)
+{
+    CLibusbSubmission* submission = static_cast<CLibusbSubmission*>(transfer->user_data);
+    const int result = TransferResult(transfer);
+
+    if (result > 0 && (transfer->buffer[0] & LIBUSB_ENDPOINT_IN)) {
+        memcpy(submission->data, libusb_control_transfer_get_data(transfer), result);
+    }
+    submission->done(submission->context, result);
+    delete submission;
+    libusb_free_transfer(transfer); // and its buffer
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xLibusbTransport Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CCP210xLibusbTransport : public CCP210xTransport
+{
+public:
+    CCP210xLibusbTransport(libusb_device_handle* h, int bus) : m_handle(h), m_bus(bus) {}
+    virtual ~CCP210xLibusbTransport() { CloseInContext(m_handle, m_bus); }
+
+    virtual int ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout) {
+        return libusb_control_transfer(m_handle, bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+    }
+    virtual int SubmitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout, CCP210xTransferDone done, void* context);
+    virtual int GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length) {
+        return libusb_get_string_descriptor(m_handle, descIndex, langId, data, length);
+    }
+    virtual int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length) {
+        return libusb_get_string_descriptor_ascii(m_handle, descIndex, data, length);
+    }
+    virtual int GetDeviceDescriptor(libusb_device_descriptor* desc) {
+        return libusb_get_device_descriptor(libusb_get_device(m_handle), desc);
+    }
+    virtual int GetConfigDescriptor(libusb_config_descriptor** config) {
+        return libusb_get_config_descriptor(libusb_get_device(m_handle), 0, config);
+    }
+    virtual void FreeConfigDescriptor(libusb_config_descriptor* config) {
+        libusb_free_config_descriptor(config);
+    }
+    virtual int Reset() {
+        return libusb_reset_device(m_handle);
+    }
+    virtual int GetBusNumber() {
+        return libusb_get_bus_number(libusb_get_device(m_handle));
+    }
+    virtual int GetDeviceAddress() {
+        return libusb_get_device_address(libusb_get_device(m_handle));
+    }
+
+private:
+    libusb_device_handle* m_handle;
+    int m_bus;                      // whose context the handle was opened in, -1 for the shared one
+};
+
+int CCP210xLibusbTransport::SubmitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout, CCP210xTransferDone done, void* context)
+{
+    libusb_transfer* transfer = libusb_alloc_transfer(0);
+    unsigned char* buffer = static_cast<unsigned char*>(malloc(LIBUSB_CONTROL_SETUP_SIZE + wLength));
+
+    if (!transfer || !buffer) {
+        libusb_free_transfer(transfer);
+        free(buffer);
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    CLibusbSubmission* submission = new CLibusbSubmission;
+
+    submission->done = done;
+    submission->context = context;
+    submission->data = data;
+
+    libusb_fill_control_setup(buffer, bmRequestType, bRequest, wValue, wIndex, wLength);
+    if (!(bmRequestType & LIBUSB_ENDPOINT_IN) && wLength) {
+        memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, data, wLength);
+    }
+    libusb_fill_control_transfer(transfer, m_handle, buffer, OnTransferDone, submission, timeout);
+    transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+
+    const int ret = libusb_submit_transfer(transfer);
+
+    if (ret != 0) {
+        delete submission;
+        libusb_free_transfer(transfer);
+    }
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xLibusbEnumeration Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CCP210xLibusbEnumeration : public CCP210xEnumeration
+{
+public:
+    CCP210xLibusbEnumeration(libusb_device** list, ssize_t count) : m_list(list), m_count(count) {}
+    virtual ~CCP210xLibusbEnumeration() {
+        libusb_free_device_list(m_list, 1); // Unreference all devices to free the device list
+    }
+
+    virtual ssize_t GetCount() {
+        return m_count;
+    }
+    virtual bool IsCandidate(ssize_t index) {
+        return IsCP210xCandidateDevice(m_list[index]);
+    }
+    virtual CP210x_STATUS Open(ssize_t index, CCP210xTransport** transport) {
+        libusb_device_handle* h;
+        int ret;
+        const int bus = OpenInContext(m_list[index], &h, &ret);
+
+        if (ret != 0) {
+            return CP210x_DEVICE_NOT_FOUND;
+        }
+        *transport = new CCP210xLibusbTransport(h, bus);
+        return CP210x_SUCCESS;
+    }
+    virtual int GetLocation(ssize_t index, CCP210xLocation* location) {
+        const int depth = libusb_get_port_numbers(m_list[index], location->ports, CP210x_MAX_PORT_DEPTH);
+
+        if (depth < 0) {
+            return depth;
+        }
+        location->bus = libusb_get_bus_number(m_list[index]);
+        location->depth = depth;
+        return 0;
+    }
+
+private:
+    libusb_device** m_list;
+    ssize_t m_count;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xLibusbBackend Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CCP210xLibusbBackend : public CCP210xBackend
+{
+public:
+    virtual CP210x_STATUS Enumerate(CCP210xEnumeration** enumeration) {
+        // Enumerate all USB devices, returning the number
+        // of USB devices and a list of those devices
+        libusb_device** list;
+        const ssize_t NumOfUSBDevices = libusb_get_device_list(libusbContext, &list);
+
+        // A negative count indicates an error
+        if (NumOfUSBDevices < 0) {
+            return CP210x_GLOBAL_DATA_ERROR;
+        }
+        *enumeration = new CCP210xLibusbEnumeration(list, NumOfUSBDevices);
+        return CP210x_SUCCESS;
+    }
+
+    virtual int GetPollFds(CP210x_POLLFD* fds, int count);
+    virtual int HandleEvents(DWORD timeoutMsec);
+};
+
+// The file descriptors of every context, devices may have been opened in any
+int CCP210xLibusbBackend::GetPollFds(CP210x_POLLFD* fds, int count)
+{
+    std::vector<libusb_context*> contexts;
+    int total = 0;
+
+    GetContexts(contexts);
+    for (size_t i = 0; i < contexts.size(); i++) {
+        const libusb_pollfd** pollfds = libusb_get_pollfds(contexts[i]);
+
+        // Not on platforms without pollable file descriptors
+        if (!pollfds) {
+            return LIBUSB_ERROR_NOT_SUPPORTED;
+        }
+        for (int j = 0; pollfds[j]; j++, total++) {
+            if (total < count) {
+                fds[total].fd = pollfds[j]->fd;
+                fds[total].events = pollfds[j]->events;
+            }
+        }
+        libusb_free_pollfds(pollfds);
+    }
+    return total;
+}
+
+// With contexts of the buses, waits for any context to have events and then
+// handles those of each without blocking
+int CCP210xLibusbBackend::HandleEvents(DWORD timeoutMsec)
+{
+    std::vector<libusb_context*> contexts;
+    timeval tv;
+
+    GetContexts(contexts);
+    tv.tv_sec = timeoutMsec / 1000;
+    tv.tv_usec = (timeoutMsec % 1000) * 1000;
+    if (contexts.size() == 1) {
+        return libusb_handle_events_timeout_completed(libusbContext, &tv, NULL);
+    }
+
+    const int count = GetPollFds(NULL, 0);
+
+    if (count < 0) {
+        return count;
+    }
+
+    std::vector<CP210x_POLLFD> fds(count);
+    std::vector<pollfd> pfds(count);
+
+    GetPollFds(count ? &fds[0] : NULL, count);
+    for (int i = 0; i < count; i++) {
+        pfds[i].fd = fds[i].fd;
+        pfds[i].events = fds[i].events;
+        pfds[i].revents = 0;
+    }
+    if (poll(count ? &pfds[0] : NULL, count, static_cast<int>(timeoutMsec)) < 0) {
+        return LIBUSB_ERROR_INTERRUPTED;
+    }
+
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    for (size_t i = 0; i < contexts.size(); i++) {
+        const int ret = libusb_handle_events_timeout_completed(contexts[i], &tv, NULL);
+
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+CCP210xBackend* GetCP210xLibusbBackend()
+{
+    static CCP210xLibusbBackend backend;
+
+    return &backend;
+}
@@ -5,7 +5,7 @@
 #include "CP210xManufacturing.h"
 #include "DeviceList.h"
 #include "CP210xDevice.h"
-#include "CP2103Device.h"
+#include "CP210xCapabilities.h"
 #include "OsDep.h"
 
 /////////////////////////////////////////////////////////////////////////////
@@ -39,6 +39,28 @@ CP210x_STATUS CP210x_GetNumDevices(
     return status;
 }
 
+CP210x_STATUS CP210x_KeepDeviceRegistry(
+        BOOL bKeep
+        ) {
+    CCP210xDevice::KeepRegistry(bKeep ? true : false);
+
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CP210x_SetPortFilter(
+        LPCSTR lpszPorts
+        ) {
+    return CCP210xDevice::SetPortFilter(lpszPorts);
+}
+
+CP210x_STATUS CP210x_SetContextPerBus(
+        BOOL bPerBus
+        ) {
+    SetCP210xLibusbContextPerBus(bPerBus ? true : false);
+
+    return CP210x_SUCCESS;
+}
+
 CP210x_STATUS CP210x_Open(
         DWORD dwDevice,
         HANDLE* cyHandle
@@ -74,6 +96,39 @@ CP210x_STATUS CP210x_Open(
     return status;
 }
 
+CP210x_STATUS CP210x_OpenByLocation(
+        LPCSTR lpszLocation,
+        HANDLE* cyHandle
+        ) {
+    CP210x_STATUS status;
+
+    // Check parameters
+    if (lpszLocation && cyHandle) {
+        *cyHandle = NULL;
+
+        CCP210xDevice* dev = NULL;
+
+        status = CCP210xDevice::OpenByLocation(lpszLocation, &dev);
+
+        if (status == CP210x_SUCCESS) {
+            DeviceList.Add(dev);
+            *cyHandle = dev->GetHandle();
+        }
+    } else {
+        status = CP210x_INVALID_PARAMETER;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CP210x_FindLocations(
+        const LPCSTR* lpszLocations,
+        DWORD dwCount,
+        LPBOOL lpbFound
+        ) {
+    return CCP210xDevice::FindLocations(lpszLocations, dwCount, lpbFound);
+}
+
 CP210x_STATUS CP210x_Close(
         HANDLE cyHandle
         ) {
@@ -86,8 +141,10 @@ CP210x_STATUS CP210x_Close(
         status = dev->Close();
 
         // Deallocate the device object, remove the device reference
-        // from the device list
-        DeviceList.Destruct(dev);
+        // from the device list, unless plans still run on it
+        if (status != CP210x_DEVICE_BUSY) {
+            DeviceList.Destruct(dev);
+        }
     } else {
         status = CP210x_INVALID_HANDLE;
     }
@@ -118,6 +175,203 @@ CP210x_GetPartNumber(
     return status;
 }
 
+CP210x_STATUS
+CP210x_GetDeviceLocation(
+        HANDLE cyHandle,
+        LPSTR lpszLocation
+        ) {
+    CP210x_STATUS status;
+    CCP210xDevice* dev = (CCP210xDevice*) cyHandle;
+
+    // Check device object
+    if (DeviceList.Validate(dev)) {
+        // Check pointers
+        if (lpszLocation) {
+            status = dev->GetLocation(lpszLocation);
+        } else {
+            status = CP210x_INVALID_PARAMETER;
+        }
+    } else {
+        status = CP210x_INVALID_HANDLE;
+    }
+
+    return status;
+}
+
+CP210x_STATUS CP210x_OpenPlan(
+        BYTE bPartNum,
+        HANDLE* cyHandle
+        ) {
+    CP210x_STATUS status;
+
+    // Check parameters
+    if (cyHandle) {
+        *cyHandle = NULL;
+
+        CCP210xDevice* plan = NULL;
+
+        status = CCP210xDevice::OpenPlan(bPartNum, &plan);
+
+        if (status == CP210x_SUCCESS) {
+            DeviceList.Add(plan);
+            *cyHandle = plan->GetHandle();
+        }
+    } else {
+        status = CP210x_INVALID_PARAMETER;
+    }
+
+    return status;
+}
+
+CP210x_STATUS
+CP210x_RunPlan(
+        HANDLE cyHandle,
+        HANDLE cyPlan,
+        LPVOID lpvSerialNumber,
+        BYTE bLength,
+        BOOL bConvertToUnicode
+        ) {
+    CP210x_STATUS status;
+    CCP210xDevice* dev = (CCP210xDevice*) cyHandle;
+    CCP210xDevice* plan = (CCP210xDevice*) cyPlan;
+
+    // Check device objects
+    if (DeviceList.Validate(dev) && DeviceList.Validate(plan)) {
+        status = dev->RunPlan(plan, lpvSerialNumber, bLength, bConvertToUnicode);
+    } else {
+        status = CP210x_INVALID_HANDLE;
+    }
+
+    return status;
+}
+
+CP210x_STATUS
+CP210x_GetPlanTransfers(
+        HANDLE cyPlan,
+        CP210x_PLAN_TRANSFER* lpTransfers,
+        LPDWORD lpdwCount
+        ) {
+    CP210x_STATUS status;
+    CCP210xDevice* plan = (CCP210xDevice*) cyPlan;
+
+    // Check device object
+    if (DeviceList.Validate(plan)) {
+        // Check pointers
+        if (lpdwCount) {
+            status = plan->GetPlanTransfers(lpTransfers, lpdwCount);
+        } else {
+            status = CP210x_INVALID_PARAMETER;
+        }
+    } else {
+        status = CP210x_INVALID_HANDLE;
+    }
+
+    return status;
+}
+
+CP210x_STATUS
+CP210x_SubmitPlan(
+        HANDLE cyHandle,
+        HANDLE cyPlan,
+        LPVOID lpvSerialNumber,
+        BYTE bLength,
+        BOOL bConvertToUnicode,
+        CP210x_PLAN_DONE pfnDone,
+        LPVOID lpContext
+        ) {
+    CP210x_STATUS status;
+    CCP210xDevice* dev = (CCP210xDevice*) cyHandle;
+    CCP210xDevice* plan = (CCP210xDevice*) cyPlan;
+
+    // Check device objects
+    if (DeviceList.Validate(dev) && DeviceList.Validate(plan)) {
+        // Check the callback
+        if (pfnDone) {
+            status = dev->SubmitPlan(plan, lpvSerialNumber, bLength, bConvertToUnicode, pfnDone, lpContext);
+        } else {
+            status = CP210x_INVALID_PARAMETER;
+        }
+    } else {
+        status = CP210x_INVALID_HANDLE;
+    }
+
+    return status;
+}
+
+CP210x_STATUS
+CP210x_GetPollFds(
+        CP210x_POLLFD* lpFds,
+        LPDWORD lpdwCount
+        ) {
+    // Check pointers
+    if (!lpdwCount) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    const int count = CCP210xBackend::Get()->GetPollFds(lpFds, lpFds ? (int) *lpdwCount : 0);
+
+    if (count == LIBUSB_ERROR_NOT_SUPPORTED) {
+        return CP210x_FUNCTION_NOT_SUPPORTED;
+    }
+    if (count < 0) {
+        return CP210x_GLOBAL_DATA_ERROR;
+    }
+    *lpdwCount = count;
+
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS
+CP210x_HandleEvents(
+        DWORD dwTimeoutMsec
+        ) {
+    return CCP210xBackend::Get()->HandleEvents(dwTimeoutMsec) == 0 ? CP210x_SUCCESS : CP210x_DEVICE_IO_FAILED;
+}
+
+CP210x_STATUS
+CP210x_GetRequestCount(
+        HANDLE cyHandle,
+        LPDWORD lpdwCount
+        ) {
+    CP210x_STATUS status;
+    CCP210xDevice* dev = (CCP210xDevice*) cyHandle;
+
+    // Check device object
+    if (DeviceList.Validate(dev)) {
+        // Check pointers
+        if (lpdwCount) {
+            status = dev->GetRequestCount(lpdwCount);
+        } else {
+            status = CP210x_INVALID_PARAMETER;
+        }
+    } else {
+        status = CP210x_INVALID_HANDLE;
+    }
+
+    return status;
+}
+
+CP210x_STATUS
+CP210x_GetCapabilities(
+        BYTE bPartNum,
+        CP210x_CAPABILITIES* lpCapabilities
+        ) {
+    CP210x_STATUS status;
+    const CCP210xPartDescriptor* part = GetCP210xPartDescriptor(bPartNum);
+
+    // Check parameters
+    if (!lpCapabilities) {
+        status = CP210x_INVALID_PARAMETER;
+    } else if (!part) {
+        status = CP210x_FUNCTION_NOT_SUPPORTED;
+    } else {
+        *lpCapabilities = part->caps;
+        status = CP210x_SUCCESS;
+    }
+
+    return status;
+}
+
 CP210x_STATUS CP210x_GetProductString(
         DWORD dwDeviceNum,
         LPVOID lpvDeviceString,
@@ -422,7 +676,7 @@ CP210x_SetLockValue(
 
     // Check device object
     if (DeviceList.Validate(dev)) {
-        status = dev->SetLockValue();
+        status = dev->Lock();
     } else {
         status = CP210x_INVALID_HANDLE;
     }
@@ -825,6 +1079,45 @@ CP210x_Reset(
     return status;
 }
 
+CP210x_STATUS
+CP210x_ResetAndReopen(
+        HANDLE cyHandle,
+        DWORD dwTimeoutMsec,
+        HANDLE* cyNewHandle
+        ) {
+    CP210x_STATUS status;
+    CCP210xDevice* dev = (CCP210xDevice*) cyHandle;
+
+    // Check parameters
+    if (!cyNewHandle) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    *cyNewHandle = NULL;
+
+    // Check device object
+    if (!DeviceList.Validate(dev)) {
+        return CP210x_INVALID_HANDLE;
+    }
+
+    CCP210xDevice* newDev = NULL;
+
+    status = dev->ResetAndReopen(dwTimeoutMsec, &newDev);
+
+    // The old handle is left as it was unless the device was reset
+    if (status == CP210x_INVALID_PARAMETER || status == CP210x_FUNCTION_NOT_SUPPORTED || status == CP210x_DEVICE_BUSY) {
+        return status;
+    }
+    dev->Close();
+    DeviceList.Destruct(dev);
+
+    if (status == CP210x_SUCCESS) {
+        DeviceList.Add(newDev);
+        *cyNewHandle = newDev->GetHandle();
+    }
+
+    return status;
+}
+
 CP210x_STATUS
 CP210x_CreateHexFile(
         HANDLE cyHandle,
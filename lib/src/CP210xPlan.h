@@ -0,0 +1,66 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xPlan.h
+//
+// Transfer plans: the control transfers that program a configuration into a
+// part, captured once by calling the setters on a plan handle (see
+// CP210x_OpenPlan()) and then run on each device (CP210x_RunPlan()). The
+// setters check and convert their parameters while the plan is captured,
+// running it only replays the transfers. The serial number transfer is the
+// one slot rebuilt for each device.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_PLAN_H
+#define CP210x_PLAN_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include "CP210xTransport.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xPlanTransfer Struct
+/////////////////////////////////////////////////////////////////////////////
+
+struct CCP210xPlanTransfer
+{
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    std::vector<unsigned char> data;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xPlanTransport Class
+/////////////////////////////////////////////////////////////////////////////
+
+// The transport of a plan handle: it keeps the OUT transfers instead of
+// carrying them and has nothing to read, so the getters fail on a plan.
+class CCP210xPlanTransport : public CCP210xTransport
+{
+public:
+    virtual int ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout);
+    virtual int GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length);
+    virtual int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length);
+
+    virtual int GetDeviceDescriptor(libusb_device_descriptor* desc);
+    virtual int GetConfigDescriptor(libusb_config_descriptor** config);
+    virtual void FreeConfigDescriptor(libusb_config_descriptor* config);
+
+    virtual int Reset();
+
+    virtual int GetBusNumber();
+    virtual int GetDeviceAddress();
+
+    // The captured transfers in the order the setters issued them
+    const std::vector<CCP210xPlanTransfer>& Transfers() const {
+        return m_transfers;
+    }
+
+private:
+    std::vector<CCP210xPlanTransfer> m_transfers;
+};
+
+#endif // CP210x_PLAN_H
@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xPlanTransport.cpp
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include "CP210xPlan.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xPlanTransport Class - Public Methods
+/////////////////////////////////////////////////////////////////////////////
+
+int CCP210xPlanTransport::ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int /*timeout*/)
+{
+    if (bmRequestType & LIBUSB_ENDPOINT_IN) {
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+
+    CCP210xPlanTransfer transfer;
+
+    transfer.bmRequestType = bmRequestType;
+    transfer.bRequest = bRequest;
+    transfer.wValue = wValue;
+    transfer.wIndex = wIndex;
+    if (wLength) {
+        transfer.data.assign(data, data + wLength);
+    }
+    m_transfers.push_back(transfer);
+    return wLength;
+}
+
+int CCP210xPlanTransport::GetStringDescriptor(uint8_t /*descIndex*/, uint16_t /*langId*/, unsigned char* /*data*/, int /*length*/)
+{
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+
+int CCP210xPlanTransport::GetStringDescriptorAscii(uint8_t /*descIndex*/, unsigned char* /*data*/, int /*length*/)
+{
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+
+int CCP210xPlanTransport::GetDeviceDescriptor(libusb_device_descriptor* /*desc*/)
+{
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+
+int CCP210xPlanTransport::GetConfigDescriptor(libusb_config_descriptor** /*config*/)
+{
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+
+void CCP210xPlanTransport::FreeConfigDescriptor(libusb_config_descriptor* /*config*/)
+{
+}
+
+int CCP210xPlanTransport::Reset()
+{
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+
+int CCP210xPlanTransport::GetBusNumber()
+{
+    return -1;
+}
+
+int CCP210xPlanTransport::GetDeviceAddress()
+{
+    return -1;
+}
@@ -0,0 +1,112 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xProbes.h
+//
+// USDT (user-level statically defined tracing) probe points of libcp210x.
+// When the library is built against <sys/sdt.h> (HAVE_SYS_SDT_H) each probe
+// is a single nop instruction plus an ELF note; the arguments (and the clock
+// reads feeding the latency arguments) are only evaluated while a tracer
+// such as bpftrace or perf is attached to that particular probe. Without
+// <sys/sdt.h> all probes compile away completely.
+//
+// Provider "cp210x", probes and their arguments:
+//   enumerate__start   (op)
+//   enumerate__done    (op, usbDevices, cp210xDevices, latencyNs)
+//   device__open       (bus, address, partNum, latencyNs)
+//   device__close      (bus, address, partNum)
+//   transfer__submit   (bus, address, bmRequestType, wValue, wLength)
+//   transfer__complete (bus, address, bmRequestType, wValue, result, latencyNs)
+//   reset              (bus, address, partNum, result, latencyNs)
+//   lock               (bus, address, partNum, status)
+// where op is one of the CP210x_PROBE_OP_* values below.
+//
+// Example:
+//   bpftrace -e 'usdt:libcp210x.so:cp210x:transfer__complete
+//                { @[arg3] = hist(arg5 / 1000); }'
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_PROBES_H
+#define CP210x_PROBES_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <time.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+// Values of the "op" argument of the enumerate__* probes
+#define CP210x_PROBE_OP_GET_NUM_DEVICES     0
+#define CP210x_PROBE_OP_OPEN                1
+#define CP210x_PROBE_OP_OPEN_BY_LOCATION    2
+#define CP210x_PROBE_OP_FIND_LOCATIONS      3
+
+#if defined(HAVE_SYS_SDT_H)
+
+// Semaphores let a probe site find out cheaply whether a tracer is attached,
+// so that arguments which are expensive to compute are skipped otherwise.
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define CP210x_PROBE_SEMAPHORE(name) cp210x_##name##_semaphore
+
+// The semaphores are defined once, in CP210xDevice.cpp
+#if defined(CP210x_PROBES_DEFINE_SEMAPHORES)
+#define CP210x_PROBE_DECLARE(name) \
+    __extension__ unsigned short CP210x_PROBE_SEMAPHORE(name) __attribute__((unused)) __attribute__((section(".probes")))
+#else
+#define CP210x_PROBE_DECLARE(name) \
+    __extension__ extern unsigned short CP210x_PROBE_SEMAPHORE(name) __attribute__((unused)) __attribute__((section(".probes")))
+#endif
+
+CP210x_PROBE_DECLARE(enumerate__start);
+CP210x_PROBE_DECLARE(enumerate__done);
+CP210x_PROBE_DECLARE(device__open);
+CP210x_PROBE_DECLARE(device__close);
+CP210x_PROBE_DECLARE(transfer__submit);
+CP210x_PROBE_DECLARE(transfer__complete);
+CP210x_PROBE_DECLARE(reset);
+CP210x_PROBE_DECLARE(lock);
+
+#define CP210x_PROBE_ENABLED(name)  __builtin_expect(CP210x_PROBE_SEMAPHORE(name), 0)
+
+#define CP210x_PROBE1(name, a1)                             STAP_PROBE1(cp210x, name, a1)
+#define CP210x_PROBE3(name, a1, a2, a3)                     STAP_PROBE3(cp210x, name, a1, a2, a3)
+#define CP210x_PROBE4(name, a1, a2, a3, a4)                 STAP_PROBE4(cp210x, name, a1, a2, a3, a4)
+#define CP210x_PROBE5(name, a1, a2, a3, a4, a5)             STAP_PROBE5(cp210x, name, a1, a2, a3, a4, a5)
+#define CP210x_PROBE6(name, a1, a2, a3, a4, a5, a6)         STAP_PROBE6(cp210x, name, a1, a2, a3, a4, a5, a6)
+
+#else // !HAVE_SYS_SDT_H
+
+#define CP210x_PROBE_ENABLED(name)  0
+
+// Arguments are referenced in an unevaluated context only, to keep the
+// compiler quiet about variables which exist just to feed the probes
+#define CP210x_PROBE1(name, a1)                             do { (void) sizeof((a1)); } while (0)
+#define CP210x_PROBE3(name, a1, a2, a3)                     do { (void) sizeof((a1, a2, a3)); } while (0)
+#define CP210x_PROBE4(name, a1, a2, a3, a4)                 do { (void) sizeof((a1, a2, a3, a4)); } while (0)
+#define CP210x_PROBE5(name, a1, a2, a3, a4, a5)             do { (void) sizeof((a1, a2, a3, a4, a5)); } while (0)
+#define CP210x_PROBE6(name, a1, a2, a3, a4, a5, a6)         do { (void) sizeof((a1, a2, a3, a4, a5, a6)); } while (0)
+
+#endif // HAVE_SYS_SDT_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Helpers
+/////////////////////////////////////////////////////////////////////////////
+
+// Monotonic timestamp in nanoseconds, used to compute latency arguments.
+// Callers only take it when the corresponding probe is enabled.
+static inline uint64_t CP210x_ProbeTimestampNs()
+{
+    timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif // CP210x_PROBES_H
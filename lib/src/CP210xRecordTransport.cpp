@@ -0,0 +1,364 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xRecordTransport.cpp
+//
+// Capture mode: with CP210X_RECORD=<file> in the environment every call into
+// the active backend is passed through and written to a session log (see
+// CP210xSessionLog.h) with its result, payload and timing. A submitted
+// transfer is written when it completes, as the synchronous one it replays as.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include "CP210xSessionLog.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CRecordTransport Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CRecordTransport : public CCP210xTransport
+{
+public:
+    CRecordTransport(CCP210xTransport* inner, WORD id, CSessionLogWriter* log) : m_inner(inner), m_id(id), m_log(log) {}
+    virtual ~CRecordTransport();
+
+    virtual int ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout);
+    virtual int SubmitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout, CCP210xTransferDone done, void* context);
+    virtual int GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length);
+    virtual int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length);
+    virtual int GetDeviceDescriptor(libusb_device_descriptor* desc);
+    virtual int GetConfigDescriptor(libusb_config_descriptor** config);
+    virtual void FreeConfigDescriptor(libusb_config_descriptor* config) {
+        m_inner->FreeConfigDescriptor(config);
+    }
+    virtual int Reset();
+    virtual int GetBusNumber() {
+        return m_inner->GetBusNumber();
+    }
+    virtual int GetDeviceAddress() {
+        return m_inner->GetDeviceAddress();
+    }
+
+private:
+    CCP210xTransport* m_inner;
+    const WORD m_id;
+    CSessionLogWriter* m_log;
+};
+
+CRecordTransport::~CRecordTransport()
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    CSessionRecord record(SESSION_CLOSE);
+
+    delete m_inner;
+    record.transport = m_id;
+    m_log->Write(record, startUsec);
+}
+
+int CRecordTransport::ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->ControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+    CSessionRecord record(SESSION_CONTROL);
+
+    record.transport = m_id;
+    record.bmRequestType = bmRequestType;
+    record.bRequest = bRequest;
+    record.wValue = wValue;
+    record.wIndex = wIndex;
+    record.wLength = wLength;
+    record.timeout = timeout;
+    record.status = ret;
+    if (bmRequestType & LIBUSB_ENDPOINT_IN) {
+        if (ret > 0) {
+            record.data.assign(data, data + ret);
+        }
+    } else if (wLength) {
+        record.data.assign(data, data + wLength);
+    }
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+// A transfer submitted through the recorder, until it completes
+struct CRecordSubmission
+{
+    CRecordSubmission() : record(SESSION_CONTROL) {}
+
+    CSessionLogWriter* log;
+    CSessionRecord record;
+    uint64_t startUsec;
+    unsigned char* data;
+    CCP210xTransferDone done;
+    void* context;
+};
+
+static void OnRecordedTransferDone(void* context, int result)
+{
+    CRecordSubmission* submission = static_cast<CRecordSubmission*>(context);
+    const CCP210xTransferDone done = submission->done;
+    void* const doneContext = submission->context;
+
+    submission->record.status = result;
+    if ((submission->record.bmRequestType & LIBUSB_ENDPOINT_IN) && result > 0) {
+        submission->record.data.assign(submission->data, submission->data + result);
+    }
+    submission->log->Write(submission->record, submission->startUsec);
+    delete submission;
+    done(doneContext, result);
+}
+
+int CRecordTransport::SubmitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout, CCP210xTransferDone done, void* context)
+{
+    CRecordSubmission* submission = new CRecordSubmission;
+
+    submission->log = m_log;
+    submission->startUsec = CSessionLogWriter::NowUsec();
+    submission->data = data;
+    submission->done = done;
+    submission->context = context;
+    submission->record.transport = m_id;
+    submission->record.bmRequestType = bmRequestType;
+    submission->record.bRequest = bRequest;
+    submission->record.wValue = wValue;
+    submission->record.wIndex = wIndex;
+    submission->record.wLength = wLength;
+    submission->record.timeout = timeout;
+    if (!(bmRequestType & LIBUSB_ENDPOINT_IN) && wLength) {
+        submission->record.data.assign(data, data + wLength);
+    }
+
+    const int ret = m_inner->SubmitControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout, OnRecordedTransferDone, submission);
+
+    if (ret != 0) {
+        // Logged as the transfer that failed, to keep the device's records in step
+        submission->record.status = ret;
+        m_log->Write(submission->record, submission->startUsec);
+        delete submission;
+    }
+    return ret;
+}
+
+int CRecordTransport::GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->GetStringDescriptor(descIndex, langId, data, length);
+    CSessionRecord record(SESSION_STRING);
+
+    record.transport = m_id;
+    record.descIndex = descIndex;
+    record.langId = langId;
+    record.length = length;
+    record.status = ret;
+    if (ret > 0) {
+        record.data.assign(data, data + ret);
+    }
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+int CRecordTransport::GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->GetStringDescriptorAscii(descIndex, data, length);
+    CSessionRecord record(SESSION_STRING_ASCII);
+
+    record.transport = m_id;
+    record.descIndex = descIndex;
+    record.length = length;
+    record.status = ret;
+    if (ret > 0) {
+        record.data.assign(data, data + ret);
+    }
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+int CRecordTransport::GetDeviceDescriptor(libusb_device_descriptor* desc)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->GetDeviceDescriptor(desc);
+    CSessionRecord record(SESSION_DEVICE_DESCRIPTOR);
+
+    record.transport = m_id;
+    record.status = ret;
+    if (ret == 0) {
+        PackDeviceDescriptor(*desc, record.data);
+    }
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+int CRecordTransport::GetConfigDescriptor(libusb_config_descriptor** config)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->GetConfigDescriptor(config);
+    CSessionRecord record(SESSION_CONFIG_DESCRIPTOR);
+
+    record.transport = m_id;
+    record.status = ret;
+    if (ret == 0) {
+        PackConfigDescriptor(**config, record.data);
+    }
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+int CRecordTransport::Reset()
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->Reset();
+    CSessionRecord record(SESSION_RESET);
+
+    record.transport = m_id;
+    record.status = ret;
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CRecordEnumeration Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CRecordEnumeration : public CCP210xEnumeration
+{
+public:
+    CRecordEnumeration(CCP210xEnumeration* inner, CSessionLogWriter* log) : m_inner(inner), m_log(log) {}
+    virtual ~CRecordEnumeration() {
+        delete m_inner;
+    }
+
+    virtual ssize_t GetCount() {
+        return m_inner->GetCount();
+    }
+    virtual bool IsCandidate(ssize_t index);
+    virtual CP210x_STATUS Open(ssize_t index, CCP210xTransport** transport);
+    virtual int GetLocation(ssize_t index, CCP210xLocation* location);
+
+private:
+    CCP210xEnumeration* m_inner;
+    CSessionLogWriter* m_log;
+};
+
+bool CRecordEnumeration::IsCandidate(ssize_t index)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const bool candidate = m_inner->IsCandidate(index);
+    CSessionRecord record(SESSION_CANDIDATE);
+
+    record.index = static_cast<WORD>(index);
+    record.status = candidate ? 1 : 0;
+    m_log->Write(record, startUsec);
+    return candidate;
+}
+
+CP210x_STATUS CRecordEnumeration::Open(ssize_t index, CCP210xTransport** transport)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    CCP210xTransport* inner;
+    const CP210x_STATUS status = m_inner->Open(index, &inner);
+    CSessionRecord record(SESSION_OPEN);
+
+    record.index = static_cast<WORD>(index);
+    record.status = status;
+    if (status == CP210x_SUCCESS) {
+        record.transport = m_log->NextTransportId();
+        record.bus = inner->GetBusNumber();
+        record.address = inner->GetDeviceAddress();
+        *transport = new CRecordTransport(inner, record.transport, m_log);
+    }
+    m_log->Write(record, startUsec);
+    return status;
+}
+
+int CRecordEnumeration::GetLocation(ssize_t index, CCP210xLocation* location)
+{
+    const uint64_t startUsec = CSessionLogWriter::NowUsec();
+    const int ret = m_inner->GetLocation(index, location);
+    CSessionRecord record(SESSION_LOCATION);
+
+    record.index = static_cast<WORD>(index);
+    record.status = ret;
+    if (ret == 0) {
+        record.bus = location->bus;
+        record.data.assign(location->ports, location->ports + location->depth);
+    }
+    m_log->Write(record, startUsec);
+    return ret;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CRecordBackend Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CRecordBackend : public CCP210xBackend
+{
+public:
+    CRecordBackend(CSessionLogWriter* log) : m_inner(NULL), m_log(log) {}
+
+    void SetInner(CCP210xBackend* inner) {
+        m_inner = inner;
+    }
+
+    virtual CP210x_STATUS Enumerate(CCP210xEnumeration** enumeration) {
+        const uint64_t startUsec = CSessionLogWriter::NowUsec();
+        CCP210xEnumeration* inner;
+        const CP210x_STATUS status = m_inner->Enumerate(&inner);
+        CSessionRecord record(SESSION_ENUMERATE);
+
+        record.status = status;
+        if (status == CP210x_SUCCESS) {
+            record.count = static_cast<int>(inner->GetCount());
+            *enumeration = new CRecordEnumeration(inner, m_log);
+        }
+        m_log->Write(record, startUsec);
+        return status;
+    }
+    virtual uint64_t NowMsec() {
+        return m_inner->NowMsec();
+    }
+    virtual void Delay(DWORD msec) {
+        m_inner->Delay(msec);
+    }
+    // Not logged: the completions they run are, as their transfers
+    virtual int GetPollFds(CP210x_POLLFD* fds, int count) {
+        return m_inner->GetPollFds(fds, count);
+    }
+    virtual int HandleEvents(DWORD timeoutMsec) {
+        return m_inner->HandleEvents(timeoutMsec);
+    }
+
+private:
+    CCP210xBackend* m_inner;
+    CSessionLogWriter* m_log;
+};
+
+// Wraps inner while CP210X_RECORD names a writable file, otherwise returns
+// inner itself. Called with the backend lock held.
+CCP210xBackend* GetCP210xRecordBackend(CCP210xBackend* inner)
+{
+    static bool initialized;
+    static CSessionLogWriter* log;
+
+    if (!initialized) {
+        const char* path = getenv("CP210X_RECORD");
+
+        initialized = true;
+        if (path && *path) {
+            log = new CSessionLogWriter;
+            if (!log->Open(path)) {
+                delete log;
+                log = NULL;
+            }
+        }
+    }
+    if (!log) {
+        return inner;
+    }
+
+    static CRecordBackend backend(log);
+    backend.SetInner(inner);
+    return &backend;
+}
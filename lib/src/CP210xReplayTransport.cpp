@@ -0,0 +1,463 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xReplayTransport.cpp
+//
+// Replay backend: feeds a session log written with CP210X_RECORD back to the
+// library. Selected with CP210X_BACKEND=replay, the log is named by
+// CP210X_REPLAY=<file>.
+//
+// Enumerations and opens are matched against the log in order, the calls on
+// an open device in the order of that device's records: each one must be of
+// the recorded type and with the recorded request parameters. OUT payloads
+// aren't compared, so a run may program different values (e.g. fresh
+// serials) than the recorded one; IN data is always the recorded one. A
+// device closed early skips the rest of its records, so a run that gives up
+// on a device (e.g. a failed verification) stays in step with the log.
+//
+// The first mismatch, or a call past the end of the log, is reported on
+// stderr and ends the session: that and every later call fails, and
+// enumerations fail with CP210x_SESSION_ENDED so callers stop retrying.
+//
+// Logs of version 1 predate SESSION_LOCATION: device locations are unknown
+// when replaying them.
+//
+// By default every call takes as long as it did on the recorded station,
+// CP210X_REPLAY_TIMING=none replays as fast as possible.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include "CP210xSessionLog.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CReplaySession Class
+/////////////////////////////////////////////////////////////////////////////
+
+static const char* const SessionTypeNames[SESSION_NUM_TYPES] =
+{
+    "none", "enumerate", "candidate", "open", "close", "control",
+    "string", "string-ascii", "device-descriptor", "config-descriptor", "reset",
+    "location"
+};
+
+class CReplaySession
+{
+public:
+    CReplaySession() : m_loaded(false), m_diverged(false), m_timed(true), m_version(0) {}
+
+    CP210x_STATUS Load();
+
+    // Whether the log has records of the given type at all
+    bool Logs(BYTE type) const {
+        return type != SESSION_LOCATION || m_version >= 2;
+    }
+
+    // Takes the next record of the transport, or of the enumerations for
+    // the types that don't use one, if it is of the given type and matches
+    // the key, NULL (and the session diverged) otherwise.
+    const CSessionRecord* Next(BYTE type, WORD transport, const CSessionRecord* key = NULL);
+
+    // Takes the close record of the transport, skipping the records of the
+    // calls the recorded run made on it and this one didn't. NULL if the
+    // recorded run never closed it.
+    const CSessionRecord* Close(WORD transport);
+
+    // Spends the recorded duration of a call taken with Next()
+    void Pace(const CSessionRecord* record);
+
+private:
+    // Indexes into m_records of one stream, in order, and the next to take
+    struct CStream
+    {
+        CStream() : next(0) {}
+
+        std::vector<size_t> records;
+        size_t next;
+    };
+
+    static bool IsEnumerationType(BYTE type) {
+        return type == SESSION_ENUMERATE || type == SESSION_CANDIDATE || type == SESSION_OPEN || type == SESSION_LOCATION;
+    }
+    CStream& StreamOf(BYTE type, WORD transport) {
+        return IsEnumerationType(type) ? m_enumerations : m_transports[transport];
+    }
+    void Diverge(size_t index, const char* what, BYTE type);
+
+    CCriticalSectionLock m_lock;
+    bool m_loaded;
+    bool m_diverged;
+    bool m_timed;
+    WORD m_version;
+    std::vector<CSessionRecord> m_records;
+    CStream m_enumerations;
+    std::map<WORD, CStream> m_transports;
+};
+
+CP210x_STATUS CReplaySession::Load()
+{
+    CP210x_STATUS status = CP210x_SUCCESS;
+
+    m_lock.Lock();
+    if (!m_loaded) {
+        const char* path = getenv("CP210X_REPLAY");
+        const char* timing = getenv("CP210X_REPLAY_TIMING");
+
+        m_loaded = true;
+        m_timed = !(timing && !strcmp(timing, "none"));
+        if (!path || !*path) {
+            fprintf(stderr, "libcp210x replay: CP210X_REPLAY is not set\n");
+            m_diverged = true;
+        } else if (!CSessionLogReader::Load(path, m_records, &m_version)) {
+            fprintf(stderr, "libcp210x replay: can't load session log %s\n", path);
+            m_diverged = true;
+        } else {
+            for (size_t i = 0; i < m_records.size(); i++) {
+                StreamOf(m_records[i].type, m_records[i].transport).records.push_back(i);
+            }
+        }
+    }
+    if (m_diverged) {
+        status = CP210x_SESSION_ENDED;
+    }
+    m_lock.Unlock();
+
+    return status;
+}
+
+const CSessionRecord* CReplaySession::Next(BYTE type, WORD transport, const CSessionRecord* key)
+{
+    const CSessionRecord* record = NULL;
+
+    m_lock.Lock();
+    CStream& stream = StreamOf(type, transport);
+    if (m_diverged) {
+        // Already reported
+    } else if (stream.next >= stream.records.size()) {
+        Diverge(m_records.size(), NULL, type);
+    } else {
+        const size_t index = stream.records[stream.next];
+        const CSessionRecord& next = m_records[index];
+
+        if (next.type != type) {
+            Diverge(index, SessionTypeNames[next.type], type);
+        } else if (key && (next.index != key->index ||
+                next.bmRequestType != key->bmRequestType || next.bRequest != key->bRequest ||
+                next.wValue != key->wValue || next.wIndex != key->wIndex || next.wLength != key->wLength ||
+                next.descIndex != key->descIndex || next.langId != key->langId || next.length != key->length)) {
+            Diverge(index, "other parameters", type);
+        } else {
+            record = &next;
+            stream.next++;
+        }
+    }
+    m_lock.Unlock();
+
+    return record;
+}
+
+const CSessionRecord* CReplaySession::Close(WORD transport)
+{
+    const CSessionRecord* record = NULL;
+
+    m_lock.Lock();
+    if (!m_diverged) {
+        CStream& stream = m_transports[transport];
+
+        while (stream.next < stream.records.size()) {
+            const CSessionRecord& next = m_records[stream.records[stream.next++]];
+
+            if (next.type == SESSION_CLOSE) {
+                record = &next;
+                break;
+            }
+        }
+    }
+    m_lock.Unlock();
+
+    return record;
+}
+
+void CReplaySession::Pace(const CSessionRecord* record)
+{
+    if (m_timed && record->durationUsec) {
+        usleep(record->durationUsec);
+    }
+}
+
+// Called with m_lock held, what is NULL if the log has no more records for the call
+void CReplaySession::Diverge(size_t index, const char* what, BYTE type)
+{
+    if (what) {
+        fprintf(stderr, "libcp210x replay: session diverged at record %lu: %s call, expected %s\n",
+                static_cast<unsigned long>(index), SessionTypeNames[type], what);
+    } else {
+        fprintf(stderr, "libcp210x replay: session log ended before the next %s call\n", SessionTypeNames[type]);
+    }
+    m_diverged = true;
+}
+
+static CReplaySession Session;
+
+/////////////////////////////////////////////////////////////////////////////
+// CReplayTransport Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CReplayTransport : public CCP210xTransport
+{
+public:
+    CReplayTransport(WORD id, int bus, int address) : m_id(id), m_bus(bus), m_address(address) {}
+    virtual ~CReplayTransport();
+
+    virtual int ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout);
+    virtual int GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length);
+    virtual int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length);
+    virtual int GetDeviceDescriptor(libusb_device_descriptor* desc);
+    virtual int GetConfigDescriptor(libusb_config_descriptor** config);
+    virtual void FreeConfigDescriptor(libusb_config_descriptor* config) {
+        delete reinterpret_cast<CCP210xConfigDescriptorBlock*>(config);
+    }
+    virtual int Reset();
+    virtual int GetBusNumber() {
+        return m_bus;
+    }
+    virtual int GetDeviceAddress() {
+        return m_address;
+    }
+
+private:
+    int ReadData(const CSessionRecord* record, unsigned char* data, int length);
+
+    const WORD m_id;
+    const int m_bus;
+    const int m_address;
+};
+
+CReplayTransport::~CReplayTransport()
+{
+    const CSessionRecord* record = Session.Close(m_id);
+
+    if (record) {
+        Session.Pace(record);
+    }
+}
+
+// Hands out the recorded IN data and result of a call
+int CReplayTransport::ReadData(const CSessionRecord* record, unsigned char* data, int length)
+{
+    if (record->status > 0 && !record->data.empty()) {
+        const int size = static_cast<int>(record->data.size()) < length ? static_cast<int>(record->data.size()) : length;
+
+        memcpy(data, &record->data[0], size);
+    }
+    Session.Pace(record);
+    return record->status;
+}
+
+int CReplayTransport::ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout)
+{
+    CSessionRecord key(SESSION_CONTROL);
+    const CSessionRecord* record;
+
+    (void)timeout;
+    key.bmRequestType = bmRequestType;
+    key.bRequest = bRequest;
+    key.wValue = wValue;
+    key.wIndex = wIndex;
+    key.wLength = wLength;
+    record = Session.Next(SESSION_CONTROL, m_id, &key);
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    if (!(bmRequestType & LIBUSB_ENDPOINT_IN)) {
+        Session.Pace(record);
+        return record->status;
+    }
+    return ReadData(record, data, wLength);
+}
+
+int CReplayTransport::GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length)
+{
+    CSessionRecord key(SESSION_STRING);
+    const CSessionRecord* record;
+
+    key.descIndex = descIndex;
+    key.langId = langId;
+    key.length = length;
+    record = Session.Next(SESSION_STRING, m_id, &key);
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    return ReadData(record, data, length);
+}
+
+int CReplayTransport::GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length)
+{
+    CSessionRecord key(SESSION_STRING_ASCII);
+    const CSessionRecord* record;
+
+    key.descIndex = descIndex;
+    key.length = length;
+    record = Session.Next(SESSION_STRING_ASCII, m_id, &key);
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    return ReadData(record, data, length);
+}
+
+int CReplayTransport::GetDeviceDescriptor(libusb_device_descriptor* desc)
+{
+    const CSessionRecord* record = Session.Next(SESSION_DEVICE_DESCRIPTOR, m_id);
+
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    Session.Pace(record);
+    if (record->status == 0 && !UnpackDeviceDescriptor(record->data, desc)) {
+        return LIBUSB_ERROR_IO;
+    }
+    return record->status;
+}
+
+int CReplayTransport::GetConfigDescriptor(libusb_config_descriptor** config)
+{
+    const CSessionRecord* record = Session.Next(SESSION_CONFIG_DESCRIPTOR, m_id);
+
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    Session.Pace(record);
+    if (record->status == 0) {
+        *config = UnpackConfigDescriptor(record->data);
+        if (!*config) {
+            return LIBUSB_ERROR_IO;
+        }
+    }
+    return record->status;
+}
+
+int CReplayTransport::Reset()
+{
+    const CSessionRecord* record = Session.Next(SESSION_RESET, m_id);
+
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    Session.Pace(record);
+    return record->status;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CReplayEnumeration Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CReplayEnumeration : public CCP210xEnumeration
+{
+public:
+    CReplayEnumeration(int count) : m_count(count) {}
+
+    virtual ssize_t GetCount() {
+        return m_count;
+    }
+    virtual bool IsCandidate(ssize_t index);
+    virtual CP210x_STATUS Open(ssize_t index, CCP210xTransport** transport);
+    virtual int GetLocation(ssize_t index, CCP210xLocation* location);
+
+private:
+    const int m_count;
+};
+
+bool CReplayEnumeration::IsCandidate(ssize_t index)
+{
+    CSessionRecord key(SESSION_CANDIDATE);
+    const CSessionRecord* record;
+
+    key.index = static_cast<WORD>(index);
+    record = Session.Next(SESSION_CANDIDATE, 0, &key);
+    if (!record) {
+        return false;
+    }
+    Session.Pace(record);
+    return record->status != 0;
+}
+
+CP210x_STATUS CReplayEnumeration::Open(ssize_t index, CCP210xTransport** transport)
+{
+    CSessionRecord key(SESSION_OPEN);
+    const CSessionRecord* record;
+
+    key.index = static_cast<WORD>(index);
+    record = Session.Next(SESSION_OPEN, 0, &key);
+    if (!record) {
+        return CP210x_DEVICE_NOT_FOUND;
+    }
+    Session.Pace(record);
+    if (record->status == CP210x_SUCCESS) {
+        *transport = new CReplayTransport(record->transport, record->bus, record->address);
+    }
+    return record->status;
+}
+
+int CReplayEnumeration::GetLocation(ssize_t index, CCP210xLocation* location)
+{
+    CSessionRecord key(SESSION_LOCATION);
+    const CSessionRecord* record;
+
+    if (!Session.Logs(SESSION_LOCATION)) {
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    key.index = static_cast<WORD>(index);
+    record = Session.Next(SESSION_LOCATION, 0, &key);
+    if (!record) {
+        return LIBUSB_ERROR_IO;
+    }
+    Session.Pace(record);
+    if (record->status == 0) {
+        if (record->data.size() > CP210x_MAX_PORT_DEPTH) {
+            return LIBUSB_ERROR_IO;
+        }
+        location->bus = record->bus;
+        location->depth = static_cast<int>(record->data.size());
+        if (location->depth) {
+            memcpy(location->ports, &record->data[0], location->depth);
+        }
+    }
+    return record->status;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CReplayBackend Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CReplayBackend : public CCP210xBackend
+{
+public:
+    virtual CP210x_STATUS Enumerate(CCP210xEnumeration** enumeration) {
+        CP210x_STATUS status = Session.Load();
+        const CSessionRecord* record;
+
+        if (status != CP210x_SUCCESS) {
+            return status;
+        }
+        record = Session.Next(SESSION_ENUMERATE, 0);
+        if (!record) {
+            return CP210x_SESSION_ENDED;
+        }
+        Session.Pace(record);
+        if (record->status == CP210x_SUCCESS) {
+            *enumeration = new CReplayEnumeration(record->count);
+        }
+        return record->status;
+    }
+};
+
+CCP210xBackend* GetCP210xReplayBackend()
+{
+    static CReplayBackend backend;
+    return &backend;
+}
@@ -0,0 +1,450 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xSessionLog.cpp
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <time.h>
+#include "CP210xSessionLog.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Record encoding
+/////////////////////////////////////////////////////////////////////////////
+
+// Appends little endian fields to a buffer
+class CSessionEncoder
+{
+public:
+    CSessionEncoder(std::vector<BYTE>& buffer) : m_buffer(buffer) {}
+
+    void U8(BYTE& v) {
+        m_buffer.push_back(v);
+    }
+    void U16(WORD& v) {
+        m_buffer.push_back(v & 0xFF);
+        m_buffer.push_back(v >> 8);
+    }
+    void U32(DWORD& v) {
+        for (int i = 0; i < 32; i += 8) {
+            m_buffer.push_back((v >> i) & 0xFF);
+        }
+    }
+    void I32(int& v) {
+        DWORD u = static_cast<DWORD>(v);
+        U32(u);
+    }
+    void Bytes(std::vector<BYTE>& v) {
+        WORD length = static_cast<WORD>(v.size());
+        U16(length);
+        m_buffer.insert(m_buffer.end(), v.begin(), v.begin() + length);
+    }
+
+private:
+    std::vector<BYTE>& m_buffer;
+};
+
+// Reads little endian fields back, Ok() turns false on a truncated record
+class CSessionDecoder
+{
+public:
+    CSessionDecoder(const std::vector<BYTE>& buffer, size_t pos) : m_buffer(buffer), m_pos(pos), m_ok(true) {}
+
+    bool Ok() const { return m_ok; }
+    size_t Pos() const { return m_pos; }
+
+    void U8(BYTE& v) {
+        v = Need(1) ? m_buffer[m_pos++] : 0;
+    }
+    void U16(WORD& v) {
+        v = 0;
+        if (Need(2)) {
+            v = m_buffer[m_pos] | (m_buffer[m_pos + 1] << 8);
+            m_pos += 2;
+        }
+    }
+    void U32(DWORD& v) {
+        v = 0;
+        if (Need(4)) {
+            for (int i = 0; i < 4; i++) {
+                v |= static_cast<DWORD>(m_buffer[m_pos++]) << (8 * i);
+            }
+        }
+    }
+    void I32(int& v) {
+        DWORD u;
+        U32(u);
+        v = static_cast<int>(u);
+    }
+    void Bytes(std::vector<BYTE>& v) {
+        WORD length;
+        U16(length);
+        v.clear();
+        if (Need(length)) {
+            v.assign(m_buffer.begin() + m_pos, m_buffer.begin() + m_pos + length);
+            m_pos += length;
+        }
+    }
+
+private:
+    bool Need(size_t count) {
+        if (m_pos + count > m_buffer.size()) {
+            m_ok = false;
+        }
+        return m_ok;
+    }
+
+    const std::vector<BYTE>& m_buffer;
+    size_t m_pos;
+    bool m_ok;
+};
+
+// The layout of every record type, shared by the encoder and the decoder
+template <class TCodec>
+static void SessionRecordFields(TCodec& c, CSessionRecord& r)
+{
+    c.U8(r.type);
+    c.U32(r.gapUsec);
+    c.U32(r.durationUsec);
+
+    switch (r.type) {
+    case SESSION_ENUMERATE:
+        c.I32(r.status);
+        c.I32(r.count);
+        break;
+
+    case SESSION_CANDIDATE:
+        c.U16(r.index);
+        c.I32(r.status);
+        break;
+
+    case SESSION_OPEN:
+        c.U16(r.index);
+        c.I32(r.status);
+        c.U16(r.transport);
+        c.I32(r.bus);
+        c.I32(r.address);
+        break;
+
+    case SESSION_CLOSE:
+        c.U16(r.transport);
+        break;
+
+    case SESSION_CONTROL:
+        c.U16(r.transport);
+        c.U8(r.bmRequestType);
+        c.U8(r.bRequest);
+        c.U16(r.wValue);
+        c.U16(r.wIndex);
+        c.U16(r.wLength);
+        c.U32(r.timeout);
+        c.I32(r.status);
+        c.Bytes(r.data);
+        break;
+
+    case SESSION_STRING:
+        c.U16(r.transport);
+        c.U8(r.descIndex);
+        c.U16(r.langId);
+        c.I32(r.length);
+        c.I32(r.status);
+        c.Bytes(r.data);
+        break;
+
+    case SESSION_STRING_ASCII:
+        c.U16(r.transport);
+        c.U8(r.descIndex);
+        c.I32(r.length);
+        c.I32(r.status);
+        c.Bytes(r.data);
+        break;
+
+    case SESSION_DEVICE_DESCRIPTOR:
+    case SESSION_CONFIG_DESCRIPTOR:
+        c.U16(r.transport);
+        c.I32(r.status);
+        c.Bytes(r.data);
+        break;
+
+    case SESSION_RESET:
+        c.U16(r.transport);
+        c.I32(r.status);
+        break;
+
+    case SESSION_LOCATION:
+        c.U16(r.index);
+        c.I32(r.status);
+        c.I32(r.bus);
+        c.Bytes(r.data);
+        break;
+    }
+}
+
+CSessionRecord::CSessionRecord(BYTE recordType)
+    : type(recordType), gapUsec(0), durationUsec(0), transport(0), index(0), status(0), count(0), bus(0), address(0),
+      bmRequestType(0), bRequest(0), wValue(0), wIndex(0), wLength(0), timeout(0), descIndex(0), langId(0), length(0)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CSessionLogWriter Class
+/////////////////////////////////////////////////////////////////////////////
+
+CSessionLogWriter::CSessionLogWriter() : m_file(NULL), m_lastStartUsec(0), m_nextTransport(1)
+{
+}
+
+CSessionLogWriter::~CSessionLogWriter()
+{
+    if (m_file) {
+        fclose(m_file);
+    }
+}
+
+bool CSessionLogWriter::Open(const char* path)
+{
+    WORD version = CP210x_SESSION_LOG_VERSION;
+
+    m_file = fopen(path, "wb");
+    if (!m_file) {
+        return false;
+    }
+    m_buffer.assign(CP210x_SESSION_LOG_MAGIC, CP210x_SESSION_LOG_MAGIC + 8);
+    CSessionEncoder(m_buffer).U16(version);
+    fwrite(&m_buffer[0], 1, m_buffer.size(), m_file);
+    fflush(m_file);
+    m_lastStartUsec = NowUsec();
+    return true;
+}
+
+uint64_t CSessionLogWriter::NowUsec()
+{
+    timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void CSessionLogWriter::Write(CSessionRecord& record, uint64_t startUsec)
+{
+    const uint64_t endUsec = NowUsec();
+
+    m_lock.Lock();
+    if (m_file) {
+        const uint64_t gap = startUsec > m_lastStartUsec ? startUsec - m_lastStartUsec : 0;
+        const uint64_t duration = endUsec - startUsec;
+
+        record.gapUsec = gap > 0xFFFFFFFFULL ? 0xFFFFFFFF : static_cast<DWORD>(gap);
+        record.durationUsec = duration > 0xFFFFFFFFULL ? 0xFFFFFFFF : static_cast<DWORD>(duration);
+        m_lastStartUsec = startUsec;
+
+        m_buffer.clear();
+        CSessionEncoder encoder(m_buffer);
+        SessionRecordFields(encoder, record);
+        fwrite(&m_buffer[0], 1, m_buffer.size(), m_file);
+
+        // Keep the log usable if the station crashes mid-session
+        if (record.type == SESSION_CLOSE || record.type == SESSION_RESET) {
+            fflush(m_file);
+        }
+    }
+    m_lock.Unlock();
+}
+
+WORD CSessionLogWriter::NextTransportId()
+{
+    WORD id;
+
+    m_lock.Lock();
+    id = m_nextTransport++;
+    m_lock.Unlock();
+
+    return id;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CSessionLogReader Class
+/////////////////////////////////////////////////////////////////////////////
+
+bool CSessionLogReader::Load(const char* path, std::vector<CSessionRecord>& records, WORD* version)
+{
+    std::vector<BYTE> buffer;
+    BYTE chunk[4096];
+    size_t count;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    if (buffer.size() < 10 || memcmp(&buffer[0], CP210x_SESSION_LOG_MAGIC, 8)) {
+        return false;
+    }
+
+    CSessionDecoder decoder(buffer, 8);
+    decoder.U16(*version);
+    if (!*version || *version > CP210x_SESSION_LOG_VERSION) {
+        return false;
+    }
+
+    records.clear();
+    while (decoder.Pos() < buffer.size()) {
+        CSessionRecord record(0);
+
+        SessionRecordFields(decoder, record);
+        if (!decoder.Ok() || !record.type || record.type >= SESSION_NUM_TYPES) {
+            return false;
+        }
+        records.push_back(record);
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Descriptor packing
+/////////////////////////////////////////////////////////////////////////////
+
+void PackDeviceDescriptor(const libusb_device_descriptor& desc, std::vector<BYTE>& data)
+{
+    const BYTE packed[18] = {
+        desc.bLength, desc.bDescriptorType,
+        static_cast<BYTE>(desc.bcdUSB & 0xFF), static_cast<BYTE>(desc.bcdUSB >> 8),
+        desc.bDeviceClass, desc.bDeviceSubClass, desc.bDeviceProtocol, desc.bMaxPacketSize0,
+        static_cast<BYTE>(desc.idVendor & 0xFF), static_cast<BYTE>(desc.idVendor >> 8),
+        static_cast<BYTE>(desc.idProduct & 0xFF), static_cast<BYTE>(desc.idProduct >> 8),
+        static_cast<BYTE>(desc.bcdDevice & 0xFF), static_cast<BYTE>(desc.bcdDevice >> 8),
+        desc.iManufacturer, desc.iProduct, desc.iSerialNumber, desc.bNumConfigurations
+    };
+
+    data.assign(packed, packed + sizeof(packed));
+}
+
+bool UnpackDeviceDescriptor(const std::vector<BYTE>& data, libusb_device_descriptor* desc)
+{
+    if (data.size() != 18) {
+        return false;
+    }
+    memset(desc, 0, sizeof(*desc));
+    desc->bLength = data[0];
+    desc->bDescriptorType = data[1];
+    desc->bcdUSB = data[2] | (data[3] << 8);
+    desc->bDeviceClass = data[4];
+    desc->bDeviceSubClass = data[5];
+    desc->bDeviceProtocol = data[6];
+    desc->bMaxPacketSize0 = data[7];
+    desc->idVendor = data[8] | (data[9] << 8);
+    desc->idProduct = data[10] | (data[11] << 8);
+    desc->bcdDevice = data[12] | (data[13] << 8);
+    desc->iManufacturer = data[14];
+    desc->iProduct = data[15];
+    desc->iSerialNumber = data[16];
+    desc->bNumConfigurations = data[17];
+    return true;
+}
+
+// Layout: configuration header (7 bytes), then per interface the
+// interface descriptor fields (7 bytes) and per endpoint 5 bytes
+void PackConfigDescriptor(const libusb_config_descriptor& config, std::vector<BYTE>& data)
+{
+    const BYTE numInterfaces = config.bNumInterfaces < CP210x_MAX_INTERFACES ? config.bNumInterfaces : CP210x_MAX_INTERFACES;
+
+    data.clear();
+    data.push_back(config.wTotalLength & 0xFF);
+    data.push_back(config.wTotalLength >> 8);
+    data.push_back(numInterfaces);
+    data.push_back(config.bConfigurationValue);
+    data.push_back(config.iConfiguration);
+    data.push_back(config.bmAttributes);
+    data.push_back(config.MaxPower);
+
+    for (BYTE i = 0; i < numInterfaces; i++) {
+        const libusb_interface& intf = config.interface[i];
+        const libusb_interface_descriptor* alt = intf.num_altsetting ? intf.altsetting : NULL;
+        const BYTE numEndpoints = !alt ? 0 : alt->bNumEndpoints < CP210x_MAX_ENDPOINTS ? alt->bNumEndpoints : CP210x_MAX_ENDPOINTS;
+
+        data.push_back(alt ? 1 : 0);
+        data.push_back(alt ? alt->bInterfaceNumber : i);
+        data.push_back(alt ? alt->bInterfaceClass : 0);
+        data.push_back(alt ? alt->bInterfaceSubClass : 0);
+        data.push_back(alt ? alt->bInterfaceProtocol : 0);
+        data.push_back(alt ? alt->iInterface : 0);
+        data.push_back(numEndpoints);
+        for (BYTE e = 0; e < numEndpoints; e++) {
+            const libusb_endpoint_descriptor& ep = alt->endpoint[e];
+
+            data.push_back(ep.bEndpointAddress);
+            data.push_back(ep.bmAttributes);
+            data.push_back(ep.wMaxPacketSize & 0xFF);
+            data.push_back(ep.wMaxPacketSize >> 8);
+            data.push_back(ep.bInterval);
+        }
+    }
+}
+
+libusb_config_descriptor* UnpackConfigDescriptor(const std::vector<BYTE>& data)
+{
+    if (data.size() < 7 || data[2] > CP210x_MAX_INTERFACES) {
+        return NULL;
+    }
+
+    CCP210xConfigDescriptorBlock* block = new CCP210xConfigDescriptorBlock;
+    libusb_config_descriptor& config = block->config;
+    size_t pos = 7;
+
+    memset(block, 0, sizeof(*block));
+    config.bLength = 9;
+    config.bDescriptorType = LIBUSB_DT_CONFIG;
+    config.wTotalLength = data[0] | (data[1] << 8);
+    config.bNumInterfaces = data[2];
+    config.bConfigurationValue = data[3];
+    config.iConfiguration = data[4];
+    config.bmAttributes = data[5];
+    config.MaxPower = data[6];
+    config.interface = block->interfaces;
+
+    for (BYTE i = 0; i < config.bNumInterfaces; i++) {
+        libusb_interface_descriptor& alt = block->altsettings[i];
+
+        if (pos + 7 > data.size() || data[pos + 6] > CP210x_MAX_ENDPOINTS) {
+            delete block;
+            return NULL;
+        }
+        block->interfaces[i].num_altsetting = data[pos];
+        block->interfaces[i].altsetting = &alt;
+        alt.bLength = 9;
+        alt.bDescriptorType = LIBUSB_DT_INTERFACE;
+        alt.bInterfaceNumber = data[pos + 1];
+        alt.bInterfaceClass = data[pos + 2];
+        alt.bInterfaceSubClass = data[pos + 3];
+        alt.bInterfaceProtocol = data[pos + 4];
+        alt.iInterface = data[pos + 5];
+        alt.bNumEndpoints = data[pos + 6];
+        alt.endpoint = block->endpoints[i];
+        pos += 7;
+
+        for (BYTE e = 0; e < alt.bNumEndpoints; e++) {
+            libusb_endpoint_descriptor& ep = block->endpoints[i][e];
+
+            if (pos + 5 > data.size()) {
+                delete block;
+                return NULL;
+            }
+            ep.bLength = 7;
+            ep.bDescriptorType = LIBUSB_DT_ENDPOINT;
+            ep.bEndpointAddress = data[pos];
+            ep.bmAttributes = data[pos + 1];
+            ep.wMaxPacketSize = data[pos + 2] | (data[pos + 3] << 8);
+            ep.bInterval = data[pos + 4];
+            pos += 5;
+        }
+    }
+    return &block->config;
+}
@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xSessionLog.h
+//
+// Binary log of the traffic between libcp210x and a backend, written by the
+// record backend (CP210X_RECORD=<file>) and fed back by the replay backend
+// (CP210X_BACKEND=replay, CP210X_REPLAY=<file>).
+//
+// The file is the 8 byte magic "CP210XSL", a 16-bit format version and one
+// record per backend call, all little endian. Each record starts with
+//   u8  type
+//   u32 usec since the previous record started
+//   u32 usec the call took
+// followed by the fields of its type, see CSessionLogWriter::Write().
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_SESSION_LOG_H
+#define CP210x_SESSION_LOG_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <vector>
+#include "CP210xTransport.h"
+#include "OsDep.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+#define CP210x_SESSION_LOG_MAGIC        "CP210XSL"
+#define CP210x_SESSION_LOG_VERSION      2       // 2 added SESSION_LOCATION
+
+enum SessionRecordType
+{
+    SESSION_ENUMERATE = 1,      // status, count
+    SESSION_CANDIDATE,          // index, status (0/1)
+    SESSION_OPEN,               // index, status, transport, bus, address
+    SESSION_CLOSE,              // transport
+    SESSION_CONTROL,            // transport, setup, timeout, status, data
+    SESSION_STRING,             // transport, descIndex, langId, length, status, data
+    SESSION_STRING_ASCII,       // transport, descIndex, length, status, data
+    SESSION_DEVICE_DESCRIPTOR,  // transport, status, data
+    SESSION_CONFIG_DESCRIPTOR,  // transport, status, data
+    SESSION_RESET,              // transport, status
+    SESSION_LOCATION,           // index, status, bus, data (port numbers)
+    SESSION_NUM_TYPES
+};
+
+// One backend call. Fields not used by a type are 0. data holds what
+// crossed the bus (OUT: sent, IN: received) or a packed descriptor.
+struct CSessionRecord
+{
+    BYTE type;
+    DWORD gapUsec;
+    DWORD durationUsec;
+
+    WORD transport;
+    WORD index;
+    int status;
+    int count;
+    int bus;
+    int address;
+
+    BYTE bmRequestType;
+    BYTE bRequest;
+    WORD wValue;
+    WORD wIndex;
+    WORD wLength;
+    DWORD timeout;
+
+    BYTE descIndex;
+    WORD langId;
+    int length;
+
+    std::vector<BYTE> data;
+
+    CSessionRecord(BYTE recordType);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CSessionLogWriter Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CSessionLogWriter
+{
+public:
+    CSessionLogWriter();
+    ~CSessionLogWriter();
+
+    bool Open(const char* path);
+
+    // Microseconds on the log's clock, for the record timings
+    static uint64_t NowUsec();
+
+    // Stamps the record with startUsec/now and appends it
+    void Write(CSessionRecord& record, uint64_t startUsec);
+    WORD NextTransportId();
+
+private:
+    CCriticalSectionLock m_lock;
+    FILE* m_file;
+    uint64_t m_lastStartUsec;
+    WORD m_nextTransport;
+    std::vector<BYTE> m_buffer;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CSessionLogReader Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CSessionLogReader
+{
+public:
+    // Reads the whole log of any version up to ours, false if it can't be
+    // read or is malformed
+    static bool Load(const char* path, std::vector<CSessionRecord>& records, WORD* version);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Descriptor packing
+/////////////////////////////////////////////////////////////////////////////
+
+void PackDeviceDescriptor(const libusb_device_descriptor& desc, std::vector<BYTE>& data);
+bool UnpackDeviceDescriptor(const std::vector<BYTE>& data, libusb_device_descriptor* desc);
+
+// Keeps the first altsetting of up to CP210x_MAX_INTERFACES interfaces with
+// up to CP210x_MAX_ENDPOINTS endpoints, which covers every CP210x
+void PackConfigDescriptor(const libusb_config_descriptor& config, std::vector<BYTE>& data);
+// Returns a CCP210xConfigDescriptorBlock, NULL if data is malformed
+libusb_config_descriptor* UnpackConfigDescriptor(const std::vector<BYTE>& data);
+
+#endif // CP210x_SESSION_LOG_H
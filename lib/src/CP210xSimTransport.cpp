@@ -0,0 +1,1644 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xSimTransport.cpp
+//
+// Simulated backend of the transport seam (see CP210xSim.h). Every device
+// is a small model of its part's firmware: the vendor requests read and
+// write the device "flash", string descriptors are served from it, and a
+// reset takes the device off the bus for the re-enumeration time, after
+// which it comes back at a new address presenting the programmed
+// descriptors. Like a real host, the device and configuration descriptors
+// seen through an open handle are the ones cached at enumeration time.
+// Faults are injected per device operation, by rate or by script.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "CP210xTransport.h"
+#include "CP210xSim.h"
+#include "OsDep.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+#define SIM_DEVICES_PER_BUS             63
+#define SIM_PORTS_PER_HUB               7       // every root port has a hub, 9 of them fill a bus
+#define SIM_MAX_INTERFACES              CP210x_MAX_INTERFACES
+#define SIM_LOCK_UNLOCKED               0xFF
+#define SIM_MAX_STRING_BYTES            252
+#define SIM_FAULT_NONE                  0xFF
+#define SIM_SLOW_REENUMERATION_MSEC     2000
+#define SIM_STRING_TIMEOUT_MSEC         1000    // libusb's timeout of string descriptor requests
+
+// CP2102N configuration block, see setCP2102N_USBString() in smt for the
+// string layout: 2-byte big endian length, 0x03, UTF-16LE characters
+#define CP2102N_CONFIG_SIZE             0x2a6
+#define CP2102N_CONFIG_VERSION          1
+#define CP2102N_CONFIG_UPDATE_OFFSET    4
+#define CP2102N_DEVICE_DESC_OFFSET      5
+#define CP2102N_CONFIG_DESC_OFFSET      23
+#define CP2102N_LANG_DESC_OFFSET        55
+#define CP2102N_MANUFACTURER_OFFSET     59
+#define CP2102N_MANUFACTURER_SIZE       131
+#define CP2102N_PRODUCT_OFFSET          190
+#define CP2102N_PRODUCT_SIZE            259
+#define CP2102N_SERIAL_OFFSET           449
+#define CP2102N_SERIAL_SIZE             131
+#define CP2102N_CHECKSUM_OFFSET         676
+
+#define CP2102N_VID_OFFSET              (CP2102N_DEVICE_DESC_OFFSET + 8)
+#define CP2102N_PID_OFFSET              (CP2102N_DEVICE_DESC_OFFSET + 10)
+#define CP2102N_BCD_DEVICE_OFFSET       (CP2102N_DEVICE_DESC_OFFSET + 12)
+#define CP2102N_ATTRIBUTES_OFFSET       (CP2102N_CONFIG_DESC_OFFSET + 7)
+#define CP2102N_MAX_POWER_OFFSET        (CP2102N_CONFIG_DESC_OFFSET + 8)
+
+// Factory defaults and request set of each part family
+struct CSimPartInfo
+{
+    BYTE partNum;
+    WORD pid;
+    BYTE numInterfaces;
+    BYTE portConfigSize;    // 0x370C payload, 0 if not supported
+    BYTE flushBufferSize;   // 0x370D payload, 0 if not supported
+    bool hasBaudConfig;     // 0x3709
+    bool hasDeviceMode;     // 0x3711
+    const char* product;
+};
+
+static const CSimPartInfo SimParts[] =
+{
+    { CP210x_CP2101_VERSION,        0xEA60, 1, 0,  0, false, false, "CP2101 USB to UART Bridge Controller" },
+    { CP210x_CP2102_VERSION,        0xEA60, 1, 0,  0, true,  false, "CP2102 USB to UART Bridge Controller" },
+    { CP210x_CP2103_VERSION,        0xEA60, 1, 13, 0, true,  false, "CP2103 USB to UART Bridge Controller" },
+    { CP210x_CP2104_VERSION,        0xEA60, 1, 13, 1, false, false, "CP2104 USB to UART Bridge Controller" },
+    { CP210x_CP2105_VERSION,        0xEA70, 2, 15, 1, false, true,  "CP2105 Dual USB to UART Bridge Controller" },
+    { CP210x_CP2108_VERSION,        0xEA71, 4, 73, 2, false, false, "CP2108 Quad USB to UART Bridge Controller" },
+    { CP210x_CP2109_VERSION,        0xEA60, 1, 0,  0, true,  false, "CP2109 USB to UART Bridge Controller" },
+    { CP210x_CP2102N_QFN28_VERSION, 0xEA60, 1, 0,  0, false, false, "CP2102N USB to UART Bridge Controller" },
+    { CP210x_CP2102N_QFN24_VERSION, 0xEA60, 1, 0,  0, false, false, "CP2102N USB to UART Bridge Controller" },
+    { CP210x_CP2102N_QFN20_VERSION, 0xEA60, 1, 0,  0, false, false, "CP2102N USB to UART Bridge Controller" },
+};
+
+static const CSimPartInfo* FindSimPart(BYTE partNum)
+{
+    for (size_t i = 0; i < sizeof(SimParts) / sizeof(SimParts[0]); i++) {
+        if (SimParts[i].partNum == partNum) {
+            return &SimParts[i];
+        }
+    }
+    return NULL;
+}
+
+static bool IsCP2102N(const CSimPartInfo* part)
+{
+    return part->partNum >= CP210x_CP2102N_QFN28_VERSION && part->partNum <= CP210x_CP2102N_QFN20_VERSION;
+}
+
+// Simulated timing, see CP210xSim_SetLatency()
+struct CSimLatency
+{
+    DWORD transferUsec;
+    DWORD openUsec;
+    DWORD reenumerationMsec;
+};
+
+// Device operations faults are drawn for
+enum SimOperation
+{
+    SIM_OP_IN,
+    SIM_OP_OUT,
+    SIM_OP_LANGID,  // string descriptor 0
+    SIM_OP_STRING,
+    SIM_OP_RESET
+};
+
+// Fault injection, see CP210xSim_SetFaultRate()
+struct CSimFaultRate
+{
+    DWORD perMillion;
+    DWORD param;
+};
+
+// Fault settings handed to devices when they are plugged in
+struct CSimFaultConfig
+{
+    CSimFaultRate rates[CP210xSim_NUM_FAULTS];
+    DWORD seed;
+};
+
+// One step of a fault script: the next count operations get fault
+struct CSimFaultStep
+{
+    BYTE fault;
+    DWORD count;
+};
+
+// Names in fault scripts and CP210X_SIM_FAULTS, indexed by CP210xSim_FAULT_*
+static const char* const SimFaultNames[CP210xSim_NUM_FAULTS] =
+{
+    "timeout",
+    "stall",
+    "short",
+    "disconnect",
+    "slowreenum",
+    "corrupt",
+};
+
+// What the host learns about a device when enumerating it
+struct CSimEnumState
+{
+    DWORD generation;
+    libusb_device_descriptor devDesc;
+    BYTE bmAttributes;
+    BYTE maxPower;
+    int bus;
+    int address;
+    CCP210xLocation location;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Helpers
+/////////////////////////////////////////////////////////////////////////////
+
+// Clock installed with CP210xSim_SetClock(), the system clock if NULL
+static CP210xSim_NOW_USEC SimClockNowUsec;
+static CP210xSim_SLEEP_USEC SimClockSleepUsec;
+
+static uint64_t SimNowNs()
+{
+    timespec ts;
+
+    if (SimClockNowUsec) {
+        return SimClockNowUsec() * 1000ULL;
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static void SimDelayUsec(DWORD usec)
+{
+    if (!usec) {
+        return;
+    }
+    if (SimClockSleepUsec) {
+        SimClockSleepUsec(usec);
+    } else {
+        usleep(usec);
+    }
+}
+
+// Same checksum the CP2102N firmware and smt use over the config block
+static WORD Fletcher16(const BYTE* data, WORD bytes)
+{
+    WORD sum1 = 0xff, sum2 = 0xff;
+
+    while (bytes) {
+        WORD tlen = bytes >= 20 ? 20 : bytes;
+        bytes -= tlen;
+        do {
+            sum2 += sum1 += *data++;
+        } while (--tlen);
+        sum1 = (sum1 & 0xff) + (sum1 >> 8);
+        sum2 = (sum2 & 0xff) + (sum2 >> 8);
+    }
+    sum1 = (sum1 & 0xff) + (sum1 >> 8);
+    sum2 = (sum2 & 0xff) + (sum2 >> 8);
+    return sum2 << 8 | sum1;
+}
+
+static std::vector<BYTE> AsciiToUtf16(const char* str)
+{
+    std::vector<BYTE> utf16;
+
+    for (; *str; str++) {
+        utf16.push_back(static_cast<BYTE>(*str));
+        utf16.push_back(0);
+    }
+    return utf16;
+}
+
+// Looks up a fault by name, "ok" is SIM_FAULT_NONE. Returns false if unknown.
+static bool FindSimFault(const char* name, size_t length, BYTE* fault)
+{
+    if (length == 2 && !strncmp(name, "ok", 2)) {
+        *fault = SIM_FAULT_NONE;
+        return true;
+    }
+    for (BYTE i = 0; i < CP210xSim_NUM_FAULTS; i++) {
+        if (strlen(SimFaultNames[i]) == length && !strncmp(name, SimFaultNames[i], length)) {
+            *fault = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses "<fault>[*<count>],..." into steps
+static bool ParseFaultScript(const char* script, std::vector<CSimFaultStep>& steps)
+{
+    steps.clear();
+    while (script && *script) {
+        const size_t length = strcspn(script, "*,");
+        CSimFaultStep step;
+
+        if (!FindSimFault(script, length, &step.fault)) {
+            return false;
+        }
+        script += length;
+        step.count = 1;
+        if (*script == '*') {
+            char* end;
+
+            step.count = strtoul(script + 1, &end, 10);
+            if (end == script + 1 || !step.count) {
+                return false;
+            }
+            script = end;
+        }
+        if (*script == ',') {
+            script++;
+        } else if (*script) {
+            return false;
+        }
+        steps.push_back(step);
+    }
+    return true;
+}
+
+static bool IsSimFaultPossible(BYTE fault, SimOperation op)
+{
+    switch (fault) {
+    case CP210xSim_FAULT_TIMEOUT:
+    case CP210xSim_FAULT_STALL:
+        return op != SIM_OP_RESET;
+    case CP210xSim_FAULT_SHORT_READ:
+        return op == SIM_OP_IN || op == SIM_OP_LANGID || op == SIM_OP_STRING;
+    case CP210xSim_FAULT_DISCONNECT:
+        return op == SIM_OP_OUT;
+    case CP210xSim_FAULT_SLOW_REENUMERATION:
+        return op == SIM_OP_RESET;
+    case CP210xSim_FAULT_CORRUPT_STRING:
+        return op == SIM_OP_STRING;
+    }
+    return false;
+}
+
+// Copies up to wLength bytes of a device-side buffer into an IN transfer
+static int ReturnData(unsigned char* data, uint16_t wLength, const BYTE* src, size_t size)
+{
+    const size_t count = wLength < size ? wLength : size;
+
+    if (count) {
+        memcpy(data, src, count);
+    }
+    return static_cast<int>(count);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CSimDevice Class
+/////////////////////////////////////////////////////////////////////////////
+
+// One simulated device. Reference counted: the backend holds a reference
+// while the device is plugged in, every enumeration and transport one more.
+class CSimDevice
+{
+public:
+    CSimDevice(DWORD id, const CSimPartInfo* part, WORD vid, WORD pid, const char* serial, const CSimLatency& latency, const CSimFaultConfig& faults);
+
+    void AddRef();
+    void Release();
+
+    DWORD GetId() const { return m_id; }
+
+    bool Enumerate(uint64_t nowNs, CSimEnumState* state);
+    bool IsCurrent(DWORD generation);
+    void Unplug();
+
+    void GetLatency(CSimLatency* latency);
+    void SetLatency(const CSimLatency& latency);
+
+    void SetFaultRate(BYTE fault, const CSimFaultRate& rate);
+    void SetFaultScript(const std::vector<CSimFaultStep>& steps);
+    void SetFaultSeed(DWORD seed);
+    DWORD GetFaultCount(BYTE fault);
+
+    int ControlTransfer(DWORD generation, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout);
+    int GetStringDescriptor(DWORD generation, uint8_t descIndex, unsigned char* data, int length);
+    int Reset(DWORD generation);
+
+    static libusb_config_descriptor* BuildConfigDescriptor(BYTE partNum, const CSimEnumState& state);
+
+private:
+    ~CSimDevice() {}
+
+    bool IsLocked() const;
+    void Reenumerate();
+    void DropOffBus(DWORD extraMsec);
+    BYTE DrawFault(SimOperation op);
+    DWORD NextRandom();
+    int VendorIn(uint16_t wValue, unsigned char* data, uint16_t wLength);
+    int VendorOut(uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength);
+    bool StoreString(std::vector<BYTE>& str, const unsigned char* data, uint16_t wLength);
+
+    // CP2102N keeps everything in its config block
+    void BuildConfig();
+    void LoadConfig();
+    void StoreConfigWord(int offset, WORD value);
+    void StoreConfigString(int offset, int size, const std::vector<BYTE>& utf16);
+    static void ParseConfigString(const BYTE* area, int size, std::vector<BYTE>& utf16);
+
+    CCriticalSectionLock m_lock;
+    DWORD m_refs;
+
+    const DWORD m_id;
+    const CSimPartInfo* const m_part;
+    CSimLatency m_latency;
+
+    // Bus presence: a reset bumps the generation, which invalidates all
+    // open handles, and keeps the device off the bus until m_reattachNs
+    bool m_attached;
+    DWORD m_generation;
+    uint64_t m_reattachNs;
+    CSimEnumState m_enum;
+
+    // Fault injection: the script goes first, then the rates
+    CSimFaultRate m_faultRates[CP210xSim_NUM_FAULTS];
+    std::vector<CSimFaultStep> m_faultScript;
+    size_t m_faultStep;
+    DWORD m_faultCount[CP210xSim_NUM_FAULTS];
+    DWORD m_random;
+
+    // Flash contents
+    WORD m_vid;
+    WORD m_pid;
+    WORD m_bcdDevice;
+    BYTE m_bmAttributes;
+    BYTE m_maxPower;
+    BYTE m_lockValue;
+    WORD m_flushBufferConfig;
+    BYTE m_deviceMode[2];
+    std::vector<BYTE> m_manufacturer;
+    std::vector<BYTE> m_product;
+    std::vector<BYTE> m_serial;
+    std::vector<BYTE> m_interface[SIM_MAX_INTERFACES];
+    std::vector<BYTE> m_baudConfig;
+    std::vector<BYTE> m_portConfig;
+    std::vector<BYTE> m_config;
+};
+
+CSimDevice::CSimDevice(DWORD id, const CSimPartInfo* part, WORD vid, WORD pid, const char* serial, const CSimLatency& latency, const CSimFaultConfig& faults)
+    : m_refs(1), m_id(id), m_part(part), m_latency(latency), m_attached(true), m_generation(0), m_reattachNs(0), m_faultStep(0)
+{
+    memcpy(m_faultRates, faults.rates, sizeof(m_faultRates));
+    memset(m_faultCount, 0, sizeof(m_faultCount));
+    SetFaultSeed(faults.seed);
+
+    m_vid = vid;
+    m_pid = pid;
+    m_bcdDevice = 0x0100;
+    m_bmAttributes = 0x80;
+    m_maxPower = 0x32;
+    m_lockValue = SIM_LOCK_UNLOCKED;
+    m_flushBufferConfig = 0;
+    m_deviceMode[0] = 0;
+    m_deviceMode[1] = 0;
+    m_manufacturer = AsciiToUtf16("Silicon Labs");
+    m_product = AsciiToUtf16(part->product);
+    m_serial = AsciiToUtf16(serial);
+    for (BYTE i = 0; i < part->numInterfaces; i++) {
+        char name[32];
+
+        sprintf(name, "%s Interface %u", part->numInterfaces > 2 ? "Quad" : "Dual", i);
+        m_interface[i] = AsciiToUtf16(name);
+    }
+    if (part->hasBaudConfig) {
+        m_baudConfig.assign(NUM_BAUD_CONFIGS * BAUD_CONFIG_SIZE, 0);
+    }
+    m_portConfig.assign(part->portConfigSize, 0);
+    if (IsCP2102N(part)) {
+        BuildConfig();
+    }
+
+    m_enum.generation = 0;
+    m_enum.address = 0;
+    Reenumerate();
+}
+
+void CSimDevice::AddRef()
+{
+    m_lock.Lock();
+    m_refs++;
+    m_lock.Unlock();
+}
+
+void CSimDevice::Release()
+{
+    m_lock.Lock();
+    const DWORD refs = --m_refs;
+    m_lock.Unlock();
+
+    if (!refs) {
+        delete this;
+    }
+}
+
+// Returns the descriptors the host would see now, false while the device
+// is off the bus
+bool CSimDevice::Enumerate(uint64_t nowNs, CSimEnumState* state)
+{
+    bool present;
+
+    m_lock.Lock();
+    present = m_attached && nowNs >= m_reattachNs;
+    if (present) {
+        *state = m_enum;
+    }
+    m_lock.Unlock();
+
+    return present;
+}
+
+bool CSimDevice::IsCurrent(DWORD generation)
+{
+    bool current;
+
+    m_lock.Lock();
+    current = m_attached && m_generation == generation;
+    m_lock.Unlock();
+
+    return current;
+}
+
+void CSimDevice::Unplug()
+{
+    m_lock.Lock();
+    m_attached = false;
+    m_generation++;
+    m_lock.Unlock();
+}
+
+void CSimDevice::GetLatency(CSimLatency* latency)
+{
+    m_lock.Lock();
+    *latency = m_latency;
+    m_lock.Unlock();
+}
+
+void CSimDevice::SetLatency(const CSimLatency& latency)
+{
+    m_lock.Lock();
+    m_latency = latency;
+    m_lock.Unlock();
+}
+
+void CSimDevice::SetFaultRate(BYTE fault, const CSimFaultRate& rate)
+{
+    m_lock.Lock();
+    m_faultRates[fault] = rate;
+    m_lock.Unlock();
+}
+
+void CSimDevice::SetFaultScript(const std::vector<CSimFaultStep>& steps)
+{
+    m_lock.Lock();
+    m_faultScript = steps;
+    m_faultStep = 0;
+    m_lock.Unlock();
+}
+
+void CSimDevice::SetFaultSeed(DWORD seed)
+{
+    m_lock.Lock();
+    m_random = (seed ^ (m_id * 0x9E3779B9)) | 1; // xorshift state must not be 0
+    m_lock.Unlock();
+}
+
+DWORD CSimDevice::GetFaultCount(BYTE fault)
+{
+    DWORD count;
+
+    m_lock.Lock();
+    count = m_faultCount[fault];
+    m_lock.Unlock();
+
+    return count;
+}
+
+DWORD CSimDevice::NextRandom()
+{
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+// Picks the fault of the next operation, SIM_FAULT_NONE to carry it out
+// normally. Called with m_lock held.
+BYTE CSimDevice::DrawFault(SimOperation op)
+{
+    BYTE fault = SIM_FAULT_NONE;
+
+    if (m_faultStep < m_faultScript.size()) {
+        CSimFaultStep& step = m_faultScript[m_faultStep];
+
+        if (IsSimFaultPossible(step.fault, op)) {
+            fault = step.fault;
+        }
+        if (!--step.count) {
+            m_faultStep++;
+        }
+    } else {
+        for (BYTE i = 0; i < CP210xSim_NUM_FAULTS; i++) {
+            if (m_faultRates[i].perMillion && IsSimFaultPossible(i, op) &&
+                    NextRandom() % 1000000 < m_faultRates[i].perMillion) {
+                fault = i;
+                break;
+            }
+        }
+    }
+    if (fault != SIM_FAULT_NONE) {
+        m_faultCount[fault]++;
+    }
+    return fault;
+}
+
+bool CSimDevice::IsLocked() const
+{
+    if (IsCP2102N(m_part)) {
+        return m_config[CP2102N_CONFIG_UPDATE_OFFSET] != SIM_LOCK_UNLOCKED;
+    }
+    return m_lockValue != SIM_LOCK_UNLOCKED;
+}
+
+// Takes the descriptor snapshot presented at the next enumeration. The
+// address alternates between two ranges so it changes on every reset but
+// stays unique on the simulated bus, the port the device is plugged into
+// stays the same.
+void CSimDevice::Reenumerate()
+{
+    const DWORD slot = (m_id - 1) % SIM_DEVICES_PER_BUS;
+    libusb_device_descriptor& desc = m_enum.devDesc;
+
+    memset(&desc, 0, sizeof(desc));
+    desc.bLength = 18;
+    desc.bDescriptorType = LIBUSB_DT_DEVICE;
+    desc.bcdUSB = 0x0200;
+    desc.bDeviceClass = LIBUSB_CLASS_PER_INTERFACE;
+    desc.bMaxPacketSize0 = 64;
+    desc.idVendor = m_vid;
+    desc.idProduct = m_pid;
+    desc.bcdDevice = m_bcdDevice;
+    desc.iManufacturer = 1;
+    desc.iProduct = 2;
+    desc.iSerialNumber = (m_part->numInterfaces > 1) ? 3 + m_part->numInterfaces : 3;
+    desc.bNumConfigurations = 1;
+
+    m_enum.generation = m_generation;
+    m_enum.bmAttributes = m_bmAttributes;
+    m_enum.maxPower = m_maxPower;
+    m_enum.bus = 1 + (m_id - 1) / SIM_DEVICES_PER_BUS;
+    m_enum.address = 1 + slot + ((m_generation & 1) ? SIM_DEVICES_PER_BUS : 0);
+    m_enum.location.bus = m_enum.bus;
+    m_enum.location.depth = 2;
+    m_enum.location.ports[0] = static_cast<uint8_t>(1 + slot / SIM_PORTS_PER_HUB);
+    m_enum.location.ports[1] = static_cast<uint8_t>(1 + slot % SIM_PORTS_PER_HUB);
+}
+
+// Takes the device off the bus for the re-enumeration time plus extraMsec,
+// handles open to it stop working. Called with m_lock held.
+void CSimDevice::DropOffBus(DWORD extraMsec)
+{
+    m_generation++;
+    m_reattachNs = SimNowNs() + (static_cast<uint64_t>(m_latency.reenumerationMsec) + extraMsec) * 1000000ULL;
+    Reenumerate();
+}
+
+int CSimDevice::Reset(DWORD generation)
+{
+    m_lock.Lock();
+    if (!m_attached || m_generation != generation) {
+        m_lock.Unlock();
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    if (DrawFault(SIM_OP_RESET) == CP210xSim_FAULT_SLOW_REENUMERATION) {
+        const DWORD extraMsec = m_faultRates[CP210xSim_FAULT_SLOW_REENUMERATION].param;
+
+        DropOffBus(extraMsec ? extraMsec : SIM_SLOW_REENUMERATION_MSEC);
+    } else {
+        DropOffBus(0);
+    }
+    m_lock.Unlock();
+
+    // The device comes back as a new one, so the handle can't be kept
+    return LIBUSB_ERROR_NOT_FOUND;
+}
+
+int CSimDevice::ControlTransfer(DWORD generation, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout)
+{
+    DWORD hangMsec = 0;
+    int ret;
+
+    if (wLength && !data) {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+
+    m_lock.Lock();
+    if (!m_attached || m_generation != generation) {
+        ret = LIBUSB_ERROR_NO_DEVICE;
+    } else {
+        const bool in = (bmRequestType & LIBUSB_ENDPOINT_IN) != 0;
+        const BYTE fault = DrawFault(in ? SIM_OP_IN : SIM_OP_OUT);
+
+        if (fault == CP210xSim_FAULT_TIMEOUT) {
+            hangMsec = m_faultRates[fault].param ? m_faultRates[fault].param : timeout;
+            ret = LIBUSB_ERROR_TIMEOUT;
+        } else if (fault == CP210xSim_FAULT_STALL) {
+            ret = LIBUSB_ERROR_PIPE;
+        } else if (fault == CP210xSim_FAULT_DISCONNECT) {
+            // Gone before the data stage completed, nothing reaches flash
+            DropOffBus(0);
+            ret = LIBUSB_ERROR_NO_DEVICE;
+        } else if (bRequest != 0xFF) {
+            ret = LIBUSB_ERROR_PIPE;
+        } else if (bmRequestType == 0xC0) {
+            ret = VendorIn(wValue, data, wLength);
+            if (fault == CP210xSim_FAULT_SHORT_READ && ret > 0) {
+                ret /= 2;
+            }
+        } else if (bmRequestType == 0x40) {
+            ret = VendorOut(wValue, wIndex, data, wLength);
+        } else {
+            ret = LIBUSB_ERROR_PIPE;
+        }
+    }
+    m_lock.Unlock();
+
+    // A timed out request holds the caller for the whole timeout
+    if (hangMsec) {
+        SimDelayUsec(hangMsec * 1000);
+    }
+    return ret;
+}
+
+int CSimDevice::VendorIn(uint16_t wValue, unsigned char* data, uint16_t wLength)
+{
+    const bool cp2102n = IsCP2102N(m_part);
+
+    switch (wValue) {
+    case 0x370B: // part number, the CP2101 predates it
+        if (m_part->partNum != CP210x_CP2101_VERSION) {
+            return ReturnData(data, wLength, &m_part->partNum, 1);
+        }
+        break;
+
+    case 0x3709:
+        if (m_part->hasBaudConfig) {
+            return ReturnData(data, wLength, &m_baudConfig[0], m_baudConfig.size());
+        }
+        break;
+
+    case 0x370A:
+        if (!cp2102n) {
+            return ReturnData(data, wLength, &m_lockValue, 1);
+        }
+        break;
+
+    case 0x370C:
+        if (!m_portConfig.empty()) {
+            return ReturnData(data, wLength, &m_portConfig[0], m_portConfig.size());
+        }
+        break;
+
+    case 0x370D:
+        if (m_part->flushBufferSize) {
+            const BYTE flush[2] = { static_cast<BYTE>(m_flushBufferConfig & 0xFF), static_cast<BYTE>(m_flushBufferConfig >> 8) };
+            return ReturnData(data, wLength, flush, m_part->flushBufferSize);
+        }
+        break;
+
+    case 0x3711:
+        if (m_part->hasDeviceMode) {
+            return ReturnData(data, wLength, m_deviceMode, sizeof(m_deviceMode));
+        }
+        break;
+
+    case 0x000E: // CP2102N config, as sent by CCP210xDevice::GetConfig()
+    case 0x370E:
+        if (cp2102n) {
+            return ReturnData(data, wLength, &m_config[0], m_config.size());
+        }
+        break;
+
+    case 0x0010: // CP2102N firmware version
+        if (cp2102n) {
+            const BYTE version[3] = { 1, 0, 8 };
+            return ReturnData(data, wLength, version, sizeof(version));
+        }
+        break;
+    }
+    return LIBUSB_ERROR_PIPE;
+}
+
+int CSimDevice::VendorOut(uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength)
+{
+    const bool cp2102n = IsCP2102N(m_part);
+
+    // A locked device refuses every customization
+    if (IsLocked()) {
+        return LIBUSB_ERROR_PIPE;
+    }
+
+    switch (wValue) {
+    case 0x3701:
+        m_vid = wIndex;
+        if (cp2102n) {
+            StoreConfigWord(CP2102N_VID_OFFSET, wIndex);
+        }
+        return 0;
+
+    case 0x3702:
+        m_pid = wIndex;
+        if (cp2102n) {
+            StoreConfigWord(CP2102N_PID_OFFSET, wIndex);
+        }
+        return 0;
+
+    case 0x3705:
+        m_bmAttributes = static_cast<BYTE>(wIndex);
+        if (cp2102n) {
+            m_config[CP2102N_ATTRIBUTES_OFFSET] = m_bmAttributes;
+            StoreConfigWord(CP2102N_VID_OFFSET, m_vid); // refreshes the checksum
+        }
+        return 0;
+
+    case 0x3706:
+        m_maxPower = static_cast<BYTE>(wIndex);
+        if (cp2102n) {
+            m_config[CP2102N_MAX_POWER_OFFSET] = m_maxPower;
+            StoreConfigWord(CP2102N_VID_OFFSET, m_vid);
+        }
+        return 0;
+
+    case 0x3707:
+        m_bcdDevice = wIndex;
+        if (cp2102n) {
+            StoreConfigWord(CP2102N_BCD_DEVICE_OFFSET, wIndex);
+        }
+        return 0;
+
+    case 0x3703:
+        if (!StoreString(m_product, data, wLength)) {
+            break;
+        }
+        if (cp2102n) {
+            StoreConfigString(CP2102N_PRODUCT_OFFSET, CP2102N_PRODUCT_SIZE, m_product);
+        }
+        return wLength;
+
+    case 0x3704:
+        if (!StoreString(m_serial, data, wLength)) {
+            break;
+        }
+        if (cp2102n) {
+            StoreConfigString(CP2102N_SERIAL_OFFSET, CP2102N_SERIAL_SIZE, m_serial);
+        }
+        return wLength;
+
+    case 0x3714:
+        if (!StoreString(m_manufacturer, data, wLength)) {
+            break;
+        }
+        if (cp2102n) {
+            StoreConfigString(CP2102N_MANUFACTURER_OFFSET, CP2102N_MANUFACTURER_SIZE, m_manufacturer);
+        }
+        return wLength;
+
+    case 0x370F:
+        if (cp2102n) {
+            // Whole config block, stored as sent: the checksum isn't
+            // checked, smt's lock() only patches enableConfigUpdate
+            if (wLength != CP2102N_CONFIG_SIZE || data[2] != CP2102N_CONFIG_VERSION) {
+                break;
+            }
+            m_config.assign(data, data + wLength);
+            LoadConfig();
+            return wLength;
+        }
+        /* FALLTHROUGH */
+    case 0x3710:
+    case 0x3712:
+    case 0x3713:
+        {
+            // Interface strings of the multi-interface parts
+            static const uint16_t setupCmd[SIM_MAX_INTERFACES] = { 0x370F, 0x3710, 0x3712, 0x3713 };
+
+            for (BYTE i = 0; i < m_part->numInterfaces && m_part->numInterfaces > 1; i++) {
+                if (setupCmd[i] == wValue) {
+                    return StoreString(m_interface[i], data, wLength) ? static_cast<int>(wLength) : static_cast<int>(LIBUSB_ERROR_PIPE);
+                }
+            }
+        }
+        break;
+
+    case 0x3709:
+        if (m_part->hasBaudConfig && wLength >= m_baudConfig.size()) {
+            memcpy(&m_baudConfig[0], data, m_baudConfig.size());
+            return wLength;
+        }
+        break;
+
+    case 0x370A:
+        if (!cp2102n) {
+            m_lockValue = static_cast<BYTE>(wIndex);
+            return 0;
+        }
+        break;
+
+    case 0x370C:
+        if (!m_portConfig.empty() && wLength == m_portConfig.size()) {
+            memcpy(&m_portConfig[0], data, wLength);
+            return wLength;
+        }
+        break;
+
+    case 0x370D:
+        if (m_part->flushBufferSize) {
+            m_flushBufferConfig = (m_part->flushBufferSize > 1) ? wIndex : (wIndex & 0xFF);
+            return 0;
+        }
+        break;
+
+    case 0x3711:
+        if (m_part->hasDeviceMode && wLength >= sizeof(m_deviceMode)) {
+            memcpy(m_deviceMode, data, sizeof(m_deviceMode));
+            return wLength;
+        }
+        break;
+    }
+    return LIBUSB_ERROR_PIPE;
+}
+
+// Takes a string from the USB string descriptor payload used by the setters
+bool CSimDevice::StoreString(std::vector<BYTE>& str, const unsigned char* data, uint16_t wLength)
+{
+    if (wLength < 2 || data[1] != LIBUSB_DT_STRING || data[0] < 2 || data[0] > wLength || (data[0] & 1)) {
+        return false;
+    }
+    if (data[0] - 2 > SIM_MAX_STRING_BYTES) {
+        return false;
+    }
+    str.assign(data + 2, data + data[0]);
+    return true;
+}
+
+int CSimDevice::GetStringDescriptor(DWORD generation, uint8_t descIndex, unsigned char* data, int length)
+{
+    std::vector<BYTE> desc;
+
+    m_lock.Lock();
+    if (!m_attached || m_generation != generation) {
+        m_lock.Unlock();
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    const BYTE fault = DrawFault(descIndex ? SIM_OP_STRING : SIM_OP_LANGID);
+    if (fault == CP210xSim_FAULT_TIMEOUT || fault == CP210xSim_FAULT_STALL) {
+        const DWORD hangMsec = m_faultRates[fault].param ? m_faultRates[fault].param : SIM_STRING_TIMEOUT_MSEC;
+
+        m_lock.Unlock();
+        if (fault == CP210xSim_FAULT_STALL) {
+            return LIBUSB_ERROR_PIPE;
+        }
+        SimDelayUsec(hangMsec * 1000);
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+
+    const std::vector<BYTE>* str = NULL;
+    if (descIndex == 1) {
+        str = &m_manufacturer;
+    } else if (descIndex == 2) {
+        str = &m_product;
+    } else if (descIndex == m_enum.devDesc.iSerialNumber) {
+        str = &m_serial;
+    } else if (descIndex >= 3 && descIndex < 3 + m_part->numInterfaces && m_part->numInterfaces > 1) {
+        str = &m_interface[descIndex - 3];
+    }
+
+    desc.push_back(2);
+    desc.push_back(LIBUSB_DT_STRING);
+    if (descIndex == 0) {
+        desc.push_back(0x09); // English (US)
+        desc.push_back(0x04);
+    } else if (str) {
+        desc.insert(desc.end(), str->begin(), str->end());
+
+        // A well formed descriptor with one character replaced
+        if (fault == CP210xSim_FAULT_CORRUPT_STRING && desc.size() > 2) {
+            const size_t pos = 2 + 2 * (NextRandom() % ((desc.size() - 2) / 2));
+            const BYTE garbage = static_cast<BYTE>('!' + NextRandom() % 94);
+
+            desc[pos] = (desc[pos] == garbage) ? '~' : garbage;
+            desc[pos + 1] = 0;
+        }
+    }
+    m_lock.Unlock();
+
+    if (descIndex && !str) {
+        return LIBUSB_ERROR_PIPE;
+    }
+    desc[0] = static_cast<BYTE>(desc.size());
+
+    int ret = ReturnData(data, length > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(length), &desc[0], desc.size());
+    if (fault == CP210xSim_FAULT_SHORT_READ) {
+        ret /= 2;
+    }
+    return ret;
+}
+
+libusb_config_descriptor* CSimDevice::BuildConfigDescriptor(BYTE partNum, const CSimEnumState& state)
+{
+    const CSimPartInfo* part = FindSimPart(partNum);
+    CCP210xConfigDescriptorBlock* desc = new CCP210xConfigDescriptorBlock;
+
+    memset(desc, 0, sizeof(*desc));
+    desc->config.bLength = 9;
+    desc->config.bDescriptorType = LIBUSB_DT_CONFIG;
+    desc->config.wTotalLength = 9 + part->numInterfaces * (9 + 2 * 7);
+    desc->config.bNumInterfaces = part->numInterfaces;
+    desc->config.bConfigurationValue = 1;
+    desc->config.bmAttributes = state.bmAttributes;
+    desc->config.MaxPower = state.maxPower;
+    desc->config.interface = desc->interfaces;
+
+    for (BYTE i = 0; i < part->numInterfaces; i++) {
+        libusb_interface_descriptor& alt = desc->altsettings[i];
+
+        alt.bLength = 9;
+        alt.bDescriptorType = LIBUSB_DT_INTERFACE;
+        alt.bInterfaceNumber = i;
+        alt.bNumEndpoints = 2;
+        alt.bInterfaceClass = LIBUSB_CLASS_VENDOR_SPEC;
+        alt.iInterface = (part->numInterfaces > 1) ? 3 + i : 2;
+        alt.endpoint = desc->endpoints[i];
+        desc->interfaces[i].altsetting = &alt;
+        desc->interfaces[i].num_altsetting = 1;
+
+        // The CP2101 is told apart by its endpoint 3 pair
+        const BYTE ep = (partNum == CP210x_CP2101_VERSION) ? 0x03 : 0x01 + 2 * i;
+        for (int e = 0; e < 2; e++) {
+            desc->endpoints[i][e].bLength = 7;
+            desc->endpoints[i][e].bDescriptorType = LIBUSB_DT_ENDPOINT;
+            desc->endpoints[i][e].bEndpointAddress = e ? (ep | LIBUSB_ENDPOINT_IN) : ep;
+            desc->endpoints[i][e].bmAttributes = LIBUSB_TRANSFER_TYPE_BULK;
+            desc->endpoints[i][e].wMaxPacketSize = 64;
+        }
+    }
+    return &desc->config;
+}
+
+// Default CP2102N config block matching the device's factory state
+void CSimDevice::BuildConfig()
+{
+    m_config.assign(CP2102N_CONFIG_SIZE, 0);
+
+    BYTE* cfg = &m_config[0];
+    cfg[0] = CP2102N_CONFIG_SIZE & 0xFF;
+    cfg[1] = CP2102N_CONFIG_SIZE >> 8;
+    cfg[2] = CP2102N_CONFIG_VERSION;
+    cfg[3] = 1;
+    cfg[CP2102N_CONFIG_UPDATE_OFFSET] = SIM_LOCK_UNLOCKED;
+
+    const BYTE deviceDesc[18] = { 18, LIBUSB_DT_DEVICE, 0x00, 0x02, 0, 0, 0, 64,
+                                  0, 0, 0, 0, 0, 0, 1, 2, 3, 1 };
+    memcpy(cfg + CP2102N_DEVICE_DESC_OFFSET, deviceDesc, sizeof(deviceDesc));
+    const BYTE configDesc[9] = { 9, LIBUSB_DT_CONFIG, 32, 0, 1, 1, 0, 0, 0 };
+    memcpy(cfg + CP2102N_CONFIG_DESC_OFFSET, configDesc, sizeof(configDesc));
+    const BYTE langDesc[4] = { 4, LIBUSB_DT_STRING, 0x09, 0x04 };
+    memcpy(cfg + CP2102N_LANG_DESC_OFFSET, langDesc, sizeof(langDesc));
+
+    cfg[CP2102N_ATTRIBUTES_OFFSET] = m_bmAttributes;
+    cfg[CP2102N_MAX_POWER_OFFSET] = m_maxPower;
+    StoreConfigWord(CP2102N_PID_OFFSET, m_pid);
+    StoreConfigWord(CP2102N_BCD_DEVICE_OFFSET, m_bcdDevice);
+    StoreConfigWord(CP2102N_VID_OFFSET, m_vid);
+    StoreConfigString(CP2102N_MANUFACTURER_OFFSET, CP2102N_MANUFACTURER_SIZE, m_manufacturer);
+    StoreConfigString(CP2102N_PRODUCT_OFFSET, CP2102N_PRODUCT_SIZE, m_product);
+    StoreConfigString(CP2102N_SERIAL_OFFSET, CP2102N_SERIAL_SIZE, m_serial);
+}
+
+// Picks the descriptor fields back out of a config block written by the host
+void CSimDevice::LoadConfig()
+{
+    const BYTE* cfg = &m_config[0];
+
+    m_vid = cfg[CP2102N_VID_OFFSET] | (cfg[CP2102N_VID_OFFSET + 1] << 8);
+    m_pid = cfg[CP2102N_PID_OFFSET] | (cfg[CP2102N_PID_OFFSET + 1] << 8);
+    m_bcdDevice = cfg[CP2102N_BCD_DEVICE_OFFSET] | (cfg[CP2102N_BCD_DEVICE_OFFSET + 1] << 8);
+    m_bmAttributes = cfg[CP2102N_ATTRIBUTES_OFFSET];
+    m_maxPower = cfg[CP2102N_MAX_POWER_OFFSET];
+    ParseConfigString(cfg + CP2102N_MANUFACTURER_OFFSET, CP2102N_MANUFACTURER_SIZE, m_manufacturer);
+    ParseConfigString(cfg + CP2102N_PRODUCT_OFFSET, CP2102N_PRODUCT_SIZE, m_product);
+    ParseConfigString(cfg + CP2102N_SERIAL_OFFSET, CP2102N_SERIAL_SIZE, m_serial);
+}
+
+void CSimDevice::StoreConfigWord(int offset, WORD value)
+{
+    m_config[offset] = value & 0xFF;
+    m_config[offset + 1] = value >> 8;
+
+    const WORD checksum = Fletcher16(&m_config[0], CP2102N_CHECKSUM_OFFSET);
+    m_config[CP2102N_CHECKSUM_OFFSET] = checksum >> 8;
+    m_config[CP2102N_CHECKSUM_OFFSET + 1] = checksum & 0xFF;
+}
+
+void CSimDevice::StoreConfigString(int offset, int size, const std::vector<BYTE>& utf16)
+{
+    // The stored length counts one extra (zero) character, as smt writes it
+    const size_t count = (utf16.size() + 5 > static_cast<size_t>(size)) ? size - 5 : utf16.size();
+    const WORD descLen = static_cast<WORD>(count + 2);
+    BYTE* area = &m_config[offset];
+
+    memset(area, 0, size);
+    area[0] = descLen >> 8;
+    area[1] = descLen & 0xFF;
+    area[2] = LIBUSB_DT_STRING;
+    if (count) {
+        memcpy(area + 3, &utf16[0], count);
+    }
+    StoreConfigWord(CP2102N_VID_OFFSET, m_vid);
+}
+
+void CSimDevice::ParseConfigString(const BYTE* area, int size, std::vector<BYTE>& utf16)
+{
+    const int descLen = (area[0] << 8) | area[1];
+
+    utf16.clear();
+    if (area[2] == LIBUSB_DT_STRING && descLen >= 2 && descLen + 3 <= size) {
+        utf16.assign(area + 3, area + 3 + descLen - 2);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CSimTransport Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CSimTransport : public CCP210xTransport
+{
+public:
+    CSimTransport(CSimDevice* dev, BYTE partNum, const CSimEnumState& state) : m_dev(dev), m_partNum(partNum), m_state(state) {
+        m_dev->AddRef();
+    }
+    virtual ~CSimTransport() {
+        m_dev->Release();
+    }
+
+    virtual int ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout) {
+        Delay();
+        return m_dev->ControlTransfer(m_state.generation, bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+    }
+    virtual int GetStringDescriptor(uint8_t descIndex, uint16_t /*langId*/, unsigned char* data, int length) {
+        Delay();
+        return m_dev->GetStringDescriptor(m_state.generation, descIndex, data, length);
+    }
+    virtual int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length);
+    virtual int GetDeviceDescriptor(libusb_device_descriptor* desc) {
+        *desc = m_state.devDesc;
+        return 0;
+    }
+    virtual int GetConfigDescriptor(libusb_config_descriptor** config) {
+        *config = CSimDevice::BuildConfigDescriptor(m_partNum, m_state);
+        return 0;
+    }
+    virtual void FreeConfigDescriptor(libusb_config_descriptor* config);
+    virtual int Reset() {
+        Delay();
+        return m_dev->Reset(m_state.generation);
+    }
+    virtual int GetBusNumber() {
+        return m_state.bus;
+    }
+    virtual int GetDeviceAddress() {
+        return m_state.address;
+    }
+
+private:
+    void Delay() {
+        CSimLatency latency;
+
+        m_dev->GetLatency(&latency);
+        SimDelayUsec(latency.transferUsec);
+    }
+
+    CSimDevice* m_dev;
+    const BYTE m_partNum;
+    const CSimEnumState m_state;
+};
+
+// Same conversion as libusb_get_string_descriptor_ascii(), including its
+// language ID request ahead of the string itself
+int CSimTransport::GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length)
+{
+    unsigned char buf[255];
+    int ret;
+
+    if (length <= 0) {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    ret = GetStringDescriptor(0, 0, buf, sizeof(buf));
+    if (ret < 0) {
+        return ret;
+    }
+    if (ret < 4) {
+        return LIBUSB_ERROR_IO;
+    }
+    ret = GetStringDescriptor(descIndex, buf[2] | (buf[3] << 8), buf, sizeof(buf));
+    if (ret < 0) {
+        return ret;
+    }
+    if (buf[1] != LIBUSB_DT_STRING || buf[0] > ret) {
+        return LIBUSB_ERROR_IO;
+    }
+
+    int di = 0;
+    for (int si = 2; si + 1 < buf[0] && di < length - 1; si += 2) {
+        data[di++] = (buf[si + 1] || (buf[si] & 0x80)) ? '?' : buf[si];
+    }
+    data[di] = 0;
+    return di;
+}
+
+void CSimTransport::FreeConfigDescriptor(libusb_config_descriptor* config)
+{
+    delete reinterpret_cast<CCP210xConfigDescriptorBlock*>(config);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CSimEnumeration Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CSimEnumeration : public CCP210xEnumeration
+{
+public:
+    virtual ~CSimEnumeration() {
+        for (size_t i = 0; i < m_devices.size(); i++) {
+            m_devices[i]->Release();
+        }
+    }
+
+    void Add(CSimDevice* dev, BYTE partNum, const CSimEnumState& state) {
+        dev->AddRef();
+        m_devices.push_back(dev);
+        m_partNums.push_back(partNum);
+        m_states.push_back(state);
+    }
+
+    virtual ssize_t GetCount() {
+        return static_cast<ssize_t>(m_devices.size());
+    }
+    virtual bool IsCandidate(ssize_t /*index*/) {
+        return true;
+    }
+    virtual CP210x_STATUS Open(ssize_t index, CCP210xTransport** transport) {
+        CSimLatency latency;
+
+        m_devices[index]->GetLatency(&latency);
+        SimDelayUsec(latency.openUsec);
+
+        // Gone since the snapshot was taken
+        if (!m_devices[index]->IsCurrent(m_states[index].generation)) {
+            return CP210x_DEVICE_NOT_FOUND;
+        }
+        *transport = new CSimTransport(m_devices[index], m_partNums[index], m_states[index]);
+        return CP210x_SUCCESS;
+    }
+    virtual int GetLocation(ssize_t index, CCP210xLocation* location) {
+        *location = m_states[index].location;
+        return 0;
+    }
+
+private:
+    std::vector<CSimDevice*> m_devices;
+    std::vector<BYTE> m_partNums;
+    std::vector<CSimEnumState> m_states;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CSimBackend Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CSimBackend : public CCP210xBackend
+{
+public:
+    CSimBackend();
+    virtual ~CSimBackend();
+
+    virtual CP210x_STATUS Enumerate(CCP210xEnumeration** enumeration);
+    virtual uint64_t NowMsec();
+    virtual void Delay(DWORD msec);
+
+    CP210x_STATUS AddDevice(BYTE partNum, WORD vid, WORD pid, LPCSTR serial, LPDWORD lpdwSimId);
+    CP210x_STATUS RemoveDevice(DWORD id);
+    void RemoveAllDevices();
+    void SetLatency(const CSimLatency& latency);
+
+    CP210x_STATUS SetFaultRate(DWORD id, BYTE fault, const CSimFaultRate& rate);
+    CP210x_STATUS SetFaultScript(DWORD id, const std::vector<CSimFaultStep>& steps);
+    CP210x_STATUS GetFaultCount(DWORD id, BYTE fault, LPDWORD count);
+    void SetFaultSeed(DWORD seed);
+
+private:
+    void ReadFaultEnvironment();
+
+    CCriticalSectionLock m_lock;
+    std::vector<CSimDevice*> m_devices;
+    std::vector<BYTE> m_partNums;
+    DWORD m_nextId;
+    CSimLatency m_latency;
+    CSimFaultConfig m_faults;
+};
+
+// Populates the simulated buses from the CP210X_SIM_* environment, see
+// CP210xSim.h
+CSimBackend::CSimBackend() : m_nextId(1)
+{
+    memset(&m_latency, 0, sizeof(m_latency));
+    memset(&m_faults, 0, sizeof(m_faults));
+
+    const char* seed = getenv("CP210X_SIM_SEED");
+    if (seed) {
+        m_faults.seed = strtoul(seed, NULL, 0);
+    }
+
+    const char* latency = getenv("CP210X_SIM_LATENCY");
+    if (latency) {
+        unsigned int transferUsec = 0, openUsec = 0, reenumerationMsec = 0;
+
+        sscanf(latency, "%u,%u,%u", &transferUsec, &openUsec, &reenumerationMsec);
+        m_latency.transferUsec = transferUsec;
+        m_latency.openUsec = openUsec;
+        m_latency.reenumerationMsec = reenumerationMsec;
+    }
+
+    const char* devices = getenv("CP210X_SIM_DEVICES");
+    while (devices && *devices) {
+        char* end;
+        const unsigned long partNum = strtoul(devices, &end, 16);
+        unsigned long count = 1;
+
+        if (end == devices) {
+            break;
+        }
+        if (*end == ':') {
+            count = strtoul(end + 1, &end, 10);
+        }
+        while (count--) {
+            if (AddDevice(static_cast<BYTE>(partNum), 0, 0, NULL, NULL) != CP210x_SUCCESS) {
+                break;
+            }
+        }
+        devices = (*end == ',') ? end + 1 : NULL;
+    }
+
+    ReadFaultEnvironment();
+}
+
+// Malformed entries are skipped, like those of CP210X_SIM_DEVICES
+void CSimBackend::ReadFaultEnvironment()
+{
+    const char* faults = getenv("CP210X_SIM_FAULTS");
+    while (faults && *faults) {
+        const size_t length = strcspn(faults, "=,");
+        BYTE fault;
+
+        if (faults[length] == '=' && FindSimFault(faults, length, &fault) && fault != SIM_FAULT_NONE) {
+            CSimFaultRate rate;
+            char* end;
+
+            rate.perMillion = strtoul(faults + length + 1, &end, 10);
+            rate.param = (*end == ':') ? strtoul(end + 1, &end, 10) : 0;
+            SetFaultRate(0, fault, rate);
+            faults = end;
+        } else {
+            faults += length;
+        }
+        faults = strchr(faults, ',');
+        if (faults) {
+            faults++;
+        }
+    }
+
+    const char* scripts = getenv("CP210X_SIM_FAULT_SCRIPT");
+    while (scripts && *scripts) {
+        const size_t length = strcspn(scripts, ";");
+        const std::string entry(scripts, length);
+        char* script;
+        const unsigned long id = strtoul(entry.c_str(), &script, 10);
+        std::vector<CSimFaultStep> steps;
+
+        if (*script == ':' && ParseFaultScript(script + 1, steps)) {
+            SetFaultScript(id, steps);
+        }
+        scripts += length;
+        if (*scripts) {
+            scripts++;
+        }
+    }
+}
+
+CSimBackend::~CSimBackend()
+{
+    RemoveAllDevices();
+}
+
+CP210x_STATUS CSimBackend::Enumerate(CCP210xEnumeration** enumeration)
+{
+    CSimEnumeration* simEnum = new CSimEnumeration;
+    const uint64_t nowNs = SimNowNs();
+
+    m_lock.Lock();
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        CSimEnumState state;
+
+        if (m_devices[i]->Enumerate(nowNs, &state)) {
+            simEnum->Add(m_devices[i], m_partNums[i], state);
+        }
+    }
+    m_lock.Unlock();
+
+    *enumeration = simEnum;
+    return CP210x_SUCCESS;
+}
+
+// The devices re-enumerate by the clock installed with CP210xSim_SetClock()
+uint64_t CSimBackend::NowMsec()
+{
+    return SimNowNs() / 1000000;
+}
+
+void CSimBackend::Delay(DWORD msec)
+{
+    SimDelayUsec(msec * 1000);
+}
+
+CP210x_STATUS CSimBackend::AddDevice(BYTE partNum, WORD vid, WORD pid, LPCSTR serial, LPDWORD lpdwSimId)
+{
+    const CSimPartInfo* part = FindSimPart(partNum);
+    char defaultSerial[16];
+
+    if (!part || (serial && !*serial)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+
+    m_lock.Lock();
+    const DWORD id = m_nextId++;
+    if (!serial) {
+        sprintf(defaultSerial, "SIM%06u", static_cast<unsigned int>(id));
+        serial = defaultSerial;
+    }
+    m_devices.push_back(new CSimDevice(id, part, vid ? vid : 0x10C4, pid ? pid : part->pid, serial, m_latency, m_faults));
+    m_partNums.push_back(partNum);
+    m_lock.Unlock();
+
+    if (lpdwSimId) {
+        *lpdwSimId = id;
+    }
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CSimBackend::RemoveDevice(DWORD id)
+{
+    CSimDevice* dev = NULL;
+
+    m_lock.Lock();
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        if (m_devices[i]->GetId() == id) {
+            dev = m_devices[i];
+            m_devices.erase(m_devices.begin() + i);
+            m_partNums.erase(m_partNums.begin() + i);
+            break;
+        }
+    }
+    m_lock.Unlock();
+
+    if (!dev) {
+        return CP210x_DEVICE_NOT_FOUND;
+    }
+    dev->Unplug();
+    dev->Release();
+    return CP210x_SUCCESS;
+}
+
+void CSimBackend::RemoveAllDevices()
+{
+    std::vector<CSimDevice*> devices;
+
+    m_lock.Lock();
+    devices.swap(m_devices);
+    m_partNums.clear();
+    m_lock.Unlock();
+
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i]->Unplug();
+        devices[i]->Release();
+    }
+}
+
+void CSimBackend::SetLatency(const CSimLatency& latency)
+{
+    m_lock.Lock();
+    m_latency = latency;
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        m_devices[i]->SetLatency(latency);
+    }
+    m_lock.Unlock();
+}
+
+// Id 0 also becomes the default of devices plugged in later
+CP210x_STATUS CSimBackend::SetFaultRate(DWORD id, BYTE fault, const CSimFaultRate& rate)
+{
+    CP210x_STATUS status = id ? CP210x_DEVICE_NOT_FOUND : CP210x_SUCCESS;
+
+    m_lock.Lock();
+    if (!id) {
+        m_faults.rates[fault] = rate;
+    }
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        if (!id || m_devices[i]->GetId() == id) {
+            m_devices[i]->SetFaultRate(fault, rate);
+            status = CP210x_SUCCESS;
+        }
+    }
+    m_lock.Unlock();
+
+    return status;
+}
+
+CP210x_STATUS CSimBackend::SetFaultScript(DWORD id, const std::vector<CSimFaultStep>& steps)
+{
+    CP210x_STATUS status = id ? CP210x_DEVICE_NOT_FOUND : CP210x_SUCCESS;
+
+    m_lock.Lock();
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        if (!id || m_devices[i]->GetId() == id) {
+            m_devices[i]->SetFaultScript(steps);
+            status = CP210x_SUCCESS;
+        }
+    }
+    m_lock.Unlock();
+
+    return status;
+}
+
+CP210x_STATUS CSimBackend::GetFaultCount(DWORD id, BYTE fault, LPDWORD count)
+{
+    CP210x_STATUS status = id ? CP210x_DEVICE_NOT_FOUND : CP210x_SUCCESS;
+
+    *count = 0;
+    m_lock.Lock();
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        if (!id || m_devices[i]->GetId() == id) {
+            *count += m_devices[i]->GetFaultCount(fault);
+            status = CP210x_SUCCESS;
+        }
+    }
+    m_lock.Unlock();
+
+    return status;
+}
+
+void CSimBackend::SetFaultSeed(DWORD seed)
+{
+    m_lock.Lock();
+    m_faults.seed = seed;
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        m_devices[i]->SetFaultSeed(seed);
+    }
+    m_lock.Unlock();
+}
+
+static CSimBackend* GetSimBackend()
+{
+    static CSimBackend backend;
+
+    return &backend;
+}
+
+CCP210xBackend* GetCP210xSimBackend()
+{
+    return GetSimBackend();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Exported Library Functions
+/////////////////////////////////////////////////////////////////////////////
+
+CP210x_STATUS CP210xSim_Enable(
+        const BOOL bEnable
+        ) {
+    CCP210xBackend::Select(bEnable ? GetCP210xSimBackend() : GetCP210xLibusbBackend());
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CP210xSim_AddDevice(
+        const BYTE bPartNum,
+        const WORD wVid,
+        const WORD wPid,
+        LPCSTR lpszSerialNumber,
+        LPDWORD lpdwSimId
+        ) {
+    return GetSimBackend()->AddDevice(bPartNum, wVid, wPid, lpszSerialNumber, lpdwSimId);
+}
+
+CP210x_STATUS CP210xSim_RemoveDevice(
+        const DWORD dwSimId
+        ) {
+    return GetSimBackend()->RemoveDevice(dwSimId);
+}
+
+CP210x_STATUS CP210xSim_RemoveAllDevices() {
+    GetSimBackend()->RemoveAllDevices();
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CP210xSim_SetLatency(
+        const DWORD dwTransferUsec,
+        const DWORD dwOpenUsec,
+        const DWORD dwReenumerationMsec
+        ) {
+    CSimLatency latency;
+
+    latency.transferUsec = dwTransferUsec;
+    latency.openUsec = dwOpenUsec;
+    latency.reenumerationMsec = dwReenumerationMsec;
+    GetSimBackend()->SetLatency(latency);
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CP210xSim_SetFaultRate(
+        const DWORD dwSimId,
+        const DWORD dwFault,
+        const DWORD dwPerMillion,
+        const DWORD dwParam
+        ) {
+    CSimFaultRate rate;
+
+    if (dwFault >= CP210xSim_NUM_FAULTS || dwPerMillion > 1000000) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    rate.perMillion = dwPerMillion;
+    rate.param = dwParam;
+    return GetSimBackend()->SetFaultRate(dwSimId, static_cast<BYTE>(dwFault), rate);
+}
+
+CP210x_STATUS CP210xSim_SetFaultScript(
+        const DWORD dwSimId,
+        LPCSTR lpszScript
+        ) {
+    std::vector<CSimFaultStep> steps;
+
+    if (!ParseFaultScript(lpszScript, steps)) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    return GetSimBackend()->SetFaultScript(dwSimId, steps);
+}
+
+CP210x_STATUS CP210xSim_GetFaultCount(
+        const DWORD dwSimId,
+        const DWORD dwFault,
+        LPDWORD lpdwCount
+        ) {
+    if (dwFault >= CP210xSim_NUM_FAULTS || !lpdwCount) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    return GetSimBackend()->GetFaultCount(dwSimId, static_cast<BYTE>(dwFault), lpdwCount);
+}
+
+CP210x_STATUS CP210xSim_SetClock(
+        CP210xSim_NOW_USEC pfnNowUsec,
+        CP210xSim_SLEEP_USEC pfnSleepUsec
+        ) {
+    if (!pfnNowUsec != !pfnSleepUsec) {
+        return CP210x_INVALID_PARAMETER;
+    }
+    SimClockNowUsec = pfnNowUsec;
+    SimClockSleepUsec = pfnSleepUsec;
+    return CP210x_SUCCESS;
+}
+
+CP210x_STATUS CP210xSim_SetFaultSeed(
+        const DWORD dwSeed
+        ) {
+    GetSimBackend()->SetFaultSeed(dwSeed);
+    return CP210x_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xTransport.cpp
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <vector>
+#include "CP210xTransport.h"
+#include "OsDep.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Global Variables
+/////////////////////////////////////////////////////////////////////////////
+
+static CCriticalSectionLock BackendLock;
+static CCP210xBackend* ActiveBackend;
+
+// Completions of the transfers the default SubmitControlTransfer() carried out
+// at once, run by the default HandleEvents(). The pipe is readable while any
+// is queued.
+struct CDeferredDone
+{
+    CCP210xTransferDone done;
+    void* context;
+    int result;
+};
+
+static CCriticalSectionLock DeferredLock;
+static std::vector<CDeferredDone> Deferred;
+static int DeferredPipe[2] = { -1, -1 };
+
+// The read end of the pipe, created on first use, -1 if it can't be.
+// DeferredLock must be held.
+static int DeferredPollFd()
+{
+    if (DeferredPipe[0] < 0 && pipe(DeferredPipe) == 0) {
+        for (int i = 0; i < 2; i++) {
+            fcntl(DeferredPipe[i], F_SETFL, O_NONBLOCK);
+            fcntl(DeferredPipe[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+    return DeferredPipe[0];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xTransport Class - Public Methods
+/////////////////////////////////////////////////////////////////////////////
+
+int CCP210xTransport::SubmitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout, CCP210xTransferDone done, void* context)
+{
+    CDeferredDone deferred;
+
+    deferred.done = done;
+    deferred.context = context;
+    deferred.result = ControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout);
+
+    DeferredLock.Lock();
+    if (Deferred.empty() && DeferredPollFd() >= 0) {
+        const char wake = 0;
+
+        if (write(DeferredPipe[1], &wake, 1) != 1) {
+            // Full, so readable already
+        }
+    }
+    Deferred.push_back(deferred);
+    DeferredLock.Unlock();
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xBackend Class - Static Methods
+/////////////////////////////////////////////////////////////////////////////
+
+// The backend is picked on first use: CP210X_BACKEND=sim selects simulated
+// devices, CP210X_BACKEND=replay a recorded session, anything else the real
+// USB stack. With CP210X_RECORD set, whichever is active gets recorded.
+CCP210xBackend* CCP210xBackend::Get()
+{
+    CCP210xBackend* backend;
+
+    BackendLock.Lock();
+    if (!ActiveBackend) {
+        const char* name = getenv("CP210X_BACKEND");
+
+        if (name && !strcmp(name, "sim")) {
+            ActiveBackend = GetCP210xSimBackend();
+        } else if (name && !strcmp(name, "replay")) {
+            ActiveBackend = GetCP210xReplayBackend();
+        } else {
+            ActiveBackend = GetCP210xLibusbBackend();
+        }
+    }
+    backend = GetCP210xRecordBackend(ActiveBackend);
+    BackendLock.Unlock();
+
+    return backend;
+}
+
+void CCP210xBackend::Select(CCP210xBackend* backend)
+{
+    BackendLock.Lock();
+    ActiveBackend = backend;
+    BackendLock.Unlock();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xBackend Class - Public Methods
+/////////////////////////////////////////////////////////////////////////////
+
+uint64_t CCP210xBackend::NowMsec()
+{
+    timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+void CCP210xBackend::Delay(DWORD msec)
+{
+    usleep(static_cast<useconds_t>(msec) * 1000);
+}
+
+int CCP210xBackend::GetPollFds(CP210x_POLLFD* fds, int count)
+{
+    DeferredLock.Lock();
+    const int fd = DeferredPollFd();
+    DeferredLock.Unlock();
+
+    if (fd < 0) {
+        return LIBUSB_ERROR_OTHER;
+    }
+    if (count > 0) {
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+    }
+    return 1;
+}
+
+// Runs the completions queued when it's called, those the completions queue
+// by submitting further transfers are left for the next call
+int CCP210xBackend::HandleEvents(DWORD timeoutMsec)
+{
+    std::vector<CDeferredDone> ready;
+    char drain[64];
+
+    DeferredLock.Lock();
+    const int fd = DeferredPollFd();
+    const bool idle = Deferred.empty();
+    DeferredLock.Unlock();
+
+    if (idle && timeoutMsec) {
+        pollfd pfd;
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        poll(&pfd, 1, static_cast<int>(timeoutMsec));
+    }
+
+    DeferredLock.Lock();
+    ready.swap(Deferred);
+    while (fd >= 0 && read(fd, drain, sizeof(drain)) > 0) {
+    }
+    DeferredLock.Unlock();
+
+    for (size_t i = 0; i < ready.size(); i++) {
+        ready[i].done(ready[i].context, ready[i].result);
+    }
+    return 0;
+}
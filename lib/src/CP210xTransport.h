@@ -0,0 +1,155 @@
+/////////////////////////////////////////////////////////////////////////////
+// CP210xTransport.h
+//
+// The seam between CCP210xDevice and the USB stack. A backend takes
+// snapshots of the bus (enumerations), an enumeration opens transports and
+// a transport carries the requests of one open device. All methods follow
+// the libusb conventions for return values (byte counts or LIBUSB_ERROR_*),
+// so the device classes don't care which backend they are talking to.
+//
+// Backends:
+//   libusb - real hardware (CP210xLibusbTransport.cpp), the default
+//   sim    - simulated devices (CP210xSimTransport.cpp), selected with
+//            CP210X_BACKEND=sim in the environment or CP210xSim_Enable()
+//   replay - a session log (CP210xReplayTransport.cpp), selected with
+//            CP210X_BACKEND=replay and CP210X_REPLAY=<file>
+//   record - wraps the active backend and logs its traffic
+//            (CP210xRecordTransport.cpp) while CP210X_RECORD=<file> is set
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CP210x_TRANSPORT_H
+#define CP210x_TRANSPORT_H
+
+/////////////////////////////////////////////////////////////////////////////
+// Includes
+/////////////////////////////////////////////////////////////////////////////
+
+#include <sys/types.h>
+#include "libusb.h"
+#include "CP210xManufacturing.h"
+#include "CP210xCapabilities.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xLocation Struct
+/////////////////////////////////////////////////////////////////////////////
+
+// USB 3 allows 7 tiers of hubs
+#define CP210x_MAX_PORT_DEPTH           7
+
+// Where a device is plugged in: its bus and the hub ports leading to it from
+// the root, as libusb_get_port_numbers() reports them. Unlike the device
+// address it survives resets and a re-enumeration under another VID/PID.
+struct CCP210xLocation
+{
+    int bus;
+    int depth;
+    uint8_t ports[CP210x_MAX_PORT_DEPTH];
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xTransport Class
+/////////////////////////////////////////////////////////////////////////////
+
+// Called from CCP210xBackend::HandleEvents() when an asynchronous control
+// transfer is done, with what ControlTransfer() would have returned
+typedef void (*CCP210xTransferDone)(void* context, int result);
+
+// An open device. Deleting the transport closes the device.
+class CCP210xTransport
+{
+public:
+    virtual ~CCP210xTransport() {}
+
+    virtual int ControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout) = 0;
+
+    // Starts the transfer and returns 0, or a LIBUSB_ERROR_* if it can't be
+    // started. data must stay valid until done() ran. By default the transfer
+    // is carried out by ControlTransfer() right away, only done() is deferred.
+    virtual int SubmitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char* data, uint16_t wLength, unsigned int timeout, CCP210xTransferDone done, void* context);
+    virtual int GetStringDescriptor(uint8_t descIndex, uint16_t langId, unsigned char* data, int length) = 0;
+    virtual int GetStringDescriptorAscii(uint8_t descIndex, unsigned char* data, int length) = 0;
+
+    // Descriptors as cached by the host at enumeration time
+    virtual int GetDeviceDescriptor(libusb_device_descriptor* desc) = 0;
+    virtual int GetConfigDescriptor(libusb_config_descriptor** config) = 0;
+    virtual void FreeConfigDescriptor(libusb_config_descriptor* config) = 0;
+
+    virtual int Reset() = 0;
+
+    // Location of the device on the bus, -1 if unknown
+    virtual int GetBusNumber() = 0;
+    virtual int GetDeviceAddress() = 0;
+};
+
+// Configuration descriptor in a single allocation, for backends that build
+// descriptors themselves instead of getting them from libusb. config comes
+// first, so the libusb_config_descriptor* handed out can be deleted as the
+// whole block. CP210x_MAX_INTERFACES comes with the part descriptors.
+#define CP210x_MAX_ENDPOINTS            4
+
+struct CCP210xConfigDescriptorBlock
+{
+    libusb_config_descriptor config;
+    libusb_interface interfaces[CP210x_MAX_INTERFACES];
+    libusb_interface_descriptor altsettings[CP210x_MAX_INTERFACES];
+    libusb_endpoint_descriptor endpoints[CP210x_MAX_INTERFACES][CP210x_MAX_ENDPOINTS];
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xEnumeration Class
+/////////////////////////////////////////////////////////////////////////////
+
+// A snapshot of the USB devices present at the time of Enumerate().
+// Deleting the enumeration releases the snapshot, transports opened from
+// it stay valid.
+class CCP210xEnumeration
+{
+public:
+    virtual ~CCP210xEnumeration() {}
+
+    virtual ssize_t GetCount() = 0;
+    virtual bool IsCandidate(ssize_t index) = 0;
+    virtual CP210x_STATUS Open(ssize_t index, CCP210xTransport** transport) = 0;
+
+    // Where the device is plugged in, without opening it
+    virtual int GetLocation(ssize_t index, CCP210xLocation* location) = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CCP210xBackend Class
+/////////////////////////////////////////////////////////////////////////////
+
+class CCP210xBackend
+{
+public:
+    virtual ~CCP210xBackend() {}
+
+    virtual CP210x_STATUS Enumerate(CCP210xEnumeration** enumeration) = 0;
+
+    // The clock the backend's devices keep time by, for waiting on them (e.g.
+    // to come back after a reset); the monotonic system clock by default
+    virtual uint64_t NowMsec();
+    virtual void Delay(DWORD msec);
+
+    // The events of the asynchronous transfers, for an application's own poll
+    // loop: the file descriptors to wait on, of which it fills at most count
+    // and returns how many there are, and the call that completes the transfers
+    // that are done, waiting up to timeoutMsec for one (libusb conventions).
+    // By default a pipe is readable while deferred completions are queued.
+    virtual int GetPollFds(CP210x_POLLFD* fds, int count);
+    virtual int HandleEvents(DWORD timeoutMsec);
+
+    // The backend all devices are enumerated with
+    static CCP210xBackend* Get();
+    static void Select(CCP210xBackend* backend);
+};
+
+CCP210xBackend* GetCP210xLibusbBackend();
+// Whether the libusb backend opens the devices of each bus in a context of its own
+void SetCP210xLibusbContextPerBus(bool bPerBus);
+CCP210xBackend* GetCP210xSimBackend();
+CCP210xBackend* GetCP210xReplayBackend();
+// Returns inner unless CP210X_RECORD is set
+CCP210xBackend* GetCP210xRecordBackend(CCP210xBackend* inner);
+
+#endif // CP210x_TRANSPORT_H
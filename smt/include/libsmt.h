@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////////////
+// libsmt.h
+//
+// The program/verify/lock orchestration of smt-cp210x as a library, for a
+// test executive driving it in process: a configuration is loaded once and
+// then run as batches against the devices on the bus, each reporting its
+// messages and the outcome of every step on every device through callbacks.
+// Batches run one at a time, whichever thread they are started from.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef LIBSMT_H
+#define LIBSMT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+	SMT_OK = 0,
+	SMT_USAGE_ERROR,	// the batch or the configuration asks for what the devices can't do
+	SMT_SYNTAX_ERROR,	// the configuration file doesn't parse
+	SMT_LIBRARY_ERROR,	// a libcp210x call failed
+	SMT_PROCESS_ERROR,	// the devices didn't go along: their count, a verification, ...
+	SMT_NO_MEMORY,
+	SMT_INTERNAL_ERROR	// anything else that went wrong
+} SMT_STATUS;
+
+typedef enum
+{
+	SMT_STEP_PROGRAM = 0,
+	SMT_STEP_VERIFY,
+	SMT_STEP_LOCK
+} SMT_STEP;
+
+// A loaded configuration file
+typedef struct SMT_CONFIG SMT_CONFIG;
+
+// The outcome of a step on a device, valid during the callback only
+typedef struct
+{
+	SMT_STEP	step;
+	const char*	location;	// where the device is plugged in, e.g. "1-4.2", "" if unknown
+	const char*	serialNumber;	// programmed, or read back by verify and lock
+	int		ok;
+	const char*	message;	// why it failed, "" if ok
+} SMT_DEVICE_RESULT;
+
+typedef void (*SMT_DEVICE_CALLBACK)(void* context, const SMT_DEVICE_RESULT* result);
+// a line smt-cp210x would print, to stderr if isError
+typedef void (*SMT_MESSAGE_CALLBACK)(void* context, int isError, const char* line);
+
+typedef struct
+{
+	unsigned int		deviceCount;	// the batch fails unless it finds that many devices
+	int			program;
+	int			verify;
+	int			verifyLocked;	// verify locked devices too, as --verify-locked-config
+	int			lock;		// after verify only
+	const char* const*	serialNumbers;	// deviceCount of them to program and verify, or NULL
+	int			generateSerialNumbers;	// program GUIDs instead, as --serial-nums GUID
+	unsigned int		verifyAttempts;	// 0 retries verification until it succeeds
+	SMT_DEVICE_CALLBACK	onDevice;	// may be NULL
+	SMT_MESSAGE_CALLBACK	onMessage;	// may be NULL
+	void*			context;	// passed to the callbacks
+	const char*		ports;		// the batch's ports, as --ports, or NULL for every port
+	unsigned int		maxOpen;	// devices open at once, as --max-open, 0 for no limit
+	int			contextPerBus;	// a libusb context per bus, as --context-per-bus
+} SMT_BATCH;
+
+/// @brief Loads and validates a configuration file, text or compiled (see --compile)
+/// @param fileName is the configuration file
+/// @param config points at a buffer into which the configuration will be written, to free with smt_free_config()
+/// @returns SMT_OK on success, the reason is in smt_last_error() otherwise
+SMT_STATUS smt_load_config(const char* fileName, SMT_CONFIG** config);
+
+void smt_free_config(SMT_CONFIG* config);
+
+/// @brief Runs the steps of the batch on the devices of the configuration's FilterPartNumByte
+/// and FilterVidPid, as smt-cp210x does with the equivalent command line
+/// @returns SMT_OK if every step succeeded on every device, the reason is in smt_last_error() otherwise
+SMT_STATUS smt_run_batch(const SMT_CONFIG* config, const SMT_BATCH* batch);
+
+/// @brief Copies the message of the last smt_load_config() or smt_run_batch() that failed,
+/// of any thread, NUL terminated and truncated to size bytes; waits for a running batch
+/// @param buf receives the message, may be NULL if size is 0
+/// @returns the length of the whole message, so a larger buf can be passed again
+unsigned int smt_last_error(char* buf, unsigned int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBSMT_H
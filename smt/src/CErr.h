@@ -29,12 +29,24 @@ public:
   CDllErr( const char *msg) : CErrMsg( msg) {}
 };
 
+class CFatalDllErr : public CDllErr // thrown when the DLL can't serve any further call, so retrying is pointless
+{
+public:
+  CFatalDllErr( const char *msg) : CDllErr( msg) {}
+};
+
 class CCustErr : public CErrMsg // thrown any time the customization process goes wrong
 {
 public:
   CCustErr( const char *msg) : CErrMsg( msg) {}
 };
 
+class CCancelErr : public CCustErr // thrown when smtd cancels the job, so retrying is pointless
+{
+public:
+  CCancelErr() : CCustErr( "cancelled, the client went away") {}
+};
+
 class CUsageErr {
 public:
   CUsageErr(std::string error_string) : mError(error_string) {}
@@ -22,6 +22,7 @@
 #else
 #include "OsDep.h"
 #include "CP210xManufacturing.h"
+#include "CP210xSim.h"
 #endif
 #include "stdio.h"
 #include "util.h"
@@ -39,6 +40,10 @@ void AbortOnErr( CP210x_STATUS status, std::string funcName)
     {
         char msg[ 128];
         sprintf( msg, /*SIZEOF_ARRAY( msg),*/ "%s returned 0x%x", funcName.c_str(), status);
+        if( status == CP210x_SESSION_ENDED)
+        {
+            throw CFatalDllErr( msg);
+        }
         throw CDllErr( msg);
     }
 }
@@ -50,16 +55,192 @@ DWORD LibSpecificNumDevices( const CVidPid &, const CVidPid &)
     AbortOnErr( CP210x_GetNumDevices( &DevCnt ), "CP210x_GetNumDevices");
     return DevCnt;
 }
+void LibSpecificSetPorts( const std::string &ports)
+{
+    const CP210x_STATUS status = CP210x_SetPortFilter( ports.c_str());
+    if( status == CP210x_INVALID_PARAMETER)
+    {
+        throw CUsageErr( "Invalid --ports pattern");
+    }
+    AbortOnErr( status, "CP210x_SetPortFilter");
+}
+void LibSpecificSetContextPerBus( bool perBus)
+{
+    AbortOnErr( CP210x_SetContextPerBus( perBus ? TRUE : FALSE), "CP210x_SetContextPerBus");
+}
+std::string LibSpecificLocation( HANDLE h)
+{
+    CP210x_LOCATION_STRING location;
+    const CP210x_STATUS status = CP210x_GetDeviceLocation( h, location);
+    if( status == CP210x_FUNCTION_NOT_SUPPORTED)
+    {
+        return std::string();
+    }
+    AbortOnErr( status, "CP210x_GetDeviceLocation");
+    return location;
+}
+HANDLE LibSpecificOpen( const std::string &location)
+{
+    HANDLE h;
+    const CP210x_STATUS status = CP210x_OpenByLocation( location.c_str(), &h);
+    if( status == CP210x_DEVICE_NOT_FOUND)
+    {
+        return NULL;
+    }
+    AbortOnErr( status, "CP210x_OpenByLocation");
+    return h;
+}
+bool LibSpecificFindLocations( const std::vector<std::string> &locations, std::vector<bool> &found)
+{
+    std::vector<LPCSTR> names;
+    for( size_t i = 0; i < locations.size(); i++)
+    {
+        names.push_back( locations[ i].c_str());
+    }
+    std::vector<BOOL> isFound( locations.size() + 1, FALSE);
+    if( CP210x_FindLocations( names.empty() ? NULL : &names[ 0], static_cast<DWORD>( names.size()), &isFound[ 0]) != CP210x_SUCCESS)
+    {
+        return false;
+    }
+    found.assign( isFound.begin(), isFound.begin() + locations.size());
+    return true;
+}
+void LibSpecificClose( HANDLE h)
+{
+    if( CP210x_Close( h) != CP210x_SUCCESS)
+    {
+        g_BusOut.warn( "CP210x_Close failed");
+    }
+}
+HANDLE LibSpecificOpenPlan( const CDevType &devType)
+{
+    HANDLE h;
+    AbortOnErr( CP210x_OpenPlan( devType.Value(), &h), "CP210x_OpenPlan");
+    return h;
+}
+void LibSpecificRunPlan( HANDLE plan, HANDLE h, const std::vector<BYTE> *pSerNum)
+{
+    BYTE *str = pSerNum ? const_cast<BYTE*>( pSerNum->data()) : NULL;
+    BYTE CchStr = pSerNum ? static_cast<BYTE>( pSerNum->size()) : 0;
+    AbortOnErr( CP210x_RunPlan( h, plan, str, CchStr, TRUE /*bConvertToUnicode*/), "CP210x_RunPlan");
+}
+std::vector<std::string> LibSpecificPlanTransfers( HANDLE plan, DWORD &bytes)
+{
+    DWORD count = 0;
+    AbortOnErr( CP210x_GetPlanTransfers( plan, NULL, &count), "CP210x_GetPlanTransfers");
+    std::vector<CP210x_PLAN_TRANSFER> transfers( count);
+    if( count)
+    {
+        AbortOnErr( CP210x_GetPlanTransfers( plan, &transfers[ 0], &count), "CP210x_GetPlanTransfers");
+    }
+    std::vector<std::string> lines;
+    for( DWORD i = 0; i < count; i++)
+    {
+        char line[ 64];
+        sprintf( line, "%02x %02x %04x %04x %u bytes", transfers[ i].bmRequestType, transfers[ i].bRequest,
+                 transfers[ i].wValue, transfers[ i].wIndex, transfers[ i].wLength);
+        lines.push_back( line);
+        bytes += transfers[ i].wLength;
+    }
+    return lines;
+}
+DWORD LibSpecificRequestCount( HANDLE h)
+{
+    DWORD count;
+    AbortOnErr( CP210x_GetRequestCount( h, &count), "CP210x_GetRequestCount");
+    return count;
+}
+//---------------------------------------------------------------------------------
+CBusSnapshot::CBusSnapshot()
+{
+    DWORD DevCnt;
+    AbortOnErr( CP210x_GetNumDevices( &DevCnt ), "CP210x_GetNumDevices");
+    try
+    {
+        for( DWORD i = 0; i < DevCnt; i++)
+        {
+            CBusDev dev;
+            AbortOnErr( CP210x_Open( i, &dev.h), "CP210x_Open");
+            m_Devs.push_back( dev);
+            AbortOnErr( CP210x_GetPartNumber( dev.h, &m_Devs.back().partNum), "CP210x_GetPartNumber");
+            AbortOnErr( CP210x_GetDeviceVid( dev.h, &m_Devs.back().vid), "CP210x_GetDeviceVid");
+            AbortOnErr( CP210x_GetDevicePid( dev.h, &m_Devs.back().pid), "CP210x_GetDevicePid");
+            const std::string location = LibSpecificLocation( dev.h);
+            if( !location.empty() && !m_PortLocks.lock( location))
+            {
+                g_BusOut.warn( "INFO: skipping the device at " + location + ", another process claimed it");
+                m_Devs.pop_back();
+                AbortOnErr( CP210x_Close( dev.h), "CP210x_Close");
+            }
+            else if( !location.empty() && g_HandlePool.enabled())
+            {
+                m_Devs.back().location = location;
+                m_Devs.back().h = NULL;
+                AbortOnErr( CP210x_Close( dev.h), "CP210x_Close");
+            }
+        }
+    }
+    catch( ...)
+    {
+        closeRest();
+        throw;
+    }
+}
+CBusSnapshot::~CBusSnapshot()
+{
+    closeRest();
+}
+HANDLE CBusSnapshot::take( DWORD i, const CDevType &devType, const CVidPid &vidPid)
+{
+    HANDLE h = NULL;
+    std::string location;
+    m_Lock.Lock();
+    CBusDev &dev = m_Devs.at( i);
+    if( ( dev.h || !dev.location.empty()) && dev.partNum == devType.Value() && dev.vid == vidPid.m_Vid && dev.pid == vidPid.m_Pid)
+    {
+        h = dev.h;
+        location = dev.location;
+        dev.h = NULL;
+        dev.location.clear();
+    }
+    m_Lock.Unlock();
+    if( h || location.empty())
+    {
+        return h;
+    }
+    g_HandlePool.reserve();
+    return LibSpecificOpen( location);
+}
+void CBusSnapshot::closeRest()
+{
+    m_Lock.Lock();
+    for( size_t i = 0; i < m_Devs.size(); i++)
+    {
+        if( m_Devs[ i].h && CP210x_Close( m_Devs[ i].h) != CP210x_SUCCESS)
+        {
+            g_BusOut.warn( "CP210x_Close failed");
+        }
+        m_Devs[ i].h = NULL;
+        m_Devs[ i].location.clear();
+    }
+    m_Lock.Unlock();
+}
 //---------------------------------------------------------------------------------
 class CCP210xDev
 {
 public:
     CCP210xDev( const CVidPid &FilterVidPid, DWORD devIndex);
+    CCP210xDev( HANDLE h); // takes over an open device
     ~CCP210xDev();
-    HANDLE            handle() const { return m_H; }
+    HANDLE            handle() const { return m_pSlot ? g_HandlePool.acquire( m_pSlot) : m_H; }
+    // where the device is plugged in, empty if the library can't tell
+    std::string       location() const { return m_pSlot ? CHandlePool::location( m_pSlot) : LibSpecificLocation( m_H); }
     bool              isLocked() const;
     void              lock() const;
+    static DWORD      lockRequests() { return 1; }
     void              reset() const;
+    // the device is open again, as found at its port, when it returns
+    void              resetAndReopen( DWORD timeoutMsec);
     CDevType          getDevType() const;
     CVidPid           getVidPid() const;
     BYTE              getPowerMode() const;
@@ -78,76 +259,139 @@ public:
     void              setManufacturer( const std::vector<BYTE> &str, bool isAscii) const;
     void              setProduct( const std::vector<BYTE> &str, bool isAscii) const;
 
-    HANDLE m_H;
+private:
+    void              pool();
+    HANDLE m_H;                     // unless the pool has the device
+    CHandlePool::CSlot *m_pSlot;
 };
-CCP210xDev::CCP210xDev( const CVidPid &, DWORD devIndex)
+CCP210xDev::CCP210xDev( const CVidPid &, DWORD devIndex) : m_pSlot( NULL)
 {
+    g_HandlePool.reserve();
     AbortOnErr( CP210x_Open( devIndex, &m_H), "CP210x_Open");
+    pool();
+}
+CCP210xDev::CCP210xDev( HANDLE h) : m_H( h), m_pSlot( NULL)
+{
+    pool();
+}
+// hands the device over to the handle pool if there is one and the location is known
+void CCP210xDev::pool()
+{
+    if( !g_HandlePool.enabled())
+    {
+        return;
+    }
+    const std::string location = LibSpecificLocation( m_H);
+    if( !location.empty())
+    {
+        m_pSlot = g_HandlePool.add( location, m_H);
+        m_H = NULL;
+    }
 }
 CCP210xDev::~CCP210xDev()
 {
+    if( m_pSlot)
+    {
+        g_HandlePool.remove( m_pSlot);
+        return;
+    }
+    if( !m_H)
+    {
+        return; // lost in resetAndReopen()
+    }
     CP210x_STATUS status = CP210x_Close( m_H);
     if( status != CP210x_SUCCESS)
     {
-        std::cerr << "CP210x_Close failed\n";
+        g_BusOut.warn( "CP210x_Close failed");
     }
 }
 bool CCP210xDev::isLocked() const
 {
+    // a part without a lock value, the CP2101, is never locked
+    CP210x_CAPABILITIES caps;
+    AbortOnErr( CP210x_GetCapabilities( getDevType().Value(), &caps), "CP210x_GetCapabilities");
+    if( !(caps.Operations & CP210x_CAP_LOCK_VALUE))
+    {
+        return false;
+    }
     BYTE lock;
-    AbortOnErr( CP210x_GetLockValue( m_H, &lock), "CP210x_GetLockValue");
+    AbortOnErr( CP210x_GetLockValue( handle(), &lock), "CP210x_GetLockValue");
     return lock != 0;
 }
 void CCP210xDev::lock() const
 {
-    AbortOnErr( CP210x_SetLockValue( m_H), "CP210x_SetLockValue");
+    AbortOnErr( CP210x_SetLockValue( handle()), "CP210x_SetLockValue");
 }
 void  CCP210xDev::reset() const
 {
-    AbortOnErr( CP210x_Reset( m_H), "CP210x_Reset");
+    AbortOnErr( CP210x_Reset( handle()), "CP210x_Reset");
+}
+void  CCP210xDev::resetAndReopen( DWORD timeoutMsec)
+{
+    const std::string location = this->location();
+    HANDLE h = NULL;
+    const CP210x_STATUS status = CP210x_ResetAndReopen( handle(), timeoutMsec, &h);
+    if( status != CP210x_INVALID_PARAMETER && status != CP210x_FUNCTION_NOT_SUPPORTED)
+    {
+        // the old handle is closed
+        if( m_pSlot)
+        {
+            g_HandlePool.replace( m_pSlot, h);
+        }
+        else
+        {
+            m_H = h;
+        }
+    }
+    if( status == CP210x_DEVICE_NOT_FOUND)
+    {
+        const std::string msg = "the device at " + location + " didn't come back from its reset";
+        throw CCustErr( msg.c_str());
+    }
+    AbortOnErr( status, "CP210x_ResetAndReopen");
 }
 CDevType CCP210xDev::getDevType() const
 {
     BYTE partNum;
-    AbortOnErr( CP210x_GetPartNumber( m_H, &partNum ), "CP210x_GetPartNumber");
+    AbortOnErr( CP210x_GetPartNumber( handle(), &partNum ), "CP210x_GetPartNumber");
     return CDevType( partNum);
 }
 CVidPid CCP210xDev::getVidPid() const
 {
     WORD vid, pid;
-    AbortOnErr( CP210x_GetDeviceVid( m_H, &vid ), "CP210x_GetDeviceVid");
-    AbortOnErr( CP210x_GetDevicePid( m_H, &pid ), "CP210x_GetDevicePid");
+    AbortOnErr( CP210x_GetDeviceVid( handle(), &vid ), "CP210x_GetDeviceVid");
+    AbortOnErr( CP210x_GetDevicePid( handle(), &pid ), "CP210x_GetDevicePid");
     return CVidPid( vid, pid);
 }
 BYTE CCP210xDev::getPowerMode() const
 {
     BOOL SelfPower;
-    AbortOnErr( CP210x_GetSelfPower( m_H, &SelfPower), "CP210x_GetSelfPower");
+    AbortOnErr( CP210x_GetSelfPower( handle(), &SelfPower), "CP210x_GetSelfPower");
     return SelfPower ? 1 : 0;
 }
 BYTE CCP210xDev::getMaxPower() const
 {
     BYTE MaxPower;
-    AbortOnErr( CP210x_GetMaxPower( m_H, &MaxPower), "CP210x_GetMaxPower");
+    AbortOnErr( CP210x_GetMaxPower( handle(), &MaxPower), "CP210x_GetMaxPower");
     return MaxPower;
 }
 WORD CCP210xDev::getDevVer() const
 {
     WORD devVer;
-    AbortOnErr( CP210x_GetDeviceVersion( m_H, &devVer), "CP210x_GetDeviceVersion");
+    AbortOnErr( CP210x_GetDeviceVersion( handle(), &devVer), "CP210x_GetDeviceVersion");
     return devVer;
 }
 WORD CCP210xDev::getFlushBufCfg() const
 {
     WORD flushBufCfg;
-    AbortOnErr( CP210x_GetFlushBufferConfig( m_H, &flushBufCfg), "CP210x_GetFlushBufferConfig");
+    AbortOnErr( CP210x_GetFlushBufferConfig( handle(), &flushBufCfg), "CP210x_GetFlushBufferConfig");
     return flushBufCfg;
 }
 std::vector<BYTE> CCP210xDev::getSerNum( bool isAscii) const
 {
     std::vector<BYTE> str( MAX_UCHAR);
     BYTE CchStr = 0;
-    AbortOnErr( CP210x_GetDeviceSerialNumber( m_H, str.data(), &CchStr, isAscii), "CP210x_GetDeviceSerialNumber");
+    AbortOnErr( CP210x_GetDeviceSerialNumber( handle(), str.data(), &CchStr, isAscii), "CP210x_GetDeviceSerialNumber");
     str.resize( CchStr * (isAscii ? 1 : 2));
     return str;
 }
@@ -155,7 +399,7 @@ std::vector<BYTE> CCP210xDev::getManufacturer( bool isAscii) const
 {
     std::vector<BYTE> str( MAX_UCHAR);
     BYTE CchStr = 0;
-    AbortOnErr( CP210x_GetDeviceManufacturerString( m_H, str.data(), &CchStr, isAscii), "CP210x_GetDeviceManufacturerString");
+    AbortOnErr( CP210x_GetDeviceManufacturerString( handle(), str.data(), &CchStr, isAscii), "CP210x_GetDeviceManufacturerString");
     str.resize( CchStr * (isAscii ? 1 : 2));
     return str;
 }
@@ -163,45 +407,45 @@ std::vector<BYTE> CCP210xDev::getProduct( bool isAscii) const
 {
     std::vector<BYTE> str( MAX_UCHAR);
     BYTE CchStr = 0;
-    AbortOnErr( CP210x_GetDeviceProductString( m_H, str.data(), &CchStr, isAscii), "CP210x_GetDeviceProductString");
+    AbortOnErr( CP210x_GetDeviceProductString( handle(), str.data(), &CchStr, isAscii), "CP210x_GetDeviceProductString");
     str.resize( CchStr * (isAscii ? 1 : 2));
     return str;
 }
 void CCP210xDev::setVidPid( WORD vid, WORD pid) const
 {
-    AbortOnErr( CP210x_SetVid( m_H, vid), "CP210x_SetVid");
-    AbortOnErr( CP210x_SetPid( m_H, pid), "CP210x_SetPid");
+    AbortOnErr( CP210x_SetVid( handle(), vid), "CP210x_SetVid");
+    AbortOnErr( CP210x_SetPid( handle(), pid), "CP210x_SetPid");
 }
 void CCP210xDev::setPowerMode( BYTE val) const
 {
-    AbortOnErr( CP210x_SetSelfPower( m_H, val ? TRUE : FALSE ), "CP210x_SetSelfPower");
+    AbortOnErr( CP210x_SetSelfPower( handle(), val ? TRUE : FALSE ), "CP210x_SetSelfPower");
 }
 void CCP210xDev::setMaxPower( BYTE val) const
 {
-    AbortOnErr( CP210x_SetMaxPower( m_H, val), "CP210x_SetMaxPower");
+    AbortOnErr( CP210x_SetMaxPower( handle(), val), "CP210x_SetMaxPower");
 }
 void CCP210xDev::setDevVer( WORD val) const
 {
-    AbortOnErr( CP210x_SetDeviceVersion( m_H, val), "CP210x_SetDeviceVersion");
+    AbortOnErr( CP210x_SetDeviceVersion( handle(), val), "CP210x_SetDeviceVersion");
 }
 void CCP210xDev::setFlushBufCfg( WORD val) const
 {
-    AbortOnErr( CP210x_SetFlushBufferConfig( m_H, val), "CP210x_SetFlushBufferConfig");
+    AbortOnErr( CP210x_SetFlushBufferConfig( handle(), val), "CP210x_SetFlushBufferConfig");
 }
 void CCP210xDev::setSerNum( const std::vector<BYTE> &str, bool isAscii) const
 {
     BYTE CchStr = static_cast<BYTE> ( str.size() / (isAscii ? 1 : 2));
-    AbortOnErr( CP210x_SetSerialNumber( m_H, const_cast<BYTE*>( str.data()), CchStr, isAscii), "CP210x_SetSerialNumber");
+    AbortOnErr( CP210x_SetSerialNumber( handle(), const_cast<BYTE*>( str.data()), CchStr, isAscii), "CP210x_SetSerialNumber");
 }
 void CCP210xDev::setManufacturer( const std::vector<BYTE> &str, bool isAscii) const
 {
     BYTE CchStr = static_cast<BYTE> ( str.size() / (isAscii ? 1 : 2));
-    AbortOnErr( CP210x_SetManufacturerString( m_H, const_cast<BYTE*>( str.data()), CchStr, isAscii), "CP210x_SetManufacturerString");
+    AbortOnErr( CP210x_SetManufacturerString( handle(), const_cast<BYTE*>( str.data()), CchStr, isAscii), "CP210x_SetManufacturerString");
 }
 void CCP210xDev::setProduct( const std::vector<BYTE> &str, bool isAscii) const
 {
     BYTE CchStr = static_cast<BYTE> ( str.size() / (isAscii ? 1 : 2));
-    AbortOnErr( CP210x_SetProductString( m_H, const_cast<BYTE*>( str.data()), CchStr, isAscii), "CP210x_SetProductString");
+    AbortOnErr( CP210x_SetProductString( handle(), const_cast<BYTE*>( str.data()), CchStr, isAscii), "CP210x_SetProductString");
 }
 
 //---------------------------------------------------------------------------------
@@ -234,8 +478,11 @@ class CCP2102NDev : public CCP210xDev
 {
 public:
     CCP2102NDev( const CVidPid &FilterVidPid, DWORD devIndex) : CCP210xDev( FilterVidPid, devIndex) {}
+    CCP2102NDev( HANDLE h) : CCP210xDev( h) {}
     bool              isLocked() const;
     void              lock() const;
+    // reads the Config, writes it back locked and reads it again to check
+    static DWORD      lockRequests() { return 3; }
     void              setSerNum( const std::vector<BYTE> &str, bool isAscii) const;
 
 };
@@ -243,7 +490,7 @@ public:
 bool CCP2102NDev::isLocked() const
 {
     CCP2102NConfig Config = {0};
-    AbortOnErr( CP210x_GetConfig( m_H, &Config.Raw[0], static_cast<WORD>( sizeof( Config))), "CP210x_GetConfig");
+    AbortOnErr( CP210x_GetConfig( handle(), &Config.Raw[0], static_cast<WORD>( sizeof( Config))), "CP210x_GetConfig");
     if( Config.Fields.configVersion != CP2102N_CONFIG_VERSION)
     {
         throw CCustErr( "CP2102N returned unknown config version");
@@ -257,12 +504,12 @@ bool CCP2102NDev::isLocked() const
 void CCP2102NDev::lock() const
 {
     CCP2102NConfig Config;
-    AbortOnErr( CP210x_GetConfig( m_H, &Config.Raw[0], static_cast<WORD>( sizeof( Config))), "CP210x_GetConfig");
+    AbortOnErr( CP210x_GetConfig( handle(), &Config.Raw[0], static_cast<WORD>( sizeof( Config))), "CP210x_GetConfig");
     Config.Fields.enableConfigUpdate = 0;
-    AbortOnErr( CP210x_SetConfig( m_H, &Config.Raw[0], static_cast<WORD>( sizeof( Config))), "CP210x_SetConfig");
+    AbortOnErr( CP210x_SetConfig( handle(), &Config.Raw[0], static_cast<WORD>( sizeof( Config))), "CP210x_SetConfig");
 
     CCP2102NConfig finalConfig;
-    AbortOnErr( CP210x_GetConfig( m_H, &finalConfig.Raw[0], static_cast<WORD>( sizeof( finalConfig))), "CP210x_GetConfig");
+    AbortOnErr( CP210x_GetConfig( handle(), &finalConfig.Raw[0], static_cast<WORD>( sizeof( finalConfig))), "CP210x_GetConfig");
     if( memcmp( &Config.Raw[0], &finalConfig.Raw[0], sizeof( finalConfig)))
     {
         throw CCustErr( "CP2102N config verification failed after locking");
@@ -281,12 +528,25 @@ void CCP2102NDev::setSerNum( const std::vector<BYTE> &str, bool isAscii) const
 // Here is a bunch of customization parametersfound in cp210x devices. They are included
 // into each individual cp210x device that supports the parameter.
 //---------------------------------------------------------------------------------
+// Throws if the device type lacks the CP210x_CAP_* operation parmName needs
+void validateOperation( const std::string &parmName, const CP210x_CAPABILITIES &caps, DWORD operation)
+{
+    if( !(caps.Operations & operation))
+    {
+        throw CUsageErr( parmName + " isn't supported by the device type");
+    }
+}
 struct CFlushBufferConfig
 {
     CFlushBufferConfig() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "FlushBufferConfig"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const { w.putUshort( m_Config); }
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_FLUSH_BUFFER_CONFIG); }
 private:
     bool m_Specified;
     WORD m_Config;
@@ -304,24 +564,24 @@ bool CFlushBufferConfig::readParm( const std::string &parmName)
 }
 void CFlushBufferConfig::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     dev.setFlushBufCfg( m_Config);
 }
-void CFlushBufferConfig::verify( const CCP210xDev &dev) const
+void CFlushBufferConfig::readBack( const CCP210xDev &dev)
 {
-    if( !m_Specified) { return; }
-    if( m_Config != dev.getFlushBufCfg())
-    {
-        throw CCustErr( "Failed FlushBufferConfig verification");
-    }
+    m_Config = dev.getFlushBufCfg();
 }
 //---------------------------------------------------------------------------------
 struct CDeviceMode
 {
     CDeviceMode() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "DeviceMode"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const { w.putUchar( m_ModeECI); w.putUchar( m_ModeSCI); }
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_DEVICE_MODE); }
 private:
     bool m_Specified;
     BYTE m_ModeECI;
@@ -341,35 +601,38 @@ bool CDeviceMode::readParm( const std::string &parmName)
 }
 void CDeviceMode::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     AbortOnErr( CP210x_SetDeviceMode( dev.handle(), m_ModeECI, m_ModeSCI), "CP210x_SetDeviceMode");
 }
-void CDeviceMode::verify( const CCP210xDev &dev) const
+void CDeviceMode::readBack( const CCP210xDev &dev)
 {
-    if( !m_Specified) { return; }
-    BYTE ModeECI;
-    BYTE ModeSCI;
-    AbortOnErr( CP210x_GetDeviceMode( dev.handle(), &ModeECI, &ModeSCI), "CP210x_GetDeviceMode");
-    if( m_ModeECI != ModeECI || m_ModeSCI != ModeSCI)
-    {
-        throw CCustErr( "Failed DeviceMode verification");
-    }
+    AbortOnErr( CP210x_GetDeviceMode( dev.handle(), &m_ModeECI, &m_ModeSCI), "CP210x_GetDeviceMode");
 }
 //---------------------------------------------------------------------------------
+// the string of interface TIfc
+template< BYTE TIfc >
 struct CInterfaceString
 {
     CInterfaceString() { m_Specified  = false; }
-    bool readParm( BYTE ifc, const std::string &parmName);
-    void program( BYTE ifc, const CCP210xDev &dev) const;
-    void verify( BYTE ifc, const CCP210xDev &dev) const;
+    bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const
+    {
+        return std::string( m_IsAscii ? "InterfaceStringAscii" : "InterfaceStringUnicode") + static_cast<char>( '0' + TIfc);
+    }
+    void program( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const { w.putBytes( m_str); }
+    void validate( const CP210x_CAPABILITIES &caps) const;
 private:
     bool m_Specified;
     bool m_IsAscii;
     std::vector<BYTE>  m_str;
 };
-bool CInterfaceString::readParm( BYTE ifc, const std::string &parmName)
+template< BYTE TIfc >
+bool CInterfaceString<TIfc>::readParm( const std::string &parmName)
 {
-    char ifcDigit = '0' + ifc;
+    char ifcDigit = '0' + TIfc;
     if( parmName == std::string( "InterfaceStringAscii") + ifcDigit)
     {
         setSpecified( m_Specified, parmName);
@@ -388,31 +651,42 @@ bool CInterfaceString::readParm( BYTE ifc, const std::string &parmName)
     }
     return false;
 }
-void CInterfaceString::program( BYTE ifc, const CCP210xDev &dev) const
+template< BYTE TIfc >
+void CInterfaceString<TIfc>::validate( const CP210x_CAPABILITIES &caps) const
+{
+    validateOperation( keyword(), caps, CP210x_CAP_INTERFACE_STRING);
+    if( TIfc >= caps.NumInterfaces)
+    {
+        throw CUsageErr( keyword() + ": the device type has no such interface");
+    }
+    validateStrLen( keyword(), m_str, m_IsAscii, caps.MaxInterfaceStrLen);
+}
+template< BYTE TIfc >
+void CInterfaceString<TIfc>::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     BYTE CchStr = static_cast<BYTE> ( m_str.size() / (m_IsAscii ? 1 : 2));
-    AbortOnErr( CP210x_SetInterfaceString( dev.handle(), ifc, const_cast<BYTE*>( m_str.data()), CchStr, m_IsAscii), "CP210x_SetInterfaceString");
+    AbortOnErr( CP210x_SetInterfaceString( dev.handle(), TIfc, const_cast<BYTE*>( m_str.data()), CchStr, m_IsAscii), "CP210x_SetInterfaceString");
 }
-void CInterfaceString::verify( BYTE ifc, const CCP210xDev &dev) const
+template< BYTE TIfc >
+void CInterfaceString<TIfc>::readBack( const CCP210xDev &dev)
 {
-    if( !m_Specified) { return; }
-    std::vector<BYTE> str( MAX_UCHAR);
     BYTE CchStr = 0;
-    AbortOnErr( CP210x_GetDeviceInterfaceString( dev.handle(), ifc, str.data(), &CchStr, m_IsAscii), "CP210x_GetDeviceInterfaceString");
-    str.resize( CchStr * (m_IsAscii ? 1 : 2));
-    if( m_str != str)
-    {
-        throw CCustErr( "Failed InterfaceString verification");
-    }
+    m_str.resize( MAX_UCHAR);
+    AbortOnErr( CP210x_GetDeviceInterfaceString( dev.handle(), TIfc, m_str.data(), &CchStr, m_IsAscii), "CP210x_GetDeviceInterfaceString");
+    m_str.resize( CchStr * (m_IsAscii ? 1 : 2));
 }
 //---------------------------------------------------------------------------------
 struct CBaudRateConfig
 {
     CBaudRateConfig() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "BaudRateConfig"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const;
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_BAUD_RATE_CONFIG); }
 private:
     bool m_Specified;
     BAUD_CONFIG m_Config[ NUM_BAUD_CONFIGS];
@@ -438,24 +712,21 @@ bool CBaudRateConfig::readParm( const std::string &parmName)
 }
 void CBaudRateConfig::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     AbortOnErr( CP210x_SetBaudRateConfig( dev.handle(), const_cast<BAUD_CONFIG*>(&m_Config[ 0])), "CP210x_SetBaudRateConfig");
 }
-void CBaudRateConfig::verify( const CCP210xDev &dev) const
+void CBaudRateConfig::readBack( const CCP210xDev &dev)
+{
+    AbortOnErr( CP210x_GetBaudRateConfig( dev.handle(), &m_Config[ 0]), "CP210x_GetBaudRateConfig");
+}
+template< class TWriter >
+void CBaudRateConfig::save( TWriter &w) const
 {
-    if( !m_Specified) { return; }
-    BAUD_CONFIG Config[ NUM_BAUD_CONFIGS];
-    AbortOnErr( CP210x_GetBaudRateConfig( dev.handle(), &Config[ 0]), "CP210x_GetBaudRateConfig");
     for( DWORD i = 0; i < SIZEOF_ARRAY( m_Config); i++)
     {
-// printf("verify %d\n", Config[ i].BaudRate); // TODO remove
-        if( m_Config[ i].BaudGen       != Config[ i].BaudGen ||
-            m_Config[ i].Timer0Reload  != Config[ i].Timer0Reload ||
-            m_Config[ i].Prescaler     != Config[ i].Prescaler ||
-            m_Config[ i].BaudRate      != Config[ i].BaudRate)
-        {
-            throw CCustErr( "Failed BaudRateConfig verification");
-        }
+        w.putUshort( m_Config[ i].BaudGen);
+        w.putUshort( m_Config[ i].Timer0Reload);
+        w.putUchar( m_Config[ i].Prescaler);
+        w.putUlong( m_Config[ i].BaudRate);
     }
 }
 //---------------------------------------------------------------------------------
@@ -463,8 +734,13 @@ struct CPortConfig
 {
     CPortConfig() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "PortConfig"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const;
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_PORT_CONFIG); }
 private:
     bool m_Specified;
     PORT_CONFIG m_PortCfg;
@@ -487,29 +763,32 @@ bool CPortConfig::readParm( const std::string &parmName)
 }
 void CPortConfig::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     AbortOnErr( CP210x_SetPortConfig( dev.handle(), const_cast<PORT_CONFIG*>(&m_PortCfg)), "CP210x_SetPortConfig");
 }
-void CPortConfig::verify( const CCP210xDev &dev) const
+void CPortConfig::readBack( const CCP210xDev &dev)
 {
-    if( !m_Specified) { return; }
-    PORT_CONFIG PortCfg;
-    AbortOnErr( CP210x_GetPortConfig( dev.handle(), &PortCfg), "CP210x_GetPortConfig");
-    if( m_PortCfg.Mode          != PortCfg.Mode ||
-        m_PortCfg.Reset_Latch   != PortCfg.Reset_Latch ||
-        m_PortCfg.Suspend_Latch != PortCfg.Suspend_Latch ||
-        m_PortCfg.EnhancedFxn   != PortCfg.EnhancedFxn)
-    {
-        throw CCustErr( "Failed PortConfig verification");
-    }
+    AbortOnErr( CP210x_GetPortConfig( dev.handle(), &m_PortCfg), "CP210x_GetPortConfig");
+}
+template< class TWriter >
+void CPortConfig::save( TWriter &w) const
+{
+    w.putUshort( m_PortCfg.Mode);
+    w.putUshort( m_PortCfg.Reset_Latch);
+    w.putUshort( m_PortCfg.Suspend_Latch);
+    w.putUchar( m_PortCfg.EnhancedFxn);
 }
 //---------------------------------------------------------------------------------
 struct CDualPortConfig
 {
     CDualPortConfig() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "DualPortConfig"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const;
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_DUAL_PORT_CONFIG); }
 private:
     bool m_Specified;
     DUAL_PORT_CONFIG m_PortCfg;
@@ -534,31 +813,34 @@ bool CDualPortConfig::readParm( const std::string &parmName)
 }
 void CDualPortConfig::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     AbortOnErr( CP210x_SetDualPortConfig( dev.handle(), const_cast<DUAL_PORT_CONFIG*>(&m_PortCfg)), "CP210x_SetDualPortConfig");
 }
-void CDualPortConfig::verify( const CCP210xDev &dev) const
-{
-    if( !m_Specified) { return; }
-    DUAL_PORT_CONFIG PortCfg;
-    AbortOnErr( CP210x_GetDualPortConfig( dev.handle(), &PortCfg), "CP210x_GetDualPortConfig");
-    if( m_PortCfg.Mode               != PortCfg.Mode ||
-        m_PortCfg.Reset_Latch        != PortCfg.Reset_Latch ||
-        m_PortCfg.Suspend_Latch      != PortCfg.Suspend_Latch ||
-        m_PortCfg.EnhancedFxn_ECI    != PortCfg.EnhancedFxn_ECI ||
-        m_PortCfg.EnhancedFxn_SCI    != PortCfg.EnhancedFxn_SCI ||
-        m_PortCfg.EnhancedFxn_Device != PortCfg.EnhancedFxn_Device)
-    {
-        throw CCustErr( "Failed DualPortConfig verification");
-    }
+void CDualPortConfig::readBack( const CCP210xDev &dev)
+{
+    AbortOnErr( CP210x_GetDualPortConfig( dev.handle(), &m_PortCfg), "CP210x_GetDualPortConfig");
+}
+template< class TWriter >
+void CDualPortConfig::save( TWriter &w) const
+{
+    w.putUshort( m_PortCfg.Mode);
+    w.putUshort( m_PortCfg.Reset_Latch);
+    w.putUshort( m_PortCfg.Suspend_Latch);
+    w.putUchar( m_PortCfg.EnhancedFxn_ECI);
+    w.putUchar( m_PortCfg.EnhancedFxn_SCI);
+    w.putUchar( m_PortCfg.EnhancedFxn_Device);
 }
 //---------------------------------------------------------------------------------
 struct CQuadPortConfig
 {
     CQuadPortConfig() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "QuadPortConfig"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const;
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_QUAD_PORT_CONFIG); }
 private:
     bool m_Specified;
     QUAD_PORT_CONFIG m_PortCfg;
@@ -610,67 +892,70 @@ bool CQuadPortConfig::readParm( const std::string &parmName)
 }
 void CQuadPortConfig::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     AbortOnErr( CP210x_SetQuadPortConfig( dev.handle(), const_cast<QUAD_PORT_CONFIG*>(&m_PortCfg)), "CP210x_SetQuadPortConfig");
 }
-bool isEqualQuadPortState( const QUAD_PORT_STATE &qps1, const QUAD_PORT_STATE &qps2)
-{
-    if( qps1.Mode_PB0     != qps2.Mode_PB0     ||
-        qps1.Mode_PB1     != qps2.Mode_PB1     ||
-        qps1.Mode_PB2     != qps2.Mode_PB2     ||
-        qps1.Mode_PB3     != qps2.Mode_PB3     ||
-        qps1.Mode_PB4     != qps2.Mode_PB4     ||
-        qps1.LowPower_PB0 != qps2.LowPower_PB0 ||
-        qps1.LowPower_PB1 != qps2.LowPower_PB1 ||
-        qps1.LowPower_PB2 != qps2.LowPower_PB2 ||
-        qps1.LowPower_PB3 != qps2.LowPower_PB3 ||
-        qps1.LowPower_PB4 != qps2.LowPower_PB4 ||
-        qps1.Latch_PB0    != qps2.Latch_PB0    ||
-        qps1.Latch_PB1    != qps2.Latch_PB1    ||
-        qps1.Latch_PB2    != qps2.Latch_PB2    ||
-        qps1.Latch_PB3    != qps2.Latch_PB3    ||
-        qps1.Latch_PB4    != qps2.Latch_PB4)
-    {
-        return false;
-    }
-    return true;
-}
-void CQuadPortConfig::verify( const CCP210xDev &dev) const
-{
-    if( !m_Specified) { return; }
-    QUAD_PORT_CONFIG PortCfg;
-    AbortOnErr( CP210x_GetQuadPortConfig( dev.handle(), &PortCfg), "CP210x_GetQuadPortConfig");
-    if( !isEqualQuadPortState( m_PortCfg.Reset_Latch, PortCfg.Reset_Latch ) ||
-        !isEqualQuadPortState( m_PortCfg.Suspend_Latch, PortCfg.Suspend_Latch ) ||
-        m_PortCfg.IPDelay_IFC0        != PortCfg.IPDelay_IFC0       ||
-        m_PortCfg.IPDelay_IFC1        != PortCfg.IPDelay_IFC1       ||
-        m_PortCfg.IPDelay_IFC2        != PortCfg.IPDelay_IFC2       ||
-        m_PortCfg.IPDelay_IFC3        != PortCfg.IPDelay_IFC3       ||
-        m_PortCfg.EnhancedFxn_IFC0    != PortCfg.EnhancedFxn_IFC0   ||
-        m_PortCfg.EnhancedFxn_IFC1    != PortCfg.EnhancedFxn_IFC1   ||
-        m_PortCfg.EnhancedFxn_IFC2    != PortCfg.EnhancedFxn_IFC2   ||
-        m_PortCfg.EnhancedFxn_IFC3    != PortCfg.EnhancedFxn_IFC3   ||
-        m_PortCfg.EnhancedFxn_Device  != PortCfg.EnhancedFxn_Device ||
-        m_PortCfg.ExtClk0Freq         != PortCfg.ExtClk0Freq        ||
-        m_PortCfg.ExtClk1Freq         != PortCfg.ExtClk1Freq        ||
-        m_PortCfg.ExtClk2Freq         != PortCfg.ExtClk2Freq        ||
-        m_PortCfg.ExtClk3Freq         != PortCfg.ExtClk3Freq)
-    {
-        throw CCustErr( "Failed QuadPortConfig verification");
-    }
+void CQuadPortConfig::readBack( const CCP210xDev &dev)
+{
+    AbortOnErr( CP210x_GetQuadPortConfig( dev.handle(), &m_PortCfg), "CP210x_GetQuadPortConfig");
+}
+template< class TWriter >
+void saveQuadPortState( const QUAD_PORT_STATE &qps, TWriter &w)
+{
+    w.putUshort( qps.Mode_PB0);
+    w.putUshort( qps.Mode_PB1);
+    w.putUshort( qps.Mode_PB2);
+    w.putUshort( qps.Mode_PB3);
+    w.putUshort( qps.Mode_PB4);
+    w.putUshort( qps.LowPower_PB0);
+    w.putUshort( qps.LowPower_PB1);
+    w.putUshort( qps.LowPower_PB2);
+    w.putUshort( qps.LowPower_PB3);
+    w.putUshort( qps.LowPower_PB4);
+    w.putUshort( qps.Latch_PB0);
+    w.putUshort( qps.Latch_PB1);
+    w.putUshort( qps.Latch_PB2);
+    w.putUshort( qps.Latch_PB3);
+    w.putUshort( qps.Latch_PB4);
+}
+template< class TWriter >
+void CQuadPortConfig::save( TWriter &w) const
+{
+    saveQuadPortState( m_PortCfg.Reset_Latch, w);
+    saveQuadPortState( m_PortCfg.Suspend_Latch, w);
+    w.putUchar( m_PortCfg.IPDelay_IFC0);
+    w.putUchar( m_PortCfg.IPDelay_IFC1);
+    w.putUchar( m_PortCfg.IPDelay_IFC2);
+    w.putUchar( m_PortCfg.IPDelay_IFC3);
+    w.putUchar( m_PortCfg.EnhancedFxn_IFC0);
+    w.putUchar( m_PortCfg.EnhancedFxn_IFC1);
+    w.putUchar( m_PortCfg.EnhancedFxn_IFC2);
+    w.putUchar( m_PortCfg.EnhancedFxn_IFC3);
+    w.putUchar( m_PortCfg.EnhancedFxn_Device);
+    w.putUchar( m_PortCfg.ExtClk0Freq);
+    w.putUchar( m_PortCfg.ExtClk1Freq);
+    w.putUchar( m_PortCfg.ExtClk2Freq);
+    w.putUchar( m_PortCfg.ExtClk3Freq);
 }
 //---------------------------------------------------------------------------------
 struct CConfig
 {
     CConfig() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "Config"; }
     void program( const CCP210xDev &dev) const;
-    void verify( const CCP210xDev &dev) const;
+    void readBack( const CCP210xDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const
+    {
+        w.putBytes( std::vector<BYTE>( &m_Config.Raw[0], &m_Config.Raw[0] + sizeof( m_Config.Raw)));
+    }
+    void validate( const CP210x_CAPABILITIES &caps) const { validateOperation( keyword(), caps, CP210x_CAP_CONFIG); }
 private:
     bool m_Specified;
     CCP2102NConfig m_Config;
 
-  friend class CCP2102NParms;
+  friend struct CCP2102NParms;
 };
 bool CConfig::readParm( const std::string &parmName)
 {
@@ -706,146 +991,98 @@ bool CConfig::readParm( const std::string &parmName)
 }
 void CConfig::program( const CCP210xDev &dev) const
 {
-    if( !m_Specified) { return; }
     AbortOnErr( CP210x_SetConfig( dev.handle(), const_cast<BYTE*>( &m_Config.Raw[0]), static_cast<WORD>( sizeof( m_Config.Raw))), "CP210x_SetConfig");
 }
-void CConfig::verify( const CCP210xDev &dev) const
+void CConfig::readBack( const CCP210xDev &dev)
 {
-    if( !m_Specified) { return; }
-    CCP2102NConfig readConfig;
-    AbortOnErr( CP210x_GetConfig( dev.handle(), &readConfig.Raw[0], static_cast<WORD>( sizeof( readConfig.Raw))), "CP210x_GetConfig");
+    ASSERT( m_Config.Fields.enableConfigUpdate == CP2102N_CONFIG_UNLOCKED);
+    AbortOnErr( CP210x_GetConfig( dev.handle(), &m_Config.Raw[0], static_cast<WORD>( sizeof( m_Config.Raw))), "CP210x_GetConfig");
 
     // A little hack to workaround locked configurations.
     // If the Config on the chip is locked, the dumb array comparison will fail because of enableConfigUpdate.
     // But it wouldn't be a valid failure. So, hack the "unlocked" value into it before comparing.
-    ASSERT( m_Config.Fields.enableConfigUpdate == CP2102N_CONFIG_UNLOCKED);
-    readConfig.Fields.enableConfigUpdate = CP2102N_CONFIG_UNLOCKED;
-
-    if( memcmp( &readConfig.Raw[0], &m_Config.Raw[0], sizeof( readConfig)))
-    {
-        throw CCustErr( "Failed Config verification");
-    }
+    m_Config.Fields.enableConfigUpdate = CP2102N_CONFIG_UNLOCKED;
 }
 //---------------------------------------------------------------------------------
-// Base class for all cp210x devices, contains ommmon customization parameters
+// Base class for all cp210x devices: the common customization parameters, with Unicode
+// product strings, and the registry TParmList of the ones specific to the device type,
+// checked against the device type's capabilities
 //---------------------------------------------------------------------------------
-template< class TDev >
-struct CCP210xParms : public CDevParms<TDev>
+template< class TDev, class TParmList >
+struct CCP210xParms : public CDevParms<TDev, TParmList, true>
 {
-    virtual bool supportsUnicode() const { return true; }
-    virtual void readParm( const std::string &parmName);
-    void program( const TDev &dev, const std::vector<BYTE> *pSerNum) const;
-    void verify( const TDev &dev, CSerNumSet &serNumSet) const;
+    typedef CDevParms<TDev, TParmList, true> TBase;
+    void validate( const CDevType &devType, bool lock) const;
+    void validate( const CDevType &devType, const CSerNumSet &serNumSet) const;
 };
-template< class TDev >
-void CCP210xParms<TDev>::readParm( const std::string &parmName)
-{
-    CDevParms<TDev>::readParm( parmName);
-}
-template< class TDev >
-void CCP210xParms<TDev>::program( const TDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-#if 0 // TODO remove
-    if( pSerNum) {
-        std::vector<BYTE> sn = *pSerNum;
-        sn.push_back( 0);
-        printf( "program serial num: %s\n", sn.data());
-        sn.pop_back();
-    }
-#endif
-    CDevParms<TDev>::program( dev, pSerNum);
-    if( CDevParms<TDev>::m_VidPidSpecified)
-    {
-        dev.setVidPid( CDevParms<TDev>::m_Vid, CDevParms<TDev>::m_Pid);
-    }
-    if( CDevParms<TDev>::m_PowerModeSpecified)
-    {
-        dev.setPowerMode( CDevParms<TDev>::m_PowerMode);
-    }
-    if( CDevParms<TDev>::m_MaxPowerSpecified)
-    {
-        dev.setMaxPower( CDevParms<TDev>::m_MaxPower);
-    }
-    if( CDevParms<TDev>::m_DevVerSpecified)
+template< class TDev, class TParmList >
+void CCP210xParms<TDev,TParmList>::validate( const CDevType &devType, bool lock) const
+{
+    CP210x_CAPABILITIES caps;
+    AbortOnErr( CP210x_GetCapabilities( devType.Value(), &caps), "CP210x_GetCapabilities");
+    TBase::m_Common.validate( caps);
+    // CP2102N locks by its Config rather than the lock value
+    if( lock && !(caps.Operations & (CP210x_CAP_LOCK_VALUE | CP210x_CAP_CONFIG)))
     {
-        dev.setDevVer( CDevParms<TDev>::m_DevVer);
+        throw CUsageErr( "--lock isn't supported by the device type");
     }
+    TBase::m_Parms.validate( caps);
 }
-template< class TDev >
-void CCP210xParms<TDev>::verify( const TDev &dev, CSerNumSet &serNumSet) const
+template< class TDev, class TParmList >
+void CCP210xParms<TDev,TParmList>::validate( const CDevType &devType, const CSerNumSet &serNumSet) const
 {
-    CDevParms<TDev>::verify( dev, serNumSet);
-}
-//---------------------------------------------------------------------------------
-struct CCP2101Parms : public CCP210xParms<CCP210xDev>
-{
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-};
-void CCP2101Parms::readParm( const std::string &parmName) 
-{
-    CCP210xParms::readParm( parmName);
-}
-void CCP2101Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-    CCP210xParms::program( dev, pSerNum);
-}
-void CCP2101Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-}
-//---------------------------------------------------------------------------------
-struct CCP2102Parms : public CCP210xParms<CCP210xDev>
-{
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CBaudRateConfig m_BaudRateCfg;
-};
-void CCP2102Parms::readParm( const std::string &parmName)
-{
-    if( m_BaudRateCfg.readParm( parmName))
+    CP210x_CAPABILITIES caps;
+    AbortOnErr( CP210x_GetCapabilities( devType.Value(), &caps), "CP210x_GetCapabilities");
+    for( DWORD i = 0; i < serNumSet.size(); i++)
     {
-        return;
+        validateStrLen( "--serial-nums " + toString( serNumSet.at( i)), serNumSet.at( i), true /*isAscii*/, caps.MaxSerialStrLen);
     }
-    CCP210xParms::readParm( parmName);
-}
-void CCP2102Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-    CCP210xParms::program( dev, pSerNum);
-    m_BaudRateCfg.program( dev);
-}
-void CCP2102Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-    m_BaudRateCfg.verify( dev);
 }
 //---------------------------------------------------------------------------------
-class CCP2102NParms : public CCP210xParms<CCP2102NDev>
-{
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP2102NDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP2102NDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CConfig m_Cfg;
-};
-void CCP2102NParms::readParm( const std::string &parmName)
-{
-    if( m_Cfg.readParm( parmName))
+typedef CCP210xParms< CCP210xDev, CParmList<> > CCP2101Parms;
+typedef CCP210xParms< CCP210xDev, CParmList< CBaudRateConfig > > CCP2102Parms;
+typedef CCP210xParms< CCP210xDev, CParmList< CBaudRateConfig, CPortConfig > > CCP2103Parms;
+typedef CCP210xParms< CCP210xDev, CParmList< CPortConfig, CFlushBufferConfig > > CCP2104Parms;
+typedef CCP210xParms< CCP210xDev, CParmList< CFlushBufferConfig, CDeviceMode, CDualPortConfig,
+                                             CInterfaceString<0>, CInterfaceString<1> > > CCP2105Parms;
+typedef CCP210xParms< CCP210xDev, CParmList< CFlushBufferConfig, CManufacturerString<CCP210xDev,true>, CQuadPortConfig,
+                                             CInterfaceString<0>, CInterfaceString<1>,
+                                             CInterfaceString<2>, CInterfaceString<3> > > CCP2108Parms;
+typedef CCP210xParms< CCP210xDev, CParmList< CBaudRateConfig > > CCP2109Parms;
+//---------------------------------------------------------------------------------
+// The serial number of a CP2102N goes into its Config. CDevProfile programs through
+// this class, so its program() replaces the common one, and programAll() doesn't use
+// a transfer plan: the serial number isn't a transfer of its own to replace. Nor does
+// it run devices in parallel, program() puts each one's serial number into the Config.
+struct CCP2102NParms : public CCP210xParms< CCP2102NDev, CParmList< CConfig > >
+{
+    void program( const CCP2102NDev &dev, const std::vector<BYTE> *pSerNum) const;
+    void programAll( const CDevType &, const CDevSet<CCP2102NDev> &devSet, const CSerNumSet &serNumSet,
+                     const CSchedLimits &, const CProfileOut &out) const
     {
-        return;
+        for( DWORD i = 0; i < devSet.size(); i++)
+        {
+            const std::vector<BYTE> serNum = !serNumSet.empty() ? serNumSet.at( i) : std::vector<BYTE>();
+            try
+            {
+                program( devSet.at( i), !serNumSet.empty() ? &serNumSet.at( i) : NULL);
+            }
+            catch( const CErrMsg &e)
+            {
+                out.device( CProfileOut::PROGRAM, devSet.at( i).handle(), serNum, e.msg());
+                throw;
+            }
+            out.device( CProfileOut::PROGRAM, devSet.at( i).handle(), serNum, "");
+        }
     }
-    CCP210xParms::readParm( parmName);
-}
+};
 void CCP2102NParms::program( const CCP2102NDev &dev, const std::vector<BYTE> * pSerNum) const
 {
   if( pSerNum)
   {
       // add the serial number to the config.
 
-    const CCP2102NConfig & cp2102nconfigReference = m_Cfg.m_Config;
+    const CCP2102NConfig & cp2102nconfigReference = m_Parms.m_Head.m_Config;
 
     CCP2102NConfig & cp2102nconfig = const_cast<CCP2102NConfig &>(cp2102nconfigReference);
 
@@ -862,15 +1099,7 @@ void CCP2102NParms::program( const CCP2102NDev &dev, const std::vector<BYTE> * p
   }
 
    CCP210xParms::program( dev, pSerNum);
-
-    m_Cfg.program( dev);
 }
-void CCP2102NParms::verify( const CCP2102NDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-    m_Cfg.verify( dev);
-}
-
 /*
   setCP2102N_USBString
 
@@ -955,253 +1184,70 @@ void setCP2102N_USBString(CCP2102NConfig & config, cp2102n_usb_string_desc_t str
 }
 
 //---------------------------------------------------------------------------------
-struct CCP2103Parms : public CCP210xParms<CCP210xDev>
-{
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CBaudRateConfig  m_BaudRateCfg;
-    CPortConfig      m_PortCfg;
-};
-void CCP2103Parms::readParm( const std::string &parmName)
-{
-    if( m_PortCfg.readParm( parmName))
-    {
-        return;
-    }
-    if( m_BaudRateCfg.readParm( parmName))
-    {
-        return;
-    }
-    CCP210xParms::readParm( parmName);
-}
-void CCP2103Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-    CCP210xParms::program( dev, pSerNum);
-    m_BaudRateCfg.program( dev);
-    m_PortCfg.program( dev);
-}
-void CCP2103Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-    m_BaudRateCfg.verify( dev);
-    m_PortCfg.verify( dev);
-}
-//---------------------------------------------------------------------------------
-struct CCP2104Parms : public CCP210xParms<CCP210xDev>
-{
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CPortConfig          m_PortCfg;
-    CFlushBufferConfig   m_FlushBufferConfig;
-};
-void CCP2104Parms::readParm( const std::string &parmName)
-{
-    if( m_PortCfg.readParm( parmName))
-    {
-        return;
-    }
-    if( m_FlushBufferConfig.readParm( parmName))
-    {
-        return;
-    }
-    CCP210xParms::readParm( parmName);
-}
-void CCP2104Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-    CCP210xParms::program( dev, pSerNum);
-    m_PortCfg.program( dev);
-    m_FlushBufferConfig.program( dev);
-}
-void CCP2104Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-    m_PortCfg.verify( dev);
-    m_FlushBufferConfig.verify( dev);
-}
-//---------------------------------------------------------------------------------
-struct CCP2105Parms : public CCP210xParms<CCP210xDev>
+#ifndef _WIN32
+// CP210X_SIM_CLOCK=virtual runs the waits and the simulated devices on
+// simulated time, so a batch against the sim takes no more than its CPU time
+uint64_t osClockNowUsec()
 {
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CFlushBufferConfig  m_FlushBufferConfig;
-    CDeviceMode         m_DeviceMode;
-    CDualPortConfig     m_PortCfg;
-    CInterfaceString    m_IfcStr[ 2];
-};
-void CCP2105Parms::readParm( const std::string &parmName)
-{
-    if( m_FlushBufferConfig.readParm( parmName))
-    {
-        return;
-    }
-    if( m_DeviceMode.readParm( parmName))
-    {
-        return;
-    }
-    if( m_PortCfg.readParm( parmName))
-    {
-        return;
-    }
-    for( BYTE i = 0; i < SIZEOF_ARRAY( m_IfcStr); i++)
-    {
-        if( m_IfcStr[ i].readParm( i, parmName))
-        {
-            return;
-        }
-    }
-    CCP210xParms::readParm( parmName);
+    return GetOsClock()->NowUsec();
 }
-void CCP2105Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
+void osClockSleepUsec( uint64_t usec)
 {
-    CCP210xParms::program( dev, pSerNum);
-    m_FlushBufferConfig.program( dev);
-    m_DeviceMode.program( dev);
-    m_PortCfg.program( dev);
-    for( BYTE i = 0; i < SIZEOF_ARRAY( m_IfcStr); i++)
-    {
-        m_IfcStr[ i].program( i, dev);
-    }
+    GetOsClock()->SleepUsec( usec);
 }
-void CCP2105Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
+void selectClock()
 {
-    CCP210xParms::verify( dev, serNumSet);
-    m_FlushBufferConfig.verify( dev);
-    m_DeviceMode.verify( dev);
-    m_PortCfg.verify( dev);
-    for( BYTE i = 0; i < SIZEOF_ARRAY( m_IfcStr); i++)
+    static CVirtualClock virtualClock;
+    const char *clock = getenv( "CP210X_SIM_CLOCK");
+    if( clock && !strcmp( clock, "virtual"))
     {
-        m_IfcStr[ i].verify( i, dev);
-    }
-}
-//---------------------------------------------------------------------------------
-struct CCP2108Parms : public CCP210xParms<CCP210xDev>
-{
-    CCP2108Parms() : m_ManufStr( true /*supportsUnicode*/) {}
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CFlushBufferConfig               m_FlushBufferConfig;
-    CManufacturerString<CCP210xDev>  m_ManufStr;
-    CQuadPortConfig                  m_PortCfg;
-    CInterfaceString                 m_IfcStr[ 4];
-};
-
-void CCP2108Parms::readParm( const std::string &parmName) 
-{
-    if( m_FlushBufferConfig.readParm( parmName))
-    {
-        return;
-    }
-    if( m_ManufStr.readParm( parmName))
-    {
-        return;
-    }
-    if( m_PortCfg.readParm( parmName))
-    {
-        return;
-    }
-    for( BYTE i = 0; i < SIZEOF_ARRAY( m_IfcStr); i++)
-    {
-        if( m_IfcStr[ i].readParm( i, parmName))
-        {
-            return;
-        }
-    }
-    CCP210xParms::readParm( parmName);
-}
-void CCP2108Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-    CCP210xParms::program( dev, pSerNum);
-    m_FlushBufferConfig.program( dev);
-    m_ManufStr.program( dev);
-    m_PortCfg.program( dev);
-    for( BYTE i = 0; i < SIZEOF_ARRAY( m_IfcStr); i++)
-    {
-        m_IfcStr[ i].program( i, dev);
-    }
-}
-void CCP2108Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-    m_FlushBufferConfig.verify( dev);
-    m_ManufStr.verify( dev);
-    m_PortCfg.verify( dev);
-    for( BYTE i = 0; i < SIZEOF_ARRAY( m_IfcStr); i++)
-    {
-        m_IfcStr[ i].verify( i, dev);
+        SetOsClock( &virtualClock);
+        AbortOnErr( CP210xSim_SetClock( osClockNowUsec, osClockSleepUsec), "CP210xSim_SetClock");
     }
 }
+#endif
 //---------------------------------------------------------------------------------
-struct CCP2109Parms : public CCP210xParms<CCP210xDev>
+CProfile *LibSpecificProfile( const CDevType &devType, const CVidPid &vidPid, int argc, const char * argv[], DWORD index, DWORD count)
 {
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const;
-private:
-    CBaudRateConfig m_BaudRateCfg;
-};
-void CCP2109Parms::readParm( const std::string &parmName) 
-{
-    if( m_BaudRateCfg.readParm( parmName))
+#ifndef _WIN32
+    if( index == 0)
     {
-        return;
+        selectClock();
     }
-    CCP210xParms::readParm( parmName);
-}
-void CCP2109Parms::program( const CCP210xDev &dev, const std::vector<BYTE> *pSerNum) const
-{
-    CCP210xParms::program( dev, pSerNum);
-    m_BaudRateCfg.program( dev);
-}
-void CCP2109Parms::verify( const CCP210xDev &dev, CSerNumSet &serNumSet) const
-{
-    CCP210xParms::verify( dev, serNumSet);
-    m_BaudRateCfg.verify( dev);
-}
-//---------------------------------------------------------------------------------
-//---------------------------------------------------------------------------------
-void LibSpecificMain( const CDevType &devType, const CVidPid &vidPid, int argc, const char * argv[])
-{
+#endif
     if( devType.Value() == CP210x_CP2101_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2101Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2101Parms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2102_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2102Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2102Parms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2102N_QFN28_VERSION ||
              devType.Value() == CP210x_CP2102N_QFN24_VERSION ||
              devType.Value() == CP210x_CP2102N_QFN20_VERSION)
     {
-        DevSpecificMain<CCP2102NDev,CCP2102NParms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP2102NDev,CCP2102NParms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2103_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2103Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2103Parms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2104_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2104Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2104Parms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2105_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2105Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2105Parms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2108_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2108Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2108Parms>( devType, vidPid, argc, argv, index, count);
     }
     else if( devType.Value() == CP210x_CP2109_VERSION)
     {
-        DevSpecificMain<CCP210xDev,CCP2109Parms> ( devType, vidPid, argc, argv);
+        return new CDevProfile<CCP210xDev,CCP2109Parms>( devType, vidPid, argc, argv, index, count);
     }
     else
     {
@@ -0,0 +1,291 @@
+// libsmt's C API, see libsmt.h. A batch is the command line smt-cp210x would
+// get for it, run through the same profile, with the profile's output going to
+// the batch's callbacks instead of stdout and stderr.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <new>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include "util.h"
+#include "smt.h"
+#include "libsmt.h"
+
+struct SMT_CONFIG
+{
+    std::vector<char> image; // compiled, whatever the file was
+};
+
+// g_CfgFile and the library's clock are process wide, so is a batch
+static CCriticalSectionLock g_SmtLock;
+static std::string g_LastError;
+
+namespace
+{
+class CBatchSink : public CProfileSink
+{
+public:
+    CBatchSink( const SMT_BATCH &batch) : m_Batch( batch) {}
+    virtual void line( bool isError, const std::string &line)
+    {
+        if( m_Batch.onMessage)
+        {
+            m_Batch.onMessage( m_Batch.context, isError ? 1 : 0, line.c_str());
+        }
+    }
+    virtual void device( CProfileOut::EStep step, const std::string &location, const std::string &serNum, const std::string &err)
+    {
+        if( m_Batch.onDevice)
+        {
+            SMT_DEVICE_RESULT result;
+            result.step = static_cast<SMT_STEP>( step);
+            result.location = location.c_str();
+            result.serialNumber = serNum.c_str();
+            result.ok = err.empty() ? 1 : 0;
+            result.message = err.c_str();
+            m_Batch.onDevice( m_Batch.context, &result);
+        }
+    }
+private:
+    const SMT_BATCH &m_Batch;
+};
+
+// the configuration parsed into a profile for the command line, which must outlive it
+CProfile *parseProfile( const std::vector<char> &image, std::vector<const char *> &argv)
+{
+    g_CfgFile.openBuffer( image.empty() ? NULL : &image[ 0], image.size());
+    const CDevType devType = readDevType();
+    const CVidPid  vidPid  = readVidPid();
+    return LibSpecificProfile( devType, vidPid, static_cast<int>( argv.size()), &argv[ 0], 0, 1);
+}
+
+SMT_STATUS fail( SMT_STATUS status, const std::string &msg, CProfileSink *pSink)
+{
+    g_LastError = msg;
+    if( pSink)
+    {
+        pSink->line( true, "ERROR: " + msg);
+    }
+    return status;
+}
+}
+
+SMT_STATUS smt_load_config( const char *fileName, SMT_CONFIG **config)
+{
+    if( !fileName || !config)
+    {
+        return SMT_USAGE_ERROR;
+    }
+    *config = NULL;
+    g_SmtLock.Lock();
+    SMT_STATUS status = SMT_OK;
+    try
+    {
+        std::vector<char> file;
+        FILE *fp = fopen( fileName, "rb");
+        if( !fp)
+        {
+            char msg[ 128];
+            sprintf( msg, "configuration file open error %d", errno);
+            throw CUsageErr( msg);
+        }
+        char chunk[ 4096];
+        size_t cb;
+        while( (cb = fread( chunk, 1, sizeof( chunk), fp)) > 0)
+        {
+            file.insert( file.end(), chunk, chunk + cb);
+        }
+        fclose( fp);
+
+        g_CfgFile.openBuffer( file.empty() ? NULL : &file[ 0], file.size());
+        const bool compiled = g_CfgFile.isCompiled();
+        if( !compiled)
+        {
+            g_CfgFile.startImage();
+        }
+        std::vector<const char *> argv( 1, "libsmt");
+        const CDevType devType = readDevType();
+        const CVidPid  vidPid  = readVidPid();
+        delete LibSpecificProfile( devType, vidPid, 1, &argv[ 0], 0, 1);
+
+        SMT_CONFIG *cfg = new SMT_CONFIG;
+        if( compiled)
+        {
+            cfg->image.swap( file);
+        }
+        else
+        {
+            const std::vector<BYTE> image = g_CfgFile.image();
+            cfg->image.assign( image.begin(), image.end());
+        }
+        *config = cfg;
+    }
+    catch( const CSyntErr e)
+    {
+        status = fail( SMT_SYNTAX_ERROR, e.msg(), NULL);
+    }
+    catch( const CUsageErr e)
+    {
+        status = fail( SMT_USAGE_ERROR, e.msg(), NULL);
+    }
+    catch( const CDllErr e)
+    {
+        status = fail( SMT_LIBRARY_ERROR, "library: " + e.msg(), NULL);
+    }
+    catch( const CCustErr e)
+    {
+        status = fail( SMT_PROCESS_ERROR, "Manufacturing process: " + e.msg(), NULL);
+    }
+    catch( const std::bad_alloc &)
+    {
+        status = fail( SMT_NO_MEMORY, "out of memory", NULL);
+    }
+    catch( ...)
+    {
+        status = fail( SMT_INTERNAL_ERROR, "internal error", NULL);
+    }
+    g_SmtLock.Unlock();
+    return status;
+}
+
+void smt_free_config( SMT_CONFIG *config)
+{
+    delete config;
+}
+
+SMT_STATUS smt_run_batch( const SMT_CONFIG *config, const SMT_BATCH *batch)
+{
+    if( !config || !batch)
+    {
+        return SMT_USAGE_ERROR;
+    }
+    CBatchSink sink( *batch);
+    g_SmtLock.Lock();
+    g_BusOut.setSink( &sink);
+    SMT_STATUS status = SMT_OK;
+    try
+    {
+        // the command line of smt-cp210x for the batch
+        std::vector<std::string> args( 1, "libsmt");
+        char num[ 16];
+        sprintf( num, "%u", batch->deviceCount);
+        args.push_back( "--device-count");
+        args.push_back( num);
+        if( batch->program)
+        {
+            args.push_back( batch->verify ? "--set-and-verify-config" : "--set-config");
+        }
+        else if( batch->verify)
+        {
+            args.push_back( batch->verifyLocked ? "--verify-locked-config" : "--verify-config");
+        }
+        else
+        {
+            throw CUsageErr( "the batch has neither program nor verify");
+        }
+        args.push_back( "libsmt"); // the configuration is already loaded
+        if( batch->lock)
+        {
+            args.push_back( "--lock");
+        }
+        if( batch->serialNumbers && batch->generateSerialNumbers)
+        {
+            throw CUsageErr( "the batch has both serial numbers and generateSerialNumbers");
+        }
+        if( batch->serialNumbers)
+        {
+            args.push_back( "--serial-nums");
+            args.push_back( "{");
+            for( unsigned int i = 0; i < batch->deviceCount; i++)
+            {
+                args.push_back( batch->serialNumbers[ i]);
+            }
+            args.push_back( "}");
+        }
+        else if( batch->generateSerialNumbers)
+        {
+            args.push_back( "--serial-nums");
+            args.push_back( "GUID");
+        }
+        if( batch->verifyAttempts)
+        {
+            sprintf( num, "%u", batch->verifyAttempts);
+            args.push_back( "--verify-attempts");
+            args.push_back( num);
+        }
+        if( batch->ports)
+        {
+            args.push_back( "--ports");
+            args.push_back( batch->ports);
+        }
+        if( batch->maxOpen)
+        {
+            sprintf( num, "%u", batch->maxOpen);
+            args.push_back( "--max-open");
+            args.push_back( num);
+        }
+        if( batch->contextPerBus)
+        {
+            args.push_back( "--context-per-bus");
+        }
+        std::vector<const char *> argv;
+        for( size_t i = 0; i < args.size(); i++)
+        {
+            argv.push_back( args[ i].c_str());
+        }
+
+        setPorts( static_cast<int>( argv.size()), &argv[ 0]);
+        setMaxOpen( static_cast<int>( argv.size()), &argv[ 0]);
+        setContextPerBus( static_cast<int>( argv.size()), &argv[ 0]);
+        CDevVector<CProfile> profiles;
+        profiles.push_back( parseProfile( config->image, argv));
+        profiles[ 0]->setSink( &sink);
+        CBusSnapshot bus;
+        profiles[ 0]->claim( bus);
+        bus.closeRest();
+        profiles[ 0]->run();
+    }
+    catch( const CSyntErr e)
+    {
+        status = fail( SMT_SYNTAX_ERROR, e.msg(), &sink);
+    }
+    catch( const CUsageErr e)
+    {
+        status = fail( SMT_USAGE_ERROR, e.msg(), &sink);
+    }
+    catch( const CDllErr e)
+    {
+        status = fail( SMT_LIBRARY_ERROR, "library: " + e.msg(), &sink);
+    }
+    catch( const CCustErr e)
+    {
+        status = fail( SMT_PROCESS_ERROR, "Manufacturing process: " + e.msg(), &sink);
+    }
+    catch( const std::bad_alloc &)
+    {
+        status = fail( SMT_NO_MEMORY, "out of memory", &sink);
+    }
+    catch( ...)
+    {
+        status = fail( SMT_INTERNAL_ERROR, "internal error", &sink);
+    }
+    g_BusOut.setSink( NULL);
+    g_SmtLock.Unlock();
+    return status;
+}
+
+unsigned int smt_last_error( char *buf, unsigned int size)
+{
+    g_SmtLock.Lock();
+    const unsigned int len = static_cast<unsigned int>( g_LastError.size());
+    if( buf && size)
+    {
+        const unsigned int cb = len < size ? len : size - 1;
+        memcpy( buf, g_LastError.data(), cb);
+        buf[ cb] = '\0';
+    }
+    g_SmtLock.Unlock();
+    return len;
+}
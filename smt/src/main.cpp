@@ -0,0 +1,37 @@
+// Copyright (c) 2015-2016 by Silicon Laboratories Inc.  All rights reserved.
+// The program contained in this listing is proprietary to Silicon Laboratories,
+// headquartered in Austin, Texas, U.S.A. and is subject to worldwide copyright
+// protection, including protection under the United States Copyright Act of 1976
+// as an unpublished work, pursuant to Section 104 and Section 408 of Title XVII
+// of the United States code.  Unauthorized copying, adaptation, distribution,
+// use, or display is prohibited by this law.
+
+// smt-cp210x: the command of libsmt's smtMain(), run here or by smtd
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include "util.h"
+#include "smt.h"
+#include "smtd.h"
+
+int main( int argc, const char * argv[])
+{
+#ifndef _WIN32
+    std::string socketPath;
+    try
+    {
+        if( isSpecified( argc, argv, "--daemon", socketPath))
+        {
+            return runOnDaemon( socketPath, argc, argv);
+        }
+    }
+    catch( const CUsageErr e)
+    {
+        std::cerr << e.msg() << "\n\n";
+        printCmdLineHelp();
+        return 1;
+    }
+#endif
+    return smtMain( argc, argv);
+}
@@ -13,8 +13,12 @@
 #include <climits>
 #include "util.h"
 #include "smt.h"
+#include "smtd.h"
 #include <stdio.h>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
 
 void printProgDesc()
 {
@@ -62,11 +66,17 @@ void printCmdLineHelp()
 "    Legal only together with verification. If all devices are successfully\n"
 "    verified, permanently locks them so they can't be customized anymore.\n"
 "    Be sure you want to do this!\n"
+"--verify-attempts <decimal number>\n"
+"    Gives verification that many attempts instead of retrying it\n"
+"    until it succeeds, then fails.\n"
 "--verify-locked-config config_file_name\n"
 "    Same as --verify-config, but will also verify locked devices\n"
 "--set-and-verify-config config_file_name\n"
 "    Programs and verifies each device using the configuration provided in\n"
 "    the configuration file.  Prints the list of serial numbers programmed.\n"
+"    Each device is found again where it is plugged in and verified\n"
+"    against the serial number programmed there, so a unit swapped with\n"
+"    another fails verification.\n"
 "--serial-nums { X Y Z ... } | GUID\n"
 "    Specifies that serial numbers should be written to the devices.\n"
 "    If omitted, serial numbers are not programmed.\n"
@@ -80,6 +90,89 @@ void printCmdLineHelp()
 "--list config_file_name\n"
 "    Displays a list of all connected devices identified by the\n"
 "    configuration file.\n"
+"--diff-config config_file_name\n"
+"    Compares each device identified by the configuration file with\n"
+"    it and lists the parameters that differ, without retrying. Locked\n"
+"    devices are compared too. Fails if any device differs.\n"
+"--dry-run\n"
+"    Legal only together with the \"set\" and \"verify\" commands. Claims\n"
+"    the devices as they would, then lists the transfers programming\n"
+"    sends to each device and how many requests verification and --lock\n"
+"    take, and estimates the time of the run, sequential and with all\n"
+"    devices in parallel, from the latency of a request measured on the\n"
+"    first device. Reads that device but writes nothing.\n"
+"--dump-config config_file_name\n"
+"    Prints the parameters of the configuration file as JSON, each one\n"
+"    as the array of its values, byte arrays as hex strings. Doesn't\n"
+"    access any devices.\n"
+"Several configuration files, separated by commas, can be given to the\n"
+"options above to handle a mix of device families in one run, e.g.\n"
+"--set-and-verify-config cp2102n.cfg,cp2108.cfg --device-count 4,2\n"
+"    The bus is enumerated once, each file gets the devices matching its\n"
+"    FilterPartNumByte and FilterVidPid, and the files are processed\n"
+"    concurrently. --device-count then takes a count per file, in the\n"
+"    same order, and --serial-nums only GUID. Each file verifies only the\n"
+"    devices it claimed, found again where they are plugged in, and\n"
+"    every line it prints starts with its name. A report of each file's\n"
+"    outcome ends the run.\n"
+"--compile config_file_name compiled_file_name\n"
+"    Validates the configuration file and writes it in compiled form\n"
+"    (.smtc), which all options above accept in place of the text\n"
+"    configuration and load without parsing it again. Doesn't access\n"
+"    any devices.\n"
+"--script config_file_name script_file_name\n"
+"    Runs the steps of the script file, one per line, in one process:\n"
+"    program, reset, wait, verify, lock, \"pause\" for Enter, \"pause\n"
+"    msec\" and \"run command\". The devices stay open from step to step\n"
+"    but between a reset and the next wait, which finds them again where\n"
+"    they are plugged in. \"reopen [msec]\" does both for each device,\n"
+"    reopening it as soon as it is back at its port (10 s at most by\n"
+"    default). verify checks each against the serial number programmed\n"
+"    there. run gets SMT_DEVICES, \"location=serial\" words.\n"
+"--parallel <decimal number>\n"
+"    Programs that many devices at once instead of one after the other\n"
+"    (not a CP2102N, whose serial number goes into its configuration).\n"
+"    The buses take turns, and so do the hubs of a bus; the schedule\n"
+"    is printed before programming starts.\n"
+"--bus-limit <decimal number>\n"
+"    With --parallel, programs at most that many devices of a bus at\n"
+"    once. No limit by default.\n"
+"--hub-limit <decimal number>\n"
+"    With --parallel, programs at most that many devices of a hub at\n"
+"    once, 4 by default. Behind a high-speed hub, the devices share its\n"
+"    transaction translator.\n"
+"--reset-wave <decimal number>\n"
+"    Resets the devices that many at a time instead of all at once, each\n"
+"    wave waiting for its devices to be back where they are plugged in\n"
+"    before the next one goes. A wave back within --reset-target ms\n"
+"    (1000 by default) makes the next one larger by that many devices,\n"
+"    a slower one halves it. A line per wave reports its recovery time.\n"
+"--reset-spacing <decimal number>\n"
+"    With --reset-wave, waits that many ms between waves.\n"
+"--reset-target <decimal number>\n"
+"    With --reset-wave, see there.\n"
+"--ports \"pattern ...\"\n"
+"    Claims only the devices plugged in at the ports of the patterns,\n"
+"    separated by spaces or commas: a bus (\"1\"), a port (\"1-4.2\") or\n"
+"    the ports downstream of a hub (\"1-4.*\"). Other devices aren't\n"
+"    opened, nor counted by --device-count, so several instances can\n"
+"    each drive their own hubs. Each claimed device's port is also\n"
+"    locked (flock, in $SMT_LOCK_DIR, /tmp by default) for the run; a\n"
+"    device another instance locked is skipped.\n"
+"--max-open <decimal number>\n"
+"    Keeps at most that many devices open at once, for rigs with more\n"
+"    units than the file descriptor limit allows. The least recently used\n"
+"    device is closed to make room and opened again where it is plugged\n"
+"    in when it is needed. All claimed devices stay open by default.\n"
+"--context-per-bus\n"
+"    Opens the devices of each bus in a libusb context of its own, so\n"
+"    that --parallel workers on different buses don't wait on each\n"
+"    other's USB event handling. All devices share one by default.\n"
+"--daemon socket_path\n"
+"    Hands the command over to smtd serving at the socket, which runs\n"
+"    it as here with the device registry and parsed configurations it\n"
+"    keeps between commands. Commands of several clients run one at a\n"
+"    time. Relative file names are those of this working directory.\n"
 "\nNormal usage example\n"
 "    The following command will program, verify and permanently lock the\n"
 "    customizable parameters of all 3 connected devices. (Serial numbers\n"
@@ -133,7 +226,191 @@ bool isSpecified( int argc, const char * argv[], const std::string &parmName, st
     return false;
 }
 
-void redirStdinToCfgFile( int argc, const char * argv[])
+// the second argument of a command line option
+static std::string secondParm( int argc, const char * argv[], const std::string &parmName, const std::string &what)
+{
+    for( int i = 0; i < argc - 2; i++)
+    {
+        if( std::string( argv[ i]) == parmName)
+        {
+            return argv[ i + 2];
+        }
+    }
+    throw CUsageErr( what + " is missing after " + parmName + " command line option");
+}
+
+// the second argument of --compile
+std::string compiledFileName( int argc, const char * argv[])
+{
+    return secondParm( argc, argv, "--compile", "compiled file name");
+}
+
+std::vector<CScriptStep> readScript( int argc, const char * argv[])
+{
+    std::vector<CScriptStep> steps;
+    if( !isSpecified( argc, argv, "--script"))
+    {
+        return steps;
+    }
+    const std::string fileName = secondParm( argc, argv, "--script", "script file name");
+    FILE *fp = fopen( fileName.c_str(), "r");
+    if( !fp)
+    {
+        char msg[ 128];
+        sprintf( msg, "script file open error %d", errno);
+        throw CUsageErr( msg);
+    }
+    bool open = true;       // the devices are, until a reset
+    bool verified = false;  // since they were last programmed
+    char text[ 1024];
+    for( DWORD line = 1; fgets( text, sizeof( text), fp); line++)
+    {
+        std::string s( text);
+        s = s.substr( 0, s.find( '#'));
+        std::istringstream words( s);
+        std::string name;
+        if( !(words >> name))
+        {
+            continue;
+        }
+        CScriptStep step;
+        step.m_Line = line;
+        step.m_Msec = 0;
+        step.m_Text = s.substr( 0, s.find_last_not_of( " \t\r\n") + 1);
+        step.m_Text = step.m_Text.substr( step.m_Text.find_first_not_of( " \t"));
+        char msg[ 128];
+        sprintf( msg, "script line %u: ", line);
+        std::string err;
+        if( name == "program" || name == "verify" || name == "lock")
+        {
+            step.m_Kind = name == "program" ? CScriptStep::PROGRAM : name == "verify" ? CScriptStep::VERIFY : CScriptStep::LOCK;
+            if( !open)
+            {
+                err = name + " needs the devices back, wait for them after the reset";
+            }
+            else if( step.m_Kind == CScriptStep::LOCK && !verified)
+            {
+                err = "lock must follow a verify";
+            }
+            verified = step.m_Kind == CScriptStep::VERIFY || (verified && step.m_Kind == CScriptStep::LOCK);
+        }
+        else if( name == "reset" || name == "wait")
+        {
+            step.m_Kind = name == "reset" ? CScriptStep::RESET : CScriptStep::WAIT;
+            if( step.m_Kind == CScriptStep::RESET && !open)
+            {
+                err = "reset needs the devices back, wait for them after the previous reset";
+            }
+            open = step.m_Kind == CScriptStep::WAIT;
+        }
+        else if( name == "reopen")
+        {
+            step.m_Kind = CScriptStep::REOPEN;
+            step.m_Msec = SCRIPT_REOPEN_MSEC;
+            std::string msec;
+            if( !open)
+            {
+                err = "reopen needs the devices back, wait for them after the reset";
+            }
+            else if( words >> msec)
+            {
+                char *end;
+                step.m_Msec = strtoul( msec.c_str(), &end, 10);
+                if( *end || !step.m_Msec)
+                {
+                    err = "reopen takes a decimal number of milliseconds";
+                }
+            }
+        }
+        else if( name == "pause")
+        {
+            step.m_Kind = CScriptStep::PAUSE;
+            std::string msec;
+            if( words >> msec)
+            {
+                char *end;
+                step.m_Msec = strtoul( msec.c_str(), &end, 10);
+                if( *end || !step.m_Msec)
+                {
+                    err = "pause takes a decimal number of milliseconds";
+                }
+            }
+        }
+        else if( name == "run")
+        {
+            step.m_Kind = CScriptStep::RUN;
+            std::getline( words >> std::ws, step.m_Command);
+            if( step.m_Command.empty())
+            {
+                err = "run needs a command";
+            }
+        }
+        else
+        {
+            err = "unknown step " + name;
+        }
+        std::string extra;
+        if( err.empty() && step.m_Kind != CScriptStep::RUN && words >> extra)
+        {
+            err = "unexpected " + extra;
+        }
+        if( !err.empty())
+        {
+            fclose( fp);
+            throw CUsageErr( msg + err);
+        }
+        steps.push_back( step);
+    }
+    fclose( fp);
+    if( steps.empty())
+    {
+        throw CUsageErr( "script has no steps");
+    }
+    return steps;
+}
+
+void runScriptHook( const CScriptStep &step, const std::string &devices)
+{
+#ifdef _WIN32
+    _putenv_s( "SMT_DEVICES", devices.c_str());
+#else
+    setenv( "SMT_DEVICES", devices.c_str(), 1);
+#endif
+    fflush( stdout);
+    int rc = system( step.m_Command.c_str());
+#ifndef _WIN32
+    if( rc != -1 && WIFEXITED( rc))
+    {
+        rc = WEXITSTATUS( rc);
+    }
+#endif
+    if( rc != 0)
+    {
+        char msg[ 128];
+        sprintf( msg, "script line %u: command failed with %d", step.m_Line, rc);
+        throw CCustErr( msg);
+    }
+}
+
+void pauseScript( const CScriptStep &step, const CProfileOut &out)
+{
+    if( step.m_Msec)
+    {
+        delayMsec( step.m_Msec);
+        return;
+    }
+    out.print( "press Enter to continue...");
+    fflush( stdout);
+    char text[ 256];
+    if( !fgets( text, sizeof( text), stdin))
+    {
+        clearerr( stdin);
+        throw CCustErr( "no Enter to continue on, stdin is closed");
+    }
+}
+
+// the configuration files of the command, several are separated by commas
+std::vector<std::string> cfgFileNames( int argc, const char * argv[])
 {
     std::string cfgFileName;
     int fileNameCnt = 0;
@@ -161,23 +438,765 @@ void redirStdinToCfgFile( int argc, const char * argv[])
     {
         fileNameCnt++;
     }
-    if( fileNameCnt == 1)
+    if( isSpecified( argc, argv, "--diff-config", cfgFileName))
+    {
+        fileNameCnt++;
+    }
+    if( isSpecified( argc, argv, "--dump-config", cfgFileName))
+    {
+        fileNameCnt++;
+    }
+    if( isSpecified( argc, argv, "--compile", cfgFileName))
     {
-        FILE * fp = freopen( cfgFileName.c_str(), "r", stdin);
-        if( !fp)
+        fileNameCnt++;
+        compiledFileName( argc, argv); // fail before parsing if it's missing
+    }
+    if( isSpecified( argc, argv, "--script", cfgFileName))
+    {
+        fileNameCnt++;
+    }
+    if( fileNameCnt != 1)
+    {
+        throw CUsageErr( "command line must specify 1 configuration file");
+    }
+
+    std::vector<std::string> fileNames;
+    size_t start = 0, comma;
+    while( (comma = cfgFileName.find( ',', start)) != std::string::npos)
+    {
+        fileNames.push_back( cfgFileName.substr( start, comma - start));
+        start = comma + 1;
+    }
+    fileNames.push_back( cfgFileName.substr( start));
+    for( size_t i = 0; i < fileNames.size(); i++)
+    {
+        if( fileNames[ i].empty())
         {
-            char msg[ 128];
-            sprintf( msg, /*SIZEOF_ARRAY( msg),*/ "configuration file open error %d", errno);
-            throw CCustErr( msg);
+            throw CUsageErr( "empty configuration file name");
         }
     }
-    else
+    if( fileNames.size() > 1 && isSpecified( argc, argv, "--compile"))
     {
-        throw CUsageErr( "command line must specify 1 configuration file");
+        throw CUsageErr( "--compile takes 1 configuration file");
+    }
+    if( fileNames.size() > 1 && isSpecified( argc, argv, "--script"))
+    {
+        throw CUsageErr( "--script takes 1 configuration file");
     }
+    return fileNames;
+}
+
+void openCfgFile( const std::string &cfgFileName)
+{
+    if( !g_CfgFile.open( cfgFileName))
+    {
+        char msg[ 128];
+        sprintf( msg, /*SIZEOF_ARRAY( msg),*/ "configuration file open error %d", errno);
+        throw CCustErr( msg);
+    }
+}
+
+// Opens the configuration file, from smtd's cache if it has it there. True if the
+// file is to be recorded while parsing and cached with storeCachedCfgFile().
+bool openCachedCfgFile( const std::string &cfgFileName, bool compile)
+{
+#ifndef _WIN32
+    // --compile records the image itself, --verbose echoes the text
+    CCfgCache *cache = compile || g_EchoParserReads ? NULL : g_pCfgCache;
+    if( cache && cache->open( cfgFileName))
+    {
+        return false;
+    }
+    openCfgFile( cfgFileName);
+    return cache && !g_CfgFile.isCompiled();
+#else
+    openCfgFile( cfgFileName);
+    return false;
+#endif
 }
 
-int main( int argc, const char * argv[])
+void storeCachedCfgFile()
+{
+#ifndef _WIN32
+    g_pCfgCache->store();
+#endif
+}
+
+void writeCompiledCfgFile( int argc, const char * argv[])
+{
+    const std::string fileName = compiledFileName( argc, argv);
+    if( !g_CfgFile.writeImage( fileName))
+    {
+        char msg[ 128];
+        sprintf( msg, "compiled file write error %d", errno);
+        throw CCustErr( msg);
+    }
+    printf( "compiled %s: OK\n", fileName.c_str());
+}
+
+// prints the parameters of the configuration files, a JSON array of them if there are several
+void dumpProfiles( const std::vector<CProfile *> &profiles)
+{
+    if( profiles.size() == 1)
+    {
+        printf( "%s\n", profiles[ 0]->dump().c_str());
+        return;
+    }
+    printf( "[\n");
+    for( size_t i = 0; i < profiles.size(); i++)
+    {
+        printf( "%s%s\n", profiles[ i]->dump().c_str(), i + 1 < profiles.size() ? "," : "");
+    }
+    printf( "]\n");
+}
+
+//---------------------------------------------------------------------------------
+// A profile of a batch and how it went
+struct CProfileRun
+{
+    CProfile    *m_pProfile;
+    std::string  m_Name;
+    bool         m_Ok;
+};
+
+// runs the profile, reporting what goes wrong the way main() does
+void runGuarded( CProfileRun &run)
+{
+    run.m_Ok = false;
+    try
+    {
+        run.m_pProfile->run();
+        run.m_Ok = true;
+    }
+    catch( const CDllErr e)
+    {
+        std::cerr << "ERROR: " << run.m_Name << ": library: " << e.msg() << "\n";
+    }
+    catch( const CCustErr e)
+    {
+        std::cerr << "ERROR: " << run.m_Name << ": Manufacturing process: " << e.msg() << "\n";
+    }
+    catch( const CUsageErr e)
+    {
+        std::cerr << "ERROR: " << run.m_Name << ": " << e.msg() << "\n";
+    }
+    catch( const std::bad_alloc& ba)
+    {
+        std::cerr << "ERROR: " << run.m_Name << ": " << ba.what()  << "\n";
+    }
+}
+#ifndef _WIN32
+void *runGuardedThread( void *pRun)
+{
+    runGuarded( *static_cast<CProfileRun *>( pRun));
+    g_HandlePool.unpin();
+    return NULL;
+}
+#endif
+
+//---------------------------------------------------------------------------------
+const DWORD DefaultHubLimit = 4;
+
+CSchedLimits::CSchedLimits( int argc, const char * argv[])
+{
+    m_Workers = isSpecified( argc, argv, "--parallel")  ? decimalParm( argc, argv, "--parallel")  : 1;
+    m_PerBus  = isSpecified( argc, argv, "--bus-limit") ? decimalParm( argc, argv, "--bus-limit") : MAX_ULONG;
+    m_PerHub  = isSpecified( argc, argv, "--hub-limit") ? decimalParm( argc, argv, "--hub-limit") : DefaultHubLimit;
+}
+
+// "1-4.2" is on bus 1 behind the hub at 1-4, "1-4" on the root hub of bus 1
+CTopoScheduler::CTopoScheduler( const std::vector<std::string> &locations, DWORD count, const CSchedLimits &limits)
+    : m_Limits( limits), m_Left( count), m_NextBus( 0)
+{
+#ifndef _WIN32
+    m_Workers = std::min( limits.m_Workers, count);
+#else
+    m_Workers = 1;
+#endif
+    for( DWORD i = 0; i < count; i++)
+    {
+        const std::string location = locations.size() == count ? locations[ i] : "?";
+        const std::string busName = location.substr( 0, location.find( '-'));
+        const size_t dot = location.rfind( '.');
+        const std::string hubName = dot != std::string::npos ? location.substr( 0, dot) : busName;
+
+        size_t b = 0;
+        while( b < m_Buses.size() && m_Buses[ b].m_Name != busName)
+        {
+            b++;
+        }
+        if( b == m_Buses.size())
+        {
+            CBus bus;
+            bus.m_Name = busName;
+            bus.m_NextHub = 0;
+            bus.m_InFlight = 0;
+            m_Buses.push_back( bus);
+        }
+        std::vector<CHub> &hubs = m_Buses[ b].m_Hubs;
+        size_t h = 0;
+        while( h < hubs.size() && hubs[ h].m_Name != hubName)
+        {
+            h++;
+        }
+        if( h == hubs.size())
+        {
+            CHub hub;
+            hub.m_Name = hubName;
+            hub.m_Next = 0;
+            hub.m_InFlight = 0;
+            hubs.push_back( hub);
+        }
+        hubs[ h].m_Devs.push_back( i);
+        m_DevHubs.push_back( std::make_pair( b, h));
+    }
+#ifndef _WIN32
+    pthread_mutex_init( &m_Mutex, NULL);
+    pthread_cond_init( &m_Done, NULL);
+#endif
+}
+CTopoScheduler::~CTopoScheduler()
+{
+#ifndef _WIN32
+    pthread_cond_destroy( &m_Done);
+    pthread_mutex_destroy( &m_Mutex);
+#endif
+}
+// the first device, going round the buses and their hubs from where the last one
+// was taken, whose bus and hub are below their limits
+bool CTopoScheduler::take( DWORD &dev)
+{
+    for( size_t b = 0; b < m_Buses.size(); b++)
+    {
+        const size_t busIndex = ( m_NextBus + b) % m_Buses.size();
+        CBus &bus = m_Buses[ busIndex];
+        if( bus.m_InFlight >= m_Limits.m_PerBus)
+        {
+            continue;
+        }
+        for( size_t h = 0; h < bus.m_Hubs.size(); h++)
+        {
+            const size_t hubIndex = ( bus.m_NextHub + h) % bus.m_Hubs.size();
+            CHub &hub = bus.m_Hubs[ hubIndex];
+            if( hub.m_Next < hub.m_Devs.size() && hub.m_InFlight < m_Limits.m_PerHub)
+            {
+                dev = hub.m_Devs[ hub.m_Next++];
+                hub.m_InFlight++;
+                bus.m_InFlight++;
+                m_Left--;
+                bus.m_NextHub = hubIndex + 1;
+                m_NextBus = busIndex + 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+bool CTopoScheduler::next( DWORD &dev)
+{
+    bool taken = false;
+#ifndef _WIN32
+    pthread_mutex_lock( &m_Mutex);
+    while( m_Left && !( taken = take( dev)))
+    {
+        pthread_cond_wait( &m_Done, &m_Mutex);
+    }
+    pthread_mutex_unlock( &m_Mutex);
+#else
+    taken = m_Left && take( dev); // one worker, nothing else is in flight
+#endif
+    return taken;
+}
+void CTopoScheduler::done( DWORD dev)
+{
+#ifndef _WIN32
+    pthread_mutex_lock( &m_Mutex);
+#endif
+    CBus &bus = m_Buses[ m_DevHubs[ dev].first];
+    bus.m_InFlight--;
+    bus.m_Hubs[ m_DevHubs[ dev].second].m_InFlight--;
+#ifndef _WIN32
+    pthread_cond_broadcast( &m_Done);
+    pthread_mutex_unlock( &m_Mutex);
+#endif
+}
+void CTopoScheduler::cancel()
+{
+#ifndef _WIN32
+    pthread_mutex_lock( &m_Mutex);
+#endif
+    m_Left = 0;
+#ifndef _WIN32
+    pthread_cond_broadcast( &m_Done);
+    pthread_mutex_unlock( &m_Mutex);
+#endif
+}
+void CTopoScheduler::print( const CProfileOut &out) const
+{
+    char msg[ 128];
+    out.print( "--- schedule -------------");
+    sprintf( msg, "%u devices at once", m_Workers);
+    std::string line( msg);
+    if( m_Limits.m_PerBus != MAX_ULONG)
+    {
+        sprintf( msg, ", %u per bus", m_Limits.m_PerBus);
+        line += msg;
+    }
+    sprintf( msg, ", %u per hub", m_Limits.m_PerHub);
+    out.print( line + msg);
+    for( size_t b = 0; b < m_Buses.size(); b++)
+    {
+        line = "bus " + m_Buses[ b].m_Name + ":";
+        for( size_t h = 0; h < m_Buses[ b].m_Hubs.size(); h++)
+        {
+            const CHub &hub = m_Buses[ b].m_Hubs[ h];
+            sprintf( msg, " %u", static_cast<DWORD>( hub.m_Devs.size()));
+            line += std::string( h ? "," : "") + " hub " + ( hub.m_Name == m_Buses[ b].m_Name ? "root" : hub.m_Name) + msg;
+        }
+        out.print( line);
+    }
+    out.print( "--------------------------");
+}
+
+namespace
+{
+// the devices of a scheduled run and its first failure
+struct CScheduledRun
+{
+    enum EErr { NONE, DLL, FATAL_DLL, CUST, NO_MEMORY };
+    CTopoScheduler      *m_pSched;
+    CDevTask            *m_pTask;
+    CCriticalSectionLock m_Lock;
+    EErr                 m_Err;
+    std::string          m_Msg;
+
+    void fail( EErr err, const std::string &msg)
+    {
+        m_Lock.Lock();
+        if( m_Err == NONE)
+        {
+            m_Err = err;
+            m_Msg = msg;
+        }
+        m_Lock.Unlock();
+        m_pSched->cancel();
+    }
+    void work()
+    {
+        DWORD dev;
+        while( m_pSched->next( dev))
+        {
+            try
+            {
+                m_pTask->run( dev);
+            }
+            catch( const CFatalDllErr e)
+            {
+                fail( FATAL_DLL, e.msg());
+            }
+            catch( const CDllErr e)
+            {
+                fail( DLL, e.msg());
+            }
+            catch( const CCustErr e)
+            {
+                fail( CUST, e.msg());
+            }
+            catch( const std::bad_alloc &)
+            {
+                fail( NO_MEMORY, "");
+            }
+            m_pSched->done( dev);
+        }
+        g_HandlePool.unpin();
+    }
+};
+#ifndef _WIN32
+void *scheduledWorkerThread( void *pRun)
+{
+    static_cast<CScheduledRun *>( pRun)->work();
+    return NULL;
+}
+#endif
+}
+
+void runScheduled( CTopoScheduler &sched, CDevTask &task)
+{
+    CScheduledRun run;
+    run.m_pSched = &sched;
+    run.m_pTask = &task;
+    run.m_Err = CScheduledRun::NONE;
+#ifndef _WIN32
+    std::vector<pthread_t> threads;
+    for( DWORD i = 1; i < sched.workers(); i++)
+    {
+        pthread_t thread;
+        if( pthread_create( &thread, NULL, scheduledWorkerThread, &run) == 0)
+        {
+            threads.push_back( thread);
+        }
+    }
+    run.work(); // this thread is a worker too
+    for( size_t i = 0; i < threads.size(); i++)
+    {
+        pthread_join( threads[ i], NULL);
+    }
+#else
+    run.work();
+#endif
+    switch( run.m_Err)
+    {
+    case CScheduledRun::FATAL_DLL:  throw CFatalDllErr( run.m_Msg.c_str());
+    case CScheduledRun::DLL:        throw CDllErr( run.m_Msg.c_str());
+    case CScheduledRun::CUST:       throw CCustErr( run.m_Msg.c_str());
+    case CScheduledRun::NO_MEMORY:  throw std::bad_alloc();
+    default:                        break;
+    }
+}
+
+//---------------------------------------------------------------------------------
+const DWORD DefaultResetTargetMsec = 1000;
+const DWORD ResetWavePollMsec = 50;
+const DWORD ResetWaveMaxWaitMsec = 10000; // then the next wave goes anyway, and waitFor...() sort it out
+
+CResetWaves::CResetWaves( int argc, const char * argv[])
+{
+    m_Size        = isSpecified( argc, argv, "--reset-wave")    ? decimalParm( argc, argv, "--reset-wave")    : 0;
+    m_SpacingMsec = isSpecified( argc, argv, "--reset-spacing") ? decimalParm( argc, argv, "--reset-spacing") : 0;
+    m_TargetMsec  = isSpecified( argc, argv, "--reset-target")  ? decimalParm( argc, argv, "--reset-target")  : DefaultResetTargetMsec;
+}
+
+void resetInWaves( const CResetWaves &waves, const std::vector<std::string> &locations, DWORD count,
+                   CDevTask &reset, const CProfileOut &out)
+{
+    DWORD size = waves.m_Size;
+    DWORD wave = 0;
+    for( DWORD first = 0; first < count; wave++)
+    {
+        const DWORD end = std::min( count, first + size);
+        const DWORD startMsec = GetTickCount();
+        for( DWORD i = first; i < end; i++)
+        {
+            reset.run( i);
+        }
+
+        char msg[ 128];
+        if( locations.size() == count)
+        {
+            // one enumeration a poll for the whole wave; whatever fails, the devices
+            // aren't back yet until the wave's time is up
+            std::vector<std::string> waiting( locations.begin() + first, locations.begin() + end);
+            DWORD left = end - first;
+            while( left && GetTickCount() - startMsec < ResetWaveMaxWaitMsec)
+            {
+                delayMsec( ResetWavePollMsec);
+                std::vector<bool> back;
+                if( LibSpecificFindLocations( waiting, back))
+                {
+                    for( size_t i = waiting.size(); i-- > 0; )
+                    {
+                        if( back[ i])
+                        {
+                            waiting.erase( waiting.begin() + i);
+                            left--;
+                        }
+                    }
+                }
+            }
+            const DWORD backMsec = GetTickCount() - startMsec;
+            if( left)
+            {
+                sprintf( msg, "INFO: reset wave %u: %u of %u devices not back after %u ms", wave + 1, left, end - first, backMsec);
+                out.warn( msg);
+            }
+            else
+            {
+                sprintf( msg, "reset wave %u: %u device%s, back in %u ms", wave + 1, end - first, end - first == 1 ? "" : "s", backMsec);
+                out.print( msg);
+            }
+            size = !left && backMsec <= waves.m_TargetMsec ? size + waves.m_Size : std::max( size / 2, static_cast<DWORD>( 1));
+        }
+        else
+        {
+            sprintf( msg, "reset wave %u: %u device%s", wave + 1, end - first, end - first == 1 ? "" : "s"); // nowhere to wait for them
+            out.print( msg);
+        }
+        first = end;
+        if( first < count)
+        {
+            delayMsec( waves.m_SpacingMsec);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------
+void setPorts( int argc, const char * argv[])
+{
+    std::string ports; // every port unless --ports, smtd's last job may have had it
+    isSpecified( argc, argv, "--ports", ports);
+    LibSpecificSetPorts( ports);
+}
+void setMaxOpen( int argc, const char * argv[])
+{
+    DWORD maxOpen = 0; // no limit unless --max-open, smtd's last job may have had one
+    if( isSpecified( argc, argv, "--max-open"))
+    {
+        maxOpen = decimalParm( argc, argv, "--max-open");
+        if( !maxOpen)
+        {
+            throw CUsageErr( "--max-open needs at least 1 device");
+        }
+    }
+    g_HandlePool.setMax( maxOpen);
+}
+void setContextPerBus( int argc, const char * argv[])
+{
+    LibSpecificSetContextPerBus( isSpecified( argc, argv, "--context-per-bus"));
+}
+
+//---------------------------------------------------------------------------------
+volatile bool g_JobCancelled = false;
+DWORD g_MaxVerifyAttempts = 0;
+CProfileOut g_BusOut;
+
+//---------------------------------------------------------------------------------
+CHandlePool g_HandlePool;
+
+struct CHandlePool::CSlot
+{
+    std::string m_Location;
+    HANDLE      m_H;            // NULL while closed
+    std::list<CSlot *>::iterator m_Pos; // in m_Open while open
+};
+namespace
+{
+CThreadId currentThread()
+{
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return pthread_self();
+#endif
+}
+bool isThread( CThreadId a, CThreadId b)
+{
+#ifdef _WIN32
+    return a == b;
+#else
+    return pthread_equal( a, b) != 0;
+#endif
+}
+}
+void CHandlePool::reserve()
+{
+    m_Lock.Lock();
+    makeRoom();
+    m_Lock.Unlock();
+}
+CHandlePool::CSlot *CHandlePool::add( const std::string &location, HANDLE h)
+{
+    CSlot *pSlot = new CSlot;
+    pSlot->m_Location = location;
+    pSlot->m_H = h;
+    m_Lock.Lock();
+    makeRoom();
+    m_Open.push_front( pSlot);
+    pSlot->m_Pos = m_Open.begin();
+    m_Lock.Unlock();
+    return pSlot;
+}
+HANDLE CHandlePool::acquire( CSlot *pSlot)
+{
+    m_Lock.Lock();
+    try
+    {
+        if( pSlot->m_H)
+        {
+            m_Open.splice( m_Open.begin(), m_Open, pSlot->m_Pos);
+        }
+        else
+        {
+            makeRoom();
+            pSlot->m_H = LibSpecificOpen( pSlot->m_Location);
+            if( !pSlot->m_H)
+            {
+                throw CCustErr( ( "the device at " + pSlot->m_Location + " is gone").c_str());
+            }
+            m_Open.push_front( pSlot);
+            pSlot->m_Pos = m_Open.begin();
+        }
+        const CThreadId self = currentThread();
+        size_t i = 0;
+        while( i < m_Pins.size() && !isThread( m_Pins[ i].first, self))
+        {
+            i++;
+        }
+        if( i == m_Pins.size())
+        {
+            m_Pins.push_back( std::make_pair( self, pSlot));
+        }
+        m_Pins[ i].second = pSlot;
+    }
+    catch( ...)
+    {
+        m_Lock.Unlock();
+        throw;
+    }
+    const HANDLE h = pSlot->m_H;
+    m_Lock.Unlock();
+    return h;
+}
+void CHandlePool::replace( CSlot *pSlot, HANDLE h)
+{
+    m_Lock.Lock();
+    if( pSlot->m_H && !h)
+    {
+        m_Open.erase( pSlot->m_Pos);
+    }
+    else if( !pSlot->m_H && h)
+    {
+        m_Open.push_front( pSlot);
+        pSlot->m_Pos = m_Open.begin();
+    }
+    pSlot->m_H = h;
+    m_Lock.Unlock();
+}
+void CHandlePool::remove( CSlot *pSlot)
+{
+    m_Lock.Lock();
+    if( pSlot->m_H)
+    {
+        m_Open.erase( pSlot->m_Pos);
+        LibSpecificClose( pSlot->m_H);
+    }
+    for( size_t i = m_Pins.size(); i-- > 0; )
+    {
+        if( m_Pins[ i].second == pSlot)
+        {
+            m_Pins.erase( m_Pins.begin() + i);
+        }
+    }
+    m_Lock.Unlock();
+    delete pSlot;
+}
+void CHandlePool::unpin()
+{
+    const CThreadId self = currentThread();
+    m_Lock.Lock();
+    for( size_t i = m_Pins.size(); i-- > 0; )
+    {
+        if( isThread( m_Pins[ i].first, self))
+        {
+            m_Pins.erase( m_Pins.begin() + i);
+        }
+    }
+    m_Lock.Unlock();
+}
+const std::string &CHandlePool::location( const CSlot *pSlot)
+{
+    return pSlot->m_Location;
+}
+// closes the least recently used devices no thread holds on to until there is room
+// for one more, called with m_Lock held
+void CHandlePool::makeRoom()
+{
+    std::list<CSlot *>::iterator it = m_Open.end();
+    while( m_Max && m_Open.size() >= m_Max && it != m_Open.begin())
+    {
+        --it;
+        if( isPinned( *it))
+        {
+            continue;
+        }
+        CSlot *pSlot = *it;
+        it = m_Open.erase( it);
+        LibSpecificClose( pSlot->m_H);
+        pSlot->m_H = NULL;
+    }
+}
+bool CHandlePool::isPinned( const CSlot *pSlot) const
+{
+    for( size_t i = 0; i < m_Pins.size(); i++)
+    {
+        if( m_Pins[ i].second == pSlot)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Enumerates the bus once for all profiles and runs them, concurrently if there are
+// several. A batch of several profiles ends with a report of each one's outcome.
+void runProfiles( const std::vector<std::string> &fileNames, const std::vector<CProfile *> &profiles)
+{
+    CBusSnapshot bus;
+    for( size_t i = 0; i < profiles.size(); i++)
+    {
+        if( profiles.size() > 1)
+        {
+            profiles[ i]->setName( fileNames[ i]);
+        }
+        profiles[ i]->claim( bus);
+    }
+    bus.closeRest();
+
+    if( profiles.size() == 1)
+    {
+        profiles[ 0]->run();
+        return;
+    }
+
+    std::vector<CProfileRun> runs( profiles.size());
+    for( size_t i = 0; i < runs.size(); i++)
+    {
+        runs[ i].m_pProfile = profiles[ i];
+        runs[ i].m_Name = fileNames[ i];
+        runs[ i].m_Ok = false;
+    }
+#ifdef _WIN32
+    for( size_t i = 0; i < runs.size(); i++)
+    {
+        runGuarded( runs[ i]);
+    }
+#else
+    std::vector<pthread_t> threads( runs.size());
+    std::vector<bool> started( runs.size());
+    for( size_t i = 0; i < runs.size(); i++)
+    {
+        started[ i] = pthread_create( &threads[ i], NULL, runGuardedThread, &runs[ i]) == 0;
+        if( !started[ i])
+        {
+            runGuarded( runs[ i]);
+        }
+    }
+    for( size_t i = 0; i < runs.size(); i++)
+    {
+        if( started[ i])
+        {
+            pthread_join( threads[ i], NULL);
+        }
+    }
+#endif
+
+    DWORD failedCnt = 0;
+    printf( "--- batch ----------------\n");
+    for( size_t i = 0; i < runs.size(); i++)
+    {
+        printf( "%s: %s\n", runs[ i].m_Name.c_str(), runs[ i].m_Ok ? "OK" : "FAILED");
+        failedCnt += runs[ i].m_Ok ? 0 : 1;
+    }
+    printf( "--------------------------\n");
+    if( failedCnt)
+    {
+        char msg[ 128];
+        sprintf( msg, "%u of %u profiles failed", failedCnt, static_cast<DWORD>( runs.size()));
+        throw CCustErr( msg);
+    }
+}
+
+// The whole command; smtd runs one per job of its clients
+int smtMain( int argc, const char * argv[])
 {
     if( argc == 1 || isSpecified( argc, argv, "--help"))
     {
@@ -190,10 +1209,40 @@ int main( int argc, const char * argv[])
     try
     {
         g_EchoParserReads = isSpecified( argc, argv, "--verbose");
-        redirStdinToCfgFile( argc, argv);
-        const CDevType  devType = readDevType();
-        const CVidPid   vidPid  = readVidPid();
-        LibSpecificMain( devType, vidPid, argc, argv);
+        setPorts( argc, argv);
+        setMaxOpen( argc, argv);
+        setContextPerBus( argc, argv);
+        const std::vector<std::string> fileNames = cfgFileNames( argc, argv);
+        const bool compile = isSpecified( argc, argv, "--compile");
+        CDevVector<CProfile> profiles;
+        for( size_t i = 0; i < fileNames.size(); i++)
+        {
+            const bool cache = openCachedCfgFile( fileNames[ i], compile);
+            if( compile || cache)
+            {
+                g_CfgFile.startImage();
+            }
+            const CDevType  devType = readDevType();
+            const CVidPid   vidPid  = readVidPid();
+            profiles.push_back( LibSpecificProfile( devType, vidPid, argc, argv,
+                                                    static_cast<DWORD>( i), static_cast<DWORD>( fileNames.size())));
+            if( cache)
+            {
+                storeCachedCfgFile();
+            }
+        }
+        if( compile)
+        {
+            writeCompiledCfgFile( argc, argv);
+        }
+        else if( isSpecified( argc, argv, "--dump-config"))
+        {
+            dumpProfiles( profiles);
+        }
+        else
+        {
+            runProfiles( fileNames, profiles);
+        }
         rc = 0;
     }
     catch( const CDllErr e)
@@ -209,8 +1258,9 @@ int main( int argc, const char * argv[])
         std::cerr << e.msg() << "\n\n";
         printCmdLineHelp();
     }
-    catch( const CSyntErr )
+    catch( const CSyntErr e)
     {
+        std::cerr << "ERROR: " << e.msg() << "\n";
     }
     catch( const std::bad_alloc& ba)
     {
@@ -343,22 +1393,18 @@ void CSerNumSet::assertUniquness() const
         }
     }
 }
-void CSerNumSet::write() const
+void CSerNumSet::write( const CProfileOut &out) const
 {
     if( m_SN.empty())
     {
         return;
     }
-    printf( "--- new serial numbers ---\n");
+    out.print( "--- new serial numbers ---");
     for( size_t i = 0; i < m_SN.size(); i++)
     {
-        for( size_t j = 0; j < m_SN[ i].size(); j++)
-        {
-            printf( "%c", m_SN[ i][ j]);
-        }
-        printf( "\n");
+        out.print( std::string( m_SN[ i].begin(), m_SN[ i].end()));
     }
-    printf( "--------------------------\n");
+    out.print( "--------------------------");
 }
 bool CSerNumSet::findAndErase( const std::vector< BYTE> &sN)
 {
@@ -384,6 +1430,38 @@ bool isSpecified( int argc, const char * argv[], const std::string &parmName)
     }
     return false;
 }
+DWORD decimalParm( int argc, const char * argv[], const std::string &parmName, DWORD index, DWORD count)
+{
+    if( count == 1)
+    {
+        return decimalParm( argc, argv, parmName);
+    }
+    for( int i = 0; i < argc - 1; i++)
+    {
+        if( std::string( argv[ i]) == parmName)
+        {
+            const char *p = argv[ i + 1];
+            for( DWORD j = 0; j < count; j++)
+            {
+                char *end;
+                unsigned long rc = strtoul( p, &end, 10);
+                if( !rc || rc == ULONG_MAX || end == p || (*end != ',' && *end != '\0') ||
+                    (j + 1 < count) != (*end == ','))
+                {
+                    break;
+                }
+                if( j == index)
+                {
+                    return rc;
+                }
+                p = end + 1;
+            }
+        }
+    }
+    char msg[ 32];
+    sprintf( msg, "%u", count);
+    throw CUsageErr( std::string( "Invalid or missing ") + parmName + " command line option, it needs " + msg + " comma separated counts");
+}
 DWORD decimalParm( int argc, const char * argv[], const std::string &parmName)
 {
     for( int i = 0; i < argc; i++)
@@ -404,7 +1482,43 @@ DWORD decimalParm( int argc, const char * argv[], const std::string &parmName)
     throw CUsageErr( std::string( "Invalid or missing ") + parmName + " command line option");
 }
 //---------------------------------------------------------------------------------
-void waitForTotalDeviceCount( const CVidPid &oldVidPid, const CVidPid &newVidPid, DWORD expectedCount)
+// one fputs() per line, stdio doesn't interleave those of concurrent threads
+void CProfileOut::print( const std::string &line) const
+{
+    if( m_pSink)
+    {
+        m_pSink->line( false, m_Prefix + line);
+        return;
+    }
+    fputs( ( m_Prefix + line + "\n").c_str(), stdout);
+}
+void CProfileOut::warn( const std::string &line) const
+{
+    if( m_pSink)
+    {
+        m_pSink->line( true, m_Prefix + line);
+        return;
+    }
+    fputs( ( m_Prefix + line + "\n").c_str(), stderr);
+}
+void CProfileOut::device( EStep step, HANDLE h, const std::vector<BYTE> &serNum, const std::string &err) const
+{
+    if( m_pSink)
+    {
+        std::string location;
+        try
+        {
+            location = LibSpecificLocation( h);
+        }
+        catch( const CDllErr &)
+        {
+            // reported without
+        }
+        m_pSink->device( step, location, toString( serNum), err);
+    }
+}
+//---------------------------------------------------------------------------------
+void waitForTotalDeviceCount( const CVidPid &oldVidPid, const CVidPid &newVidPid, DWORD expectedCount, const CProfileOut &out)
 {
 #ifdef _WIN32
 #pragma warning(suppress : 4127)
@@ -416,11 +1530,13 @@ void waitForTotalDeviceCount( const CVidPid &oldVidPid, const CVidPid &newVidPid
         const DWORD NumDevs = LibSpecificNumDevices( oldVidPid, newVidPid);
         if( NumDevs == expectedCount) 
         {
-            printf( "waiting 3 sec...\n");
+            out.print( "waiting 3 sec...");
             delayMsec( 3000); // TODO - either this or extra retry messages on screen
             return;
         }
-        std::cerr << "INFO: Waiting. " << NumDevs << " devices found, need " << expectedCount << "\n";
+        char msg[ 128];
+        sprintf( msg, "INFO: Waiting. %u devices found, need %u", NumDevs, expectedCount);
+        out.warn( msg);
         delayMsec( 1000);
     }
     throw CCustErr( "devices failed to reboot after reset"); // dead code
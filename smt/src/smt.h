@@ -16,16 +16,39 @@
 #include "OsDep.h"
 #endif
 #include <errno.h> // for errno
+#include <algorithm>
+#include <list>
 #include "stdio.h"
 #include "CErr.h"
+#include "CriticalSectionLock.h"
 
 #ifdef verify
 #undef verify
 #endif
 
+// set by smtd when the client of the job went away
+extern volatile bool g_JobCancelled;
+// at most that many verification attempts, 0 for no limit; set by smtd only
+extern DWORD g_MaxVerifyAttempts;
+
+#define CANCEL_POLL_MSEC 100
+
+// every wait of a job on its devices goes through here, so it can be cancelled
 inline void delayMsec( DWORD msec)
 {
-    Sleep( msec);
+    for( ;; msec -= CANCEL_POLL_MSEC)
+    {
+        if( g_JobCancelled)
+        {
+            throw CCancelErr();
+        }
+        if( msec <= CANCEL_POLL_MSEC)
+        {
+            Sleep( msec);
+            break;
+        }
+        Sleep( CANCEL_POLL_MSEC);
+    }
 }
 
 
@@ -38,6 +61,50 @@ inline void setSpecified( bool &specified, const std::string &parmName)
     }
     specified = true;
 }
+// Throws if the string value of parmName has more than maxCch characters
+inline void validateStrLen( const std::string &parmName, const std::vector<BYTE> &str, bool isAscii, DWORD maxCch)
+{
+    const DWORD cch = static_cast<DWORD>( str.size() / (isAscii ? 1 : 2));
+    if( cch > maxCch)
+    {
+        char msg[ 128];
+        sprintf( msg, ": %u characters, the device type takes at most %u", cch, maxCch);
+        throw CUsageErr( parmName + msg);
+    }
+}
+
+//-----------------------------------------------------------------------
+// Where the messages of a profile go. The profiles of a batch run concurrently, so
+// there each line is prefixed with the profile's configuration file and written at once.
+class CProfileSink;
+class CProfileOut
+{
+public:
+    enum EStep { PROGRAM, VERIFY, LOCK }; // as SMT_STEP of libsmt.h
+    CProfileOut() : m_pSink( NULL) {}
+    void setPrefix( const std::string &prefix) { m_Prefix = prefix; }
+    void setSink( CProfileSink *pSink) { m_pSink = pSink; }
+    void print( const std::string &line) const;    // to stdout
+    void warn( const std::string &line) const;     // to stderr
+    // the outcome of a step on a device, err empty if it succeeded; only a sink takes it,
+    // so reading more of the device to report it is only worth it if one does
+    bool wantsDevices() const { return m_pSink != NULL; }
+    void device( EStep step, HANDLE h, const std::vector<BYTE> &serNum, const std::string &err) const;
+private:
+    std::string m_Prefix;
+    CProfileSink *m_pSink;
+};
+// Takes the lines and device outcomes of a profile in place of stdout and stderr, for libsmt
+class CProfileSink
+{
+public:
+    virtual ~CProfileSink() {}
+    virtual void line( bool isError, const std::string &line) = 0;
+    virtual void device( CProfileOut::EStep step, const std::string &location, const std::string &serNum, const std::string &err) = 0;
+};
+// the messages of the bus and its devices outside any profile; libsmt points it
+// at the sink of the batch
+extern CProfileOut g_BusOut;
 
 //-----------------------------------------------------------------------
 // ctor reads SNs from command line or auto-generates if command line says so
@@ -46,7 +113,9 @@ struct CSerNumSet
 {
     // analyzes the command line; if requested, creates a set of SNs
     CSerNumSet( int argc, const char * argv[], bool mayAutoGen, DWORD requiredCnt);
-    void write() const;
+    // the one SN a device must have
+    explicit CSerNumSet( const std::vector< BYTE> &sN) : m_AreNeeded( true), m_SN( 1, sN) {}
+    void write( const CProfileOut &out) const;
     size_t size() const { return m_SN.size(); }
     bool empty() const { return m_SN.empty(); }
     const std::vector< BYTE>& at( DWORD index) const { return m_SN[ index ]; }
@@ -59,10 +128,53 @@ private:
 };
 
 //-----------------------------------------------------------------------
+// A step of a --script file. Each line holds one: a name, then the argument of
+// pause and run. # starts a comment.
+//   program         programs the devices
+//   reset           resets them, their handles are gone until the next wait
+//   wait            waits for them to come back where they are plugged in, reopens them
+//   reopen [msec]   resets each one and reopens it as soon as it is back at its port
+//   verify          verifies them, each against the serial number programmed there
+//   lock            locks them, only after a verify
+//   pause [msec]    sleeps, or waits for Enter without msec
+//   run command     runs the shell command, see runScriptHook()
+#define SCRIPT_REOPEN_MSEC  10000
+struct CScriptStep
+{
+    enum EKind { PROGRAM, RESET, WAIT, REOPEN, VERIFY, LOCK, PAUSE, RUN };
+    EKind       m_Kind;
+    DWORD       m_Msec;     // of pause, 0 waits for Enter; of reopen, how long a device may take
+    std::string m_Command;  // of run
+    DWORD       m_Line;
+    std::string m_Text;     // the line, for the progress output
+};
+// the steps of the --script file, none without --script; throws CUsageErr if the
+// file can't be read or a step can't be carried out where it is
+std::vector<CScriptStep> readScript( int argc, const char * argv[]);
+// runs the command of a run step with SMT_DEVICES set to the devices' "location=serial
+// number" words, throws CCustErr if it fails
+void runScriptHook( const CScriptStep &step, const std::string &devices);
+// sleeps for a pause step, or waits for Enter
+void pauseScript( const CScriptStep &step, const CProfileOut &out);
+
+//-----------------------------------------------------------------------
+void printCmdLineHelp();
 // check if one of command line arguments is equal to the string
 bool isSpecified( int argc, const char * argv[], const std::string &parmName);
+// and if so, return the next one, throw CUsageErr if there is none
+bool isSpecified( int argc, const char * argv[], const std::string &parmName, std::string &fName);
 // find a command line argument equal to the string and convert the next one to DWORD, throw CUsageErr otherwise
 DWORD decimalParm( int argc, const char * argv[], const std::string &parmName);
+// the index-th of count comma separated values of the argument, one value is enough if count is 1
+DWORD decimalParm( int argc, const char * argv[], const std::string &parmName, DWORD index, DWORD count);
+// limits the devices the library sees to the ports of --ports, all of them without it
+void setPorts( int argc, const char * argv[]);
+// limits the devices open at once to --max-open, no limit without it
+void setMaxOpen( int argc, const char * argv[]);
+// opens the devices of each bus in a library context of its own with --context-per-bus
+void setContextPerBus( int argc, const char * argv[]);
+// the output file of --compile, throw CUsageErr if it's missing
+std::string compiledFileName( int argc, const char * argv[]);
 
 //-----------------------------------------------------------------------
 // Identifies a specific device within a family of devices supported by the same customization lib.
@@ -83,12 +195,37 @@ struct CVidPid
     const WORD m_Pid;
 };
 
+// the head of the configuration file, the device type and VID/PID its devices are filtered by
+CDevType readDevType();
+CVidPid readVidPid();
+
 //-----------------------------------------------------------------------
 // These functions must be implemented in the library-specific module
 //
 DWORD LibSpecificNumDevices( const CVidPid &oldVidPid, const CVidPid &newVidPid);
-// This func must call the templated DevSpecificMain with device-specific types
-void LibSpecificMain( const CDevType &devType, const CVidPid &vidPid, int argc, const char * argv[]);
+// limits enumeration to the devices at the ports of the patterns, every port if empty; throws CUsageErr if malformed
+void LibSpecificSetPorts( const std::string &ports);
+// whether the devices of each bus are opened in a library context of their own
+void LibSpecificSetContextPerBus( bool perBus);
+// where the open device is plugged in, empty if the library can't tell
+std::string LibSpecificLocation( HANDLE h);
+// opens the device plugged in at the location, NULL if there is none (yet)
+HANDLE LibSpecificOpen( const std::string &location);
+void LibSpecificClose( HANDLE h);
+// sets found[ i] for each of the locations where a device can be opened, from one enumeration;
+// false if the library can't tell
+bool LibSpecificFindLocations( const std::vector<std::string> &locations, std::vector<bool> &found);
+// opens a handle on which the setters capture the transfers that program devType
+HANDLE LibSpecificOpenPlan( const CDevType &devType);
+// sends the plan's transfers to the device, with pSerNum instead of the plan's serial number
+void LibSpecificRunPlan( HANDLE plan, HANDLE h, const std::vector<BYTE> *pSerNum);
+// one line per transfer of the plan; adds up the bytes they carry
+std::vector<std::string> LibSpecificPlanTransfers( HANDLE plan, DWORD &bytes);
+// the requests sent to the open device so far
+DWORD LibSpecificRequestCount( HANDLE h);
+class CProfile;
+// This func must create the templated CDevProfile with device-specific types
+CProfile *LibSpecificProfile( const CDevType &devType, const CVidPid &vidPid, int argc, const char * argv[], DWORD index, DWORD count);
 
 //---------------------------------------------------------------------------------
 // A helper class for CDevSet, to associate a dtor with the vector of device pointers, that deletes
@@ -98,6 +235,7 @@ void LibSpecificMain( const CDevType &devType, const CVidPid &vidPid, int argc,
 template< class TDev >
 struct CDevVector : public std::vector< TDev*>
 {
+    CDevVector() {}
     ~CDevVector()
     {
         for( size_t i = 0; i < std::vector< TDev*>::size(); i++)
@@ -105,6 +243,82 @@ struct CDevVector : public std::vector< TDev*>
             delete std::vector<TDev*>::at( i);
         }
     }
+private:
+    // a copy would delete the devices a second time
+    CDevVector( const CDevVector &);
+    CDevVector &operator=( const CDevVector &);
+};
+
+//---------------------------------------------------------------------------------
+// The open devices of the process, at most --max-open of them at a time, so that a
+// rig of hundreds of units doesn't run into the file descriptor limit or hold usbfs
+// memory for idle ones. A device added to the pool is closed when it is the least
+// recently used one and another needs its place, and opened again where it is plugged
+// in when it is used next. The device a thread used last stays open, so that no other
+// thread closes it in the middle of a request; the pool exceeds its limit rather than
+// close one of those. Without --max-open nothing is added and every device stays open.
+#ifdef _WIN32
+typedef DWORD CThreadId;
+#else
+typedef pthread_t CThreadId;
+#endif
+class CHandlePool
+{
+public:
+    struct CSlot;   // a device in the pool
+    CHandlePool() : m_Max( 0) {}
+    void setMax( DWORD maxOpen) { m_Max = maxOpen; }
+    bool enabled() const { return m_Max != 0; }
+    // closes devices until there is room for one more, before opening one to add
+    void reserve();
+    // takes over h, the open device plugged in at the location
+    CSlot *add( const std::string &location, HANDLE h);
+    // the handle of the device, opened again if it was closed; throws CCustErr if it is gone
+    HANDLE acquire( CSlot *pSlot);
+    // the device was reopened with h, NULL if it is closed
+    void replace( CSlot *pSlot, HANDLE h);
+    // closes the device and forgets it
+    void remove( CSlot *pSlot);
+    // lets the device the calling thread used last be closed, when the thread is done
+    void unpin();
+    static const std::string &location( const CSlot *pSlot);
+private:
+    void makeRoom();
+    bool isPinned( const CSlot *pSlot) const;
+    DWORD m_Max;
+    std::list<CSlot *> m_Open;  // most recently used first
+    std::vector< std::pair<CThreadId, CSlot *> > m_Pins;
+    CCriticalSectionLock m_Lock;
+};
+extern CHandlePool g_HandlePool;
+
+//---------------------------------------------------------------------------------
+// All devices exposed by the customization lib, opened once per run and shared by
+// its profiles. A CDevSet built from the snapshot takes over the devices it selects.
+// With the handle pool, the snapshot closes the devices once it knows what they are
+// and opens the ones a CDevSet takes again. Implemented in the library-specific module.
+class CBusSnapshot
+{
+public:
+    CBusSnapshot();
+    ~CBusSnapshot();
+    DWORD size() const { return static_cast<DWORD>( m_Devs.size()); }
+    // the handle of device i if it matches and wasn't taken yet, NULL otherwise
+    HANDLE take( DWORD i, const CDevType &devType, const CVidPid &vidPid);
+    // closes the devices no profile took
+    void closeRest();
+private:
+    struct CBusDev
+    {
+        HANDLE  h;
+        std::string location;   // of a device closed for the handle pool until taken
+        BYTE    partNum;
+        WORD    vid;
+        WORD    pid;
+    };
+    std::vector<CBusDev> m_Devs;
+    CCriticalSectionLock m_Lock;
+    CPortLocks m_PortLocks; // of the devices opened, held as long as the snapshot
 };
 
 //---------------------------------------------------------------------------------
@@ -116,71 +330,339 @@ class CDevSet
 {
 public:
     CDevSet( const CDevType &FilterDevType, const CVidPid &FilterVidPid, bool allowLocked = false);
+    CDevSet( const CDevType &FilterDevType, const CVidPid &FilterVidPid, CBusSnapshot &bus, bool allowLocked = false);
+    // only the devices plugged in at the locations, leaving all others alone; every device if there are none
+    CDevSet( const CDevType &FilterDevType, const CVidPid &FilterVidPid, const std::vector<std::string> &locations, bool allowLocked = false);
     DWORD size() const { return static_cast<DWORD>( m_DevSet.size()); }
     const TDev& at( size_t i) const { return *m_DevSet[ i]; }
-    void printDevInfo() const;
+    TDev& at( size_t i) { return *m_DevSet[ i]; }
+    // where the devices are plugged in, empty if the library can't tell for any of them
+    std::vector<std::string> locations() const;
+    void printDevInfo( const CProfileOut &out) const;
 private:
+    void addAll( const CDevType &FilterDevType, const CVidPid &FilterVidPid, bool allowLocked);
+    void addIfMatches( TDev *pDev, const CDevType &FilterDevType, const CVidPid &FilterVidPid, bool allowLocked);
     CDevVector<TDev> m_DevSet;
 };
 template< class TDev >
 CDevSet<TDev>::CDevSet( const CDevType &FilterDevType, const CVidPid &FilterVidPid, bool allowLocked)
+{
+    addAll( FilterDevType, FilterVidPid, allowLocked);
+}
+template< class TDev >
+void CDevSet<TDev>::addAll( const CDevType &FilterDevType, const CVidPid &FilterVidPid, bool allowLocked)
 {
     DWORD NumDevs = LibSpecificNumDevices( FilterVidPid, FilterVidPid);
 
     ASSERT( m_DevSet.empty());
     for( DWORD i = 0; i < NumDevs; i++)
     {
-        TDev *pDev = new TDev( FilterVidPid, i);
-        const CDevType devType = pDev->getDevType();
-        const CVidPid  vidPid  = pDev->getVidPid();
-        if( FilterDevType.Value() == devType.Value() &&
-            ( FilterVidPid.m_Vid == vidPid.m_Vid) &&
-            ( FilterVidPid.m_Pid == vidPid.m_Pid))
+        addIfMatches( new TDev( FilterVidPid, i), FilterDevType, FilterVidPid, allowLocked);
+    }
+}
+// takes over the device if it matches the filter, deletes it otherwise
+template< class TDev >
+void CDevSet<TDev>::addIfMatches( TDev *pDev, const CDevType &FilterDevType, const CVidPid &FilterVidPid, bool allowLocked)
+{
+    const CDevType devType = pDev->getDevType();
+    const CVidPid  vidPid  = pDev->getVidPid();
+    if( FilterDevType.Value() == devType.Value() &&
+        ( FilterVidPid.m_Vid == vidPid.m_Vid) &&
+        ( FilterVidPid.m_Pid == vidPid.m_Pid))
+    {
+        if( pDev->isLocked() && !allowLocked)
         {
-            if( pDev->isLocked() && !allowLocked)
-            {
-                delete pDev;
-                throw CCustErr( "Locked device found");
-            }
-            m_DevSet.push_back( pDev);
+            delete pDev;
+            throw CCustErr( "Locked device found");
         }
-        else
+        m_DevSet.push_back( pDev);
+    }
+    else
+    {
+        delete pDev;
+    }
+}
+template< class TDev >
+CDevSet<TDev>::CDevSet( const CDevType &FilterDevType, const CVidPid &FilterVidPid, CBusSnapshot &bus, bool allowLocked)
+{
+    ASSERT( m_DevSet.empty());
+    for( DWORD i = 0; i < bus.size(); i++)
+    {
+        const HANDLE h = bus.take( i, FilterDevType, FilterVidPid);
+        if( !h)
+        {
+            continue;
+        }
+        TDev *pDev = new TDev( h);
+        if( pDev->isLocked() && !allowLocked)
         {
             delete pDev;
+            throw CCustErr( "Locked device found");
+        }
+        m_DevSet.push_back( pDev);
+    }
+}
+template< class TDev >
+CDevSet<TDev>::CDevSet( const CDevType &FilterDevType, const CVidPid &FilterVidPid, const std::vector<std::string> &locations, bool allowLocked)
+{
+    if( locations.empty())
+    {
+        addAll( FilterDevType, FilterVidPid, allowLocked);
+        return;
+    }
+    ASSERT( m_DevSet.empty());
+    for( size_t i = 0; i < locations.size(); i++)
+    {
+        g_HandlePool.reserve();
+        const HANDLE h = LibSpecificOpen( locations[ i]);
+        if( h)
+        {
+            addIfMatches( new TDev( h), FilterDevType, FilterVidPid, allowLocked);
         }
     }
 }
 template< class TDev >
-void CDevSet<TDev>::printDevInfo() const
+std::vector<std::string> CDevSet<TDev>::locations() const
+{
+    std::vector<std::string> locations;
+    for( size_t i = 0; i < size(); i++)
+    {
+        const std::string location = at( i).location();
+        if( location.empty())
+        {
+            return std::vector<std::string>();
+        }
+        locations.push_back( location);
+    }
+    return locations;
+}
+template< class TDev >
+void CDevSet<TDev>::printDevInfo( const CProfileOut &out) const
 {
     for( size_t i = 0; i < size(); i++)
     {
         const CVidPid vidPid = at( i).getVidPid();
-        printf( "VID: %04x PID: %04x ", vidPid.m_Vid, vidPid.m_Pid);
-        printf( "Prod Str: %s ", toString( at( i).getProduct( true)).c_str());
-        printf( "Ser #: %s", toString( at( i).getSerNum( true)).c_str());
-        printf( "\n");
+        char ids[ 32];
+        sprintf( ids, "VID: %04x PID: %04x ", vidPid.m_Vid, vidPid.m_Pid);
+        std::string line = ids;
+        line += "Prod Str: " + toString( at( i).getProduct( true));
+        line += " Ser #: " + toString( at( i).getSerNum( true));
+        out.print( line);
     }
 }
+//---------------------------------------------------------------------------------
+// The limits of a parallel run: --parallel, --bus-limit and --hub-limit
+
+struct CSchedLimits
+{
+    CSchedLimits( int argc, const char * argv[]);
+    DWORD m_Workers;    // devices in flight, 1 runs them one after the other
+    DWORD m_PerBus;     // of them on a bus, its host controller
+    DWORD m_PerHub;     // of them behind a hub, sharing its transaction translator
+};
+
+// Hands out the devices of a parallel run by where they are plugged in. The buses
+// take turns, and so do the hubs of a bus, so that every host controller has work
+// and no hub's devices wait behind another's. CP210x parts are full-speed: behind
+// a high-speed hub they share its transaction translator, hence the per-hub limit.
+class CTopoScheduler
+{
+public:
+    // the devices' locations, or none if the library can't tell
+    CTopoScheduler( const std::vector<std::string> &locations, DWORD count, const CSchedLimits &limits);
+    ~CTopoScheduler();
+    DWORD workers() const { return m_Workers; }
+    // the next device the limits let in, waiting for others to be done if need be;
+    // false once all of them were handed out, or cancel() was called
+    bool next( DWORD &dev);
+    void done( DWORD dev);
+    void cancel();
+    // the limits, and the devices by bus and hub in the order they take turns
+    void print( const CProfileOut &out) const;
+private:
+    struct CHub
+    {
+        std::string         m_Name;
+        std::vector<DWORD>  m_Devs;
+        size_t              m_Next;     // of m_Devs to hand out
+        DWORD               m_InFlight;
+    };
+    struct CBus
+    {
+        std::string         m_Name;
+        std::vector<CHub>   m_Hubs;
+        size_t              m_NextHub;
+        DWORD               m_InFlight;
+    };
+    bool take( DWORD &dev);
+    const CSchedLimits  m_Limits;
+    DWORD               m_Workers;
+    std::vector<CBus>   m_Buses;
+    std::vector< std::pair<size_t, size_t> > m_DevHubs; // bus and hub of each device
+    DWORD               m_Left;
+    size_t              m_NextBus;
+#ifndef _WIN32
+    pthread_mutex_t     m_Mutex;
+    pthread_cond_t      m_Done;
+#endif
+};
+
+// What a parallel run does to a device
+class CDevTask
+{
+public:
+    virtual ~CDevTask() {}
+    virtual void run( DWORD dev) = 0;
+};
+// runs the task on the devices the scheduler hands out with its workers' threads; the
+// first failure stops the handing out and is rethrown once the devices in flight are done
+void runScheduled( CTopoScheduler &sched, CDevTask &task);
+
+//---------------------------------------------------------------------------------
+// Resets in waves, --reset-wave, --reset-spacing and --reset-target: resetting a
+// whole fixture at once has the hubs and the kernel re-enumerate it all at once,
+// and devices time out or go missing. A wave waits for its devices to be back
+// where they are plugged in before the next one goes, and the waves grow by the
+// initial size while they are back within the target time, and halve otherwise.
+
+struct CResetWaves
+{
+    CResetWaves( int argc, const char * argv[]);
+    DWORD m_Size;           // devices of the first wave, 0 resets them all at once
+    DWORD m_SpacingMsec;    // between a wave being back and the next one
+    DWORD m_TargetMsec;
+};
+// resets the devices, reset.run( i) resets device i; the locations, if the library can
+// tell them, are where the waves wait for their devices
+void resetInWaves( const CResetWaves &waves, const std::vector<std::string> &locations, DWORD count,
+                   CDevTask &reset, const CProfileOut &out);
+
+//---------------------------------------------------------------------------------
+// Registry of the customization parameters a device type supports beyond the common ones,
+// a list of parameter classes such as
+//     CParmList< CBaudRateConfig, CPortConfig >
+// Each parameter class provides
+//     bool readParm( const std::string &parmName);  parses the parameter if it's its name
+//     bool isSpecified() const;                     whether the configuration had it
+//     std::string keyword() const;                  its name in the configuration
+//     void program( const TDev &dev) const;
+//     void readBack( const TDev &dev);              replaces the values with the device's
+//     template< class TWriter > void save( TWriter &w) const;  writes the values
+//     template< class TCaps > void validate( const TCaps &caps) const;
+//                                                   checks it fits the device type
+// and the list does everything else for the whole set: a device matches a parameter
+// if the values read back from it save() the same. Calls are resolved at compile time,
+// in list order. Up to 8 parameters, the unused slots are CNoParm.
+
+struct CNoParm {};
+
+template< class TParm, class TDev >
+bool parmMatches( const TParm &parm, const TDev &dev)
+{
+    TParm devParm( parm);
+    devParm.readBack( dev);
+    CParmImage expected;
+    CParmImage found;
+    parm.save( expected);
+    devParm.save( found);
+    return expected.bytes() == found.bytes();
+}
+
+template< class T1 = CNoParm, class T2 = CNoParm, class T3 = CNoParm, class T4 = CNoParm,
+          class T5 = CNoParm, class T6 = CNoParm, class T7 = CNoParm, class T8 = CNoParm >
+struct CParmList : public CParmList< T2, T3, T4, T5, T6, T7, T8 >
+{
+    typedef CParmList< T2, T3, T4, T5, T6, T7, T8 > TTail;
+    bool readParm( const std::string &parmName)
+    {
+        return m_Head.readParm( parmName) || TTail::readParm( parmName);
+    }
+    template< class TDev >
+    void program( const TDev &dev) const
+    {
+        if( m_Head.isSpecified())
+        {
+            m_Head.program( dev);
+        }
+        TTail::program( dev);
+    }
+    // appends the keywords of the parameters the device doesn't match
+    template< class TDev >
+    void diff( const TDev &dev, std::vector<std::string> &names) const
+    {
+        if( m_Head.isSpecified() && !parmMatches( m_Head, dev))
+        {
+            names.push_back( m_Head.keyword());
+        }
+        TTail::diff( dev, names);
+    }
+    // the keyword of the first parameter the device doesn't match, empty if it matches them all
+    template< class TDev >
+    std::string firstMismatch( const TDev &dev) const
+    {
+        if( m_Head.isSpecified() && !parmMatches( m_Head, dev))
+        {
+            return m_Head.keyword();
+        }
+        return TTail::firstMismatch( dev);
+    }
+    template< class TWriter >
+    void save( TWriter &w) const
+    {
+        if( m_Head.isSpecified())
+        {
+            w.beginParm( m_Head.keyword());
+            m_Head.save( w);
+            w.endParm();
+        }
+        TTail::save( w);
+    }
+    template< class TCaps >
+    void validate( const TCaps &caps) const
+    {
+        if( m_Head.isSpecified())
+        {
+            m_Head.validate( caps);
+        }
+        TTail::validate( caps);
+    }
+    T1 m_Head;
+};
+template<>
+struct CParmList< CNoParm, CNoParm, CNoParm, CNoParm, CNoParm, CNoParm, CNoParm, CNoParm >
+{
+    bool readParm( const std::string &) { return false; }
+    template< class TDev > void program( const TDev &) const {}
+    template< class TDev > void diff( const TDev &, std::vector<std::string> &) const {}
+    template< class TDev > std::string firstMismatch( const TDev &) const { return std::string(); }
+    template< class TWriter > void save( TWriter &) const {}
+    template< class TCaps > void validate( const TCaps &) const {}
+};
+
 //---------------------------------------------------------------------------------
 // Manufacturer string customization availability varies by device, so it's extracted into a class
 // of its own, then included by each individual device type that supports it.
 
-template< class TDev >
+template< class TDev, bool TSupportsUnicode >
 struct CManufacturerString
 {
-    CManufacturerString( bool supportsUnicode) : m_SupportsUnicode( supportsUnicode) { m_Specified  = false; }
+    CManufacturerString() { m_Specified  = false; }
     bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return m_IsAscii ? "ManufacturerStringAscii" : "ManufacturerStringUnicode"; }
     void program( const TDev &dev) const;
-    void verify( const TDev &dev) const;
+    void readBack( const TDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const { w.putBytes( m_str); }
+    template< class TCaps >
+    void validate( const TCaps &caps) const { validateStrLen( keyword(), m_str, m_IsAscii, caps.MaxManufacturerStrLen); }
 private:
-    const bool  m_SupportsUnicode;
     bool        m_Specified;
     bool        m_IsAscii;
     std::vector<BYTE>  m_str;
 };
-template< class TDev >
-bool CManufacturerString<TDev>::readParm( const std::string &parmName)
+template< class TDev, bool TSupportsUnicode >
+bool CManufacturerString<TDev,TSupportsUnicode>::readParm( const std::string &parmName)
 {
     if( parmName == "ManufacturerStringAscii")
     {
@@ -190,7 +672,7 @@ bool CManufacturerString<TDev>::readParm( const std::string &parmName)
         readKeyword( "}"); // end of parameter list
         return true;
     }
-    else if( parmName == "ManufacturerStringUnicode" && m_SupportsUnicode)
+    else if( parmName == "ManufacturerStringUnicode" && TSupportsUnicode)
     {
         setSpecified( m_Specified, parmName);
         m_IsAscii    = false;
@@ -200,132 +682,307 @@ bool CManufacturerString<TDev>::readParm( const std::string &parmName)
     }
     return false;
 }
-template< class TDev >
-void CManufacturerString<TDev>::program( const TDev &dev) const
+template< class TDev, bool TSupportsUnicode >
+void CManufacturerString<TDev,TSupportsUnicode>::program( const TDev &dev) const
 {
-    if( !m_Specified) { return; }
     dev.setManufacturer( m_str, m_IsAscii);
 }
-template< class TDev >
-void CManufacturerString<TDev>::verify( const TDev &dev) const
+template< class TDev, bool TSupportsUnicode >
+void CManufacturerString<TDev,TSupportsUnicode>::readBack( const TDev &dev)
 {
-    if( !m_Specified) { return; }
-    if( m_str != dev.getManufacturer( m_IsAscii))
-    {
-        throw CCustErr( "Failed ManufacturerString verification");
-    }
+    m_str = dev.getManufacturer( m_IsAscii);
 }
 //---------------------------------------------------------------------------------
-// Common parameters for all devices
-// WARNING: program() doesn't program all items readParm() and verify() handle.
-// The rest of them is left to device-specific Parms::program().
+// The customization parameters every device type has, registered by CDevParms
+// ahead of the device-specific ones.
 
 template< class TDev >
-struct CDevParms
+struct CVidPidParm
 {
-    CDevParms()
-    {
-        m_VidPidSpecified     = false;
-        m_ProdStrSpecified    = false;
-        m_PowerModeSpecified  = false;
-        m_MaxPowerSpecified   = false;
-        m_DevVerSpecified     = false;
-    }
-    void read()
-    {
-        std::string parmName;
-        while( readWord( parmName))
-        {
-            readKeyword( "{"); // start of parameter list
-            readParm( parmName);
-        }
-    }
-    virtual bool supportsUnicode() const { return false; }
-    virtual void readParm( const std::string &parmName);
-    virtual void program( const TDev &dev, const std::vector<BYTE> *pSerNum) const;
-    virtual void verify( const TDev &dev, CSerNumSet &serNumSet) const;
-    bool    m_VidPidSpecified;
-    WORD    m_Vid;
-    WORD    m_Pid;
-    bool    m_ProdStrSpecified;
-    bool    m_ProdStrIsAscii;
-    std::vector<BYTE>  m_ProdStr;
-    bool    m_PowerModeSpecified;
-    BYTE    m_PowerMode;
-    bool    m_MaxPowerSpecified;
-    BYTE    m_MaxPower;
-    bool    m_DevVerSpecified;
-    WORD    m_DevVer;
-
-    void resetAll( const CDevSet<TDev> &devSet) const;
-    void programAll( const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet) const;
-    void verifyAll( const CDevSet<TDev> &devSet, CSerNumSet sSerNumSet) const;
-    void lockAll( const CDevSet<TDev> &devSet) const;
+    CVidPidParm() { m_Specified  = false; }
+    bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "VidPid"; }
+    void program( const TDev &dev) const { dev.setVidPid( m_Vid, m_Pid); }
+    void readBack( const TDev &dev);
+    template< class TWriter >
+    void save( TWriter &w) const { w.putUshort( m_Vid); w.putUshort( m_Pid); }
+    template< class TCaps >
+    void validate( const TCaps &) const {}
+    CVidPid value() const { return CVidPid( m_Vid, m_Pid); }
+private:
+    bool m_Specified;
+    WORD m_Vid;
+    WORD m_Pid;
 };
-
-void waitForTotalDeviceCount( const CVidPid &oldVidPid, const CVidPid &newVidPid, DWORD expectedCount);
-
 template< class TDev >
-void CDevParms<TDev>::readParm( const std::string &parmName)
+bool CVidPidParm<TDev>::readParm( const std::string &parmName)
 {
     if( parmName == "VidPid")
     {
-        setSpecified( m_VidPidSpecified, parmName);
+        setSpecified( m_Specified, parmName);
         m_Vid = readUshortParm();
         m_Pid = readUshortParm();
         readKeyword( "}"); // end of parameter list
+        return true;
     }
-    else if( parmName == "PowerMode")
+    return false;
+}
+template< class TDev >
+void CVidPidParm<TDev>::readBack( const TDev &dev)
+{
+    const CVidPid devVidPid = dev.getVidPid();
+    m_Vid = devVidPid.m_Vid;
+    m_Pid = devVidPid.m_Pid;
+}
+//---------------------------------------------------------------------------------
+template< class TDev, bool TSupportsUnicode >
+struct CProductString
+{
+    CProductString() { m_Specified  = false; }
+    bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return m_IsAscii ? "ProductStringAscii" : "ProductStringUnicode"; }
+    void program( const TDev &dev) const { dev.setProduct( m_str, m_IsAscii); }
+    void readBack( const TDev &dev) { m_str = dev.getProduct( m_IsAscii); }
+    template< class TWriter >
+    void save( TWriter &w) const { w.putBytes( m_str); }
+    template< class TCaps >
+    void validate( const TCaps &caps) const { validateStrLen( keyword(), m_str, m_IsAscii, caps.MaxProductStrLen); }
+private:
+    bool        m_Specified;
+    bool        m_IsAscii;
+    std::vector<BYTE>  m_str;
+};
+template< class TDev, bool TSupportsUnicode >
+bool CProductString<TDev,TSupportsUnicode>::readParm( const std::string &parmName)
+{
+    if( parmName == "ProductStringAscii")
     {
-        setSpecified( m_PowerModeSpecified, parmName);
-        m_PowerMode = readUcharParm();
+        setSpecified( m_Specified, parmName);
+        m_IsAscii    = true;
+        readByteArrayParm( m_str, MAX_UCHAR);
         readKeyword( "}"); // end of parameter list
+        return true;
     }
-    else if( parmName == "MaxPower")
+    else if( parmName == "ProductStringUnicode" && TSupportsUnicode)
     {
-        setSpecified( m_MaxPowerSpecified, parmName);
-        m_MaxPower = readUcharParm();
+        setSpecified( m_Specified, parmName);
+        m_IsAscii    = false;
+        readByteArrayParm( m_str, MAX_UCHAR);
         readKeyword( "}"); // end of parameter list
+        return true;
     }
-    else if( parmName == "DeviceVersion")
+    return false;
+}
+//---------------------------------------------------------------------------------
+template< class TDev >
+struct CPowerMode
+{
+    CPowerMode() { m_Specified  = false; }
+    bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "PowerMode"; }
+    void program( const TDev &dev) const { dev.setPowerMode( m_Mode); }
+    void readBack( const TDev &dev) { m_Mode = dev.getPowerMode(); }
+    template< class TWriter >
+    void save( TWriter &w) const { w.putUchar( m_Mode); }
+    template< class TCaps >
+    void validate( const TCaps &) const {}
+private:
+    bool m_Specified;
+    BYTE m_Mode;
+};
+template< class TDev >
+bool CPowerMode<TDev>::readParm( const std::string &parmName)
+{
+    if( parmName == "PowerMode")
     {
-        setSpecified( m_DevVerSpecified, parmName);
-        m_DevVer = readUshortParm();
+        setSpecified( m_Specified, parmName);
+        m_Mode = readUcharParm();
         readKeyword( "}"); // end of parameter list
+        return true;
     }
-    else if( parmName == "ProductStringAscii")
+    return false;
+}
+//---------------------------------------------------------------------------------
+template< class TDev >
+struct CMaxPower
+{
+    CMaxPower() { m_Specified  = false; }
+    bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "MaxPower"; }
+    void program( const TDev &dev) const { dev.setMaxPower( m_Power); }
+    void readBack( const TDev &dev) { m_Power = dev.getMaxPower(); }
+    template< class TWriter >
+    void save( TWriter &w) const { w.putUchar( m_Power); }
+    template< class TCaps >
+    void validate( const TCaps &) const {}
+private:
+    bool m_Specified;
+    BYTE m_Power;
+};
+template< class TDev >
+bool CMaxPower<TDev>::readParm( const std::string &parmName)
+{
+    if( parmName == "MaxPower")
     {
-        setSpecified( m_ProdStrSpecified, parmName);
-        m_ProdStrIsAscii   = true;
-        readByteArrayParm( m_ProdStr, MAX_UCHAR);
+        setSpecified( m_Specified, parmName);
+        m_Power = readUcharParm();
         readKeyword( "}"); // end of parameter list
+        return true;
     }
-    else if( parmName == "ProductStringUnicode" && supportsUnicode())
+    return false;
+}
+//---------------------------------------------------------------------------------
+template< class TDev >
+struct CDeviceVersion
+{
+    CDeviceVersion() { m_Specified  = false; }
+    bool readParm( const std::string &parmName);
+    bool isSpecified() const { return m_Specified; }
+    std::string keyword() const { return "DeviceVersion"; }
+    void program( const TDev &dev) const { dev.setDevVer( m_Version); }
+    void readBack( const TDev &dev) { m_Version = dev.getDevVer(); }
+    template< class TWriter >
+    void save( TWriter &w) const { w.putUshort( m_Version); }
+    template< class TCaps >
+    void validate( const TCaps &) const {}
+private:
+    bool m_Specified;
+    WORD m_Version;
+};
+template< class TDev >
+bool CDeviceVersion<TDev>::readParm( const std::string &parmName)
+{
+    if( parmName == "DeviceVersion")
     {
-        setSpecified( m_ProdStrSpecified, parmName);
-        m_ProdStrIsAscii   = false;
-        readByteArrayParm( m_ProdStr, MAX_UCHAR);
+        setSpecified( m_Specified, parmName);
+        m_Version = readUshortParm();
         readKeyword( "}"); // end of parameter list
+        return true;
     }
-    else
+    return false;
+}
+//---------------------------------------------------------------------------------
+// The customization parameters of a device type: the registry of the common ones and
+// TParmList, the registry of the ones specific to the type. The serial numbers come
+// from the command line rather than the configuration. A device library derives its
+// checks against the device type and, where a part needs it, its own program();
+// CDevProfile calls them on the derived type, there are no virtual functions.
+
+template< class TDev, class TParmList, bool TSupportsUnicode = false >
+struct CDevParms
+{
+    typedef CParmList< CVidPidParm<TDev>, CProductString<TDev,TSupportsUnicode>,
+                       CPowerMode<TDev>, CMaxPower<TDev>, CDeviceVersion<TDev> > TCommonParms;
+    void read();
+    void program( const TDev &dev, const std::vector<BYTE> *pSerNum) const;
+    // runs a transfer plan on each device, as many at once as the limits let
+    void programAll( const CDevType &devType, const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet,
+                     const CSchedLimits &limits, const CProfileOut &out) const;
+    // fails with the first parameter the device doesn't match
+    void verify( const TDev &dev, CSerNumSet &serNumSet) const;
+    // appends the keywords of the parameters the device doesn't match, serial number aside
+    void diff( const TDev &dev, std::vector<std::string> &names) const
+    {
+        m_Common.diff( dev, names);
+        m_Parms.diff( dev, names);
+    }
+    // checks the parameters and --lock against the device type, before any device is opened
+    void validate( const CDevType &, bool /*lock*/) const {}
+    // checks the serial numbers of the command line against the device type
+    void validate( const CDevType &, const CSerNumSet &) const {}
+    template< class TWriter >
+    void save( TWriter &w) const
+    {
+        m_Common.save( w);
+        m_Parms.save( w);
+    }
+    // the configuration's VidPid (which leads the common parameters), if it has one
+    bool vidPidSpecified() const { return m_Common.m_Head.isSpecified(); }
+    CVidPid vidPid() const { return m_Common.m_Head.value(); }
+protected:
+    TCommonParms m_Common;
+    TParmList    m_Parms;
+};
+
+void waitForTotalDeviceCount( const CVidPid &oldVidPid, const CVidPid &newVidPid, DWORD expectedCount, const CProfileOut &out);
+
+template< class TDev, class TParmList, bool TSupportsUnicode >
+void CDevParms<TDev,TParmList,TSupportsUnicode>::read()
+{
+    std::string parmName;
+    while( readWord( parmName))
     {
-        throw CSyntErr( std::string( "unknown customization parameter ") + parmName);
+        readKeyword( "{"); // start of parameter list
+        if( !m_Common.readParm( parmName) && !m_Parms.readParm( parmName))
+        {
+            throw CSyntErr( std::string( "unknown customization parameter ") + parmName);
+        }
     }
 }
-template< class TDev >
-void CDevParms<TDev>::program( const TDev &dev, const std::vector<BYTE> *pSerNum) const
+template< class TDev, class TParmList, bool TSupportsUnicode >
+void CDevParms<TDev,TParmList,TSupportsUnicode>::program( const TDev &dev, const std::vector<BYTE> *pSerNum) const
 {
     if( pSerNum)
     {
         dev.setSerNum( *pSerNum, true /*isAscii*/);
     }
-    if( m_ProdStrSpecified)
+    m_Common.program( dev);
+    m_Parms.program( dev);
+}
+// runs the plan on a device with its serial number and reports it
+template< class TDev >
+class CRunPlanTask : public CDevTask
+{
+public:
+    CRunPlanTask( HANDLE plan, const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet, const CProfileOut &out)
+        : m_Plan( plan), m_DevSet( devSet), m_SerNumSet( serNumSet), m_Out( out) {}
+    virtual void run( DWORD i)
+    {
+        const std::vector<BYTE> serNum = !m_SerNumSet.empty() ? m_SerNumSet.at( i) : std::vector<BYTE>();
+        try
+        {
+            LibSpecificRunPlan( m_Plan, m_DevSet.at( i).handle(), !m_SerNumSet.empty() ? &m_SerNumSet.at( i) : NULL);
+        }
+        catch( const CErrMsg &e)
+        {
+            m_Out.device( CProfileOut::PROGRAM, m_DevSet.at( i).handle(), serNum, e.msg());
+            throw;
+        }
+        m_Out.device( CProfileOut::PROGRAM, m_DevSet.at( i).handle(), serNum, "");
+    }
+private:
+    const HANDLE            m_Plan;
+    const CDevSet<TDev>    &m_DevSet;
+    const CSerNumSet       &m_SerNumSet;
+    const CProfileOut      &m_Out;
+};
+// The parameters go through the setters once, into a transfer plan that each device
+// then runs with its own serial number. The first one stands in while the plan is made.
+template< class TDev, class TParmList, bool TSupportsUnicode >
+void CDevParms<TDev,TParmList,TSupportsUnicode>::programAll( const CDevType &devType, const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet,
+                                                             const CSchedLimits &limits, const CProfileOut &out) const
+{
+    const TDev plan( LibSpecificOpenPlan( devType));
+    program( plan, !serNumSet.empty() ? &serNumSet.at( 0) : NULL);
+    CRunPlanTask<TDev> task( plan.handle(), devSet, serNumSet, out);
+    if( limits.m_Workers > 1 && devSet.size() > 1)
+    {
+        CTopoScheduler sched( devSet.locations(), devSet.size(), limits);
+        sched.print( out);
+        runScheduled( sched, task);
+        return;
+    }
+    for( DWORD i = 0; i < devSet.size(); i++)
     {
-        dev.setProduct( m_ProdStr, m_ProdStrIsAscii);
+        task.run( i);
     }
 }
-template< class TDev >
-void CDevParms<TDev>::verify( const TDev &dev, CSerNumSet &serNumSet) const
+template< class TDev, class TParmList, bool TSupportsUnicode >
+void CDevParms<TDev,TParmList,TSupportsUnicode>::verify( const TDev &dev, CSerNumSet &serNumSet) const
 {
     if( !serNumSet.empty())
     {
@@ -334,153 +991,687 @@ void CDevParms<TDev>::verify( const TDev &dev, CSerNumSet &serNumSet) const
             throw CCustErr( "Failed serial number verification");
         }
     }
-    if( m_VidPidSpecified)
+    std::string name = m_Common.firstMismatch( dev);
+    if( name.empty())
+    {
+        name = m_Parms.firstMismatch( dev);
+    }
+    if( !name.empty())
+    {
+        throw CCustErr( ( "Failed " + name + " verification").c_str());
+    }
+}
+//---------------------------------------------------------------------------------
+// One configuration file of a run. The constructor parses it, claim() checks the
+// command line for it and takes its devices from the bus snapshot, run() carries
+// out the commands. The profiles of a run claim one after another, so a usage error
+// or a wrong device count in any of them stops the run before anything is
+// programmed, and then run concurrently.
+class CProfile
+{
+public:
+    virtual ~CProfile() {}
+    virtual void claim( CBusSnapshot &bus) = 0;
+    virtual void run() = 0;
+    // the parameters of the configuration file as a JSON object
+    virtual std::string dump() const = 0;
+    // starts every line the profile prints with the name, for a batch
+    void setName( const std::string &name) { m_Out.setPrefix( name + ": "); }
+    void setSink( CProfileSink *pSink) { m_Out.setSink( pSink); }
+protected:
+    CProfileOut m_Out;
+};
+
+template< class TDev >
+class CResetTask : public CDevTask
+{
+public:
+    CResetTask( const CDevSet<TDev> &devSet) : m_DevSet( devSet) {}
+    virtual void run( DWORD i) { m_DevSet.at( i).reset(); }
+private:
+    const CDevSet<TDev> &m_DevSet;
+};
+
+// resets device i and takes over the handle it is reopened with
+template< class TDev >
+class CReopenTask : public CDevTask
+{
+public:
+    CReopenTask( CDevSet<TDev> &devSet, DWORD timeoutMsec) : m_DevSet( devSet), m_TimeoutMsec( timeoutMsec) {}
+    virtual void run( DWORD i) { m_DevSet.at( i).resetAndReopen( m_TimeoutMsec); }
+private:
+    CDevSet<TDev> &m_DevSet;
+    const DWORD    m_TimeoutMsec;
+};
+
+template< class TDev, class TDevParms >
+class CDevProfile : public CProfile
+{
+public:
+    CDevProfile( const CDevType &devType, const CVidPid &FilterVidPid, int argc, const char * argv[], DWORD index, DWORD count);
+    ~CDevProfile();
+    virtual void claim( CBusSnapshot &bus);
+    virtual void run();
+    virtual std::string dump() const
+    {
+        CParmJson json;
+        m_DevParms.save( json);
+        return json.text();
+    }
+private:
+    // If the cfg file doesn't specify a new vid-pid, it's not changing;
+    // so the new vid-pid is the same as filter vid-pid.
+    CVidPid newFilterVidPid() const
+    {
+        return m_DevParms.vidPidSpecified() ? m_DevParms.vidPid() : m_FilterVidPid;
+    }
+    bool vidPidChanges() const
     {
-        CVidPid devVidPid = dev.getVidPid();
-        if( devVidPid.m_Vid != m_Vid || devVidPid.m_Pid != m_Pid)
+        const CVidPid NewFilterVidPid = newFilterVidPid();
+        return m_FilterVidPid.m_Vid != NewFilterVidPid.m_Vid || m_FilterVidPid.m_Pid != NewFilterVidPid.m_Pid;
+    }
+    void waitForClaimedDevices() const;
+    void claimScript( CBusSnapshot &bus);
+    void runScript();
+    void mapPorts( const CDevSet<TDev> &devSet);
+    void verifyPorts( const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet) const;
+    std::string scriptDevices() const;
+    void dryRun( const CDevSet<TDev> &devSet) const;
+    void resetAll( const CDevSet<TDev> &devSet) const;
+    void reopenAll( CDevSet<TDev> &devSet, DWORD timeoutMsec) const;
+    void verifyAll( const CDevSet<TDev> &devSet, CSerNumSet sSerNumSet) const;
+    std::vector<BYTE> serNumOf( const TDev &dev) const;
+    DWORD diffAll( const CDevSet<TDev> &devSet) const;
+    void lockAll( const CDevSet<TDev> &devSet) const;
+
+    const CDevType  m_DevType;
+    const CVidPid   m_FilterVidPid;
+    const int       m_Argc;
+    const char    **m_Argv;
+    const DWORD     m_Index;    // of this profile's configuration file on the command line
+    const DWORD     m_Count;    // configuration files on the command line
+    const CSchedLimits m_SchedLimits;
+    const CResetWaves  m_ResetWaves;
+    TDevParms       m_DevParms;
+    bool            m_Program;
+    bool            m_Verify;
+    bool            m_Lock;
+    bool            m_DryRun;
+    DWORD           m_CustNumDevices;
+    DWORD           m_StartNumDevices;
+    CSerNumSet     *m_pSerNumSet;
+    CDevSet<TDev>  *m_pOldDevSet;   // devices matching FilterVidPid
+    CDevSet<TDev>  *m_pNewDevSet;   // devices matching the new vid-pid, for --reset and --list
+    std::vector<std::string> m_Locations; // of the claimed devices, to find them again after a reset
+    std::vector<CScriptStep> m_Script;
+    std::vector< std::vector< BYTE> > m_SerNums; // the port map: programmed at m_Locations
+};
+template< class TDev, class TDevParms >
+CDevProfile<TDev,TDevParms>::CDevProfile( const CDevType &devType, const CVidPid &FilterVidPid, int argc, const char * argv[], DWORD index, DWORD count)
+    : m_DevType( devType), m_FilterVidPid( FilterVidPid), m_Argc( argc), m_Argv( argv), m_Index( index), m_Count( count),
+      m_SchedLimits( argc, argv), m_ResetWaves( argc, argv)
+{
+    m_Program = m_Verify = m_Lock = m_DryRun = false;
+    m_CustNumDevices = m_StartNumDevices = 0;
+    m_pSerNumSet = NULL;
+    m_pOldDevSet = m_pNewDevSet = NULL;
+    m_DevParms.read();
+    m_Script = readScript( argc, argv);
+    bool lock = isSpecified( argc, argv, "--lock");
+    for( size_t i = 0; i < m_Script.size(); i++)
+    {
+        lock = lock || m_Script[ i].m_Kind == CScriptStep::LOCK;
+    }
+    m_DevParms.validate( m_DevType, lock);
+}
+template< class TDev, class TDevParms >
+CDevProfile<TDev,TDevParms>::~CDevProfile()
+{
+    delete m_pNewDevSet;
+    delete m_pOldDevSet;
+    delete m_pSerNumSet;
+}
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::claim( CBusSnapshot &bus)
+{
+    const int argc = m_Argc;
+    const char **argv = m_Argv;
+
+    if( !m_Script.empty())
+    {
+        claimScript( bus);
+        return;
+    }
+    m_DryRun  = isSpecified( argc, argv, "--dry-run");
+    if( m_DryRun && !isSpecified( argc, argv, "--set-and-verify-config") && !isSpecified( argc, argv, "--set-config") &&
+        !isSpecified( argc, argv, "--verify-config") && !isSpecified( argc, argv, "--verify-locked-config"))
+    {
+        throw CUsageErr( "--dry-run must be combined with one of \"set\" or \"verify\" commands");
+    }
+    if( isSpecified( argc, argv, "--reset") || isSpecified( argc, argv, "--list") ||
+        isSpecified( argc, argv, "--diff-config"))
+    {
+        m_pOldDevSet = new CDevSet<TDev>( m_DevType, m_FilterVidPid, bus, true /*allowLocked*/);
+        if( vidPidChanges())
         {
-            throw CCustErr( "Failed VidPid verification");
+            m_pNewDevSet = new CDevSet<TDev>( m_DevType, newFilterVidPid(), bus, true /*allowLocked*/);
         }
+        return;
+    }
+
+    m_Program = isSpecified( argc, argv, "--set-and-verify-config") ||
+                isSpecified( argc, argv, "--set-config") ;
+    m_Verify  = isSpecified( argc, argv, "--set-and-verify-config") ||
+                isSpecified( argc, argv, "--verify-config") ||
+                isSpecified( argc, argv, "--verify-locked-config") ;
+    m_Lock    = isSpecified( argc, argv, "--lock");
+    if( m_Lock && !m_Verify)
+    {
+        throw CUsageErr( "--lock must be combined with one of \"verify\" commands");
     }
-    if( m_PowerModeSpecified)
+    m_CustNumDevices = decimalParm( argc, argv, "--device-count", m_Index, m_Count);
+
+    for( int i = 0; m_Count > 1 && i < argc - 1; i++)
     {
-        if( m_PowerMode != dev.getPowerMode())
+        // the same serial numbers would go to the devices of every profile
+        if( std::string( argv[ i]) == "--serial-nums" && std::string( argv[ i + 1]) == "{")
         {
-            throw CCustErr( "Failed PowerMode verification");
+            throw CUsageErr( "--serial-nums { X Y Z ... } requires a single configuration file, use GUID");
         }
     }
-    if( m_MaxPowerSpecified)
+    m_pSerNumSet = new CSerNumSet( argc, argv, m_Program, m_CustNumDevices);
+    m_DevParms.validate( m_DevType, *m_pSerNumSet);
+
+    m_StartNumDevices = bus.size();
+    if( m_Program)
     {
-        if( m_MaxPower != dev.getMaxPower())
+        m_pOldDevSet = new CDevSet<TDev>( m_DevType, m_FilterVidPid, bus);
+        if( m_pOldDevSet->size() != m_CustNumDevices)
         {
-            throw CCustErr( "Failed MaxPower verification");
+            char msg[ 128];
+            sprintf( msg, "programming step: expected %d devices, found %d", m_CustNumDevices, m_pOldDevSet->size());
+            throw CCustErr( msg);
         }
     }
-    if( m_DevVerSpecified)
+    if( m_Program && m_Verify)
     {
-        if( m_DevVer != dev.getDevVer())
+        // The devices are found again where they are plugged in and each is verified
+        // against what was programmed there, see verifyPorts(). The profiles of a batch
+        // reset their devices concurrently, so opening the others' by index would race too.
+        m_Locations = m_pOldDevSet->locations();
+    }
+    else if( m_Count > 1 && m_Verify)
+    {
+        // a verify-only profile of a batch claims the devices it verifies
+        const CDevSet<TDev> devSet( m_DevType, newFilterVidPid(), bus, true /*allowLocked*/);
+        if( devSet.size() != m_CustNumDevices)
         {
-            throw CCustErr( "Failed DeviceVersion verification");
+            char msg[ 128];
+            sprintf( msg, "verification step: expected %d devices, found %d", m_CustNumDevices, devSet.size());
+            throw CCustErr( msg);
         }
+        m_Locations = devSet.locations();
     }
-    if( m_ProdStrSpecified)
+}
+// the claimed devices are back from their reset when all of them can be opened again
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::waitForClaimedDevices() const
+{
+#ifdef _WIN32
+#pragma warning(suppress : 4127)
+#endif
+    while( true)
     {
-        if( m_ProdStr != dev.getProduct( m_ProdStrIsAscii))
+        const DWORD NumDevs = CDevSet<TDev>( m_DevType, newFilterVidPid(), m_Locations, true /*allowLocked*/).size();
+        if( NumDevs == m_Locations.size())
         {
-            throw CCustErr( "Failed ProductString verification");
+            m_Out.print( "waiting 3 sec...");
+            delayMsec( 3000);
+            return;
         }
+        char msg[ 128];
+        sprintf( msg, "INFO: Waiting. %u devices found, need %u", NumDevs, static_cast<DWORD>( m_Locations.size()));
+        m_Out.warn( msg);
+        delayMsec( 1000);
     }
 }
-template< class TDev >
-void CDevParms<TDev>::resetAll( const CDevSet<TDev> &devSet) const
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::resetAll( const CDevSet<TDev> &devSet) const
 {
+    if( m_ResetWaves.m_Size && m_ResetWaves.m_Size < devSet.size())
+    {
+        CResetTask<TDev> task( devSet);
+        resetInWaves( m_ResetWaves, devSet.locations(), devSet.size(), task, m_Out);
+        return;
+    }
     for( size_t i = 0; i < devSet.size(); i++)
     {
         devSet.at( i).reset();
     }
 }
-template< class TDev >
-void CDevParms<TDev>::programAll( const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet) const
+// The devices wait for their re-enumeration side by side with --parallel
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::reopenAll( CDevSet<TDev> &devSet, DWORD timeoutMsec) const
 {
+    CReopenTask<TDev> task( devSet, timeoutMsec);
+    if( m_SchedLimits.m_Workers > 1 && devSet.size() > 1)
+    {
+        CTopoScheduler sched( devSet.locations(), devSet.size(), m_SchedLimits);
+        runScheduled( sched, task);
+        return;
+    }
     for( DWORD i = 0; i < devSet.size(); i++)
     {
-        program( devSet.at( i), !serNumSet.empty() ? &serNumSet.at( i) : NULL);
+        task.run( i);
     }
 }
-template< class TDev >
-void CDevParms<TDev>::verifyAll( const CDevSet<TDev> &devSet, CSerNumSet serNumSet) const
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::verifyAll( const CDevSet<TDev> &devSet, CSerNumSet serNumSet) const
 {
     for( DWORD i = 0; i < devSet.size(); i++)
     {
-        verify( devSet.at( i), serNumSet);
+        try
+        {
+            m_DevParms.verify( devSet.at( i), serNumSet);
+        }
+        catch( const CErrMsg &e)
+        {
+            m_Out.device( CProfileOut::VERIFY, devSet.at( i).handle(), serNumOf( devSet.at( i)), e.msg());
+            throw;
+        }
+        m_Out.device( CProfileOut::VERIFY, devSet.at( i).handle(), serNumOf( devSet.at( i)), "");
     }
     ASSERT( serNumSet.empty());
 }
-template< class TDev >
-void CDevParms<TDev>::lockAll( const CDevSet<TDev> &devSet) const
+// the serial number a device reports, read only for a sink of device outcomes
+template< class TDev, class TDevParms >
+std::vector<BYTE> CDevProfile<TDev,TDevParms>::serNumOf( const TDev &dev) const
+{
+    try
+    {
+        return m_Out.wantsDevices() ? dev.getSerNum( true) : std::vector<BYTE>();
+    }
+    catch( const CDllErr &)
+    {
+        return std::vector<BYTE>();
+    }
+}
+// lists the parameters each device doesn't match, returns the number of devices that don't
+template< class TDev, class TDevParms >
+DWORD CDevProfile<TDev,TDevParms>::diffAll( const CDevSet<TDev> &devSet) const
+{
+    DWORD diffCnt = 0;
+    for( DWORD i = 0; i < devSet.size(); i++)
+    {
+        std::vector<std::string> names;
+        m_DevParms.diff( devSet.at( i), names);
+        std::string line = "Ser #: " + toString( devSet.at( i).getSerNum( true)) + ":";
+        for( size_t j = 0; j < names.size(); j++)
+        {
+            line += " " + names[ j];
+        }
+        m_Out.print( names.empty() ? line + " OK" : line);
+        diffCnt += names.empty() ? 0 : 1;
+    }
+    return diffCnt;
+}
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::lockAll( const CDevSet<TDev> &devSet) const
 {
     for( DWORD i = 0; i < devSet.size(); i++)
     {
-        devSet.at( i).lock();
+        try
+        {
+            devSet.at( i).lock();
+        }
+        catch( const CErrMsg &e)
+        {
+            m_Out.device( CProfileOut::LOCK, devSet.at( i).handle(), serNumOf( devSet.at( i)), e.msg());
+            throw;
+        }
+        m_Out.device( CProfileOut::LOCK, devSet.at( i).handle(), serNumOf( devSet.at( i)), "");
     }
 }
-//---------------------------------------------------------------------------------
+// A script keeps the devices it claims open from step to step, but for the time
+// between a reset and the next wait. They are found again where they are plugged in,
+// so each one is verified against the serial number programmed there.
 template< class TDev, class TDevParms >
-void DevSpecificMain( const CDevType &devType, const CVidPid &FilterVidPid, int argc, const char * argv[])
+void CDevProfile<TDev,TDevParms>::claimScript( CBusSnapshot &bus)
 {
-    TDevParms devParms;
-    devParms.read();
+    const int argc = m_Argc;
+    const char **argv = m_Argv;
 
-    // If the cfg file doesn't specify a new vid-pid, it's not changing;
-    // so the new vid-pid is the same as filter vid-pid.
-    const CVidPid NewFilterVidPid( devParms.m_VidPidSpecified ? devParms.m_Vid : FilterVidPid.m_Vid,
-                                   devParms.m_VidPidSpecified ? devParms.m_Pid : FilterVidPid.m_Pid);
+    if( isSpecified( argc, argv, "--lock") || isSpecified( argc, argv, "--dry-run"))
+    {
+        throw CUsageErr( "--script takes its steps from the script file only");
+    }
+    for( size_t i = 0; i < m_Script.size(); i++)
+    {
+        m_Program = m_Program || m_Script[ i].m_Kind == CScriptStep::PROGRAM;
+    }
+    m_CustNumDevices = decimalParm( argc, argv, "--device-count", m_Index, m_Count);
+    m_pSerNumSet = new CSerNumSet( argc, argv, m_Program, m_CustNumDevices);
+    m_DevParms.validate( m_DevType, *m_pSerNumSet);
 
-    if( isSpecified( argc, argv, "--reset"))
+    m_StartNumDevices = bus.size();
+    // a script that doesn't program works on devices programmed before
+    m_pOldDevSet = new CDevSet<TDev>( m_DevType, m_Program ? m_FilterVidPid : newFilterVidPid(), bus, !m_Program /*allowLocked*/);
+    if( m_pOldDevSet->size() != m_CustNumDevices)
+    {
+        char msg[ 128];
+        sprintf( msg, "script: expected %d devices, found %d", m_CustNumDevices, m_pOldDevSet->size());
+        throw CCustErr( msg);
+    }
+    m_Locations = m_pOldDevSet->locations();
+}
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::runScript()
+{
+    char msg[ 128];
+    for( size_t s = 0; s < m_Script.size(); s++)
     {
-        const CDevSet<TDev> oldDevSet( devType, FilterVidPid, true /*allowLocked*/);
-        devParms.resetAll( oldDevSet);
-        if( FilterVidPid.m_Vid != NewFilterVidPid.m_Vid || FilterVidPid.m_Pid != NewFilterVidPid.m_Pid)
+        const CScriptStep &step = m_Script[ s];
+        sprintf( msg, "--- line %u: ", step.m_Line);
+        m_Out.print( msg + step.m_Text);
+        // readScript() made sure the devices are open where a step needs them
+        switch( step.m_Kind)
         {
-            const CDevSet<TDev> newDevSet( devType, NewFilterVidPid, true /*allowLocked*/);
-            devParms.resetAll( newDevSet);
+        case CScriptStep::PROGRAM:
+            m_pSerNumSet->write( m_Out);
+            m_DevParms.programAll( m_DevType, *m_pOldDevSet, *m_pSerNumSet, m_SchedLimits, m_Out);
+            mapPorts( *m_pOldDevSet);
+            sprintf( msg, "programmed %u devices: OK", m_pOldDevSet->size());
+            break;
+        case CScriptStep::RESET:
+            resetAll( *m_pOldDevSet);
+            sprintf( msg, "reset %u devices: OK", m_pOldDevSet->size());
+            delete m_pOldDevSet;
+            m_pOldDevSet = NULL;
+            break;
+        case CScriptStep::WAIT:
+            if( !m_Locations.empty())
+            {
+                waitForClaimedDevices();
+            }
+            else
+            {
+                waitForTotalDeviceCount( m_FilterVidPid, newFilterVidPid(), m_StartNumDevices, m_Out);
+            }
+            delete m_pOldDevSet;
+            m_pOldDevSet = NULL;
+            m_pOldDevSet = new CDevSet<TDev>( m_DevType, newFilterVidPid(), m_Locations, true /*allowLocked*/);
+            if( m_pOldDevSet->size() != m_CustNumDevices)
+            {
+                sprintf( msg, "script: expected %d devices, found %d", m_CustNumDevices, m_pOldDevSet->size());
+                throw CCustErr( msg);
+            }
+            sprintf( msg, "reopened %u devices: OK", m_pOldDevSet->size());
+            break;
+        case CScriptStep::REOPEN:
+            reopenAll( *m_pOldDevSet, step.m_Msec);
+            sprintf( msg, "reset and reopened %u devices: OK", m_pOldDevSet->size());
+            break;
+        case CScriptStep::VERIFY:
+            verifyPorts( *m_pOldDevSet, *m_pSerNumSet);
+            sprintf( msg, "verified %u devices: OK", m_pOldDevSet->size());
+            break;
+        case CScriptStep::LOCK:
+            lockAll( *m_pOldDevSet);
+            sprintf( msg, "locked %u devices: OK", m_pOldDevSet->size());
+            break;
+        case CScriptStep::PAUSE:
+            pauseScript( step, m_Out);
+            continue;
+        case CScriptStep::RUN:
+            runScriptHook( step, scriptDevices());
+            continue;
         }
+        m_Out.print( msg);
+    }
+}
+// each device against the serial number programmed where it is plugged in, against
+// the command line's set like --verify-config if the script didn't program or the
+// library can't tell where the devices are
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::verifyPorts( const CDevSet<TDev> &devSet, const CSerNumSet &serNumSet) const
+{
+    const std::vector<std::string> locations = devSet.locations();
+    if( m_SerNums.size() != m_Locations.size() || locations.size() != devSet.size())
+    {
+        verifyAll( devSet, serNumSet);
         return;
     }
+    for( DWORD i = 0; i < devSet.size(); i++)
+    {
+        try
+        {
+            // reopened at m_Locations in their order, unless some didn't come back
+            size_t j = i;
+            if( j >= m_Locations.size() || m_Locations[ j] != locations[ i])
+            {
+                j = std::find( m_Locations.begin(), m_Locations.end(), locations[ i]) - m_Locations.begin();
+            }
+            if( j == m_Locations.size())
+            {
+                throw CCustErr( "Failed serial number verification");
+            }
+            CSerNumSet serNum( m_SerNums[ j]);
+            m_DevParms.verify( devSet.at( i), serNum);
+        }
+        catch( const CErrMsg &e)
+        {
+            m_Out.device( CProfileOut::VERIFY, devSet.at( i).handle(), serNumOf( devSet.at( i)), e.msg());
+            throw;
+        }
+        m_Out.device( CProfileOut::VERIFY, devSet.at( i).handle(), serNumOf( devSet.at( i)), "");
+    }
+}
+// Records the port map: the serial number programmed at each device's location, so
+// that verification finds a unit swapped with another or programmed twice
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::mapPorts( const CDevSet<TDev> &devSet)
+{
+    m_SerNums.clear();
+    for( DWORD i = 0; i < m_pSerNumSet->size() && i < devSet.size(); i++)
+    {
+        m_SerNums.push_back( m_pSerNumSet->at( i));
+    }
+}
+// "location=serial number" of each device, as far as they are known
+template< class TDev, class TDevParms >
+std::string CDevProfile<TDev,TDevParms>::scriptDevices() const
+{
+    std::string devices;
+    for( size_t i = 0; i < m_Locations.size(); i++)
+    {
+        devices += (i ? " " : "") + m_Locations[ i];
+        if( i < m_SerNums.size())
+        {
+            devices += "=" + toString( m_SerNums[ i]);
+        }
+    }
+    return devices;
+}
+// Reports what the commands would send to the claimed devices and how long it would take,
+// writing nothing. The program transfers come from the transfer plan. The latency of a
+// request is measured on the first device by reading it back as verification does, which
+// gives the verification cost too.
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::dryRun( const CDevSet<TDev> &devSet) const
+{
+    const DWORD MeasurePasses = 10;
+    const DWORD ResetWaitMsec = 3000; // waitForTotalDeviceCount() and waitForClaimedDevices()
 
-    if( isSpecified( argc, argv, "--list"))
+    char msg[ 128];
+    if( devSet.size() != m_CustNumDevices)
+    {
+        sprintf( msg, "verification step: expected %d devices, found %d", m_CustNumDevices, devSet.size());
+        throw CCustErr( msg);
+    }
+    m_Out.print( "--- dry run --------------");
+    sprintf( msg, "devices: %u", devSet.size());
+    m_Out.print( msg);
+
+    DWORD programRequests = 0;
+    if( m_Program)
     {
-        const CDevSet<TDev> oldDevSet( devType, FilterVidPid, true /*allowLocked*/);
-        printf( "--- devices --------------\n");
-        oldDevSet.printDevInfo();
-        if( FilterVidPid.m_Vid != NewFilterVidPid.m_Vid || FilterVidPid.m_Pid != NewFilterVidPid.m_Pid)
+        const TDev plan( LibSpecificOpenPlan( m_DevType));
+        m_DevParms.program( plan, !m_pSerNumSet->empty() ? &m_pSerNumSet->at( 0) : NULL);
+        DWORD bytes = 0;
+        const std::vector<std::string> transfers = LibSpecificPlanTransfers( plan.handle(), bytes);
+        programRequests = static_cast<DWORD>( transfers.size());
+        sprintf( msg, "program: %u transfers, %u bytes per device", programRequests, bytes);
+        m_Out.print( msg);
+        for( size_t i = 0; i < transfers.size(); i++)
         {
-            const CDevSet<TDev> newDevSet( devType, NewFilterVidPid, true /*allowLocked*/);
-            newDevSet.printDevInfo();
+            m_Out.print( "    " + transfers[ i]);
         }
-        printf( "--------------------------\n");
-        return;
     }
 
-    const bool program = isSpecified( argc, argv, "--set-and-verify-config") ||
-                         isSpecified( argc, argv, "--set-config") ;
-    const bool verify  = isSpecified( argc, argv, "--set-and-verify-config") ||
-                         isSpecified( argc, argv, "--verify-config") ||
-                         isSpecified( argc, argv, "--verify-locked-config") ;
-    const bool lock    = isSpecified( argc, argv, "--lock");
-    if( lock && !verify)
+    DWORD verifyRequests = 0;
+    double requestMsec = 0;
+    if( devSet.size())
     {
-        throw CUsageErr( "--lock must be combined with one of \"verify\" commands");
+        const TDev &dev = devSet.at( 0);
+        const DWORD startCount = LibSpecificRequestCount( dev.handle());
+        const DWORD startMsec = GetTickCount();
+        for( DWORD pass = 0; pass < MeasurePasses; pass++)
+        {
+            std::vector<std::string> names;
+            dev.isLocked();
+            m_DevParms.diff( dev, names);
+        }
+        const DWORD elapsedMsec = GetTickCount() - startMsec;
+        const DWORD requests = LibSpecificRequestCount( dev.handle()) - startCount;
+        verifyRequests = requests / MeasurePasses;
+        requestMsec = requests ? static_cast<double>( elapsedMsec) / requests : 0;
+    }
+    if( m_Verify)
+    {
+        sprintf( msg, "verify: %u request%s per device", verifyRequests, verifyRequests == 1 ? "" : "s");
+        m_Out.print( msg);
+    }
+    const DWORD lockRequests = m_Lock ? TDev::lockRequests() : 0;
+    if( m_Lock)
+    {
+        sprintf( msg, "lock: %u request%s per device", lockRequests, lockRequests == 1 ? "" : "s");
+        m_Out.print( msg);
+    }
+    sprintf( msg, "request latency: %.3f ms, measured on the first device", requestMsec);
+    m_Out.print( msg);
+
+    const DWORD waitMsec = m_Program && m_Verify ? ResetWaitMsec : 0;
+    if( waitMsec)
+    {
+        sprintf( msg, "reset: 1 request per device, then at least %u ms until the devices are back", waitMsec);
+        m_Out.print( msg);
     }
-    const DWORD custNumDevices  = decimalParm( argc, argv, "--device-count");
+    const DWORD deviceRequests = programRequests + (waitMsec ? 1 : 0) + (m_Verify ? verifyRequests : 0) + lockRequests;
+    const double deviceMsec = deviceRequests * requestMsec;
+    sprintf( msg, "estimated time: %.1f ms sequential, %.1f ms parallel",
+             waitMsec + deviceMsec * devSet.size(), waitMsec + (devSet.size() ? deviceMsec : 0));
+    m_Out.print( msg);
+    m_Out.print( "--------------------------");
+}
+template< class TDev, class TDevParms >
+void CDevProfile<TDev,TDevParms>::run()
+{
+    const int argc = m_Argc;
+    const char **argv = m_Argv;
+    const CVidPid NewFilterVidPid = newFilterVidPid();
 
-    const CSerNumSet serNumSet( argc, argv, program, custNumDevices);
+    if( !m_Script.empty())
+    {
+        runScript();
+        return;
+    }
+    if( isSpecified( argc, argv, "--reset"))
+    {
+        resetAll( *m_pOldDevSet);
+        if( m_pNewDevSet)
+        {
+            resetAll( *m_pNewDevSet);
+        }
+        return;
+    }
 
-    const DWORD startNumDevices = LibSpecificNumDevices( FilterVidPid, FilterVidPid);
-    if( program)
+    if( isSpecified( argc, argv, "--list"))
     {
-        const CDevSet<TDev> devSet( devType, FilterVidPid);
-        if( devSet.size() != custNumDevices)
+        m_Out.print( "--- devices --------------");
+        m_pOldDevSet->printDevInfo( m_Out);
+        if( m_pNewDevSet)
+        {
+            m_pNewDevSet->printDevInfo( m_Out);
+        }
+        m_Out.print( "--------------------------");
+        return;
+    }
+
+    if( isSpecified( argc, argv, "--diff-config"))
+    {
+        m_Out.print( "--- differences ----------");
+        DWORD diffCnt = diffAll( *m_pOldDevSet);
+        if( m_pNewDevSet)
+        {
+            diffCnt += diffAll( *m_pNewDevSet);
+        }
+        m_Out.print( "--------------------------");
+        if( diffCnt)
         {
             char msg[ 128];
-            sprintf( msg, "programming step: expected %d devices, found %d", custNumDevices, devSet.size());
+            sprintf( msg, "%u devices differ from the configuration", diffCnt);
             throw CCustErr( msg);
         }
-        serNumSet.write();
-        devParms.programAll( devSet, serNumSet);
-        if( verify)
+        return;
+    }
+
+    if( m_DryRun)
+    {
+        if( m_Program)
         {
-            devParms.resetAll( devSet);
+            dryRun( *m_pOldDevSet);
         }
-        printf( "programmed %u devices: OK\n", devSet.size());
+        else
+        {
+            const bool allowLocked = !m_Lock && isSpecified( argc, argv, "--verify-locked-config");
+            dryRun( CDevSet<TDev>( m_DevType, NewFilterVidPid, m_Locations, allowLocked));
+        }
+        return;
     }
-    if( verify)
+
+    const CSerNumSet &serNumSet = *m_pSerNumSet;
+    if( m_Program)
+    {
+        const CDevSet<TDev> &devSet = *m_pOldDevSet;
+        serNumSet.write( m_Out);
+        m_DevParms.programAll( m_DevType, devSet, serNumSet, m_SchedLimits, m_Out);
+        mapPorts( devSet);
+        if( m_Verify)
+        {
+            resetAll( devSet);
+        }
+        char msg[ 128];
+        sprintf( msg, "programmed %u devices: OK", devSet.size());
+        m_Out.print( msg);
+        // close them, the reset ones are gone anyway
+        delete m_pOldDevSet;
+        m_pOldDevSet = NULL;
+    }
+    if( m_Verify)
     {
 #if 0
         printf( "*** unplug now ***\n");
         delayMsec( 2000);
 #endif
-        // retry verification until it succeeds, the user can press ^C to cancel
+        // retry verification until it succeeds, the user can press ^C to cancel,
+        // or as often as --verify-attempts and g_MaxVerifyAttempts allow
+        DWORD attempts = isSpecified( argc, argv, "--verify-attempts") ? decimalParm( argc, argv, "--verify-attempts") : 0;
+        if( g_MaxVerifyAttempts && (!attempts || attempts > g_MaxVerifyAttempts))
+        {
+            attempts = g_MaxVerifyAttempts;
+        }
+        const DWORD maxRetries = attempts - 1; // MAX_ULONG for no limit
+        DWORD retries = 0;
 #ifdef _WIN32
 #pragma warning(suppress : 4127)
 #endif
@@ -488,37 +1679,63 @@ void DevSpecificMain( const CDevType &devType, const CVidPid &FilterVidPid, int
         {
             try // catch the exceptions that mignt go away on retry
             {
-                if( program)
+                if( m_Program)
                 {
-                    waitForTotalDeviceCount( FilterVidPid, NewFilterVidPid, startNumDevices);
+                    if( !m_Locations.empty())
+                    {
+                        waitForClaimedDevices();
+                    }
+                    else
+                    {
+                        waitForTotalDeviceCount( m_FilterVidPid, NewFilterVidPid, m_StartNumDevices, m_Out);
+                    }
                 }
-                const bool allowLocked = !program && !lock && isSpecified( argc, argv, "--verify-locked-config");
-                const CDevSet<TDev> devSet( devType, NewFilterVidPid, allowLocked);
-                if( devSet.size() != custNumDevices)
+                const bool allowLocked = !m_Program && !m_Lock && isSpecified( argc, argv, "--verify-locked-config");
+                const CDevSet<TDev> devSet( m_DevType, NewFilterVidPid, m_Locations, allowLocked);
+                char msg[ 128];
+                if( devSet.size() != m_CustNumDevices)
                 {
-                    char msg[ 128];
-                    sprintf( msg, "verification step: expected %d devices, found %d", custNumDevices, devSet.size());
+                    sprintf( msg, "verification step: expected %d devices, found %d", m_CustNumDevices, devSet.size());
                     throw CCustErr( msg);
                 }
-                devParms.verifyAll( devSet, serNumSet); // gets a copy of serNumSet
-                printf( "verified %d devices: OK\n", devSet.size());
-                if( lock)
+                verifyPorts( devSet, serNumSet);
+                sprintf( msg, "verified %d devices: OK", devSet.size());
+                m_Out.print( msg);
+                if( m_Lock)
                 {
-                    devParms.lockAll( devSet);
-                    printf( "locked %d devices: OK\n", devSet.size());
+                    lockAll( devSet);
+                    sprintf( msg, "locked %d devices: OK", devSet.size());
+                    m_Out.print( msg);
                 }
                 break;
             }
+            catch( const CFatalDllErr &)
+            {
+                throw;
+            }
+            catch( const CCancelErr &)
+            {
+                throw;
+            }
             catch( const CDllErr e)
             {
-                std::cerr << "WARNING: library: " << e.msg() << "\n";
+                if( retries == maxRetries)
+                {
+                    throw;
+                }
+                m_Out.warn( "WARNING: library: " + e.msg());
             }
             catch( const CCustErr e)
             {
-                std::cerr << "WARNING: Manufacturing process: " << e.msg() << "\n";
+                if( retries == maxRetries)
+                {
+                    throw;
+                }
+                m_Out.warn( "WARNING: Manufacturing process: " + e.msg());
             }
+            retries++;
             delayMsec( 1000);
-            std::cerr << "Retrying verification...\n";
+            m_Out.warn( "Retrying verification...");
         }
     }
 }
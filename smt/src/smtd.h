@@ -0,0 +1,30 @@
+#ifndef __SLABSMTD_H__
+#define __SLABSMTD_H__ 1
+
+#include <string>
+
+// smtd keeps the library, with its libusb context and device registry, and the
+// parsed configurations between commands. smt-cp210x --daemon <socket> hands its
+// command over instead of running it itself.
+//
+// A client connects to smtd's Unix domain socket and sends one message carrying
+// its stdin, stdout and stderr (SCM_RIGHTS) and the job: a DWORD size, then its
+// working directory and arguments, each NUL terminated. smtd runs the jobs one
+// at a time as smt-cp210x would, writing to the client's stdout and stderr, and
+// answers each with its exit code as an int. A client that goes away cancels its
+// job at its next wait, and no job retries verification endlessly, so none can
+// keep the others waiting for good.
+//
+// The socket is for its owner and group only.
+
+#define SMTD_MAX_JOB_SIZE           65536
+#define SMTD_JOB_FD_CNT             3
+#define SMTD_MAX_VERIFY_ATTEMPTS    60
+#define SMTD_SOCKET_MODE            0660
+
+// the whole command, smt.cpp
+int smtMain( int argc, const char * argv[]);
+// submits the command, less "--daemon socket_path", to smtd; returns its exit code
+int runOnDaemon( const std::string &socketPath, int argc, const char * argv[]);
+
+#endif
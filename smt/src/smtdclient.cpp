@@ -0,0 +1,127 @@
+// The client side of smtd, see smtd.h
+
+#ifndef _WIN32
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "util.h"
+#include "smtd.h"
+
+static void appendStr( std::vector<char> &job, const char *s)
+{
+    job.insert( job.end(), s, s + strlen( s) + 1);
+}
+
+static int daemonErr( const char *what, int err)
+{
+    char msg[ 128];
+    sprintf( msg, "%s error %d", what, err);
+    std::cerr << "ERROR: smtd: " << msg << "\n";
+    return 1;
+}
+
+int runOnDaemon( const std::string &socketPath, int argc, const char * argv[])
+{
+    std::vector<char> job( sizeof( DWORD)); // the size goes there
+    char cwd[ PATH_MAX];
+    if( !getcwd( cwd, sizeof( cwd)))
+    {
+        return daemonErr( "getcwd", errno);
+    }
+    appendStr( job, cwd);
+    for( int i = 1; i < argc; i++)
+    {
+        if( !strcmp( argv[ i], "--daemon"))
+        {
+            i++;
+            continue;
+        }
+        appendStr( job, argv[ i]);
+    }
+    const DWORD size = static_cast<DWORD>( job.size() - sizeof( DWORD));
+    if( size > SMTD_MAX_JOB_SIZE)
+    {
+        std::cerr << "ERROR: smtd: command line too long\n";
+        return 1;
+    }
+    memcpy( &job[ 0], &size, sizeof( size));
+
+    sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr));
+    addr.sun_family = AF_UNIX;
+    if( socketPath.size() >= sizeof( addr.sun_path))
+    {
+        std::cerr << "ERROR: smtd: socket path too long\n";
+        return 1;
+    }
+    strcpy( addr.sun_path, socketPath.c_str());
+    const int fd = socket( AF_UNIX, SOCK_STREAM, 0);
+    if( fd < 0)
+    {
+        return daemonErr( "socket", errno);
+    }
+    if( connect( fd, reinterpret_cast<sockaddr *>( &addr), sizeof( addr)) != 0)
+    {
+        const int err = errno;
+        close( fd);
+        return daemonErr( "connect", err);
+    }
+
+    // stdin, stdout and stderr ride along with the first byte
+    const int fds[ SMTD_JOB_FD_CNT] = { 0, 1, 2 };
+    char control[ CMSG_SPACE( sizeof( fds))];
+    memset( control, 0, sizeof( control));
+    iovec iov;
+    iov.iov_base = &job[ 0];
+    iov.iov_len = job.size();
+    msghdr msg;
+    memset( &msg, 0, sizeof( msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof( control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR( &msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN( sizeof( fds));
+    memcpy( CMSG_DATA( cmsg), fds, sizeof( fds));
+
+    ssize_t cb = sendmsg( fd, &msg, 0);
+    size_t sent = cb > 0 ? cb : 0;
+    while( cb > 0 && sent < job.size())
+    {
+        cb = send( fd, &job[ sent], job.size() - sent, 0);
+        sent += cb > 0 ? cb : 0;
+    }
+    if( cb <= 0)
+    {
+        const int err = errno;
+        close( fd);
+        return daemonErr( "send", err);
+    }
+
+    // the job's output goes to our stdout and stderr directly, the exit code comes last
+    int rc;
+    size_t got = 0;
+    while( got < sizeof( rc) && (cb = recv( fd, reinterpret_cast<char *>( &rc) + got, sizeof( rc) - got, 0)) > 0)
+    {
+        got += cb;
+    }
+    close( fd);
+    if( got < sizeof( rc))
+    {
+        std::cerr << "ERROR: smtd: job aborted\n";
+        return 1;
+    }
+    return rc;
+}
+
+#endif
@@ -10,9 +10,19 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 bool g_EchoParserReads = false;
 
@@ -74,159 +84,586 @@ void writeByteArrayParm( const std::vector<BYTE> &arr)
     writeStr( "}");
 }
 
-// read from stdin any word, that is, a sequence without spaces
-bool readWord( std::string &word, std::istream & in  )
+//---------------------------------------------------------------------------------
+// CCfgFile
+
+CCfgFile g_CfgFile;
+
+CCfgFile::CCfgFile()
+{
+    m_Buf = m_End = m_Cur = m_Tok = NULL;
+    m_Map = NULL;
+    m_MapSize = 0;
+    m_Compiled = false;
+    m_Recording = false;
+}
+CCfgFile::~CCfgFile()
+{
+    close();
+}
+void CCfgFile::close()
+{
+#ifndef _WIN32
+    if( m_Map)
+    {
+        munmap( m_Map, m_MapSize);
+    }
+#endif
+    m_Map = NULL;
+    m_MapSize = 0;
+    m_Copy.clear();
+    m_Buf = m_End = m_Cur = m_Tok = NULL;
+    m_Compiled = false;
+    m_Recording = false;
+    m_Image.clear();
+}
+void CCfgFile::openBuffer( const char *buf, size_t size)
+{
+    close();
+    setBuffer( buf, size);
+}
+bool CCfgFile::open( const std::string &fileName)
+{
+    close();
+#ifndef _WIN32
+    const int fd = ::open( fileName.c_str(), O_RDONLY);
+    if( fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if( fstat( fd, &st) == 0 && S_ISREG( st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( map != MAP_FAILED)
+        {
+            ::close( fd);
+            m_Map = map;
+            m_MapSize = st.st_size;
+            setBuffer( static_cast<const char *>( map), m_MapSize);
+            return true;
+        }
+    }
+    // not mappable (pipe, empty file, ...), read it whole instead
+    char chunk[ 4096];
+    ssize_t cb;
+    while( (cb = read( fd, chunk, sizeof( chunk))) > 0)
+    {
+        m_Copy.insert( m_Copy.end(), chunk, chunk + cb);
+    }
+    const int err = errno;
+    ::close( fd);
+    if( cb < 0)
+    {
+        errno = err;
+        return false;
+    }
+#else
+    FILE *fp = fopen( fileName.c_str(), "rb");
+    if( !fp)
+    {
+        return false;
+    }
+    char chunk[ 4096];
+    size_t cb;
+    while( (cb = fread( chunk, 1, sizeof( chunk), fp)) > 0)
+    {
+        m_Copy.insert( m_Copy.end(), chunk, chunk + cb);
+    }
+    fclose( fp);
+#endif
+    setBuffer( m_Copy.empty() ? NULL : &m_Copy[ 0], m_Copy.size());
+    return true;
+}
+// IEEE 802.3 CRC-32 of a compiled configuration's payload
+static DWORD crc32( const BYTE *data, size_t size)
 {
-    word.clear();
-    int last = 0;
-    while( (last = in.get()) != EOF)
+    DWORD crc = 0xffffffff;
+    for( size_t i = 0; i < size; i++)
     {
-        if( !isspace( last))
+        crc ^= data[ i];
+        for( int bit = 0; bit < 8; bit++)
         {
-            // entered the word
-            word += static_cast<char>( last);
-            while( (last = in.get()) != EOF)
-            {
-                if( isspace( last))
-                {
-                    if( g_EchoParserReads)
-                    {
-                        printf( "%s%c", word.c_str(), last);
-                    }
-                    return true; // exited the word
-                }
-                word += static_cast<char>( last);
-            }
-            return true; // end of parameter list
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
         }
     }
-    return false; // couldn't read a word
+    return ~crc;
+}
+static WORD getLe16( const BYTE *p)
+{
+    return static_cast<WORD>( p[ 0] | (p[ 1] << 8));
+}
+static DWORD getLe32( const BYTE *p)
+{
+    return p[ 0] | (p[ 1] << 8) | (p[ 2] << 16) | (static_cast<DWORD>( p[ 3]) << 24);
+}
+static void putLe( std::vector<BYTE> &v, DWORD val, size_t cb)
+{
+    for( size_t i = 0; i < cb; i++)
+    {
+        v.push_back( static_cast<BYTE>( val >> (8 * i)));
+    }
 }
 
-// read from stdin a specific word
-void readKeyword( const std::string &keyWord, std::istream & in)
+void CCfgFile::setBuffer( const char *buf, size_t size)
 {
-    std::string word;
-    if( !readWord( word, in) || word != keyWord)
+    m_Buf = m_Cur = buf;
+    m_End = buf + size;
+    m_Tok = NULL;
+    m_Compiled = size >= 4 && !memcmp( buf, CFG_IMAGE_MAGIC, 4);
+    if( m_Compiled)
     {
-        throw CSyntErr( std::string( "expected ") + keyWord);
+        const BYTE *hdr = reinterpret_cast<const BYTE *>( buf);
+        if( size < CFG_IMAGE_HEADER_SIZE)
+        {
+            throw CSyntErr( "compiled configuration is truncated");
+        }
+        if( getLe16( hdr + 4) != CFG_IMAGE_VERSION)
+        {
+            throw CSyntErr( "compiled configuration is of another smt version, recompile it");
+        }
+        const DWORD payloadSize = getLe32( hdr + 8);
+        if( payloadSize != size - CFG_IMAGE_HEADER_SIZE ||
+            crc32( hdr + CFG_IMAGE_HEADER_SIZE, payloadSize) != getLe32( hdr + 12))
+        {
+            throw CSyntErr( "compiled configuration is corrupt");
+        }
+        m_Cur = buf + CFG_IMAGE_HEADER_SIZE;
+    }
+}
+bool CCfgFile::nextToken( const char *&tok, size_t &len)
+{
+    const char *p = m_Cur;
+    while( p != m_End && isspace( static_cast<unsigned char>( *p)))
+    {
+        p++;
+    }
+    if( p == m_End)
+    {
+        m_Cur = p;
+        return false; // couldn't read a word
+    }
+    tok = m_Tok = p;
+    while( p != m_End && !isspace( static_cast<unsigned char>( *p)))
+    {
+        p++;
+    }
+    len = p - tok;
+    if( p != m_End)
+    {
+        if( g_EchoParserReads)
+        {
+            printf( "%.*s%c", static_cast<int>( len), tok, *p);
+        }
+        p++; // the whitespace ending the word is consumed with it
+    }
+    m_Cur = p;
+    return true;
+}
+void CCfgFile::position( DWORD &line, DWORD &column) const
+{
+    if( m_Compiled)
+    {
+        line = column = 0;
+        return;
+    }
+    // only needed for error messages, so counted on demand
+    const char *end = m_Tok ? m_Tok : m_Cur;
+    line = 1;
+    column = 1;
+    for( const char *p = m_Buf; p && p != end; p++)
+    {
+        if( *p == '\n')
+        {
+            line++;
+            column = 1;
+        }
+        else
+        {
+            column++;
+        }
     }
 }
 
-void AssertHex( const std::string &valStr, const DWORD digitCnt)
+DWORD CCfgFile::readItem( BYTE tag)
 {
-    if( valStr.size() != digitCnt)
+    static const size_t itemSize[] = { 0, 1, 2, 4 };
+    const BYTE *p = reinterpret_cast<const BYTE *>( m_Cur);
+    if( tag > CFG_ITEM_ULONG || m_Cur == m_End || *p != tag ||
+        static_cast<size_t>( m_End - m_Cur) < 1 + itemSize[ tag])
     {
-        throw CSyntErr( "invalid hex number size");
+        throw CSyntErr( "compiled configuration doesn't match the parameters");
+    }
+    m_Cur += 1 + itemSize[ tag];
+    switch( tag)
+    {
+    case CFG_ITEM_UCHAR:  return p[ 1];
+    case CFG_ITEM_USHORT: return getLe16( p + 1);
+    default:              return getLe32( p + 1);
+    }
+}
+void CCfgFile::readItem( BYTE tag, const char *&data, size_t &len)
+{
+    const BYTE *p = reinterpret_cast<const BYTE *>( m_Cur);
+    const size_t left = m_End - m_Cur;
+    const size_t cbLen = tag == CFG_ITEM_BYTES ? 2 : 1;
+    if( !left || *p != tag || (tag != CFG_ITEM_BYTES && tag != CFG_ITEM_WORD) || left < 1 + cbLen)
+    {
+        throw CSyntErr( "compiled configuration doesn't match the parameters");
     }
-    for( DWORD i = 0; i < digitCnt; i++)
+    len = tag == CFG_ITEM_BYTES ? getLe16( p + 1) : p[ 1];
+    if( left < 1 + cbLen + len)
     {
-        if( !isxdigit( valStr[i]))
+        throw CSyntErr( "compiled configuration is truncated");
+    }
+    data = m_Cur + 1 + cbLen;
+    m_Cur = data + len;
+}
+bool CCfgFile::readWordItem( const char *&data, size_t &len)
+{
+    if( m_Cur != m_End && static_cast<BYTE>( *m_Cur) == CFG_ITEM_END)
+    {
+        m_Cur++;
+        return false;
+    }
+    readItem( CFG_ITEM_WORD, data, len);
+    return true;
+}
+void CCfgFile::recordItem( BYTE tag, DWORD val)
+{
+    if( m_Recording)
+    {
+        m_Image.push_back( tag);
+        putLe( m_Image, val, tag == CFG_ITEM_UCHAR ? 1 : tag == CFG_ITEM_USHORT ? 2 : tag == CFG_ITEM_ULONG ? 4 : 0);
+    }
+}
+void CCfgFile::recordItem( BYTE tag, const void *data, size_t len)
+{
+    if( m_Recording)
+    {
+        const BYTE *p = static_cast<const BYTE *>( data);
+        if( len > (tag == CFG_ITEM_BYTES ? MAX_USHORT : MAX_UCHAR))
         {
-            throw CSyntErr( "invalid hex number size");
+            throw CSyntErr( "value too long for a compiled configuration");
         }
+        m_Image.push_back( tag);
+        putLe( m_Image, static_cast<DWORD>( len), tag == CFG_ITEM_BYTES ? 2 : 1);
+        m_Image.insert( m_Image.end(), p, p + len);
+    }
+}
+std::vector<BYTE> CCfgFile::image() const
+{
+    std::vector<BYTE> img( CFG_IMAGE_MAGIC, CFG_IMAGE_MAGIC + 4);
+    putLe( img, CFG_IMAGE_VERSION, 2);
+    putLe( img, 0, 2);
+    putLe( img, static_cast<DWORD>( m_Image.size()), 4);
+    putLe( img, crc32( m_Image.empty() ? NULL : &m_Image[ 0], m_Image.size()), 4);
+    img.insert( img.end(), m_Image.begin(), m_Image.end());
+    return img;
+}
+bool CCfgFile::writeImage( const std::string &fileName) const
+{
+    const std::vector<BYTE> img = image();
+
+    FILE *fp = fopen( fileName.c_str(), "wb");
+    if( !fp)
+    {
+        return false;
+    }
+    bool ok = fwrite( &img[ 0], 1, img.size(), fp) == img.size();
+    const int err = errno;
+    if( fclose( fp) != 0)
+    {
+        ok = false;
     }
+    errno = err;
+    return ok;
 }
 
-// read from stdin a hex ulong
-DWORD readUlong(std::istream & in )
+//---------------------------------------------------------------------------------
+// CPortLocks
+
+CPortLocks::~CPortLocks()
 {
-    std::string valStr;
-    if( !readWord( valStr, in))
+#ifndef _WIN32
+    for( size_t i = 0; i < m_Fds.size(); i++)
     {
-        throw CSyntErr( "expected hex ulong");
+        close( m_Fds[ i]);
     }
-    AssertHex( valStr, 8);
-    return static_cast<DWORD>( strtoul(valStr.c_str(), NULL, 16));
+#endif
 }
-DWORD readUlongParm(std::istream & in )
+bool CPortLocks::lock( const std::string &location)
 {
-    readKeyword( "{");
-    std::string valStr;
-    if( !readWord( valStr, in))
+#ifndef _WIN32
+    if( std::find( m_Locations.begin(), m_Locations.end(), location) != m_Locations.end())
     {
-        throw CSyntErr( "expected hex ulong");
+        return true;
     }
-    readKeyword( "}");
-    AssertHex( valStr, 8);
-    return static_cast<DWORD>( strtoul(valStr.c_str(), NULL, 16));
+    const char *dir = getenv( "SMT_LOCK_DIR");
+    const std::string fileName = std::string( dir && *dir ? dir : "/tmp") + "/smt-cp210x-" + location + ".lock";
+    const int fd = open( fileName.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0666);
+    if( fd < 0)
+    {
+        return true; // advisory, a port that can't be locked is anybody's
+    }
+    if( flock( fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        const bool busy = errno == EWOULDBLOCK;
+        close( fd);
+        return !busy;
+    }
+    m_Fds.push_back( fd);
+    m_Locations.push_back( location);
+#else
+    (void)location;
+#endif
+    return true;
 }
 
-// read from stdin a hex ushort
-WORD readUshort(std::istream & in )
+#ifndef _WIN32
+//---------------------------------------------------------------------------------
+// CCfgCache
+
+CCfgCache *g_pCfgCache = NULL;
+
+bool CCfgCache::open( const std::string &fileName)
 {
-    std::string valStr;
-    if( !readWord( valStr, in))
+    m_MissedName.clear();
+    // jobs run in their clients' directories, so a relative name means another file each time
+    char *path = realpath( fileName.c_str(), NULL);
+    struct stat st;
+    if( !path || stat( path, &st) != 0 || !S_ISREG( st.st_mode))
     {
-        throw CSyntErr( "expected hex ushort");
+        free( path);
+        return false;
     }
-    AssertHex( valStr, 4);
-    return static_cast<WORD>( strtoul(valStr.c_str(), NULL, 16));
+    CEntry cur;
+    cur.dev = st.st_dev;
+    cur.ino = st.st_ino;
+    cur.size = st.st_size;
+    cur.mtime = st.st_mtim.tv_sec;
+    cur.mtimeNsec = st.st_mtim.tv_nsec;
+    const std::string key( path);
+    free( path);
+
+    std::map<std::string, CEntry>::const_iterator it = m_Entries.find( key);
+    if( it != m_Entries.end() && it->second.dev == cur.dev && it->second.ino == cur.ino &&
+        it->second.size == cur.size && it->second.mtime == cur.mtime && it->second.mtimeNsec == cur.mtimeNsec)
+    {
+        const std::vector<BYTE> &img = it->second.image;
+        g_CfgFile.openBuffer( reinterpret_cast<const char *>( &img[ 0]), img.size());
+        return true;
+    }
+    // stat'ed before parsing, a change while parsing makes the next job miss rather than hit stale data
+    m_MissedName = key;
+    m_Missed = cur;
+    return false;
 }
-WORD readUshortParm(std::istream & in )
+void CCfgCache::store()
 {
-    readKeyword( "{");
-    std::string valStr;
-    if( !readWord( valStr, in))
+    if( !m_MissedName.empty())
     {
-        throw CSyntErr( "expected hex ushort");
+        m_Missed.image = g_CfgFile.image();
+        m_Entries[ m_MissedName] = m_Missed;
+        m_MissedName.clear();
     }
-    AssertHex( valStr, 4);
-    readKeyword( "}");
-    return static_cast<WORD>( strtoul(valStr.c_str(), NULL, 16));
+}
+#endif
+
+//---------------------------------------------------------------------------------
+// Token readers
+
+// value of a hex digit, 0xff if the character isn't one
+static const BYTE HexDigitVal[ 256] =
+{
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+       0,   1,   2,   3,   4,   5,   6,   7,   8,   9,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,  10,  11,  12,  13,  14,  15,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,  10,  11,  12,  13,  14,  15,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+    0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+};
+
+// decodes a token of exactly digitCnt hex digits
+static bool decodeHex( const char *tok, size_t len, size_t digitCnt, DWORD &val)
+{
+    if( len != digitCnt)
+    {
+        return false;
+    }
+    val = 0;
+    for( size_t i = 0; i < len; i++)
+    {
+        const BYTE digit = HexDigitVal[ static_cast<unsigned char>( tok[ i])];
+        if( digit == 0xff)
+        {
+            return false;
+        }
+        val = (val << 4) | digit;
+    }
+    return true;
 }
 
-// read from stdin a hex uchar
-BYTE readUchar(std::istream & in )
+static bool isToken( const char *tok, size_t len, const char *word)
 {
-    std::string valStr;
-    if( !readWord( valStr, in))
+    return strlen( word) == len && !memcmp( tok, word, len);
+}
+
+// reads a hex number of digitCnt digits
+static DWORD readHex( size_t digitCnt, const char *what)
+{
+    const char *tok;
+    size_t len;
+    DWORD val;
+    if( !g_CfgFile.nextToken( tok, len))
+    {
+        throw CSyntErr( what);
+    }
+    if( !decodeHex( tok, len, digitCnt, val))
     {
-        throw CSyntErr( "expected hex uchar");
+        throw CSyntErr( "invalid hex number size");
     }
-    AssertHex( valStr, 2);
-    return static_cast<BYTE>( strtoul(valStr.c_str(), NULL, 16));
+    return val;
 }
-BYTE readUcharParm(std::istream & in)
+
+// reads a hex number of digitCnt digits, or its item of a compiled configuration
+static DWORD readValue( BYTE tag, size_t digitCnt, const char *what)
 {
-    readKeyword( "{");
-    std::string valStr;
-    if( !readWord( valStr, in))
+    if( g_CfgFile.isCompiled())
+    {
+        return g_CfgFile.readItem( tag);
+    }
+    const DWORD val = readHex( digitCnt, what);
+    g_CfgFile.recordItem( tag, val);
+    return val;
+}
+
+// read any word, that is, a sequence without spaces
+bool readWord( std::string &word)
+{
+    const char *tok;
+    size_t len;
+    const bool found = g_CfgFile.isCompiled() ? g_CfgFile.readWordItem( tok, len) : g_CfgFile.nextToken( tok, len);
+    if( !found)
+    {
+        g_CfgFile.recordItem( CFG_ITEM_END, 0);
+        word.clear();
+        return false;
+    }
+    g_CfgFile.recordItem( CFG_ITEM_WORD, tok, len);
+    word.assign( tok, len);
+    return true;
+}
+
+// read a specific word, a compiled configuration has none
+void readKeyword( const char *keyWord)
+{
+    const char *tok;
+    size_t len;
+    if( g_CfgFile.isCompiled())
+    {
+        return;
+    }
+    if( !g_CfgFile.nextToken( tok, len) || !isToken( tok, len, keyWord))
     {
-        throw CSyntErr( "expected hex uchar");
+        throw CSyntErr( std::string( "expected ") + keyWord);
     }
-    AssertHex( valStr, 2);
+}
+
+// read a hex ulong
+DWORD readUlong()
+{
+    return readValue( CFG_ITEM_ULONG, 8, "expected hex ulong");
+}
+DWORD readUlongParm()
+{
+    readKeyword( "{");
+    const DWORD val = readValue( CFG_ITEM_ULONG, 8, "expected hex ulong");
     readKeyword( "}");
-    return static_cast<BYTE>( strtoul(valStr.c_str(), NULL, 16));
+    return val;
 }
 
-// read from stdin a byte given as 2 hex digits, else the terminator
-bool readUcharElseTerm( BYTE &val, const std::string &terminator, std::istream & in)
+// read a hex ushort
+WORD readUshort()
 {
-    std::string valStr;
-    if( !readWord( valStr, in))
+    return static_cast<WORD>( readValue( CFG_ITEM_USHORT, 4, "expected hex ushort"));
+}
+WORD readUshortParm()
+{
+    readKeyword( "{");
+    const WORD val = static_cast<WORD>( readValue( CFG_ITEM_USHORT, 4, "expected hex ushort"));
+    readKeyword( "}");
+    return val;
+}
+
+// read a hex uchar
+BYTE readUchar()
+{
+    return static_cast<BYTE>( readValue( CFG_ITEM_UCHAR, 2, "expected hex uchar"));
+}
+BYTE readUcharParm()
+{
+    readKeyword( "{");
+    const BYTE val = static_cast<BYTE>( readValue( CFG_ITEM_UCHAR, 2, "expected hex uchar"));
+    readKeyword( "}");
+    return val;
+}
+
+// read a byte given as 2 hex digits, else the terminator
+bool readUcharElseTerm( BYTE &val, const char *terminator)
+{
+    const char *tok;
+    size_t len;
+    DWORD digits;
+    if( !g_CfgFile.nextToken( tok, len))
     {
         throw CSyntErr( std::string( "expected hex byte or ") + terminator);
     }
-    if( valStr == std::string( terminator))
+    if( isToken( tok, len, terminator))
     {
         return false;
     }
-    if( valStr.size() != 2 || !isxdigit( valStr[0]) || !isxdigit( valStr[1]))
+    if( !decodeHex( tok, len, 2, digits))
     {
         throw CSyntErr( std::string( "expected hex byte or ") + terminator);
     }
-    val = static_cast<BYTE>( strtoul(valStr.c_str(), NULL, 16));
+    val = static_cast<BYTE>( digits);
     return true;
 }
 
-// read from stdin a variable-size byte array in braces
-void readByteArrayParm( std::vector<BYTE> &arr, size_t max, std::istream & in)
+// read a variable-size byte array in braces
+void readByteArrayParm( std::vector<BYTE> &arr, size_t max)
 {
-    readKeyword( "{", in);
+    if( g_CfgFile.isCompiled())
+    {
+        const char *data;
+        size_t len;
+        g_CfgFile.readItem( CFG_ITEM_BYTES, data, len);
+        if( max && len > max)
+        {
+            throw CSyntErr( "byte array too large");
+        }
+        arr.assign( data, data + len);
+        return;
+    }
+    readKeyword( "{");
     arr.clear();
+    if( max)
+    {
+        arr.reserve( max);
+    }
     BYTE b;
-    while( readUcharElseTerm( b, "}", in))
+    while( readUcharElseTerm( b, "}"))
     {
         if( max && arr.size() == max)
         {
@@ -234,12 +671,13 @@ void readByteArrayParm( std::vector<BYTE> &arr, size_t max, std::istream & in)
         }
         arr.push_back( b);
     }
+    g_CfgFile.recordItem( CFG_ITEM_BYTES, arr.empty() ? NULL : &arr[ 0], arr.size());
 }
 
-// read from stdin an exact-size byte array in braces
-void readByteArrayParmExact( std::vector<BYTE> &arr, size_t CeRequired, std::istream & in)
+// read an exact-size byte array in braces
+void readByteArrayParmExact( std::vector<BYTE> &arr, size_t CeRequired)
 {
-    readByteArrayParm( arr, CeRequired, in);
+    readByteArrayParm( arr, CeRequired);
     if( arr.size() != CeRequired)
     {
         throw CSyntErr( "byte array too small");
@@ -256,6 +694,54 @@ std::string toString( const std::vector<BYTE> &a)
     return s;
 }
 
+//---------------------------------------------------------------------------------
+void CParmImage::putUshort( WORD val)
+{
+    putUchar( static_cast<BYTE>( val));
+    putUchar( static_cast<BYTE>( val >> 8));
+}
+void CParmImage::putUlong( DWORD val)
+{
+    putUshort( static_cast<WORD>( val));
+    putUshort( static_cast<WORD>( val >> 16));
+}
+void CParmImage::putBytes( const std::vector<BYTE> &arr)
+{
+    putUshort( static_cast<WORD>( arr.size()));
+    m_Bytes.insert( m_Bytes.end(), arr.begin(), arr.end());
+}
+//---------------------------------------------------------------------------------
+void CParmJson::beginParm( const std::string &keyword)
+{
+    m_Text += m_ParmCnt++ ? ",\n  \"" : "\n  \"";
+    m_Text += keyword;
+    m_Text += "\": [";
+    m_ValCnt = 0;
+}
+void CParmJson::putNumber( DWORD val)
+{
+    char num[ 16];
+    sprintf( num, "%u", val);
+    putSeparator();
+    m_Text += num;
+}
+void CParmJson::putBytes( const std::vector<BYTE> &arr)
+{
+    static const char HexDigits[] = "0123456789ABCDEF";
+    putSeparator();
+    m_Text += '"';
+    for( size_t i = 0; i < arr.size(); i++)
+    {
+        m_Text += HexDigits[ arr[ i] >> 4];
+        m_Text += HexDigits[ arr[ i] & 0xf];
+    }
+    m_Text += '"';
+}
+std::string CParmJson::text() const
+{
+    return "{" + m_Text + ( m_ParmCnt ? "\n}" : "}");
+}
+
 unsigned short fletcher16(unsigned char *dataIn, unsigned short bytes)
 {
   unsigned short sum1 = 0xff, sum2 = 0xff;
@@ -13,7 +13,10 @@
 #include <Windows.h>
 #else
 #include "OsDep.h"
+#include <sys/types.h>
 #endif
+#include <map>
+#include <sstream>
 
 #ifdef _DEBUG
 #define ASSERT(_exp) \
@@ -33,13 +36,132 @@
 // Must use generic pointer since function is called on XDATA and CODE spaces.
 unsigned short fletcher16(unsigned char *dataIn, unsigned short bytes);
 
+// Compiled configuration (.smtc): the values the readers below returned
+// while parsing a text configuration, in order and type tagged, behind a
+// header of
+//   4 bytes  CFG_IMAGE_MAGIC
+//   u16      CFG_IMAGE_VERSION, bumped whenever the readers' sequence changes
+//   u16      reserved, 0
+//   u32      payload size
+//   u32      CRC-32 of the payload
+// all little endian. Keywords aren't stored, parsing checked them already.
+#define CFG_IMAGE_MAGIC         "SMTC"
+#define CFG_IMAGE_VERSION       1
+#define CFG_IMAGE_HEADER_SIZE   16
+
+enum
+{
+    CFG_ITEM_UCHAR = 1,
+    CFG_ITEM_USHORT,
+    CFG_ITEM_ULONG,
+    CFG_ITEM_BYTES,     // u16 count, bytes
+    CFG_ITEM_WORD,      // u8 length, chars
+    CFG_ITEM_END        // readWord() found no more words
+};
+
+// The configuration file, mapped into memory and split into whitespace
+// separated tokens in place. Tokens point into the buffer, nothing is copied.
+// A compiled configuration is recognized by its magic and served from the
+// same buffer without tokenizing.
+class CCfgFile
+{
+public:
+    CCfgFile();
+    ~CCfgFile();
+    bool open( const std::string &fileName); // false with errno set on failure
+    void setBuffer( const char *buf, size_t size); // parses a caller's buffer instead
+    void openBuffer( const char *buf, size_t size); // closes the file, then setBuffer()
+    bool nextToken( const char *&tok, size_t &len);
+    // position of the last token read, 1-based, 0 for a compiled configuration
+    void position( DWORD &line, DWORD &column) const;
+
+    bool isCompiled() const { return m_Compiled; }
+    DWORD readItem( BYTE tag);
+    void readItem( BYTE tag, const char *&data, size_t &len);
+    bool readWordItem( const char *&data, size_t &len); // false at CFG_ITEM_END
+    // records the values read from now on into an image, dropping what was recorded before
+    void startImage() { m_Image.clear(); m_Recording = true; }
+    void recordItem( BYTE tag, DWORD val);
+    void recordItem( BYTE tag, const void *data, size_t len);
+    std::vector<BYTE> image() const; // header and recorded payload, as a .smtc holds them
+    bool writeImage( const std::string &fileName) const; // false with errno set on failure
+private:
+    void close();
+    const char *m_Buf;
+    const char *m_End;
+    const char *m_Cur;
+    const char *m_Tok;
+    void       *m_Map;     // set if m_Buf is mapped
+    size_t      m_MapSize;
+    std::vector<char> m_Copy; // holds what couldn't be mapped, e.g. a pipe
+    bool        m_Compiled;
+    bool        m_Recording;
+    std::vector<BYTE> m_Image;
+};
+extern CCfgFile g_CfgFile;
+
+#ifndef _WIN32
+// Compiled images of the configuration files parsed so far, for a process that
+// runs the same files over and over (smtd). An image is served while its file
+// keeps its inode, size and modification time, a changed file is parsed again.
+class CCfgCache
+{
+public:
+    // opens the cached image of the file in g_CfgFile, false if there is none
+    bool open( const std::string &fileName);
+    // caches what g_CfgFile recorded while parsing the file open() missed last
+    void store();
+private:
+    struct CEntry
+    {
+        dev_t   dev;
+        ino_t   ino;
+        off_t   size;
+        time_t  mtime;
+        long    mtimeNsec;
+        std::vector<BYTE> image;
+    };
+    std::map<std::string, CEntry> m_Entries;
+    std::string m_MissedName;
+    CEntry      m_Missed;
+};
+extern CCfgCache *g_pCfgCache; // set by smtd only
+#endif
+
+// Advisory locks on the ports of the devices a process claims, so that
+// instances whose --ports overlap don't both drive a device. They go away with
+// the object, or with the process if it dies.
+class CPortLocks
+{
+public:
+    ~CPortLocks();
+    // false if another process holds the lock of the port
+    bool lock( const std::string &location);
+private:
+    std::vector<int> m_Fds;
+    std::vector<std::string> m_Locations; // of m_Fds
+};
+
 class CSyntErr // thrown any time the program can't continue processing input
 {
 public:
+    // the position is taken now, the parser moves on
     CSyntErr( const std::string msg )
     {
-        std::cerr << "ERROR: syntax: " << msg  << "\n";
+        DWORD line, column;
+        g_CfgFile.position( line, column);
+        std::ostringstream text;
+        text << "syntax: ";
+        if( line)
+        {
+            text << "line " << line << ", column " << column << ": ";
+        }
+        text << msg;
+        m_Msg = text.str();
     }
+    const std::string &msg() const { return m_Msg; }
+private:
+    std::string m_Msg;
 };
 
 // convenience wrappers for output
@@ -56,22 +178,60 @@ void writeByteArray( const std::vector<BYTE> &arr);
 void writeByteArray( DWORD CbArr, const BYTE *arr);
 void writeByteArrayParm( const std::vector<BYTE> &arr);
 
-bool readWord( std::string &word, std::istream & in = std::cin );
-void readKeyword( const std::string &keyWord, std::istream & in = std::cin );
-void AssertHex( const std::string &valStr, const DWORD digitCnt);
-DWORD readUlong(std::istream & in = std::cin);
-DWORD readUlongParm(std::istream & in = std::cin);
-WORD readUshort(std::istream & in = std::cin);
-WORD readUshortParm(std::istream & in = std::cin);
-BYTE readUchar(std::istream & in = std::cin);
-BYTE readUcharParm(std::istream & in = std::cin);
-bool readUcharElseTerm( BYTE &val, const std::string &terminator, std::istream & in = std::cin);
-void readByteArrayParm( std::vector<BYTE> &arr, size_t max, std::istream & in = std::cin);
-void readByteArrayParmExact( std::vector<BYTE> &arr, size_t CeRequired, std::istream & in = std::cin);
+// readers of the tokens of g_CfgFile
+bool readWord( std::string &word);
+void readKeyword( const char *keyWord);
+DWORD readUlong();
+DWORD readUlongParm();
+WORD readUshort();
+WORD readUshortParm();
+BYTE readUchar();
+BYTE readUcharParm();
+bool readUcharElseTerm( BYTE &val, const char *terminator);
+void readByteArrayParm( std::vector<BYTE> &arr, size_t max);
+void readByteArrayParmExact( std::vector<BYTE> &arr, size_t CeRequired);
 
 extern bool g_EchoParserReads;
 
 // misc
 std::string toString( const std::vector<BYTE> &a);
 
+// Writers of customization parameter values, see save() of the parameter classes.
+// A parameter is written as beginParm(), its values and endParm().
+
+// binary image, little endian, byte arrays prefixed by a u16 count; equal
+// images mean equal values
+struct CParmImage
+{
+    void beginParm( const std::string &) {}
+    void putUchar( BYTE val) { m_Bytes.push_back( val); }
+    void putUshort( WORD val);
+    void putUlong( DWORD val);
+    void putBytes( const std::vector<BYTE> &arr);
+    void endParm() {}
+    const std::vector<BYTE> &bytes() const { return m_Bytes; }
+private:
+    std::vector<BYTE> m_Bytes;
+};
+
+// JSON object with a member per parameter, named as in the configuration file;
+// its value is the array of the parameter's numbers, byte arrays as hex strings
+struct CParmJson
+{
+    CParmJson() : m_ParmCnt( 0), m_ValCnt( 0) {}
+    void beginParm( const std::string &keyword);
+    void putUchar( BYTE val) { putNumber( val); }
+    void putUshort( WORD val) { putNumber( val); }
+    void putUlong( DWORD val) { putNumber( val); }
+    void putBytes( const std::vector<BYTE> &arr);
+    void endParm() { m_Text += " ]"; }
+    std::string text() const;
+private:
+    void putNumber( DWORD val);
+    void putSeparator() { m_Text += m_ValCnt++ ? ", " : " "; }
+    std::string m_Text;
+    DWORD m_ParmCnt;
+    DWORD m_ValCnt;
+};
+
 #endif // __SLABUTIL_H__
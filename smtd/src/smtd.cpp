@@ -0,0 +1,292 @@
+// smtd, the daemon smt-cp210x --daemon hands its commands over to, see smtd.h.
+// It runs the commands of all its clients in one process, so the library's
+// libusb context, whose device list libusb keeps up to date on hotplug events,
+// and its registry of probed part numbers (CP210x_KeepDeviceRegistry()) serve
+// every command, as does the cache of parsed configurations. Commands run one at
+// a time, which gives the station scripts sharing it one view of the bus.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "util.h"
+#include "smt.h"
+#include "smtd.h"
+#include "CP210xManufacturing.h"
+
+static volatile sig_atomic_t g_Stop = 0;
+
+static void onStopSignal( int)
+{
+    g_Stop = 1;
+}
+
+//---------------------------------------------------------------------------------
+// one job of a client, see smtd.h
+
+// reads cb bytes, the first ones with the client's file descriptors
+static bool recvJob( int conn, char *buf, size_t cb, std::vector<int> &fds)
+{
+    char control[ CMSG_SPACE( SMTD_JOB_FD_CNT * sizeof( int))];
+    iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = cb;
+    msghdr msg;
+    memset( &msg, 0, sizeof( msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof( control);
+    ssize_t got = recvmsg( conn, &msg, 0);
+    for( cmsghdr *cmsg = CMSG_FIRSTHDR( &msg); got > 0 && cmsg; cmsg = CMSG_NXTHDR( &msg, cmsg))
+    {
+        if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            const int *p = reinterpret_cast<const int *>( CMSG_DATA( cmsg));
+            fds.assign( p, p + (cmsg->cmsg_len - CMSG_LEN( 0)) / sizeof( int));
+        }
+    }
+    size_t done = got > 0 ? got : 0;
+    while( got > 0 && done < cb)
+    {
+        got = recv( conn, buf + done, cb - done, 0);
+        done += got > 0 ? got : 0;
+    }
+    return done == cb;
+}
+
+static bool recvAll( int conn, char *buf, size_t cb)
+{
+    size_t done = 0;
+    ssize_t got = 1;
+    while( done < cb && (got = recv( conn, buf + done, cb - done, 0)) > 0)
+    {
+        done += got;
+    }
+    return done == cb;
+}
+
+// runs the command in the client's directory with its stdin, stdout and stderr
+static int runJob( const std::vector<char> &job, const std::vector<int> &fds)
+{
+    const char *cwd = &job[ 0];
+    std::vector<const char *> argv( 1, "smt-cp210x");
+    for( const char *p = cwd + strlen( cwd) + 1; p < &job[ 0] + job.size(); p += strlen( p) + 1)
+    {
+        argv.push_back( p);
+    }
+
+    const int ownCwd = open( ".", O_RDONLY);
+    int saved[ SMTD_JOB_FD_CNT];
+    fflush( stdout);
+    std::cout.flush();
+    for( int i = 0; i < SMTD_JOB_FD_CNT; i++)
+    {
+        saved[ i] = dup( i);
+        dup2( fds[ i], i);
+    }
+
+    int rc = 1;
+    if( chdir( cwd) != 0)
+    {
+        std::cerr << "ERROR: smtd: can't enter " << cwd << "\n";
+    }
+    else
+    {
+        try
+        {
+            rc = smtMain( static_cast<int>( argv.size()), &argv[ 0]);
+        }
+        catch( ...)
+        {
+            std::cerr << "ERROR: smtd: job failed\n";
+        }
+    }
+
+    fflush( stdout);
+    std::cout.flush();
+    for( int i = 0; i < SMTD_JOB_FD_CNT; i++)
+    {
+        dup2( saved[ i], i);
+        close( saved[ i]);
+    }
+    clearerr( stdout); // the client may have gone away while it printed
+    if( ownCwd >= 0)
+    {
+        if( fchdir( ownCwd) != 0)
+        {
+            perror( "smtd: fchdir");
+        }
+        close( ownCwd);
+    }
+    return rc;
+}
+
+struct CJob
+{
+    const std::vector<char> *m_pJob;
+    const std::vector<int>  *m_pFds;
+    int                     m_Rc;
+    volatile bool           m_Done;
+};
+
+static void *jobThread( void *p)
+{
+    CJob *job = static_cast<CJob *>( p);
+    job->m_Rc = runJob( *job->m_pJob, *job->m_pFds);
+    job->m_Done = true;
+    return NULL;
+}
+
+// runs the job while watching the connection: the client only waits for the exit
+// code, so the socket turns readable or hangs up only when the client went away
+static int runWatchedJob( int conn, const std::vector<char> &job, const std::vector<int> &fds)
+{
+    CJob j = { &job, &fds, 1, false };
+    pthread_t thread;
+    g_JobCancelled = false;
+    if( pthread_create( &thread, NULL, jobThread, &j) != 0)
+    {
+        perror( "smtd: pthread_create");
+        return 1;
+    }
+    pollfd pfd;
+    pfd.fd = conn;
+    pfd.events = POLLIN | POLLRDHUP;
+    while( !j.m_Done)
+    {
+        if( poll( &pfd, 1, CANCEL_POLL_MSEC) > 0)
+        {
+            g_JobCancelled = true; // the job throws CCancelErr at its next wait
+            break;
+        }
+    }
+    pthread_join( thread, NULL);
+    if( g_JobCancelled)
+    {
+        std::cerr << "smtd: the client went away, cancelled its job\n";
+        g_JobCancelled = false;
+    }
+    return j.m_Rc;
+}
+
+static void serveClient( int conn)
+{
+    DWORD size = 0;
+    std::vector<int> fds;
+    const bool gotSize = recvJob( conn, reinterpret_cast<char *>( &size), sizeof( size), fds);
+    std::vector<char> job;
+    if( gotSize && size && size <= SMTD_MAX_JOB_SIZE && fds.size() == SMTD_JOB_FD_CNT)
+    {
+        job.resize( size);
+        if( recvAll( conn, &job[ 0], size) && job.back() == '\0')
+        {
+            const int rc = runWatchedJob( conn, job, fds);
+            send( conn, &rc, sizeof( rc), 0);
+        }
+    }
+    for( size_t i = 0; i < fds.size(); i++)
+    {
+        close( fds[ i]);
+    }
+}
+
+//---------------------------------------------------------------------------------
+
+int main( int argc, const char * argv[])
+{
+    if( argc != 2 || !strcmp( argv[ 1], "--help"))
+    {
+        printf( "Usage: smtd socket_path\n"
+                "    Serves the commands of smt-cp210x --daemon socket_path until\n"
+                "    SIGTERM or SIGINT. Verification gets at most %d attempts.\n", SMTD_MAX_VERIFY_ATTEMPTS);
+        return argc == 2 ? 0 : 1;
+    }
+    const char *socketPath = argv[ 1];
+
+    sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr));
+    addr.sun_family = AF_UNIX;
+    if( strlen( socketPath) >= sizeof( addr.sun_path))
+    {
+        std::cerr << "ERROR: smtd: socket path too long\n";
+        return 1;
+    }
+    strcpy( addr.sun_path, socketPath);
+    // a socket left behind by a smtd that died is taken over, a live one isn't
+    const int probe = socket( AF_UNIX, SOCK_STREAM, 0);
+    const bool live = probe >= 0 && connect( probe, reinterpret_cast<sockaddr *>( &addr), sizeof( addr)) == 0;
+    if( probe >= 0)
+    {
+        close( probe);
+    }
+    if( live)
+    {
+        std::cerr << "ERROR: smtd: already serving at " << socketPath << "\n";
+        return 1;
+    }
+    unlink( socketPath);
+    const int listener = socket( AF_UNIX, SOCK_STREAM, 0);
+    if( listener < 0)
+    {
+        perror( "smtd: socket");
+        return 1;
+    }
+    // anyone who can connect runs commands on the devices: the socket is created
+    // private and opened up to the group only, whatever the umask
+    const mode_t oldMask = umask( 0177);
+    const bool bound = bind( listener, reinterpret_cast<sockaddr *>( &addr), sizeof( addr)) == 0;
+    umask( oldMask);
+    if( !bound || chmod( socketPath, SMTD_SOCKET_MODE) != 0 || listen( listener, 16) != 0)
+    {
+        perror( "smtd: bind");
+        close( listener);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset( &sa, 0, sizeof( sa));
+    sa.sa_handler = onStopSignal; // no SA_RESTART, accept() returns on them
+    sigaction( SIGTERM, &sa, NULL);
+    sigaction( SIGINT, &sa, NULL);
+    signal( SIGPIPE, SIG_IGN);
+
+    if( CP210x_KeepDeviceRegistry( TRUE) != CP210x_SUCCESS)
+    {
+        std::cerr << "ERROR: smtd: can't keep the device registry\n";
+    }
+    CCfgCache cfgCache;
+    g_pCfgCache = &cfgCache;
+    g_MaxVerifyAttempts = SMTD_MAX_VERIFY_ATTEMPTS;
+
+    while( !g_Stop)
+    {
+        const int conn = accept( listener, NULL, NULL);
+        if( conn < 0)
+        {
+            if( errno != EINTR)
+            {
+                perror( "smtd: accept");
+                break;
+            }
+            continue;
+        }
+        serveClient( conn);
+        close( conn);
+    }
+
+    g_pCfgCache = NULL;
+    close( listener);
+    unlink( socketPath);
+    return 0;
+}